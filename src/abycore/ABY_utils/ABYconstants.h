@@ -43,6 +43,8 @@
 
 #define ABY_PARTY_CHANNEL (MAX_NUM_COMM_CHANNELS-3)
 #define ABY_SETUP_CHANNEL (ABY_PARTY_CHANNEL-1)
+#define YAO_PIPELINE_CHANNEL (ABY_SETUP_CHANNEL-1)
+#define YAO_REV_PIPELINE_CHANNEL (ABY_SETUP_CHANNEL-2)
 #define DJN_CHANNEL	32
 #define DGK_CHANNEL DJN_CHANNEL
 
@@ -114,6 +116,8 @@ enum e_gatetype {
 	G_TT = 0x0A, /**< Enum for computing an arbitrary truth table gate. Is needed for the 1ooN OT in SPLUT */
 	G_SHARED_IN = 0x0B, /**< Enum for pre-shared input gate, where the parties dont secret-share (e.g. in outsourcing) */
 	G_NON_LIN_CONST = 0x0C, /**< Enum for non-linear gate with a constant input (AND in boolean circuits, MUL in arithmetic circuits. One of the parents need to be a CONST gate */
+	G_NON_LIN_DOT = 0x0D, /**< Enum for DOT-PRODUCT gates (sum over the element-wise MULs of two multi-value gates in arithmetic circuits) */
+	G_NON_LIN_MAT = 0x0E, /**< Enum for MATRIX-MULTIPLICATION gates (product of two multi-value gates that hold row-major matrices in arithmetic circuits) */
 	G_PRINT_VAL = 0x40, /**< Enum gate that reconstructs the shares and prints the plaintext value with the designated string */
 	G_ASSERT = 0x41, /**< Enum gate that reconstructs the shares and compares it to an provided input plaintext value */
 	G_COMBINE = 0x80, /**< Enum for COMBINER gates that combine multiple single-value gates to one multi-value gate  */
@@ -252,6 +256,8 @@ static std::string get_gate_type_name(e_gatetype g) {
 	case G_NON_LIN: return "Non-Linear";
 	case G_NON_LIN_VEC: return "Vector-Non-Linear";
 	case G_NON_LIN_CONST: return "Constant-Non-Linear";
+	case G_NON_LIN_DOT: return "Dot-Product";
+	case G_NON_LIN_MAT: return "Matrix-Multiplication";
 	case G_IN: return "Input";
 	case G_OUT: return "Output";
 	case G_SHARED_OUT: return "Shared output";
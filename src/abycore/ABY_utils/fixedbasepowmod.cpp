@@ -0,0 +1,135 @@
+/**
+ \file 		fixedbasepowmod.cpp
+ \author	agent@local
+ \copyright	ABY - A Framework for Efficient Mixed-protocol Secure Two-party Computation
+			Copyright (C) 2015 Engineering Cryptographic Protocols Group, TU Darmstadt
+			This program is free software: you can redistribute it and/or modify
+			it under the terms of the GNU Affero General Public License as published
+			by the Free Software Foundation, either version 3 of the License, or
+			(at your option) any later version.
+			This program is distributed in the hope that it will be useful,
+			but WITHOUT ANY WARRANTY; without even the implied warranty of
+			MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+			GNU Affero General Public License for more details.
+			You should have received a copy of the GNU Affero General Public License
+			along with this program. If not, see <http://www.gnu.org/licenses/>.
+ \brief		Fixed-base modular exponentiation with precomputed tables
+ */
+
+#include "fixedbasepowmod.h"
+#include <cstdlib>
+#include <iostream>
+
+FixedBasePowMod::FixedBasePowMod(const mpz_t base, const mpz_t mod, uint32_t expbits, uint32_t windowbits) :
+		FixedBasePowMod(base, mod, expbits, windowbits, TRUE) {
+}
+
+FixedBasePowMod::FixedBasePowMod(const mpz_t base, const mpz_t mod, uint32_t expbits, uint32_t windowbits, BOOL compute) :
+		m_zBase(), m_zMod(), m_nExpBits(expbits), m_nWindowBits(windowbits), m_nWindows((expbits + windowbits - 1) / windowbits),
+		m_nWindowSize(1 << windowbits), m_pTable((mpz_t*) malloc(sizeof(mpz_t) * m_nWindows * m_nWindowSize)) {
+	if (m_pTable == NULL) {
+		std::cerr << "Memory allocation not successful for a fixed-base table of " << m_nWindows * m_nWindowSize << " values" << std::endl;
+		exit(0);
+	}
+	mpz_init_set(m_zBase, base);
+	mpz_init_set(m_zMod, mod);
+	for (uint32_t i = 0; i < m_nWindows * m_nWindowSize; i++) {
+		mpz_init(m_pTable[i]);
+	}
+	if (compute)
+		computeTable();
+}
+
+void FixedBasePowMod::computeTable() {
+	//cur = base^(2^(w*i)) for the current window i
+	mpz_t cur;
+	mpz_init(cur);
+	mpz_mod(cur, m_zBase, m_zMod);
+	for (uint32_t i = 0; i < m_nWindows; i++) {
+		mpz_t* window = m_pTable + i * m_nWindowSize;
+		mpz_set_ui(window[0], 1);
+		for (uint32_t j = 1; j < m_nWindowSize; j++) {
+			mpz_mul(window[j], window[j - 1], cur);
+			mpz_mod(window[j], window[j], m_zMod);
+		}
+		mpz_mul(cur, window[m_nWindowSize - 1], cur);
+		mpz_mod(cur, cur, m_zMod);
+	}
+	mpz_clear(cur);
+}
+
+FixedBasePowMod::~FixedBasePowMod() {
+	for (uint32_t i = 0; i < m_nWindows * m_nWindowSize; i++) {
+		mpz_clear(m_pTable[i]);
+	}
+	free(m_pTable);
+	mpz_clears(m_zBase, m_zMod, NULL);
+}
+
+void FixedBasePowMod::powmod(mpz_t res, const mpz_t exp) {
+	if (mpz_sizeinbase(exp, 2) > m_nExpBits) {
+		mpz_powm(res, m_zBase, exp, m_zMod);
+		return;
+	}
+
+	//res might be the same variable as exp, hence the product is accumulated separately
+	mpz_t acc;
+	mpz_init_set_ui(acc, 1);
+	for (uint32_t i = 0, bit = 0; i < m_nWindows; i++) {
+		uint32_t j = 0;
+		for (uint32_t k = 0; k < m_nWindowBits; k++, bit++) {
+			j |= mpz_tstbit(exp, bit) << k;
+		}
+		if (j) {
+			mpz_mul(acc, acc, m_pTable[i * m_nWindowSize + j]);
+			mpz_mod(acc, acc, m_zMod);
+		}
+	}
+	mpz_swap(res, acc);
+	mpz_clear(acc);
+}
+
+BOOL FixedBasePowMod::Write(FILE* fp) {
+	uint32_t sizes[2] = { m_nExpBits, m_nWindowBits };
+	if (fwrite(sizes, sizeof(uint32_t), 2, fp) != 2)
+		return FALSE;
+	for (uint32_t i = 0; i < m_nWindows * m_nWindowSize; i++) {
+		if (!mpz_out_raw(fp, m_pTable[i]))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+FixedBasePowMod* FixedBasePowMod::Read(FILE* fp, const mpz_t base, const mpz_t mod, uint32_t expbits, uint32_t windowbits) {
+	uint32_t sizes[2];
+	if (fread(sizes, sizeof(uint32_t), 2, fp) != 2 || sizes[0] != expbits || sizes[1] != windowbits)
+		return NULL;
+
+	FixedBasePowMod* table = new FixedBasePowMod(base, mod, expbits, windowbits, FALSE);
+	BOOL match = TRUE;
+	for (uint32_t i = 0; i < table->m_nWindows * table->m_nWindowSize && match; i++) {
+		match = mpz_inp_raw(table->m_pTable[i], fp) && mpz_sgn(table->m_pTable[i]) >= 0 && mpz_cmp(table->m_pTable[i], mod) < 0;
+	}
+
+	//value 1 of the first window is the base and value 1 of each further window is the last value of the previous
+	//window times its value 1, which does not hold for the table of another base or modulus
+	mpz_t expected;
+	mpz_init(expected);
+	if (match) {
+		mpz_mod(expected, base, mod);
+		match = mpz_cmp(table->m_pTable[1], expected) == 0;
+	}
+	for (uint32_t i = 1; i < table->m_nWindows && match; i++) {
+		mpz_t* prev = table->m_pTable + (i - 1) * table->m_nWindowSize;
+		mpz_mul(expected, prev[table->m_nWindowSize - 1], prev[1]);
+		mpz_mod(expected, expected, mod);
+		match = mpz_cmp(table->m_pTable[i * table->m_nWindowSize + 1], expected) == 0;
+	}
+	mpz_clear(expected);
+
+	if (!match) {
+		delete table;
+		return NULL;
+	}
+	return table;
+}
@@ -0,0 +1,86 @@
+/**
+ \file 		fixedbasepowmod.h
+ \author	agent@local
+ \copyright	ABY - A Framework for Efficient Mixed-protocol Secure Two-party Computation
+			Copyright (C) 2015 Engineering Cryptographic Protocols Group, TU Darmstadt
+			This program is free software: you can redistribute it and/or modify
+			it under the terms of the GNU Affero General Public License as published
+			by the Free Software Foundation, either version 3 of the License, or
+			(at your option) any later version.
+			This program is distributed in the hope that it will be useful,
+			but WITHOUT ANY WARRANTY; without even the implied warranty of
+			MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+			GNU Affero General Public License for more details.
+			You should have received a copy of the GNU Affero General Public License
+			along with this program. If not, see <http://www.gnu.org/licenses/>.
+ \brief		Fixed-base modular exponentiation with precomputed tables
+ */
+
+#ifndef __FIXEDBASEPOWMOD_H__
+#define __FIXEDBASEPOWMOD_H__
+
+#include <gmp.h>
+#include <cstdint>
+#include <cstdio>
+#include <ENCRYPTO_utils/typedefs.h>
+
+/**
+ Precomputed table for the modular exponentiation of a fixed base. The exponent is split into windows of w bits and the
+ table holds base^(j * 2^(w*i)) mod m for every window i and every window value j, such that an exponentiation takes one
+ modular multiplication per window and no squarings.
+
+ Unlike the tables of ENCRYPTO_utils/powmod.h, which are global and exist once for g and h, every object has its own
+ table. The table is only read after the construction, hence powmod can be called by several threads at once.
+ */
+class FixedBasePowMod {
+public:
+	/**
+	 Computes the table.
+	 \param base		Fixed base
+	 \param mod			Modulus
+	 \param expbits		Maximum bit-length of the exponents
+	 \param windowbits	Bits of the exponent that are processed per multiplication. The table holds ceil(expbits / windowbits) * 2^windowbits values.
+	 */
+	FixedBasePowMod(const mpz_t base, const mpz_t mod, uint32_t expbits, uint32_t windowbits);
+	~FixedBasePowMod();
+	FixedBasePowMod(const FixedBasePowMod&) = delete;
+	FixedBasePowMod& operator=(const FixedBasePowMod&) = delete;
+
+	/**
+	 Computes res = base^exp mod m. Exponents with more than expbits bits are computed with mpz_powm.
+	 \param res	Result, must be initialized
+	 \param exp	Non-negative exponent
+	 */
+	void powmod(mpz_t res, const mpz_t exp);
+
+	/**
+	 Writes the table to a file, such that it can be read with Read instead of being computed again. The base and the
+	 modulus are not written, but the table values reveal the modulus, hence the file has to be protected like it.
+	 \param fp	File that is open for writing
+	 \return TRUE on success
+	 */
+	BOOL Write(FILE* fp);
+
+	/**
+	 Reads a table that was written with Write. That the table belongs to base and mod is checked with one modular
+	 multiplication per window.
+	 \param fp	File that is open for reading
+	 \return The table, or NULL if the file does not hold a table for the same base, modulus, expbits and windowbits
+	 */
+	static FixedBasePowMod* Read(FILE* fp, const mpz_t base, const mpz_t mod, uint32_t expbits, uint32_t windowbits);
+
+private:
+	/** Allocates the table without computing it */
+	FixedBasePowMod(const mpz_t base, const mpz_t mod, uint32_t expbits, uint32_t windowbits, BOOL compute);
+	void computeTable();
+
+	mpz_t m_zBase;
+	mpz_t m_zMod;
+	uint32_t m_nExpBits;
+	uint32_t m_nWindowBits;
+	uint32_t m_nWindows;
+	uint32_t m_nWindowSize; /**< 2^windowbits, the number of table values per window */
+	mpz_t* m_pTable; /**< Value j of window i is at m_pTable[i * m_nWindowSize + j] */
+};
+
+#endif /* __FIXEDBASEPOWMOD_H__ */
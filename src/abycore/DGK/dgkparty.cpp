@@ -19,32 +19,32 @@
 #include "dgkparty.h"
 #include <ENCRYPTO_utils/timer.h>
 #include <ENCRYPTO_utils/utils.h>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #define CHECKMT 0
 #define DGK_DEBUG 0
 #define NETDEBUG 0
 #define WINDOWSIZE 65536 //maximum size of a network packet in Byte
+#define DGK_FB_WINDOW 6 //exponent bits per multiplication in the fixed-base tables
+#define DGK_RAND_BITS 400 // 2.5 * t = 2.5 * 160 = 400 bit
+
+/**
+ * writes a share with leading zeros, since mpz_export omits them
+ */
+static void exportShare(BYTE* buf, mpz_t share, UINT shareBytes) {
+	memset(buf, 0, shareBytes);
+	mpz_export(buf, NULL, 1, shareBytes, 0, 0, share);
+}
 
 /**
  * initializes a DGK_Party with the asymmetric security parameter and the sharelength and exchanges public keys.
  * @param mode - 0 = generate new key; 1 = read key
  */
-DGKParty::DGKParty(UINT DGKbits, UINT sharelen, channel* chan, UINT readkey) {
-
-	m_nShareLength = sharelen;
-	m_nDGKbits = DGKbits;
-	m_nBuflen = DGKbits / 8 + 1; //size of one ciphertext to send via network. DGK uses n bits == n/8 bytes
-
-#if DEBUG
-	cout << "Created party with " << DGKbits << " key bits and" << sharelen << " bit shares" << endl;
-#endif
-
-	if (readkey) {
-		readKey();
-	} else {
-		generateKey();
-	}
-
+DGKParty::DGKParty(UINT DGKbits, UINT sharelen, channel* chan, UINT readkey) :
+		DGKParty(DGKbits, sharelen, readkey) {
 	keyExchange(chan);
 }
 
@@ -52,12 +52,13 @@ DGKParty::DGKParty(UINT DGKbits, UINT sharelen, channel* chan, UINT readkey) {
  * initializes a DGK_Party with the asymmetric security parameter and the sharelength.
  * @param mode - 0 = generate new key; 1 = read key
  * Public keys must be exchanged manually when using this constructor!
+ * A ciphertext is sent with DGKbits / 8 + 1 bytes.
  */
-DGKParty::DGKParty(UINT DGKbits, UINT sharelen, UINT readkey) {
-
-	m_nShareLength = sharelen;
-	m_nDGKbits = DGKbits;
-	m_nBuflen = DGKbits / 8 + 1; //size of one ciphertext to send via network. DGK uses n bits == n/8 bytes
+DGKParty::DGKParty(UINT DGKbits, UINT sharelen, UINT readkey) :
+		m_nNumMTThreads(1), m_nShareLength(sharelen), m_nDGKbits(DGKbits), m_nBuflen(DGKbits / 8 + 1), m_localpub(NULL),
+		m_remotepub(NULL), m_prv(NULL), m_zQInv(), m_cFBLocalGP(NULL), m_cFBLocalHP(NULL), m_cFBLocalGQ(NULL),
+		m_cFBLocalHQ(NULL), m_cFBRemoteG(NULL), m_cFBRemoteH(NULL) {
+	mpz_init(m_zQInv);
 
 #if DGK_DEBUG
 	cout << "Created party with " << DGKbits << " key bits and" << sharelen << " bit shares" << endl;
@@ -75,6 +76,7 @@ void DGKParty::readKey() {
 	cout << "KeyGen" << endl;
 #endif
 	dgk_readkey(m_nDGKbits, m_nShareLength, &m_localpub, &m_prv);
+	precomputeLocalTables(TRUE);
 #if DGK_DEBUG
 	cout << "key read." << endl;
 #endif
@@ -85,11 +87,120 @@ void DGKParty::generateKey() {
 	cout << "KeyGen" << endl;
 #endif
 	dgk_keygen(m_nDGKbits, m_nShareLength, &m_localpub, &m_prv);
+	precomputeLocalTables(FALSE);
 #if DEBUG
 	cout << "key generated." << endl;
 #endif
 }
 
+void DGKParty::freeLocalTables() {
+	delete m_cFBLocalGP;
+	delete m_cFBLocalHP;
+	delete m_cFBLocalGQ;
+	delete m_cFBLocalHQ;
+	m_cFBLocalGP = NULL;
+	m_cFBLocalHP = NULL;
+	m_cFBLocalGQ = NULL;
+	m_cFBLocalHQ = NULL;
+}
+
+void DGKParty::precomputeLocalTables(BOOL cached) {
+	UINT gbits = 2 * m_nShareLength + 2;
+	mpz_t gp, hp, gq, hq;
+	mpz_inits(gp, hp, gq, hq, NULL);
+	mpz_mod(gp, m_localpub->g, m_prv->p);
+	mpz_mod(hp, m_localpub->h, m_prv->p);
+	mpz_mod(gq, m_localpub->g, m_prv->q);
+	mpz_mod(hq, m_localpub->h, m_prv->q);
+	mpz_invert(m_zQInv, m_prv->q, m_prv->p);
+
+	freeLocalTables();
+
+	char filename[64];
+	snprintf(filename, sizeof(filename), DGK_TABLE_FILE, m_nDGKbits, (UINT) m_nShareLength);
+	FILE* fp = NULL;
+	struct stat st;
+	if (cached && (fp = fopen(filename, "rb")) != NULL) {
+		//a cache that others can read or write is not trusted and is replaced by one that only the owner can access
+		if (fstat(fileno(fp), &st) != 0 || st.st_uid != geteuid() || (st.st_mode & (S_IRWXG | S_IRWXO))) {
+			std::cerr << "Warning: Ignoring the DGK tables in " << filename << ", which are accessible by other users" << std::endl;
+			fclose(fp);
+			fp = NULL;
+		}
+	}
+	if (cached && fp) {
+		//the tables are only taken if all of them belong to the current key
+		m_cFBLocalGP = FixedBasePowMod::Read(fp, gp, m_prv->p, gbits, DGK_FB_WINDOW);
+		m_cFBLocalHP = m_cFBLocalGP ? FixedBasePowMod::Read(fp, hp, m_prv->p, DGK_RAND_BITS, DGK_FB_WINDOW) : NULL;
+		m_cFBLocalGQ = m_cFBLocalHP ? FixedBasePowMod::Read(fp, gq, m_prv->q, gbits, DGK_FB_WINDOW) : NULL;
+		m_cFBLocalHQ = m_cFBLocalGQ ? FixedBasePowMod::Read(fp, hq, m_prv->q, DGK_RAND_BITS, DGK_FB_WINDOW) : NULL;
+		fclose(fp);
+	}
+
+	if (!m_cFBLocalHQ) {
+		freeLocalTables();
+		m_cFBLocalGP = new FixedBasePowMod(gp, m_prv->p, gbits, DGK_FB_WINDOW);
+		m_cFBLocalHP = new FixedBasePowMod(hp, m_prv->p, DGK_RAND_BITS, DGK_FB_WINDOW);
+		m_cFBLocalGQ = new FixedBasePowMod(gq, m_prv->q, gbits, DGK_FB_WINDOW);
+		m_cFBLocalHQ = new FixedBasePowMod(hq, m_prv->q, DGK_RAND_BITS, DGK_FB_WINDOW);
+
+		if (cached) {
+			//the file is renamed after it was written, such that a party that runs in the same directory never reads a partial file.
+			//It is created for the owner only, since the tables reveal the private key.
+			char tmpname[80];
+			snprintf(tmpname, sizeof(tmpname), "%s.%d", filename, (int) getpid());
+			int fd = open(tmpname, O_WRONLY | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+			fp = fd >= 0 ? fdopen(fd, "wb") : NULL;
+			if (fd >= 0 && !fp)
+				close(fd);
+			BOOL success = fp && m_cFBLocalGP->Write(fp) && m_cFBLocalHP->Write(fp) && m_cFBLocalGQ->Write(fp) && m_cFBLocalHQ->Write(fp);
+			if (fp)
+				success = (fclose(fp) == 0) && success;
+			if (!success || rename(tmpname, filename) != 0) {
+				std::cerr << "Warning: Unable to store the DGK tables in " << filename << std::endl;
+				remove(tmpname);
+			}
+		}
+	}
+
+	mpz_clears(gp, hp, gq, hq, NULL);
+}
+
+/**
+ * encrypts plaintext with the local key modulo p and q: res = g^m * h^r mod n. r, tp and tq are temporaries. res may be plaintext.
+ */
+void DGKParty::encryptCRT(mpz_t res, mpz_t plaintext, mpz_t r, mpz_t tp, mpz_t tq) {
+	aby_prng(r, DGK_RAND_BITS);
+
+	m_cFBLocalGP->powmod(tp, plaintext);
+	m_cFBLocalHP->powmod(tq, r);
+	mpz_mul(tp, tp, tq);
+	mpz_mod(tp, tp, m_prv->p);
+
+	m_cFBLocalGQ->powmod(tq, plaintext);
+	m_cFBLocalHQ->powmod(r, r);
+	mpz_mul(tq, tq, r);
+	mpz_mod(tq, tq, m_prv->q);
+
+	// res = tq + q * ((tp - tq) * q^-1 mod p)
+	mpz_sub(tp, tp, tq);
+	mpz_mul(tp, tp, m_zQInv);
+	mpz_mod(tp, tp, m_prv->p);
+	mpz_mul(tp, tp, m_prv->q);
+	mpz_add(res, tp, tq);
+}
+
+/**
+ * encrypts plaintext with the remote key: res = g^m * h^r mod n. r is a temporary. res may be plaintext.
+ */
+void DGKParty::encryptRemote(mpz_t res, mpz_t plaintext, mpz_t r) {
+	aby_prng(r, DGK_RAND_BITS);
+	m_cFBRemoteH->powmod(r, r);
+	m_cFBRemoteG->powmod(res, plaintext);
+	mpz_mul(res, res, r);
+	mpz_mod(res, res, m_remotepub->n);
+}
+
 /**
  * deletes party and frees keys
  */
@@ -97,6 +208,11 @@ DGKParty::~DGKParty() {
 #if DGK_DEBUG
 	cout << "Deleting DGKParty..." << endl;
 #endif
+	freeLocalTables();
+	delete m_cFBRemoteG;
+	delete m_cFBRemoteH;
+	mpz_clear(m_zQInv);
+
 	dgk_freeprvkey(m_prv);
 	dgk_freepubkey(m_localpub);
 	dgk_freepubkey(m_remotepub);
@@ -119,27 +235,13 @@ void DGKParty::preCompBench(BYTE * bA, BYTE * bB, BYTE * bC, BYTE * bA1, BYTE *
 	cout << "dgkbits: " << m_nDGKbits << " sharelen: " << m_nShareLength << endl;
 #endif
 
-	mpz_t r, x, y, z;
-	mpz_inits(r, x, y, z, NULL);
-
-	// shares for server part
-	mpz_t a[numMTs];
-	mpz_t b[numMTs];
-	mpz_t c[numMTs];
-
-	// shares for client part
-	mpz_t a1[numMTs];
-	mpz_t b1[numMTs];
-	mpz_t c1[numMTs];
-
-	for (UINT i = 0; i < numMTs; i++) {
-		mpz_inits(a[i], b[i], c[i], a1[i], b1[i], c1[i], NULL);
-	}
+	mpz_t r, x, y, z, a, b, c, tp, tq;
+	mpz_inits(r, x, y, z, a, b, c, tp, tq, NULL);
 
 	//allocate buffers for mpz_t ciphertext #numMTs with m_nBuflen
-	BYTE * abuf = (BYTE*) calloc(numMTs * m_nBuflen, 1);
-	BYTE * bbuf = (BYTE*) calloc(numMTs * m_nBuflen, 1);
-	BYTE * zbuf = (BYTE*) calloc(numMTs * m_nBuflen, 1);
+	BYTE * abuf = (BYTE*) calloc((uint64_t) numMTs * m_nBuflen, 1);
+	BYTE * bbuf = (BYTE*) calloc((uint64_t) numMTs * m_nBuflen, 1);
+	BYTE * zbuf = (BYTE*) calloc((uint64_t) numMTs * m_nBuflen, 1);
 
 	clock_gettime(CLOCK_MONOTONIC, &start);
 
@@ -148,30 +250,30 @@ void DGKParty::preCompBench(BYTE * bA, BYTE * bB, BYTE * bC, BYTE * bA1, BYTE *
 		mpz_import(x, 1, 1, shareBytes, 0, 0, bA + i * shareBytes);
 		mpz_import(y, 1, 1, shareBytes, 0, 0, bB + i * shareBytes);
 
-		dgk_encrypt_crt(r, m_localpub, m_prv, x);
-		mpz_export(abuf + i * m_nBuflen, NULL, -1, 1, 1, 0, r);
-		dgk_encrypt_crt(z, m_localpub, m_prv, y);
-		mpz_export(bbuf + i * m_nBuflen, NULL, -1, 1, 1, 0, z);
+		encryptCRT(x, x, r, tp, tq);
+		mpz_export(abuf + (uint64_t) i * m_nBuflen, NULL, -1, 1, 1, 0, x);
+		encryptCRT(y, y, r, tp, tq);
+		mpz_export(bbuf + (uint64_t) i * m_nBuflen, NULL, -1, 1, 1, 0, y);
 
 	}
 
 	// send & receive encrypted values
-	int window = WINDOWSIZE;
-	int tosend = m_nBuflen * numMTs;
-	offset = 0;
+	uint64_t window = WINDOWSIZE;
+	uint64_t tosend = (uint64_t) m_nBuflen * numMTs;
+	uint64_t bufoffset = 0;
 
 	while (tosend > 0) {
 
 		window = std::min(window, tosend);
 
-		chan->send(abuf + offset, window);
-		chan->blocking_receive(abuf + offset, window);
+		chan->send(abuf + bufoffset, window);
+		chan->blocking_receive(abuf + bufoffset, window);
 
-		chan->send(bbuf + offset, window);
-		chan->blocking_receive(bbuf + offset, window);
+		chan->send(bbuf + bufoffset, window);
+		chan->blocking_receive(bbuf + bufoffset, window);
 
 		tosend -= window;
-		offset += window;
+		bufoffset += window;
 	}
 
 	// ----------------#############   ###############-----------------------
@@ -181,29 +283,29 @@ void DGKParty::preCompBench(BYTE * bA, BYTE * bB, BYTE * bC, BYTE * bA1, BYTE *
 
 	//read shares from client byte arrays
 	for (UINT j = 0; j < numMTs; j++) {
-		mpz_import(a1[j], 1, 1, shareBytes, 0, 0, bA1 + offset);
-		mpz_import(b1[j], 1, 1, shareBytes, 0, 0, bB1 + offset);
+		mpz_import(a, 1, 1, shareBytes, 0, 0, bA1 + offset);
+		mpz_import(b, 1, 1, shareBytes, 0, 0, bB1 + offset);
 
-		mpz_import(x, m_nBuflen, -1, 1, 1, 0, abuf + j * m_nBuflen);
-		mpz_import(y, m_nBuflen, -1, 1, 1, 0, bbuf + j * m_nBuflen);
+		mpz_import(x, m_nBuflen, -1, 1, 1, 0, abuf + (uint64_t) j * m_nBuflen);
+		mpz_import(y, m_nBuflen, -1, 1, 1, 0, bbuf + (uint64_t) j * m_nBuflen);
 
-		dbpowmod(c1[j], x, b1[j], y, a1[j], m_remotepub->n);
+		dbpowmod(c, x, b, y, a, m_remotepub->n);
 
 		// pick random r for masking
 		aby_prng(x, 2 * m_nShareLength + 1);
 
-		dgk_encrypt_fb(y, m_remotepub, x);
+		encryptRemote(y, x, r);
 
 		// "add" encrypted r and add to buffer
-		mpz_mul(z, c1[j], y);
+		mpz_mul(z, c, y);
 		mpz_mod(z, z, m_remotepub->n);
-		mpz_export(zbuf + j * m_nBuflen, NULL, -1, 1, 1, 0, z); // TODO maybe reuse abuf, but make sure it's cleaned properly
+		mpz_export(zbuf + (uint64_t) j * m_nBuflen, NULL, -1, 1, 1, 0, z); // TODO maybe reuse abuf, but make sure it's cleaned properly
 
-		mpz_mul(c1[j], a1[j], b1[j]); //c = a * b
-		mpz_sub(c1[j], c1[j], x); // c = c - x
-		mpz_mod_2exp(c1[j], c1[j], m_nShareLength); // c = c mod 2^shareLength
+		mpz_mul(c, a, b); //c = a * b
+		mpz_sub(c, c, x); // c = c - x
+		mpz_mod_2exp(c, c, m_nShareLength); // c = c mod 2^shareLength
 
-		mpz_export(bC1 + offset, NULL, 1, shareBytes, 0, 0, c1[j]);
+		exportShare(bC1 + offset, c, shareBytes);
 
 		offset += shareBytes;
 	}
@@ -212,17 +314,17 @@ void DGKParty::preCompBench(BYTE * bA, BYTE * bB, BYTE * bC, BYTE * bA1, BYTE *
 // all packets packed. exchange these packets
 
 	window = WINDOWSIZE;
-	tosend = m_nBuflen * numMTs;
-	offset = 0;
+	tosend = (uint64_t) m_nBuflen * numMTs;
+	bufoffset = 0;
 
 	while (tosend > 0) {
 		window = std::min(window, tosend);
 
-		chan->send(zbuf + offset, window);
-		chan->blocking_receive(zbuf + offset, window);
+		chan->send(zbuf + bufoffset, window);
+		chan->blocking_receive(zbuf + bufoffset, window);
 
 		tosend -= window;
-		offset += window;
+		bufoffset += window;
 	}
 
 //calculate server c shares
@@ -231,16 +333,16 @@ void DGKParty::preCompBench(BYTE * bA, BYTE * bB, BYTE * bC, BYTE * bA1, BYTE *
 
 	for (UINT i = 0; i < numMTs; i++) {
 
-		mpz_import(r, m_nBuflen, -1, 1, 1, 0, zbuf + i * m_nBuflen);
+		mpz_import(r, m_nBuflen, -1, 1, 1, 0, zbuf + (uint64_t) i * m_nBuflen);
 		dgk_decrypt(r, m_localpub, m_prv, r);
 
-		mpz_import(a[i], 1, 1, shareBytes, 0, 0, bA + offset);
-		mpz_import(b[i], 1, 1, shareBytes, 0, 0, bB + offset);
+		mpz_import(a, 1, 1, shareBytes, 0, 0, bA + offset);
+		mpz_import(b, 1, 1, shareBytes, 0, 0, bB + offset);
 
-		mpz_mod_2exp(c[i], r, m_nShareLength); // c = x mod 2^shareLength == read the share from least significant bits
-		mpz_addmul(c[i], a[i], b[i]); //c = a*b + c
-		mpz_mod_2exp(c[i], c[i], m_nShareLength); // c = c mod 2^shareLength
-		mpz_export(bC + offset, NULL, 1, shareBytes, 0, 0, c[i]);
+		mpz_mod_2exp(c, r, m_nShareLength); // c = x mod 2^shareLength == read the share from least significant bits
+		mpz_addmul(c, a, b); //c = a*b + c
+		mpz_mod_2exp(c, c, m_nShareLength); // c = c mod 2^shareLength
+		exportShare(bC + offset, c, shareBytes);
 		offset += shareBytes;
 
 	}
@@ -290,11 +392,7 @@ void DGKParty::preCompBench(BYTE * bA, BYTE * bB, BYTE * bC, BYTE * bA1, BYTE *
 	printf("generating 2x %u MTs took %f\n", numMTs, getMillies(start, end));
 
 //clean up after ourselves
-	for (UINT i = 0; i < numMTs; i++) {
-		mpz_clears(a[i], b[i], c[i], a1[i], b1[i], c1[i], NULL);
-	}
-
-	mpz_clears(r, x, y, z, NULL);
+	mpz_clears(r, x, y, z, a, b, c, tp, tq, NULL);
 
 	free(abuf);
 	free(bbuf);
@@ -320,9 +418,11 @@ void DGKParty::keyExchange(channel* chan) {
 
 	dgk_complete_pubkey(m_nDGKbits, m_nShareLength, &m_remotepub, n, g, h);
 
-	// pre calculate table for fixed-base exponentiation for client
-	fbpowmod_init_g(m_remotepub->g, m_remotepub->n, 2 * m_nShareLength + 2);
-	fbpowmod_init_h(m_remotepub->h, m_remotepub->n, 400); // 2.5 * t = 2.5 * 160 = 400 bit
+	// pre calculate tables for fixed-base exponentiation for client
+	delete m_cFBRemoteG;
+	delete m_cFBRemoteH;
+	m_cFBRemoteG = new FixedBasePowMod(m_remotepub->g, m_remotepub->n, 2 * m_nShareLength + 2, DGK_FB_WINDOW);
+	m_cFBRemoteH = new FixedBasePowMod(m_remotepub->h, m_remotepub->n, DGK_RAND_BITS, DGK_FB_WINDOW);
 
 	//free a and b
 	mpz_clears(n, g, h, NULL);
@@ -434,4 +534,5 @@ void DGKParty::loadNewKey(UINT DGKbits, UINT sharelen) {
 	m_nDGKbits = DGKbits;
 	m_nShareLength = sharelen;
 	dgk_readkey(m_nDGKbits, m_nShareLength, &m_localpub, &m_prv);
+	precomputeLocalTables(TRUE);
 }
@@ -26,12 +26,31 @@
 #include <ENCRYPTO_utils/crypto/dgk.h>
 #include <ENCRYPTO_utils/powmod.h>
 #include <ENCRYPTO_utils/channel.h>
+#include "../ABY_utils/fixedbasepowmod.h"
 
+/**
+ \def 	DGK_TABLE_FILE
+ \brief	Format of the file that caches the fixed-base tables of a key that was read from disk, with the key bit-length and
+ 	 	the share bit-length as parameters. It lies in the working directory, next to the key file that dgk_readkey reads
+ 	 	from there. The tables are reduced modulo the private factors and reveal them, hence the file is only readable by
+ 	 	its owner.
+ */
+#define DGK_TABLE_FILE "dgk_tables_%u_%u.bin"
+
+/**
+ Generates arithmetic multiplication triples with the DGK cryptosystem.
+
+ Encryptions take g^m and h^r from fixed-base tables, which are built once per key: modulo p and q for the local key,
+ modulo n for the remote key. The tables of a key that was read from disk are cached in DGK_TABLE_FILE and read from
+ there by later runs. The cache is as sensitive as the private key and is created with permissions 0600.
+ */
 class DGKParty {
 public:
 	DGKParty(UINT DGKbits, UINT sharelen, UINT readkey);
 	DGKParty(UINT DGKbits, UINT sharelen, channel* chan, UINT readkey);
 	~DGKParty();
+	DGKParty(const DGKParty&) = delete;
+	DGKParty& operator=(const DGKParty&) = delete;
 
 	void keyExchange(channel* chan);
 
@@ -53,6 +72,20 @@ private:
 	dgk_pubkey_t *m_localpub, *m_remotepub;
 	dgk_prvkey_t *m_prv;
 
+	mpz_t m_zQInv; /**< q^-1 mod p */
+	FixedBasePowMod *m_cFBLocalGP, *m_cFBLocalHP, *m_cFBLocalGQ, *m_cFBLocalHQ; /**< g^m and h^r mod p and mod q of the local key */
+	FixedBasePowMod *m_cFBRemoteG, *m_cFBRemoteH; /**< g^m and h^r mod n of the remote key */
+
+	void freeLocalTables();
+	/**
+	 Builds the fixed-base tables of the local key.
+	 \param cached	If TRUE, the tables are read from DGK_TABLE_FILE, or written to it if it does not hold them
+	 */
+	void precomputeLocalTables(BOOL cached);
+
+	void encryptCRT(mpz_t res, mpz_t plaintext, mpz_t r, mpz_t tp, mpz_t tq);
+	void encryptRemote(mpz_t res, mpz_t plaintext, mpz_t r);
+
 	void benchPreCompPacking1(channel* chan, BYTE * buf, UINT packlen, UINT numshares, mpz_t * a, mpz_t * b, mpz_t * c, mpz_t * a1, mpz_t * b1, mpz_t * c1, mpz_t r, mpz_t x,
 			mpz_t y, mpz_t z);
 
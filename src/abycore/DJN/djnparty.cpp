@@ -19,43 +19,102 @@
 #include "djnparty.h"
 #include <ENCRYPTO_utils/timer.h>
 #include <ENCRYPTO_utils/utils.h>
+#include <algorithm>
+#include <cstring>
+#include <unistd.h>
 
 #define CHECKMT 0
 #define DJN_DEBUG 0
 #define NETDEBUG 0
 #define NETDEBUG2 0
 #define WINDOWSIZE 65536//maximum size of a network packet in Byte
+#define DJN_FB_WINDOW 4 //exponent bits per multiplication in the fixed-base tables
+#define DJN_ENCRYPT_CHUNK 8 //number of MTs a thread encrypts at once
+
+class DJNParty::CModExpThread: public CThread {
+public:
+	CModExpThread(uint32_t id, DJNParty* callback) :
+			threadid(id), m_pCallback(callback), m_evt(), m_eJob(e_DJN_Undefined) {
+	};
+	~CModExpThread() {
+	}
+	CModExpThread(const CModExpThread&) = delete;
+	CModExpThread& operator=(const CModExpThread&) = delete;
+
+	void PutJob(EDJNJobType e) {
+		m_eJob = e;
+		m_evt.Set();
+	}
+
+	void ThreadMain();
+	uint32_t threadid;
+	DJNParty* m_pCallback;
+	CEvent m_evt;
+	EDJNJobType m_eJob;
+};
+
+void DJNParty::CModExpThread::ThreadMain() {
+	for (;;) {
+		m_evt.Wait();
+
+		switch (m_eJob) {
+		case e_DJN_Stop:
+			return;
+		case e_DJN_Encrypt:
+		case e_DJN_Pack:
+		case e_DJN_Unpack:
+			m_pCallback->runJobChunks();
+			break;
+		case e_DJN_Undefined:
+		default:
+			std::cerr << "Error: Unhandled DJN Thread Job!" << std::endl;
+		}
+
+		m_pCallback->threadDone();
+	}
+}
+
+/**
+ * exports a share with a fixed length. mpz_export writes nothing for zero, hence the share is cleared first.
+ */
+static void exportShare(BYTE* buf, mpz_t share, UINT shareBytes) {
+	memset(buf, 0, shareBytes);
+	mpz_export(buf, NULL, 1, shareBytes, 0, 0, share);
+}
 
 /**
  * initializes a DJN_Party with the asymmetric security parameter and the sharelength.
  * Generates DJN key.
  * Key Exchange must be done manually after calling this constructor!
  */
-DJNParty::DJNParty(UINT DJNbits, UINT sharelen, channel* chan) {
+DJNParty::DJNParty(UINT DJNbits, UINT sharelen, channel* chan) :
+		DJNParty(DJNbits, sharelen) {
+	keyExchange(chan);
+}
 
-	m_nShareLength = sharelen;
-	m_nDJNbits = DJNbits;
-	m_nBuflen = DJNbits / 4 + 1;
+//DJN chooses the randomness of an encryption with half the bit-length of n
+DJNParty::DJNParty(UINT DJNbits, UINT sharelen) :
+		m_nNumMTThreads(1), m_nShareLength(sharelen), m_nDJNbits(DJNbits), m_nBuflen(DJNbits / 4 + 1), m_localpub(NULL),
+		m_remotepub(NULL), m_prv(NULL), m_nRandBits((DJNbits + 1) / 2), m_zPSquared(), m_zQSquared(), m_zQSquaredInv(),
+		m_zQInv(), m_zPMinusOne(), m_zQMinusOne(), m_zHp(), m_zHq(), m_cFBLocalP(NULL), m_cFBLocalQ(NULL), m_cFBRemote(NULL),
+		m_vThreads(), m_eJob(e_DJN_Undefined), m_nJobItems(0), m_nJobChunk(1), m_nJobCtr(0), m_nWorkingThreads(0),
+		m_lockJob(new CLock()), m_evtJob(new CEvent()), m_sBatch() {
+	init();
 
 #if DJN_DEBUG
-	std::cout << "(sock) Created party with " << DJNbits << " bits and" << m_nBuflen << std::endl;
+	std::cout << "Created party with " << DJNbits << " bits and" << m_nBuflen << std::endl;
 #endif
 
 	keyGen();
-	keyExchange(chan);
 }
 
-DJNParty::DJNParty(UINT DJNbits, UINT sharelen) {
-
-	m_nShareLength = sharelen;
-	m_nDJNbits = DJNbits;
-	m_nBuflen = DJNbits / 4 + 1;
-
-#if DJN_DEBUG
-	std::cout << "(nosock) Created party with " << DJNbits << " bits and" << m_nBuflen << std::endl;
-#endif
+void DJNParty::init() {
+	mpz_inits(m_zPSquared, m_zQSquared, m_zQSquaredInv, m_zQInv, m_zPMinusOne, m_zQMinusOne, m_zHp, m_zHq, NULL);
 
-	keyGen();
+	//the exponentiations are independent of the network, hence all processors are used by default
+	long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	m_nNumMTThreads = ncpus > 1 ? ncpus : 1;
+	startThreads();
 }
 
 void DJNParty::keyGen() {
@@ -63,12 +122,55 @@ void DJNParty::keyGen() {
 	std::cout << "KG" << std::endl;
 #endif
 	djn_keygen(m_nDJNbits, &m_localpub, &m_prv);
+	precomputeCRT();
+}
+
+/**
+ * pre-calculates the values for the CRT encryption and decryption with the local key
+ */
+void DJNParty::precomputeCRT() {
+	mpz_t t;
+	mpz_init(t);
+
+	mpz_mul(m_zPSquared, m_prv->p, m_prv->p);
+	mpz_mul(m_zQSquared, m_prv->q, m_prv->q);
+	mpz_invert(m_zQSquaredInv, m_zQSquared, m_zPSquared);
+	mpz_invert(m_zQInv, m_prv->q, m_prv->p);
+	mpz_sub_ui(m_zPMinusOne, m_prv->p, 1);
+	mpz_sub_ui(m_zQMinusOne, m_prv->q, 1);
+
+	// h_p = L_p((n+1)^(p-1) mod p^2)^-1 mod p, h_q analogously
+	mpz_add_ui(t, m_localpub->n, 1);
+	mpz_powm(m_zHp, t, m_zPMinusOne, m_zPSquared);
+	mpz_sub_ui(m_zHp, m_zHp, 1);
+	mpz_divexact(m_zHp, m_zHp, m_prv->p);
+	mpz_invert(m_zHp, m_zHp, m_prv->p);
+	mpz_powm(m_zHq, t, m_zQMinusOne, m_zQSquared);
+	mpz_sub_ui(m_zHq, m_zHq, 1);
+	mpz_divexact(m_zHq, m_zHq, m_prv->q);
+	mpz_invert(m_zHq, m_zHq, m_prv->q);
+
+	// fixed-base tables for h_s^r mod p^2 and mod q^2
+	delete m_cFBLocalP;
+	delete m_cFBLocalQ;
+	mpz_mod(t, m_localpub->h_s, m_zPSquared);
+	m_cFBLocalP = new FixedBasePowMod(t, m_zPSquared, m_nRandBits, DJN_FB_WINDOW);
+	mpz_mod(t, m_localpub->h_s, m_zQSquared);
+	m_cFBLocalQ = new FixedBasePowMod(t, m_zQSquared, m_nRandBits, DJN_FB_WINDOW);
+
+	mpz_clear(t);
 }
 
 void DJNParty::setSharelLength(UINT sharelen) {
 	m_nShareLength = sharelen;
 }
 
+void DJNParty::setNumThreads(UINT nthreads) {
+	stopThreads();
+	m_nNumMTThreads = nthreads > 1 ? nthreads : 1;
+	startThreads();
+}
+
 /**
  * deletes party and frees keys and randstate
  */
@@ -76,114 +178,218 @@ DJNParty::~DJNParty() {
 #if DJN_DEBUG
 	std::cout << "Deleting DJNParty...";
 #endif
+	stopThreads();
+	delete m_lockJob;
+	delete m_evtJob;
+
+	delete m_cFBLocalP;
+	delete m_cFBLocalQ;
+	delete m_cFBRemote;
+	mpz_clears(m_zPSquared, m_zQSquared, m_zQSquaredInv, m_zQInv, m_zPMinusOne, m_zQMinusOne, m_zHp, m_zHq, NULL);
+
 	djn_freeprvkey(m_prv);
 	djn_freepubkey(m_localpub);
 	djn_freepubkey(m_remotepub);
 
 }
 
-/**
- * inputs pre-allocates byte buffers for aMT calculation.
- * numMTs must be the total number of MTs and divisible by 2
- */
-void DJNParty::preCompBench(BYTE * bA, BYTE * bB, BYTE * bC, BYTE * bA1, BYTE * bB1, BYTE * bC1, UINT numMTs, channel* chan) {
-	struct timespec start, end;
-
-	numMTs = numMTs / 2; // We can be both sender and receiver at the same time.
-
-	UINT maxShareLen = 2 * m_nShareLength + 41; // length of one share in the packet, sigma = 40
-	UINT packshares = m_nDJNbits / maxShareLen; // number of shares in one packet
-	UINT numpacks = (numMTs + packshares - 1) / packshares; // total number of packets to send in order to generate numMTs = CEIL(numMTs/2*numshares)
-
-	UINT shareBytes = m_nShareLength / 8;
-	UINT offset = 0;
-	UINT limit = packshares; // upper bound for a package shares, used to handle non-full last packages / alignment
-
-#if DJN_DEBUG
-	std::cout << "djnbits: " << m_nDJNbits << " sharelen: " << m_nShareLength << " packlen: " << maxShareLen << " numshares: " << packshares << " numpacks: " << numpacks << std::endl;
-#endif
-
-	mpz_t r, x, y, z;
-	mpz_inits(r, x, y, z, NULL);
-
-	// shares for server part
-	mpz_t a[packshares];
-	mpz_t b[packshares];
-	mpz_t c[packshares];
-
-	// shares for client part
-	mpz_t a1[packshares];
-	mpz_t b1[packshares];
-	mpz_t c1[packshares];
-
-	for (UINT i = 0; i < packshares; i++) {
-		mpz_inits(a[i], b[i], c[i], a1[i], b1[i], c1[i], NULL);
+//The calling thread works on each job as well, hence m_nNumMTThreads-1 additional threads are started
+void DJNParty::startThreads() {
+	m_vThreads.resize(m_nNumMTThreads - 1);
+	for (UINT i = 0; i < m_vThreads.size(); i++) {
+		m_vThreads[i] = new CModExpThread(i, this);
+		m_vThreads[i]->Start();
 	}
+}
 
-	//allocate buffers for mpz_t ciphertext #numMTs with m_nBuflen
-	BYTE * abuf = (BYTE*) calloc(numMTs * m_nBuflen, 1);
-	BYTE * bbuf = (BYTE*) calloc(numMTs * m_nBuflen, 1);
-	BYTE * zbuf = (BYTE*) calloc(numpacks * m_nBuflen, 1);
-
-	clock_gettime(CLOCK_MONOTONIC, &start);
-
-	// read server a,b shares and encrypt them into buffer
-	for (UINT i = 0; i < numMTs; i++) {
-		mpz_import(x, 1, 1, shareBytes, 0, 0, bA + i * shareBytes);
-		mpz_import(y, 1, 1, shareBytes, 0, 0, bB + i * shareBytes);
+void DJNParty::stopThreads() {
+	for (UINT i = 0; i < m_vThreads.size(); i++) {
+		m_vThreads[i]->PutJob(e_DJN_Stop);
+		m_vThreads[i]->Wait();
+		delete m_vThreads[i];
+	}
+	m_vThreads.clear();
+}
 
-		djn_encrypt_crt(r, m_localpub, m_prv, x);
-		mpz_export(abuf + i * m_nBuflen, NULL, -1, 1, 1, 0, r);
-		djn_encrypt_crt(z, m_localpub, m_prv, y);
-		mpz_export(bbuf + i * m_nBuflen, NULL, -1, 1, 1, 0, z);
+/**
+ * processes the items [0, numitems) of a job on all threads and returns when they are done
+ */
+void DJNParty::runJob(EDJNJobType e, UINT numitems, UINT chunk) {
+	m_eJob = e;
+	m_nJobItems = numitems;
+	m_nJobChunk = chunk;
+	m_nJobCtr = 0;
+	m_nWorkingThreads = m_vThreads.size();
+	for (UINT i = 0; i < m_vThreads.size(); i++) {
+		m_vThreads[i]->PutJob(e);
+	}
+	runJobChunks();
+	for (;;) {
+		m_lockJob->Lock();
+		UINT n = m_nWorkingThreads;
+		m_lockJob->Unlock();
+		if (!n)
+			break;
+		m_evtJob->Wait();
+	}
+}
 
+void DJNParty::runJobChunks() {
+	UINT start, end;
+	for (;;) {
+		m_lockJob->Lock();
+		start = m_nJobCtr;
+		end = std::min(start + m_nJobChunk, m_nJobItems);
+		m_nJobCtr = end;
+		m_lockJob->Unlock();
+
+		if (start >= end)
+			return;
+
+		switch (m_eJob) {
+		case e_DJN_Encrypt:
+			encryptShares(start, end);
+			break;
+		case e_DJN_Pack:
+			packShares(start, end);
+			break;
+		case e_DJN_Unpack:
+			unpackShares(start, end);
+			break;
+		default:
+			return;
+		}
 	}
+}
 
-	// send & receive encrypted values
-	int window = WINDOWSIZE;
-	int tosend = m_nBuflen * numMTs;
-	offset = 0;
+void DJNParty::threadDone() {
+	m_lockJob->Lock();
+	UINT n = --m_nWorkingThreads;
+	m_lockJob->Unlock();
 
-	while (tosend > 0) {
+	if (!n)
+		m_evtJob->Set();
+}
 
-		window = std::min(window, tosend);
+/**
+ * encrypts plaintext with the local key: res = (1 + plaintext * n) * h_s^r mod n^2, where h_s^r is computed modulo p^2
+ * and q^2 from the fixed-base tables. r, tp and tq are temporaries. res may be plaintext.
+ */
+void DJNParty::encryptCRT(mpz_t res, mpz_t plaintext, mpz_t r, mpz_t tp, mpz_t tq) {
+	aby_prng(r, m_nRandBits);
+	m_cFBLocalP->powmod(tp, r);
+	m_cFBLocalQ->powmod(tq, r);
+
+	// h_s^r mod n^2 = tq + q^2 * ((tp - tq) * q^-2 mod p^2)
+	mpz_sub(tp, tp, tq);
+	mpz_mul(tp, tp, m_zQSquaredInv);
+	mpz_mod(tp, tp, m_zPSquared);
+	mpz_mul(tp, tp, m_zQSquared);
+	mpz_add(tp, tp, tq);
+
+	mpz_mul(res, plaintext, m_localpub->n);
+	mpz_add_ui(res, res, 1);
+	mpz_mul(res, res, tp);
+	mpz_mod(res, res, m_localpub->n_squared);
+}
 
-		chan->send(abuf + offset, window);
-		chan->blocking_receive(abuf + offset, window);
+/**
+ * decrypts ciphertext with the local key modulo p^2 and q^2. tp and tq are temporaries. res may be ciphertext.
+ */
+void DJNParty::decryptCRT(mpz_t res, mpz_t ciphertext, mpz_t tp, mpz_t tq) {
+	// m_p = L_p(c^(p-1) mod p^2) * h_p mod p
+	mpz_mod(tp, ciphertext, m_zPSquared);
+	mpz_powm(tp, tp, m_zPMinusOne, m_zPSquared);
+	mpz_sub_ui(tp, tp, 1);
+	mpz_divexact(tp, tp, m_prv->p);
+	mpz_mul(tp, tp, m_zHp);
+	mpz_mod(tp, tp, m_prv->p);
+
+	// m_q = L_q(c^(q-1) mod q^2) * h_q mod q
+	mpz_mod(tq, ciphertext, m_zQSquared);
+	mpz_powm(tq, tq, m_zQMinusOne, m_zQSquared);
+	mpz_sub_ui(tq, tq, 1);
+	mpz_divexact(tq, tq, m_prv->q);
+	mpz_mul(tq, tq, m_zHq);
+	mpz_mod(tq, tq, m_prv->q);
+
+	// m = m_q + q * ((m_p - m_q) * q^-1 mod p)
+	mpz_sub(tp, tp, tq);
+	mpz_mul(tp, tp, m_zQInv);
+	mpz_mod(tp, tp, m_prv->p);
+	mpz_mul(tp, tp, m_prv->q);
+	mpz_add(res, tp, tq);
+}
 
-		chan->send(bbuf + offset, window);
-		chan->blocking_receive(bbuf + offset, window);
+/**
+ * encrypts plaintext with the remote key, where h_s^r is taken from the fixed-base table. r is a temporary.
+ */
+void DJNParty::encryptRemote(mpz_t res, mpz_t plaintext, mpz_t r) {
+	aby_prng(r, m_nRandBits);
+	m_cFBRemote->powmod(r, r);
+
+	mpz_mul(res, plaintext, m_remotepub->n);
+	mpz_add_ui(res, res, 1);
+	mpz_mul(res, res, r);
+	mpz_mod(res, res, m_remotepub->n_squared);
+}
 
-		tosend -= window;
-		offset += window;
+/**
+ * encrypts the a and b shares of the MTs [start, end) with the local key
+ */
+void DJNParty::encryptShares(UINT start, UINT end) {
+	djn_batch* b = &m_sBatch;
+	mpz_t x, r, tp, tq;
+	mpz_inits(x, r, tp, tq, NULL);
+
+	for (UINT i = start; i < end; i++) {
+		mpz_import(x, 1, 1, b->shareBytes, 0, 0, b->A + (uint64_t) i * b->shareBytes);
+		encryptCRT(x, x, r, tp, tq);
+		mpz_export(b->abuf + (uint64_t) i * m_nBuflen, NULL, -1, 1, 1, 0, x);
+
+		mpz_import(x, 1, 1, b->shareBytes, 0, 0, b->B + (uint64_t) i * b->shareBytes);
+		encryptCRT(x, x, r, tp, tq);
+		mpz_export(b->bbuf + (uint64_t) i * m_nBuflen, NULL, -1, 1, 1, 0, x);
 	}
 
-	// ----------------#############   ###############-----------------------
-	// pack ALL the packets
+	mpz_clears(x, r, tp, tq, NULL);
+}
 
-	offset = 0;
-	for (UINT i = 0; i < numpacks; i++) {
+/**
+ * computes the encrypted products for the packs [start, end) under the remote key, packs them, masks them and computes
+ * the client c shares
+ */
+void DJNParty::packShares(UINT start, UINT end) {
+	djn_batch* b = &m_sBatch;
+	mpz_t r, x, y, z;
+	mpz_inits(r, x, y, z, NULL);
 
-		if (i == numpacks - 1) {
-			limit = numMTs % packshares; // if last package, only fill buffers to requested size and discard remaining shares
-		}
+	mpz_t* a1 = (mpz_t*) malloc(sizeof(mpz_t) * b->packshares);
+	mpz_t* b1 = (mpz_t*) malloc(sizeof(mpz_t) * b->packshares);
+	mpz_t* c1 = (mpz_t*) malloc(sizeof(mpz_t) * b->packshares);
+	for (UINT j = 0; j < b->packshares; j++) {
+		mpz_inits(a1[j], b1[j], c1[j], NULL);
+	}
+
+	for (UINT i = start; i < end; i++) {
+		UINT first = i * b->packshares;
+		UINT limit = std::min(b->packshares, b->numMTs - first); // the last pack may not be full
 
 		//read shares from client byte arrays
 		for (UINT j = 0; j < limit; j++) {
-			mpz_import(a1[j], 1, 1, shareBytes, 0, 0, bA1 + offset);
-			mpz_import(b1[j], 1, 1, shareBytes, 0, 0, bB1 + offset);
+			mpz_import(a1[j], 1, 1, b->shareBytes, 0, 0, b->A1 + (uint64_t) (first + j) * b->shareBytes);
+			mpz_import(b1[j], 1, 1, b->shareBytes, 0, 0, b->B1 + (uint64_t) (first + j) * b->shareBytes);
 
-			mpz_import(x, m_nBuflen, -1, 1, 1, 0, abuf + (j + i * packshares) * m_nBuflen);
-			mpz_import(y, m_nBuflen, -1, 1, 1, 0, bbuf + (j + i * packshares) * m_nBuflen);
+			mpz_import(x, m_nBuflen, -1, 1, 1, 0, b->abuf + (uint64_t) (first + j) * m_nBuflen);
+			mpz_import(y, m_nBuflen, -1, 1, 1, 0, b->bbuf + (uint64_t) (first + j) * m_nBuflen);
 
 			dbpowmod(c1[j], x, b1[j], y, a1[j], m_remotepub->n_squared); //double base exponentiation
-			offset += shareBytes;
 		}
 
 		// horner packing of shares into 1 ciphertext
 		mpz_set(z, c1[limit - 1]);
 		mpz_set_ui(y, 0);
-		mpz_setbit(y, maxShareLen); // y = 2^shareLength, for shifting ciphertext
+		mpz_setbit(y, b->packlen); // y = 2^packlen, for shifting ciphertext
 
 		for (int j = limit - 2; j >= 0; j--) {
 			mpz_powm(z, z, y, m_remotepub->n_squared);
@@ -191,80 +397,154 @@ void DJNParty::preCompBench(BYTE * bA, BYTE * bB, BYTE * bC, BYTE * bA1, BYTE *
 			mpz_mod(z, z, m_remotepub->n_squared);
 		}
 
-		// pick random r for masking
-		aby_prng(x, mpz_sizeinbase(m_remotepub->n, 2) + 128);
-		mpz_mod(x, x, m_remotepub->n);
+		// pick random x for masking. Every share is masked with packlen random bits. The masked sum stays below n, such
+		// that it does not wrap around.
+		aby_prng(x, limit * b->packlen);
 
-		djn_encrypt_fb(y, m_remotepub, x);
+		encryptRemote(y, x, r);
 
-		// "add" encrypted r and add to buffer
+		// "add" encrypted x and add to buffer
 		mpz_mul(z, z, y);
 		mpz_mod(z, z, m_remotepub->n_squared);
 
-		mpz_export(zbuf + i * m_nBuflen, NULL, -1, 1, 1, 0, z); // TODO maybe reuse abuf, but make sure it's cleaned properly
-
-		offset -= shareBytes * limit;
+		mpz_export(b->zbuf + (uint64_t) i * m_nBuflen, NULL, -1, 1, 1, 0, z);
 
 		// calculate c shares for client part
 		for (UINT j = 0; j < limit; j++) {
-			mpz_mod_2exp(y, x, m_nShareLength); // y = r mod 2^shareLength == read the share from least significant bits
-			mpz_div_2exp(x, x, maxShareLen); // r = r >> maxShareLen
+			mpz_mod_2exp(y, x, m_nShareLength); // y = x mod 2^shareLength == read the share from least significant bits
+			mpz_div_2exp(x, x, b->packlen); // x = x >> packlen
 
 			mpz_mul(c1[j], a1[j], b1[j]); //c = a * b
 			mpz_sub(c1[j], c1[j], y); // c = c - y
 
 			mpz_mod_2exp(c1[j], c1[j], m_nShareLength); // c = c mod 2^shareLength
-			mpz_export(bC1 + offset, NULL, 1, shareBytes, 0, 0, c1[j]);
+			exportShare(b->C1 + (uint64_t) (first + j) * b->shareBytes, c1[j], b->shareBytes);
+		}
+	}
 
-			offset += shareBytes;
+	for (UINT j = 0; j < b->packshares; j++) {
+		mpz_clears(a1[j], b1[j], c1[j], NULL);
+	}
+	free(a1);
+	free(b1);
+	free(c1);
+	mpz_clears(r, x, y, z, NULL);
+}
+
+/**
+ * decrypts the packs [start, end) that were received from the other party and computes the server c shares
+ */
+void DJNParty::unpackShares(UINT start, UINT end) {
+	djn_batch* b = &m_sBatch;
+	mpz_t a, bs, c, r, tp, tq;
+	mpz_inits(a, bs, c, r, tp, tq, NULL);
+
+	for (UINT i = start; i < end; i++) {
+		UINT first = i * b->packshares;
+		UINT limit = std::min(b->packshares, b->numMTs - first);
+
+		mpz_import(r, m_nBuflen, -1, 1, 1, 0, b->zbuf + (uint64_t) i * m_nBuflen);
+
+		decryptCRT(r, r, tp, tq);
+
+		for (UINT j = 0; j < limit; j++) {
+			mpz_import(a, 1, 1, b->shareBytes, 0, 0, b->A + (uint64_t) (first + j) * b->shareBytes);
+			mpz_import(bs, 1, 1, b->shareBytes, 0, 0, b->B + (uint64_t) (first + j) * b->shareBytes);
+
+			mpz_mod_2exp(c, r, m_nShareLength); // c = x mod 2^shareLength == read the share from least significant bits
+			mpz_div_2exp(r, r, b->packlen); // x = x >> packlen
+			mpz_addmul(c, a, bs); //c = a*b + c
+			mpz_mod_2exp(c, c, m_nShareLength); // c = c mod 2^shareLength
+			exportShare(b->C + (uint64_t) (first + j) * b->shareBytes, c, b->shareBytes);
 		}
 	}
 
-	// ----------------#############   ###############-----------------------
-	// all packets packed. exchange these packets
+	mpz_clears(a, bs, c, r, tp, tq, NULL);
+}
 
-	window = WINDOWSIZE;
-	tosend = m_nBuflen * numpacks;
-	offset = 0;
+/**
+ * inputs pre-allocates byte buffers for aMT calculation.
+ * numMTs must be the total number of MTs and divisible by 2
+ */
+void DJNParty::preCompBench(BYTE * bA, BYTE * bB, BYTE * bC, BYTE * bA1, BYTE * bB1, BYTE * bC1, UINT numMTs, channel* chan) {
+	struct timespec start, end;
+
+	numMTs = numMTs / 2; // We can be both sender and receiver at the same time.
+
+	djn_batch* b = &m_sBatch;
+	b->A = bA;
+	b->B = bB;
+	b->C = bC;
+	b->A1 = bA1;
+	b->B1 = bB1;
+	b->C1 = bC1;
+	b->numMTs = numMTs;
+	b->packlen = 2 * m_nShareLength + 41; // length of one share in the packet, sigma = 40
+	// number of shares in one packet. n has at least DJNbits-1 bits, the masked shares take at most packshares * packlen + 1 bits
+	b->packshares = (m_nDJNbits - 3) / b->packlen;
+	b->numpacks = (numMTs + b->packshares - 1) / b->packshares; // total number of packets to send in order to generate numMTs = CEIL(numMTs/2*numshares)
+	b->shareBytes = m_nShareLength / 8;
+
+#if DJN_DEBUG
+	std::cout << "djnbits: " << m_nDJNbits << " sharelen: " << m_nShareLength << " packlen: " << b->packlen << " numshares: " << b->packshares << " numpacks: " << b->numpacks << std::endl;
+#endif
+
+	//allocate buffers for mpz_t ciphertext #numMTs with m_nBuflen
+	b->abuf = (BYTE*) calloc((uint64_t) numMTs * m_nBuflen, 1);
+	b->bbuf = (BYTE*) calloc((uint64_t) numMTs * m_nBuflen, 1);
+	b->zbuf = (BYTE*) calloc((uint64_t) b->numpacks * m_nBuflen, 1);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	// read server a,b shares and encrypt them into buffer
+	runJob(e_DJN_Encrypt, numMTs, DJN_ENCRYPT_CHUNK);
+
+	// send & receive encrypted values
+	uint64_t window = WINDOWSIZE;
+	uint64_t tosend = (uint64_t) m_nBuflen * numMTs;
+	uint64_t offset = 0;
 
 	while (tosend > 0) {
+
 		window = std::min(window, tosend);
 
-		chan->send(zbuf + offset, window);
-		chan->blocking_receive(zbuf + offset, window);
+		chan->send(b->abuf + offset, window);
+		chan->blocking_receive(b->abuf + offset, window);
+
+		chan->send(b->bbuf + offset, window);
+		chan->blocking_receive(b->bbuf + offset, window);
 
 		tosend -= window;
 		offset += window;
 	}
 
-	//unpack and calculate server c shares
-	limit = packshares;
-	offset = 0;
+	// ----------------#############   ###############-----------------------
+	// pack ALL the packets
 
-	for (UINT i = 0; i < numpacks; i++) {
+	runJob(e_DJN_Pack, b->numpacks, 1);
 
-		if (i == numpacks - 1) {
-			limit = numMTs % packshares; // if last package, only fill buffers to requested size and discard remaining shares
-		}
+	// ----------------#############   ###############-----------------------
+	// all packets packed. exchange these packets
 
-		mpz_import(r, m_nBuflen, -1, 1, 1, 0, zbuf + i * m_nBuflen);
+	window = WINDOWSIZE;
+	tosend = (uint64_t) m_nBuflen * b->numpacks;
+	offset = 0;
 
-		djn_decrypt(r, m_localpub, m_prv, r);
+	while (tosend > 0) {
+		window = std::min(window, tosend);
 
-		for (UINT j = 0; j < limit; j++) {
-			mpz_import(a[j], 1, 1, shareBytes, 0, 0, bA + offset);
-			mpz_import(b[j], 1, 1, shareBytes, 0, 0, bB + offset);
-
-			mpz_mod_2exp(c[j], r, m_nShareLength); // c = x mod 2^shareLength == read the share from least significant bits
-			mpz_div_2exp(r, r, maxShareLen); // x = x >> maxShareLen
-			mpz_addmul(c[j], a[j], b[j]); //c = a*b + c
-			mpz_mod_2exp(c[j], c[j], m_nShareLength); // c = c mod 2^shareLength
-			mpz_export(bC + offset, NULL, 1, shareBytes, 0, 0, c[j]);
-			offset += shareBytes;
-		}
+		chan->send(b->zbuf + offset, window);
+		chan->blocking_receive(b->zbuf + offset, window);
+
+		tosend -= window;
+		offset += window;
 	}
 
+	//unpack and calculate server c shares
+	runJob(e_DJN_Unpack, b->numpacks, 1);
+
 #if CHECKMT
+	UINT shareBytes = b->shareBytes;
 	std::cout << "Checking MT validity with values from other party:" << std::endl;
 
 	mpz_t ai, bi, ci, ai1, bi1, ci1, ta, tb;
@@ -309,15 +589,9 @@ void DJNParty::preCompBench(BYTE * bA, BYTE * bB, BYTE * bC, BYTE * bA1, BYTE *
 	printf("generating 2x %u MTs took %f\n", numMTs, getMillies(start, end));
 
 //clean up after ourselves
-	for (UINT i = 0; i < packshares; i++) {
-		mpz_clears(a[i], b[i], c[i], a1[i], b1[i], c1[i], NULL);
-	}
-
-	mpz_clears(r, x, y, z, NULL);
-
-	free(abuf);
-	free(bbuf);
-	free(zbuf);
+	free(b->abuf);
+	free(b->bbuf);
+	free(b->zbuf);
 }
 
 /**
@@ -377,7 +651,7 @@ void DJNParty::benchPreCompPacking1(channel* chan, BYTE * buf, UINT packlen, UIN
 // pick random r for masking
 	aby_prng(x, mpz_sizeinbase(m_remotepub->n, 2) + 128);
 	mpz_mod(x, x, m_remotepub->n);
-	djn_encrypt_fb(y, m_remotepub, x);
+	encryptRemote(y, x, r);
 
 // "add" encrypted r and send
 	mpz_mul(z, z, y);
@@ -412,7 +686,8 @@ void DJNParty::keyExchange(channel* chan) {
 	djn_complete_pubkey(m_nDJNbits, &m_remotepub, a, b);
 
 // pre calculate table for fixed-base exponentiation for client
-	fbpowmod_init_g(m_remotepub->h_s, m_remotepub->n_squared, 2 * m_nDJNbits);
+	delete m_cFBRemote;
+	m_cFBRemote = new FixedBasePowMod(m_remotepub->h_s, m_remotepub->n_squared, m_nRandBits, DJN_FB_WINDOW);
 
 //free a and b
 	mpz_clears(a, b, NULL);
@@ -26,21 +26,57 @@
 #include <ENCRYPTO_utils/crypto/djn.h>
 #include <ENCRYPTO_utils/powmod.h>
 #include <ENCRYPTO_utils/channel.h>
+#include <ENCRYPTO_utils/thread.h>
+#include "../ABY_utils/fixedbasepowmod.h"
 
+/**
+ Generates arithmetic multiplication triples with the DJN variant of the Paillier cryptosystem. Both parties act as
+ sender and receiver at the same time, each for one half of the triples.
+
+ The local key is kept in CRT form: encryption and decryption work modulo p^2 and q^2 and the randomness h_s^r is taken
+ from fixed-base tables. The randomness under the remote key is taken from a fixed-base table as well. The
+ exponentiations of a batch are spread over a pool of m_nNumMTThreads threads, which is independent of the number of OT
+ threads and defaults to the number of available processors.
+ */
 class DJNParty {
 public:
 	DJNParty(UINT DJNbits, UINT sharelen);
 	DJNParty(UINT DJNbits, UINT sharelen, channel* chan);
 	~DJNParty();
+	DJNParty(const DJNParty&) = delete;
+	DJNParty& operator=(const DJNParty&) = delete;
 
 	void keyExchange(channel* chan);
 	void preCompBench(BYTE * bA, BYTE * bB, BYTE * bC, BYTE * bA1, BYTE * bB1, BYTE * bC1, UINT numMTs, channel* chan);
 
 	void setSharelLength(UINT sharelen);
 
+	/**
+	 Sets the number of threads that compute the exponentiations. Must not be called during preCompBench.
+	 */
+	void setNumThreads(UINT nthreads);
+
 	void keyGen();
 
 private:
+	enum EDJNJobType {
+		e_DJN_Encrypt, e_DJN_Pack, e_DJN_Unpack, e_DJN_Stop, e_DJN_Undefined
+	};
+
+	class CModExpThread;
+
+	/** Buffers and dimensions of the batch that is currently generated by preCompBench */
+	typedef struct djn_batch_ctx {
+		BYTE *A, *B, *C; /**< Shares of the triples that are encrypted under the local key */
+		BYTE *A1, *B1, *C1; /**< Shares of the triples that are encrypted under the remote key */
+		BYTE *abuf, *bbuf, *zbuf; /**< Ciphertexts of A, B and the packed products */
+		UINT numMTs; /**< Number of triples in each half */
+		UINT packlen; /**< Bits per share in a packed ciphertext */
+		UINT packshares; /**< Number of shares in a packed ciphertext */
+		UINT numpacks; /**< Number of packed ciphertexts */
+		UINT shareBytes;
+	} djn_batch;
+
 	USHORT m_nNumMTThreads;
 	USHORT m_nShareLength;
 	UINT m_nDJNbits;
@@ -50,6 +86,45 @@ private:
 	djn_pubkey_t *m_localpub, *m_remotepub;
 	djn_prvkey_t *m_prv;
 
+	UINT m_nRandBits; /**< Bit-length of the randomness r of an encryption */
+
+	// CRT representation of the local key
+	mpz_t m_zPSquared, m_zQSquared;
+	mpz_t m_zQSquaredInv; /**< q^-2 mod p^2 */
+	mpz_t m_zQInv; /**< q^-1 mod p */
+	mpz_t m_zPMinusOne, m_zQMinusOne;
+	mpz_t m_zHp, m_zHq; /**< Inverses of L_p((n+1)^(p-1) mod p^2) mod p and L_q((n+1)^(q-1) mod q^2) mod q */
+	FixedBasePowMod *m_cFBLocalP, *m_cFBLocalQ; /**< h_s^r mod p^2 and mod q^2 */
+	FixedBasePowMod *m_cFBRemote; /**< h_s^r mod n^2 of the remote key */
+
+	// Thread pool for the exponentiations
+	std::vector<CModExpThread*> m_vThreads;
+	EDJNJobType m_eJob;
+	UINT m_nJobItems; /**< Number of MTs or packs of the current job */
+	UINT m_nJobChunk; /**< Number of items that a thread takes at once */
+	UINT m_nJobCtr; /**< First item that was not taken by a thread */
+	UINT m_nWorkingThreads;
+	CLock* m_lockJob; /**< Protects m_nJobCtr and m_nWorkingThreads */
+	CEvent* m_evtJob; /**< Signals that all threads are done with the current job */
+	djn_batch m_sBatch;
+
+	void init();
+	void precomputeCRT();
+
+	void encryptCRT(mpz_t res, mpz_t plaintext, mpz_t r, mpz_t tp, mpz_t tq);
+	void decryptCRT(mpz_t res, mpz_t ciphertext, mpz_t tp, mpz_t tq);
+	void encryptRemote(mpz_t res, mpz_t plaintext, mpz_t r);
+
+	void startThreads();
+	void stopThreads();
+	void runJob(EDJNJobType e, UINT numitems, UINT chunk);
+	void runJobChunks();
+	void threadDone();
+
+	void encryptShares(UINT start, UINT end);
+	void packShares(UINT start, UINT end);
+	void unpackShares(UINT start, UINT end);
+
 	void benchPreCompPacking1(channel* chan, BYTE * buf, UINT packlen, UINT numshares, mpz_t * a, mpz_t * b, mpz_t * c, mpz_t * a1, mpz_t * b1, mpz_t * c1, mpz_t r, mpz_t x,
 			mpz_t y, mpz_t z);
 
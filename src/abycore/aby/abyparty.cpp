@@ -59,7 +59,8 @@ ABYParty::ABYParty(e_role pid, const char* addr, uint16_t port, seclvl seclvl,
 	uint32_t bitlen, uint32_t nthreads, e_mt_gen_alg mg_algo,
 	uint32_t maxgates)
 	: m_eMTGenAlg(mg_algo), m_eRole(pid), m_nPort(port), m_sSecLvl(seclvl),
-	m_cAddress(addr) {
+	m_cAddress(addr), m_bOptimizeCircuit(FALSE), m_bOptimizeDepth(FALSE), m_bCoalesceGates(FALSE),
+	m_nSkippedInteractions(0), m_tSndBuf(), m_tRcvBuf() {
 
 	StartWatch("Initialization", P_INIT);
 
@@ -175,12 +176,6 @@ void ABYParty::Cleanup() {
 	if (m_pSetup)
 		delete m_pSetup;
 
-	// free any gates that are still instantiated
-	for(size_t i = 0; i < m_pCircuit->GetGateHead(); i++) {
-		if(m_pGates[i].instantiated) {
-			m_vSharings[0]->FreeGate(&m_pGates[i]);
-		}
-	}
 	for(uint32_t i = 0; i < S_LAST; i++) {
 		if(m_vSharings[i]) {
 			delete m_vSharings[i];
@@ -193,6 +188,9 @@ void ABYParty::Cleanup() {
 		delete m_pCircuit;
 	}
 
+	free(m_tSndBuf.data);
+	free(m_tRcvBuf.data);
+
 	for (uint32_t i = 0; i < m_nHelperThreads; i++) {
 		m_vThreads[i]->PutJob(e_Party_Stop);
 		m_vThreads[i]->Wait();
@@ -223,8 +221,24 @@ void ABYParty::ExecCircuit() {
 
 	StartRecording("Starting execution", P_TOTAL, m_vSockets);
 
-	//Setup phase
+	//the AND gates have to be final before the sharings count the MTs and garbled tables they need
+	if (m_bOptimizeCircuit) {
+		OptimizeCircuit();
+	}
+	if (m_bOptimizeDepth) {
+		BalanceCircuit();
+	}
+	//runs after the balancing, which puts more AND gates on the same level
+	if (m_bCoalesceGates) {
+		CoalesceCircuit();
+	}
+
+	//the plan has to exist before the setup phase, which already instantiates the input keys of the Yao client
+	PlanGateValues();
+
+	//Setup phase, which has to wait until the pool was refilled in the background
 	StartRecording("Starting setup phase: ", P_SETUP, m_vSockets);
+	m_pSetup->WaitForPoolRefill();
 	for (uint32_t i = 0; i < m_vSharings.size(); i++) {
 #ifndef BATCH
 		std::cout << "Preparing setup phase for " << m_vSharings[i]->sharing_type() << " sharing" << std::endl;
@@ -271,8 +285,12 @@ void ABYParty::ExecCircuit() {
 	std::cout << "Evaluating circuit" << std::endl;
 #endif
 
-	//Online phase
-	if(m_vSharings[S_BOOL]->GetPreCompPhaseValue() != ePreCompStore) {
+	//Online phase, which is skipped if the MTs of a sharing are only pre-computed for a later execution
+	BOOL precompstore = FALSE;
+	for (uint32_t i = 0; i < m_vSharings.size(); i++) {
+		precompstore |= (m_vSharings[i]->GetPreCompPhaseValue() == ePreCompStore);
+	}
+	if(!precompstore) {
 		StartRecording("Starting online phase: ", P_ONLINE, m_vSockets);
 		EvaluateCircuit();
 		StopRecording("Time for online phase: ", P_ONLINE, m_vSockets);
@@ -303,40 +321,54 @@ BOOL ABYParty::InitCircuit(uint32_t bitlen, uint32_t maxgates) {
 	m_pCircuit = new ABYCircuit(maxgates);
 
 	m_vSharings.resize(S_LAST);
-	m_vSharings[S_BOOL] = new BoolSharing(S_BOOL, m_eRole, 1, m_pCircuit, m_cCrypt);
+	m_vSharings[S_BOOL] = new BoolSharing(S_BOOL, m_eRole, 1, m_pCircuit, m_cCrypt, m_nNumOTThreads);
 	if (m_eRole == SERVER) {
-		m_vSharings[S_YAO] = new YaoServerSharing(S_YAO, SERVER, m_sSecLvl.symbits, m_pCircuit, m_cCrypt);
+		m_vSharings[S_YAO] = new YaoServerSharing(S_YAO, SERVER, m_sSecLvl.symbits, m_pCircuit, m_cCrypt, m_nNumOTThreads);
 		m_vSharings[S_YAO_REV] = new YaoClientSharing(S_YAO_REV, CLIENT, m_sSecLvl.symbits, m_pCircuit, m_cCrypt);
 	}
 	else {
 		m_vSharings[S_YAO] = new YaoClientSharing(S_YAO, CLIENT, m_sSecLvl.symbits, m_pCircuit, m_cCrypt);
-		m_vSharings[S_YAO_REV] = new YaoServerSharing(S_YAO_REV, SERVER, m_sSecLvl.symbits, m_pCircuit, m_cCrypt);
+		m_vSharings[S_YAO_REV] = new YaoServerSharing(S_YAO_REV, SERVER, m_sSecLvl.symbits, m_pCircuit, m_cCrypt, m_nNumOTThreads);
 	}
+	m_vSharings[S_ARITH] = CreateArithSharing(bitlen);
+	m_vSharings[S_SPLUT] = new SetupLUT(S_SPLUT, m_eRole, 1, m_pCircuit, m_cCrypt);
+
+	m_pGates = m_pCircuit->Gates();
+
+#ifndef BATCH
+	std::cout << " circuit initialized..." << std::endl;
+#endif
+
+	return TRUE;
+}
+
+Sharing* ABYParty::CreateArithSharing(uint32_t bitlen) {
 	switch (bitlen) {
 	case 8:
-		m_vSharings[S_ARITH] = new ArithSharing<UINT8_T>(S_ARITH, m_eRole, 1, m_pCircuit, m_cCrypt, m_eMTGenAlg);
-		break;
+		return new ArithSharing<UINT8_T>(S_ARITH, m_eRole, 1, m_pCircuit, m_cCrypt, m_eMTGenAlg);
 	case 16:
-		m_vSharings[S_ARITH] = new ArithSharing<UINT16_T>(S_ARITH, m_eRole, 1, m_pCircuit, m_cCrypt, m_eMTGenAlg);
-		break;
+		return new ArithSharing<UINT16_T>(S_ARITH, m_eRole, 1, m_pCircuit, m_cCrypt, m_eMTGenAlg);
 	case 32:
-		m_vSharings[S_ARITH] = new ArithSharing<UINT32_T>(S_ARITH, m_eRole, 1, m_pCircuit, m_cCrypt, m_eMTGenAlg);
-		break;
+		return new ArithSharing<UINT32_T>(S_ARITH, m_eRole, 1, m_pCircuit, m_cCrypt, m_eMTGenAlg);
 	case 64:
-		m_vSharings[S_ARITH] = new ArithSharing<UINT64_T>(S_ARITH, m_eRole, 1, m_pCircuit, m_cCrypt, m_eMTGenAlg);
-		break;
+		return new ArithSharing<UINT64_T>(S_ARITH, m_eRole, 1, m_pCircuit, m_cCrypt, m_eMTGenAlg);
 	default:
-		m_vSharings[S_ARITH] = new ArithSharing<UINT32_T>(S_ARITH, m_eRole, 1, m_pCircuit, m_cCrypt, m_eMTGenAlg);
-		break;
+		return new ArithSharing<UINT32_T>(S_ARITH, m_eRole, 1, m_pCircuit, m_cCrypt, m_eMTGenAlg);
 	}
-	m_vSharings[S_SPLUT] = new SetupLUT(S_SPLUT, m_eRole, 1, m_pCircuit, m_cCrypt);
-
-	m_pGates = m_pCircuit->Gates();
+}
 
-#ifndef BATCH
-	std::cout << " circuit initialized..." << std::endl;
-#endif
+BOOL ABYParty::SetArithBitLen(uint32_t bitlen) {
+	if (m_pCircuit->GetGateHead() > 0) {
+		std::cerr << "Error: The bit-length of the arithmetic sharing can only be changed before a circuit is built" << std::endl;
+		return FALSE;
+	}
+	if (m_vSharings[S_ARITH]->GetCircuitBuildRoutine()->GetShareBitLen() == bitlen)
+		return TRUE;
 
+	Sharing* arith = CreateArithSharing(bitlen);
+	arith->SetPreCompPhaseValue(m_vSharings[S_ARITH]->GetPreCompPhaseValue());
+	delete m_vSharings[S_ARITH];
+	m_vSharings[S_ARITH] = arith;
 	return TRUE;
 }
 
@@ -350,6 +382,7 @@ BOOL ABYParty::EvaluateCircuit() {
 	std::vector<double> fincirclayer(num_sharings,0);
 #endif
 	m_nDepth = 0;
+	m_nSkippedInteractions = 0;
 
 	m_tPartyChan = new channel(ABY_PARTY_CHANNEL, m_tComm->rcv_std, m_tComm->snd_std);
 
@@ -419,7 +452,7 @@ BOOL ABYParty::EvaluateCircuit() {
 		}
 	}
 #if DEBUGABYPARTY
-		std::cout << "Done with online phase; synchronizing "<< std::endl;
+		std::cout << "Done with online phase after " << maxdepth - m_nSkippedInteractions << " interactions (" << m_nSkippedInteractions << " layers without communication); synchronizing "<< std::endl;
 #endif
 	m_tPartyChan->synchronize_end();
 	delete m_tPartyChan;
@@ -437,95 +470,108 @@ BOOL ABYParty::EvaluateCircuit() {
 }
 
 BOOL ABYParty::PerformInteraction() {
+	//The buffers are collected before waking up the threads. The bytes this party receives are the bytes the other
+	//party sends and vice versa, hence both parties skip layers without any communication.
+	CollectInteractionBuffers(&m_tSndBuf, true);
+	CollectInteractionBuffers(&m_tRcvBuf, false);
+	if (m_tSndBuf.totalbytes == 0 && m_tRcvBuf.totalbytes == 0) {
+		m_nSkippedInteractions++;
+		return true;
+	}
+
 	WakeupWorkerThreads(e_Party_Comm);
 	BOOL success = WaitWorkerThreads();
 	return success;
 }
 
-BOOL ABYParty::ThreadSendValues() {
-	std::vector<std::vector<BYTE*> >sendbuf(m_vSharings.size());
-	std::vector<std::vector<uint64_t> >sndbytes(m_vSharings.size());
+BYTE* ABYParty::GetInteractionBuffer(interaction_buf* buf, uint64_t bytes) {
+	//the buffer only grows, such that no allocation is necessary for most circuit layers
+	if (bytes > buf->size) {
+		buf->size = std::max(bytes, 2 * buf->size);
+		buf->data = (BYTE*) realloc(buf->data, buf->size);
+		assert(buf->data != NULL);
+	}
+	return buf->data;
+}
+
+void ABYParty::CollectInteractionBuffers(interaction_buf* buf, BOOL send) {
+	buf->frags.resize(m_vSharings.size());
+	buf->fragbytes.resize(m_vSharings.size());
+	buf->totalbytes = 0;
+	buf->nfrags = 0;
+	buf->lastfrag = NULL;
 
-	uint64_t snd_buf_size_total = 0, ctr = 0;
 	for (uint32_t j = 0; j < m_vSharings.size(); j++) {
-		m_vSharings[j]->GetDataToSend(sendbuf[j], sndbytes[j]);
-		for (uint32_t i = 0; i < sendbuf[j].size(); i++) {
-			snd_buf_size_total += sndbytes[j][i];
-			//m_tPartyChan->send(sendbuf[j][i], sndbytes[j][i]);
+		buf->frags[j].clear();
+		buf->fragbytes[j].clear();
+		if (send) {
+			m_vSharings[j]->GetDataToSend(buf->frags[j], buf->fragbytes[j]);
+		} else {
+			m_vSharings[j]->GetBuffersToReceive(buf->frags[j], buf->fragbytes[j]);
+		}
+		for (uint32_t i = 0; i < buf->frags[j].size(); i++) {
+			buf->totalbytes += buf->fragbytes[j][i];
+			if (buf->fragbytes[j][i] > 0) {
+				buf->nfrags++;
+				buf->lastfrag = buf->frags[j][i];
+			}
 #ifdef DEBUGCOMM
 			cout_mutex.lock();
-			std::cout << "(" << m_nDepth << ") Sending " << sndbytes[j][i] << " bytes on socket " << m_eRole << " for sharing " << j << std::endl;
+			if (send) {
+				std::cout << "(" << m_nDepth << ") Sending " << buf->fragbytes[j][i] << " bytes on socket " << m_eRole << " for sharing " << j << std::endl;
+			} else {
+				std::cout << "(" << m_nDepth << ") Receiving " << buf->fragbytes[j][i] << " bytes on socket " << (m_eRole^1) << " for sharing " << j << std::endl;
+			}
 			cout_mutex.unlock();
 #endif
 		}
-		//sendbuf[j].clear();
-		//sndbytes[j].clear();
 	}
-	uint8_t* snd_buf_total = (uint8_t*) malloc(snd_buf_size_total);
-	for (uint32_t j = 0; j < m_vSharings.size(); j++) {
-		for (uint32_t i = 0; i < sendbuf[j].size(); i++) {
-			if(sndbytes[j][i] > 0) {
-				memcpy(snd_buf_total+ctr, sendbuf[j][i], sndbytes[j][i]);
-				ctr+= sndbytes[j][i];
+}
+
+BOOL ABYParty::ThreadSendValues() {
+	std::vector<std::vector<BYTE*> >& sendbuf = m_tSndBuf.frags;
+	std::vector<std::vector<uint64_t> >& sndbytes = m_tSndBuf.fragbytes;
+	uint64_t ctr = 0;
+
+	if (m_tSndBuf.nfrags == 1) {
+		//a single fragment is sent directly from the buffer of the sharing
+		m_tPartyChan->send(m_tSndBuf.lastfrag, m_tSndBuf.totalbytes);
+	} else if (m_tSndBuf.nfrags > 1) {
+		BYTE* snd_buf_total = GetInteractionBuffer(&m_tSndBuf, m_tSndBuf.totalbytes);
+		for (uint32_t j = 0; j < m_vSharings.size(); j++) {
+			for (uint32_t i = 0; i < sendbuf[j].size(); i++) {
+				if(sndbytes[j][i] > 0) {
+					memcpy(snd_buf_total+ctr, sendbuf[j][i], sndbytes[j][i]);
+					ctr+= sndbytes[j][i];
+				}
 			}
 		}
+		m_tPartyChan->send(snd_buf_total, m_tSndBuf.totalbytes);
 	}
-	//gettimeofday(&tstart, NULL);
-	if(snd_buf_size_total > 0) {
-		//m_vSockets[2]->Send(snd_buf_total, snd_buf_size_total);
-		m_tPartyChan->send(snd_buf_total, snd_buf_size_total);
-	}
-	free(snd_buf_total);
 
 	return true;
 }
 
 BOOL ABYParty::ThreadReceiveValues() {
-	std::vector<std::vector<BYTE*> > rcvbuf(m_vSharings.size());
-	std::vector<std::vector<uint64_t> > rcvbytes(m_vSharings.size());
-
-//	timeval tstart, tend;
-
-	uint64_t rcvbytestotal = 0;
-	for (uint32_t j = 0; j < m_vSharings.size(); j++) {
-		m_vSharings[j]->GetBuffersToReceive(rcvbuf[j], rcvbytes[j]);
-		for (uint32_t i = 0; i < rcvbuf[j].size(); i++) {
-			rcvbytestotal += rcvbytes[j][i];
-			//	m_tPartyChan->blocking_receive(sendbuf[j][i], sndbytes[j][i]);
-#ifdef DEBUGCOMM
-			cout_mutex.lock();
-			std::cout << "(" << m_nDepth << ") Receiving " << rcvbytes[j][i] << " bytes on socket " << (m_eRole^1) << " for sharing " << j << std::endl;
-			cout_mutex.unlock();
-#endif
-		}
-	}
-	uint8_t* rcvbuftotal = (uint8_t*) malloc(rcvbytestotal);
-	assert(rcvbuftotal != NULL);
-	//gettimeofday(&tstart, NULL);
-	if (rcvbytestotal > 0) {
-		//m_vSockets[2]->Receive(rcvbuftotal, rcvbytestotal);
-		m_tPartyChan->blocking_receive(rcvbuftotal, rcvbytestotal);
-	}
-
-	//gettimeofday(&tend, NULL);
-	//std::cout << "(" << m_nDepth << ") Time taken for receiving " << rcvbytestotal << " bytes: " << getMillies(tstart, tend) << std::endl;
-
-	for (uint32_t j = 0, ctr = 0; j < m_vSharings.size(); j++) {
-		for (uint32_t i = 0; i < rcvbuf[j].size(); i++) {
-			if (rcvbytes[j][i] > 0) {
-				memcpy(rcvbuf[j][i], rcvbuftotal + ctr, rcvbytes[j][i]);
-				ctr += rcvbytes[j][i];
+	std::vector<std::vector<BYTE*> >& rcvbuf = m_tRcvBuf.frags;
+	std::vector<std::vector<uint64_t> >& rcvbytes = m_tRcvBuf.fragbytes;
+
+	if (m_tRcvBuf.nfrags == 1) {
+		//a single fragment is received directly into the buffer of the sharing
+		m_tPartyChan->blocking_receive(m_tRcvBuf.lastfrag, m_tRcvBuf.totalbytes);
+	} else if (m_tRcvBuf.nfrags > 1) {
+		BYTE* rcvbuftotal = GetInteractionBuffer(&m_tRcvBuf, m_tRcvBuf.totalbytes);
+		m_tPartyChan->blocking_receive(rcvbuftotal, m_tRcvBuf.totalbytes);
+
+		for (uint32_t j = 0, ctr = 0; j < m_vSharings.size(); j++) {
+			for (uint32_t i = 0; i < rcvbuf[j].size(); i++) {
+				if (rcvbytes[j][i] > 0) {
+					memcpy(rcvbuf[j][i], rcvbuftotal + ctr, rcvbytes[j][i]);
+					ctr += rcvbytes[j][i];
+				}
 			}
 		}
 	}
-	free(rcvbuftotal);
-
-	for (uint32_t j = 0; j < m_vSharings.size(); j++) {
-		rcvbuf[j].clear();
-		rcvbytes[j].clear();
-	}
-	rcvbuf.clear();
-	rcvbytes.clear();
 
 	return true;
 }
@@ -602,7 +648,8 @@ BOOL ABYParty::ABYPartyListen() {
 // TODO: are InstantiateGate and UsedGate needed in ABYParty? They don't
 // seem to get used anywhere
 void ABYParty::InstantiateGate(uint32_t gateid) {
-	m_pGates[gateid].gs.val = (UGATE_T*) malloc(sizeof(UGATE_T) * (ceil_divide(m_pGates[gateid].nvals, GATE_T_BITS)));
+	m_pGates[gateid].gs.val = (UGATE_T*) m_pCircuit->GetValueArena()->Alloc(m_pGates[gateid].context,
+			sizeof(UGATE_T) * (ceil_divide(m_pGates[gateid].nvals, GATE_T_BITS)), FALSE);
 }
 
 void ABYParty::UsedGate(uint32_t gateid) {
@@ -610,7 +657,7 @@ void ABYParty::UsedGate(uint32_t gateid) {
 	m_pGates[gateid].nused--;
 	//If the gate is needed in another subsequent gate, delete it
 	if (!m_pGates[gateid].nused) {
-		free(m_pGates[gateid].gs.val);
+		m_pCircuit->GetValueArena()->Free(m_pGates[gateid].gs.val);
 
 	}
 }
@@ -620,17 +667,89 @@ void ABYParty::Reset() {
 	m_nDepth = 0;
 	m_nMyNumInBits = 0;
 
-	// free any gates that are still instantiated
-	for(size_t i = 0; i < m_pCircuit->GetGateHead(); i++) {
-		if(m_pGates[i].instantiated) {
-			m_vSharings[0]->FreeGate(&m_pGates[i]);
-		}
-	}
+	// the values of gates that are still instantiated are taken back by the value arena in m_pCircuit->Reset()
 	for (uint32_t i = 0; i < m_vSharings.size(); i++) {
 		m_vSharings[i]->Reset();
 	}
 
 	m_pCircuit->Reset();
+
+	//the values that the execution took from the pool are pre-computed while the next circuit is built
+	m_pSetup->StartPoolRefill();
+}
+
+void ABYParty::PlanGateValues() {
+	std::vector<uint64_t> bytes(m_pCircuit->GetGateHead(), 0);
+	for (uint32_t i = 0; i < bytes.size(); i++) {
+		GATE* gate = m_pGates + i;
+		//values that were assigned while building the circuit and gates without a value are not planned
+		if (gate->instantiated || gate->context >= S_LAST || !m_vSharings[gate->context] || gate->type == G_PRINT_VAL
+				|| gate->type == G_ASSERT)
+			continue;
+		bytes[i] = m_vSharings[gate->context]->GetGateValueBytes(gate);
+	}
+	m_pCircuit->PlanGateValues(bytes);
+}
+
+void ABYParty::EnableSetupPool(uint32_t nexecs) {
+	m_pSetup->EnableSetupPool(nexecs);
+}
+
+void ABYParty::EnableCircuitOptimization(BOOL enable) {
+	m_bOptimizeCircuit = enable;
+}
+
+void ABYParty::OptimizeCircuit() {
+	std::vector<BYTE> status;
+	m_pCircuit->OptimizeGates(status);
+	for (uint32_t i = 0; i < m_vSharings.size(); i++) {
+		m_vSharings[i]->GetCircuitBuildRoutine()->ApplyGateOptimization(status);
+	}
+#ifndef BATCH
+	uint32_t nremoved = 0, nfolded = 0;
+	for (uint32_t i = 0; i < status.size(); i++) {
+		nremoved += (status[i] & GATE_OPT_REMOVED) != 0;
+		nfolded += (status[i] & (GATE_OPT_REMOVED | GATE_OPT_FOLDED)) == GATE_OPT_FOLDED;
+	}
+	std::cout << "Circuit optimization removed " << nremoved << " and folded " << nfolded << " gates" << std::endl;
+#endif
+}
+
+void ABYParty::EnableDepthOptimization(BOOL enable) {
+	m_bOptimizeDepth = enable;
+}
+
+void ABYParty::BalanceCircuit() {
+	//only the levels of GMW gates change, the gates of the other sharings stay on their levels
+	Circuit* boolcirc = m_vSharings[S_BOOL]->GetCircuitBuildRoutine();
+#ifndef BATCH
+	uint32_t depth = boolcirc->GetMaxDepth();
+#endif
+	m_pCircuit->BalanceGates();
+	boolcirc->UpdateQueueLevels();
+#ifndef BATCH
+	std::cout << "Depth of the GMW circuit after balancing its AND trees: " << depth << " -> " << boolcirc->GetMaxDepth() << std::endl;
+#endif
+}
+
+void ABYParty::EnableGateCoalescing(BOOL enable) {
+	m_bCoalesceGates = enable;
+}
+
+void ABYParty::CoalesceCircuit() {
+	std::vector<BYTE> status;
+	std::vector<uint32_t> rank;
+	m_pCircuit->CoalesceGates(status, rank);
+	m_vSharings[S_BOOL]->GetCircuitBuildRoutine()->ApplyGateCoalescing(status, rank);
+#ifndef BATCH
+	uint32_t ncoalesced = 0, nsimd = 0;
+	GATE* gates = m_pCircuit->Gates();
+	for (uint32_t i = 0; i < status.size(); i++) {
+		ncoalesced += (status[i] & GATE_OPT_SPLIT) != 0;
+		nsimd += (status[i] & GATE_OPT_ADDED) && gates[i].type != G_PERM;
+	}
+	std::cout << "Coalesced " << ncoalesced << " scalar GMW gates into " << nsimd << " SIMD gates" << std::endl;
+#endif
 }
 
 double ABYParty::GetTiming(ABYPHASE phase) {
@@ -645,6 +764,14 @@ uint64_t ABYParty::GetReceivedData(ABYPHASE phase) {
 	return GetReceivedDataForPhase(phase);
 }
 
+uint64_t ABYParty::GetGateValueHighWaterMark(e_sharing sharing) {
+	return m_pCircuit->GetValueArena()->GetHighWaterMark(sharing);
+}
+
+uint32_t ABYParty::GetSkippedInteractions() {
+	return m_nSkippedInteractions;
+}
+
 //===========================================================================
 // Thread Management
 BOOL ABYParty::WakeupWorkerThreads(EPartyJobType e) {
@@ -47,11 +47,64 @@ public:
 	std::vector<Sharing*>& GetSharings();
 	void ExecCircuit();
 
+	/**
+	 Prepare the party for the next circuit. The connection, the base OTs and the OT extension, as well as all threads
+	 are kept, such that an arbitrary number of circuits of varying shape can be evaluated in one session.
+	 */
 	void Reset();
 
+	/**
+	 Select the bit-length of the arithmetic sharing for the next circuit, which has to be done by both parties before
+	 the circuit is built. The arithmetic sharing is replaced, hence its circuit has to be fetched from GetSharings() again.
+	 \param bitlen	8, 16, 32 or 64
+	 \return FALSE if a circuit was already built
+	 */
+	BOOL SetArithBitLen(uint32_t bitlen);
+
+	/**
+	 Keep the MTs and Yao input OTs of nexecs executions pre-computed in the background between executions, such that
+	 ExecCircuit after a Reset only has to perform the remaining setup and the online phase. The pool is sized by the
+	 demand of the previous execution. Both parties have to call this with the same value, 0 disables the pool.
+	 */
+	void EnableSetupPool(uint32_t nexecs = 1);
+
+	/**
+	 Optimize the Boolean and Yao gates of each circuit before it is evaluated: gates with constant inputs are folded,
+	 gates that compute the same value as an earlier gate are merged and gates whose value is never used are removed, which
+	 saves MTs, garbled tables and communication for the AND gates among them. Both parties have to call this with the
+	 same value.
+	 */
+	void EnableCircuitOptimization(BOOL enable = TRUE);
+
+	/**
+	 Minimize the multiplicative depth of the GMW circuit before it is evaluated by rebalancing its trees of AND gates,
+	 such that every removed level saves a communication round. The number of gates is kept. Runs after the optimization
+	 of EnableCircuitOptimization, which merges the double inversions in chains of OR gates. Both parties have to call this
+	 with the same value.
+	 */
+	void EnableDepthOptimization(BOOL enable = TRUE);
+
+	/**
+	 Coalesce the scalar XOR, AND and inversion gates of the GMW circuit that are evaluated together into SIMD gates before
+	 the circuit is evaluated, which saves the evaluation of each gate on its own for circuits that were built from single
+	 wires. Runs after the optimizations of EnableCircuitOptimization and EnableDepthOptimization. Both parties have to call
+	 this with the same value.
+	 */
+	void EnableGateCoalescing(BOOL enable = TRUE);
+
 	double GetTiming(ABYPHASE phase);
 	uint64_t GetSentData(ABYPHASE phase);
 	uint64_t GetReceivedData(ABYPHASE phase);
+	/**
+	 \return Maximum number of bytes that the gate values of a sharing occupied at the same time during the last
+	 execution. Has to be called before Reset.
+	 */
+	uint64_t GetGateValueHighWaterMark(e_sharing sharing);
+	/**
+	 \return Number of circuit layers of the last execution in which no sharing had data to exchange, such that the
+	 interaction was skipped.
+	 */
+	uint32_t GetSkippedInteractions();
 
 
 private:
@@ -59,6 +112,7 @@ private:
 	void Cleanup();
 
 	BOOL InitCircuit(uint32_t bitlen, uint32_t maxgates);
+	Sharing* CreateArithSharing(uint32_t bitlen);
 
 	BOOL EstablishConnection();
 
@@ -66,6 +120,14 @@ private:
 	BOOL ABYPartyConnect();
 
 	BOOL EvaluateCircuit();
+	//Plan the memory of the gate values with the sizes that the sharings allocate for them
+	void PlanGateValues();
+	//Optimize the gates and update the queues of the circuits accordingly
+	void OptimizeCircuit();
+	//Rebalance the AND trees of the GMW circuit and move its gates to their new levels
+	void BalanceCircuit();
+	//Coalesce the scalar gates of the GMW circuit into SIMD gates and update its queues
+	void CoalesceCircuit();
 
 	void BuildCircuit();
 	void BuildBoolMult(uint32_t bitlen, uint32_t resbitlen, uint32_t nvals);
@@ -78,6 +140,19 @@ private:
 	BOOL ThreadSendValues();
 	BOOL ThreadReceiveValues();
 
+	/** Buffers of one direction of the interaction, which are kept across circuit layers */
+	struct interaction_buf {
+		BYTE* data = NULL; /**< Contiguous buffer that holds all fragments of a layer if there is more than one */
+		uint64_t size = 0; /**< Allocated bytes of data */
+		std::vector<std::vector<BYTE*> > frags{}; /**< Fragments of each sharing */
+		std::vector<std::vector<uint64_t> > fragbytes{}; /**< Bytes of each fragment */
+		uint64_t totalbytes = 0; /**< Sum of the bytes of all fragments of the current layer */
+		uint32_t nfrags = 0; /**< Number of non-empty fragments of the current layer */
+		BYTE* lastfrag = NULL; /**< Last non-empty fragment, which is used directly if it is the only one */
+	};
+	BYTE* GetInteractionBuffer(interaction_buf* buf, uint64_t bytes);
+	void CollectInteractionBuffers(interaction_buf* buf, BOOL send);
+
 	void PrintPerformanceStatistics();
 
 	e_mt_gen_alg m_eMTGenAlg;
@@ -96,6 +171,10 @@ private:
 	const char* m_cAddress;
 
 	uint32_t m_nDepth;
+	BOOL m_bOptimizeCircuit;
+	BOOL m_bOptimizeDepth;
+	BOOL m_bCoalesceGates;
+	uint32_t m_nSkippedInteractions; // circuit layers in which no sharing had data to exchange
 
 	uint32_t m_nMyNumInBits;
 	// Ciruit
@@ -116,6 +195,8 @@ private:
 	comm_ctx* m_tComm;
 
 	channel* m_tPartyChan;
+	interaction_buf m_tSndBuf; /**< Only used by the sending worker thread */
+	interaction_buf m_tRcvBuf; /**< Only used by the receiving worker thread */
 #ifdef DEBUGCOMM
 	std::mutex cout_mutex;
 #endif
@@ -17,8 +17,14 @@
  */
 
 #include "abysetup.h"
-
-ABYSetup::ABYSetup(crypto* crypt, uint32_t numThreads, e_role role, e_mt_gen_alg mtalgo) {
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+
+ABYSetup::ABYSetup(crypto* crypt, uint32_t numThreads, e_role role, e_mt_gen_alg mtalgo) :
+		m_vPools(), m_nPoolExecs(0), m_cPoolCrypt(NULL), m_tstreamtask(), m_pStreamThread(NULL), m_evtStream(), m_lockStream(), m_pPoolThread(NULL),
+		m_evtPool(), m_lockPool(), m_bPoolRefill(FALSE), m_bPoolSuccess(TRUE) {
 	m_nNumOTThreads = numThreads;
 	m_cCrypt = crypt;
 	m_eRole = role;
@@ -47,6 +53,11 @@ BOOL ABYSetup::Init() {
 		m_vThreads[i] = new CWorkerThread(i, this);
 		m_vThreads[i]->Start();
 	}
+	m_pStreamThread = new CWorkerThread(0, this);
+	m_pStreamThread->Start();
+
+	m_pPoolThread = new CWorkerThread(0, this);
+	m_pPoolThread->Start();
 
 	//the bit length of the DJN and DGK party is irrelevant here, since it is set for each MT Gen task independently
 	if (m_eMTGenAlg == MT_PAILLIER) {
@@ -69,11 +80,25 @@ BOOL ABYSetup::Init() {
 }
 
 void ABYSetup::Cleanup() {
+	//the pool thread uses the worker threads and the OT extension
+	WaitForPoolRefill();
+	m_pPoolThread->PutJob(e_Stop);
+	m_pPoolThread->Wait();
+	delete m_pPoolThread;
+	FreePools();
+	if(m_cPoolCrypt) {
+		delete m_cPoolCrypt;
+	}
+
 	for(size_t i = 0; i < m_vThreads.size(); i++) {
 		m_vThreads[i]->PutJob(e_Stop);
 		m_vThreads[i]->Wait();
 		delete m_vThreads[i];
 	}
+	WaitForStreamEnd();
+	m_pStreamThread->PutJob(e_Stop);
+	m_pStreamThread->Wait();
+	delete m_pStreamThread;
 	if(m_tSetupChan) {
 		m_tSetupChan->synchronize_end();
 		delete m_tSetupChan;
@@ -189,6 +214,7 @@ BOOL ABYSetup::PrepareSetupPhase(comm_ctx* comm) {
 }
 
 BOOL ABYSetup::PerformSetupPhase() {
+	WaitForPoolRefill();
 	/* Compute OT extension */
 	WakeupWorkerThreads(e_IKNPOTExt);
 	BOOL success = WaitWorkerThreads();
@@ -202,6 +228,7 @@ BOOL ABYSetup::PerformSetupPhase() {
 		//Start Paillier MT generation
 		WakeupWorkerThreads(e_MTPaillier);
 		success &= WaitWorkerThreads();
+		m_vPKMTGenTasks.clear();
 	} else if (m_eMTGenAlg == MT_DGK) {
 #ifndef BENCH_PRECOMP
 		m_cDGKMTGen = (DGKParty**) malloc(sizeof(DGKParty*) * m_vPKMTGenTasks.size());
@@ -216,10 +243,13 @@ BOOL ABYSetup::PerformSetupPhase() {
 		WakeupWorkerThreads(e_MTDGK);
 		success &= WaitWorkerThreads();
 
+		//all threads work on every task, hence the tasks are freed once they are done
 		for (uint32_t i = 0; i < m_vPKMTGenTasks.size(); i++) {
 			delete m_cDGKMTGen[i];
+			free(m_vPKMTGenTasks[i]);
 		}
 		free(m_cDGKMTGen);
+		m_vPKMTGenTasks.clear();
 	}
 	return success;
 }
@@ -387,32 +417,24 @@ BOOL ABYSetup::ThreadRunKKRcv(uint32_t exec) {
 
 
 BOOL ABYSetup::ThreadRunPaillierMTGen(uint32_t threadid) {
-
-	uint32_t nthreads = 2 * m_nNumOTThreads;
-
-	channel* djnchan = new channel(DJN_CHANNEL+threadid, m_tComm->rcv_std, m_tComm->snd_std);
+	//The MTs are generated over a single channel. DJNParty spreads the exponentiations over its own threads, such that
+	//the number of threads does not depend on the number of OT threads.
+	channel* djnchan = new channel(DJN_CHANNEL + threadid, m_tComm->rcv_std, m_tComm->snd_std);
 	for (uint32_t i = 0; i < m_vPKMTGenTasks.size(); i++) {
 
 		PKMTGenVals* ptask = m_vPKMTGenTasks[i];
 
-		uint32_t nummtsperthread = ceil_divide(ptask->numMTs, nthreads);
-
-		uint32_t mynummts = nummtsperthread; //times two since we need the number of MTs to be a multiple of 2 internally
 		uint32_t sharebytelen = ceil_divide(ptask->sharebitlen, 8);
-		if (threadid == nthreads - 1) {
-			mynummts = ptask->numMTs - (nthreads-1 ) * nummtsperthread;
-		}
-
-		uint32_t mystartpos = nummtsperthread * threadid * sharebytelen;
 		m_cPaillierMTGen->setSharelLength(ptask->sharebitlen);
 
-		UINT32_T roleoffset = mystartpos + sharebytelen * (mynummts / 2);
+		//the first half of the MTs is encrypted under the key of the server, the second half under the key of the client
+		UINT32_T roleoffset = sharebytelen * (ptask->numMTs / 2);
 		if (m_eRole == SERVER) {
-			m_cPaillierMTGen->preCompBench(ptask->A->GetArr() + mystartpos, ptask->B->GetArr() + mystartpos, ptask->C->GetArr() + mystartpos, ptask->A->GetArr() + roleoffset,
-					ptask->B->GetArr() + roleoffset, ptask->C->GetArr() + roleoffset, mynummts, djnchan);
+			m_cPaillierMTGen->preCompBench(ptask->A->GetArr(), ptask->B->GetArr(), ptask->C->GetArr(), ptask->A->GetArr() + roleoffset,
+					ptask->B->GetArr() + roleoffset, ptask->C->GetArr() + roleoffset, ptask->numMTs, djnchan);
 		} else {
-			m_cPaillierMTGen->preCompBench(ptask->A->GetArr() + roleoffset, ptask->B->GetArr() + roleoffset, ptask->C->GetArr() + roleoffset, ptask->A->GetArr() + mystartpos,
-					ptask->B->GetArr() + mystartpos, ptask->C->GetArr() + mystartpos, mynummts, djnchan);
+			m_cPaillierMTGen->preCompBench(ptask->A->GetArr() + roleoffset, ptask->B->GetArr() + roleoffset, ptask->C->GetArr() + roleoffset, ptask->A->GetArr(),
+					ptask->B->GetArr(), ptask->C->GetArr(), ptask->numMTs, djnchan);
 		}
 		free(ptask);
 	}
@@ -453,7 +475,6 @@ BOOL ABYSetup::ThreadRunDGKMTGen(uint32_t threadid) {
 			m_cDGKMTGen[i]->preCompBench(ptask->A->GetArr() + roleoffset, ptask->B->GetArr() + roleoffset, ptask->C->GetArr() + roleoffset, ptask->A->GetArr() + mystartpos,
 					ptask->B->GetArr() + mystartpos, ptask->C->GetArr() + mystartpos, mynummts, dgkchan);
 		}
-		free(ptask);
 	}
 	dgkchan->synchronize_end();
 	delete dgkchan;
@@ -461,6 +482,302 @@ BOOL ABYSetup::ThreadRunDGKMTGen(uint32_t threadid) {
 	return true;
 }
 
+//===========================================================================
+// Pool of pre-computed values
+void ABYSetup::EnableSetupPool(uint32_t nexecs) {
+	WaitForPoolRefill();
+	m_nPoolExecs = nexecs;
+	if (nexecs == 0) {
+		FreePools();
+	} else if (!m_cPoolCrypt) {
+		m_cPoolCrypt = new crypto(m_cCrypt->get_seclvl().symbits);
+	}
+}
+
+PoolVals* ABYSetup::GetPool(e_sharing sharing, uint32_t bitlen) {
+	for (uint32_t i = 0; i < m_vPools.size(); i++) {
+		if (m_vPools[i]->sharing == sharing && m_vPools[i]->bitlen == bitlen)
+			return m_vPools[i];
+	}
+	PoolVals* pool = (PoolVals*) calloc(1, sizeof(PoolVals));
+	pool->sharing = sharing;
+	pool->bitlen = bitlen;
+	if (sharing == S_YAO || sharing == S_YAO_REV) {
+		//the Yao server of the sharing is the sender of the OTs
+		BOOL sender = (sharing == S_YAO) == (m_eRole == SERVER);
+		pool->abits = sender ? 0 : 1;
+		pool->bbits = bitlen;
+		pool->cbits = sender ? bitlen : 0;
+	} else {
+		pool->abits = (sharing == S_ARITH) ? bitlen : 1;
+		pool->bbits = bitlen;
+		pool->cbits = bitlen;
+	}
+	m_vPools.push_back(pool);
+	return pool;
+}
+
+void ABYSetup::FreePools() {
+	for (uint32_t i = 0; i < m_vPools.size(); i++) {
+		free(m_vPools[i]->A);
+		free(m_vPools[i]->B);
+		free(m_vPools[i]->C);
+		free(m_vPools[i]);
+	}
+	m_vPools.clear();
+}
+
+BOOL ABYSetup::TakeFromPool(e_sharing sharing, std::vector<mt_store_section>& sections) {
+	if (m_nPoolExecs == 0)
+		return FALSE;
+	WaitForPoolRefill();
+
+	//the values are taken in multiples of 8, such that the remaining values start at a byte
+	BOOL success = TRUE;
+	std::vector<PoolVals*> pools(sections.size(), NULL);
+	for (uint32_t i = 0; i < sections.size(); i++) {
+		if (sections[i].nmts == 0)
+			continue;
+		uint64_t nvals = PadToMultiple(sections[i].nmts, 8);
+		pools[i] = GetPool(sharing, sections[i].bitlen);
+		pools[i]->ntarget = nvals * m_nPoolExecs;
+		success &= pools[i]->navail >= nvals;
+	}
+	if (!success)
+		return FALSE;
+
+	for (uint32_t i = 0; i < sections.size(); i++) {
+		PoolVals* pool = pools[i];
+		if (!pool)
+			continue;
+		if (pool->abits > 0 && sections[i].A)
+			memcpy(sections[i].A, pool->A + pool->nstart * pool->abits / 8, sections[i].abytes);
+		if (pool->bbits > 0 && sections[i].B)
+			memcpy(sections[i].B, pool->B + pool->nstart * pool->bbits / 8, sections[i].bcbytes);
+		if (pool->cbits > 0 && sections[i].C)
+			memcpy(sections[i].C, pool->C + pool->nstart * pool->cbits / 8, sections[i].bcbytes);
+		uint64_t nvals = PadToMultiple(sections[i].nmts, 8);
+		pool->nstart += nvals;
+		pool->navail -= nvals;
+	}
+	return TRUE;
+}
+
+void ABYSetup::StartPoolRefill() {
+	if (m_nPoolExecs == 0 || m_vPools.size() == 0)
+		return;
+	WaitForPoolRefill();
+	m_lockPool.Lock();
+	m_bPoolRefill = TRUE;
+	m_lockPool.Unlock();
+	m_pPoolThread->PutJob(e_RefillPool);
+}
+
+BOOL ABYSetup::WaitForPoolRefill() {
+	for (;;) {
+		m_lockPool.Lock();
+		BOOL refill = m_bPoolRefill;
+		m_lockPool.Unlock();
+		if (!refill)
+			return m_bPoolSuccess;
+		m_evtPool.Wait();
+	}
+	return m_bPoolSuccess;
+}
+
+//The OTs are the same as the ones of BoolSharing, ArithSharing and YaoServerSharing / YaoClientSharing in PrepareSetupPhase
+void ABYSetup::AddPoolOTTasks(PoolVals* pool, uint64_t nvals, CBitVector* A, CBitVector* B, CBitVector* C, CBitVector* S) {
+	uint32_t bitlen = pool->bitlen;
+
+	if (pool->sharing == S_YAO || pool->sharing == S_YAO_REV) {
+		uint32_t inverse = pool->sharing == S_YAO ? 0 : 1;
+		IKNP_OTTask* task = (IKNP_OTTask*) malloc(sizeof(IKNP_OTTask));
+		task->bitlen = bitlen;
+		task->snd_flavor = Snd_R_OT;
+		task->rec_flavor = Rec_OT;
+		task->numOTs = nvals;
+		task->mskfct = new XORMasking(bitlen);
+		task->delete_mskfct = TRUE;
+		B->Create(nvals * bitlen);
+		if (pool->cbits > 0) {
+			C->Create(nvals * bitlen);
+			task->pval.sndval.X0 = B;
+			task->pval.sndval.X1 = C;
+		} else {
+			A->Create(nvals, m_cPoolCrypt);
+			task->pval.rcvval.C = A;
+			task->pval.rcvval.R = B;
+		}
+		m_vIKNPOTTasks[inverse].push_back(task);
+		return;
+	}
+
+	if (pool->sharing == S_ARITH) {
+		A->Create(nvals, bitlen, m_cPoolCrypt);
+		B->Create(nvals, bitlen, m_cPoolCrypt);
+		C->Create(nvals, bitlen);
+		S->Create(nvals, bitlen);
+	} else {
+		A->Create(nvals, m_cPoolCrypt);
+		B->Create(nvals * bitlen, m_cPoolCrypt);
+		C->Create(nvals * bitlen);
+		S->Create(nvals * bitlen);
+	}
+	for (uint32_t j = 0; j < 2; j++) {
+		IKNP_OTTask* task = (IKNP_OTTask*) malloc(sizeof(IKNP_OTTask));
+		task->bitlen = bitlen;
+		task->rec_flavor = Rec_OT;
+		task->delete_mskfct = TRUE;
+		if (pool->sharing == S_ARITH) {
+			task->snd_flavor = Snd_C_OT;
+			task->numOTs = nvals * bitlen;
+			switch (bitlen) {
+			case 8:
+				task->mskfct = new ArithMTMasking<UINT8_T>(1, B);
+				break;
+			case 16:
+				task->mskfct = new ArithMTMasking<UINT16_T>(1, B);
+				break;
+			case 64:
+				task->mskfct = new ArithMTMasking<UINT64_T>(1, B);
+				break;
+			default:
+				task->mskfct = new ArithMTMasking<UINT32_T>(1, B);
+				break;
+			}
+		} else {
+			task->snd_flavor = Snd_R_OT;
+			task->numOTs = nvals;
+			task->mskfct = new XORMasking(bitlen);
+		}
+		if ((m_eRole ^ j) == SERVER) {
+			task->pval.sndval.X0 = C;
+			task->pval.sndval.X1 = (pool->sharing == S_ARITH) ? C : B;
+		} else {
+			task->pval.rcvval.C = A;
+			task->pval.rcvval.R = S;
+		}
+		m_vIKNPOTTasks[j].push_back(task);
+	}
+}
+
+template<typename T>
+static void ComputeArithPoolMTs(CBitVector* A, CBitVector* B, CBitVector* C, CBitVector* S, uint64_t nvals) {
+	T* a = (T*) A->GetArr();
+	T* b = (T*) B->GetArr();
+	T* c = (T*) C->GetArr();
+	T* s = (T*) S->GetArr();
+	for (uint64_t i = 0; i < nvals; i++) {
+		c[i] = a[i] * b[i] + c[i] + s[i];
+	}
+}
+
+//Same as BoolSharing::ComputeMTs and ArithSharing::ComputeMTsFromOTs
+void ABYSetup::ComputePoolMTs(PoolVals* pool, uint64_t nvals, CBitVector* A, CBitVector* B, CBitVector* C, CBitVector* S) {
+	uint32_t bitlen = pool->bitlen;
+
+	if (pool->sharing == S_ARITH) {
+		switch (bitlen) {
+		case 8:
+			ComputeArithPoolMTs<UINT8_T>(A, B, C, S, nvals);
+			break;
+		case 16:
+			ComputeArithPoolMTs<UINT16_T>(A, B, C, S, nvals);
+			break;
+		case 64:
+			ComputeArithPoolMTs<UINT64_T>(A, B, C, S, nvals);
+			break;
+		default:
+			ComputeArithPoolMTs<UINT32_T>(A, B, C, S, nvals);
+			break;
+		}
+		return;
+	}
+
+	uint64_t stringbytelen = nvals * bitlen / 8;
+	CBitVector temp;
+	temp.Create(stringbytelen * 8);
+	temp.Reset();
+
+	B->XORBytes(C->GetArr(), 0, stringbytelen);
+	if (bitlen == 1) {
+		temp.SetAND(A->GetArr(), B->GetArr(), 0, nvals / 8);
+	} else {
+		for (uint64_t j = 0, bitidx = 0; j < nvals; j++, bitidx += bitlen) {
+			if (A->GetBitNoMask(j)) {
+				temp.SetBitsPosOffset(B->GetArr(), bitidx, bitidx, bitlen);
+			}
+		}
+	}
+	C->XORBytes(temp.GetArr(), 0, stringbytelen);
+	C->XORBytes(S->GetArr(), 0, stringbytelen);
+	temp.delCBitVector();
+}
+
+//Moves the values that were not yet taken to the front of the buffer and appends the new values
+static BYTE* AppendToPoolBuffer(BYTE* buf, uint32_t bits, uint64_t nstart, uint64_t navail, BYTE* vals, uint64_t nvals) {
+	if (bits == 0)
+		return buf;
+	uint64_t availbytes = navail * bits / 8;
+	uint64_t valbytes = nvals * bits / 8;
+	if (availbytes > 0)
+		memmove(buf, buf + nstart * bits / 8, availbytes);
+	buf = (BYTE*) realloc(buf, availbytes + valbytes);
+	memcpy(buf + availbytes, vals, valbytes);
+	return buf;
+}
+
+//Runs on the pool thread. Both parties refill the same pools in the same order, since they took the same values.
+BOOL ABYSetup::ThreadRunPoolRefill() {
+	uint32_t npools = m_vPools.size();
+	std::vector<uint64_t> nvals(npools, 0);
+	std::vector<CBitVector> A(npools), B(npools), C(npools), S(npools);
+	BOOL refill = FALSE;
+
+	for (uint32_t i = 0; i < npools; i++) {
+		PoolVals* pool = m_vPools[i];
+		if (pool->navail >= pool->ntarget)
+			continue;
+		nvals[i] = pool->ntarget - pool->navail;
+		AddPoolOTTasks(pool, nvals[i], &A[i], &B[i], &C[i], &S[i]);
+		refill = TRUE;
+	}
+
+	BOOL success = TRUE;
+	if (refill) {
+		WakeupWorkerThreads(e_IKNPOTExt);
+		success = WaitWorkerThreads();
+	}
+	if (!success) {
+		std::cerr << "Error: Unable to refill the setup pool" << std::endl;
+	}
+
+	for (uint32_t i = 0; i < npools; i++) {
+		PoolVals* pool = m_vPools[i];
+		if (nvals[i] > 0 && success) {
+			if (pool->sharing != S_YAO && pool->sharing != S_YAO_REV) {
+				ComputePoolMTs(pool, nvals[i], &A[i], &B[i], &C[i], &S[i]);
+			}
+			pool->A = AppendToPoolBuffer(pool->A, pool->abits, pool->nstart, pool->navail, A[i].GetArr(), nvals[i]);
+			pool->B = AppendToPoolBuffer(pool->B, pool->bbits, pool->nstart, pool->navail, B[i].GetArr(), nvals[i]);
+			pool->C = AppendToPoolBuffer(pool->C, pool->cbits, pool->nstart, pool->navail, C[i].GetArr(), nvals[i]);
+			pool->nstart = 0;
+			pool->navail += nvals[i];
+		}
+		A[i].delCBitVector();
+		B[i].delCBitVector();
+		C[i].delCBitVector();
+		S[i].delCBitVector();
+	}
+
+	m_lockPool.Lock();
+	m_bPoolSuccess = success;
+	m_bPoolRefill = FALSE;
+	m_lockPool.Unlock();
+	m_evtPool.Set();
+	return success;
+}
+
 //starts a new sending thread but may stop if there is a thread already running
 void ABYSetup::AddSendTask(BYTE* sndbuf, uint64_t sndbytes) {
 	WaitWorkerThreads();
@@ -475,12 +792,50 @@ BOOL ABYSetup::WaitForTransmissionEnd() {
 
 //starts a new receivingthread but may stop if there is a thread already running
 void ABYSetup::AddReceiveTask(BYTE* rcvbuf, uint64_t rcvbytes) {
+	//the data of a running stream precedes the data of this task on the setup channel
+	WaitForStreamEnd();
 	WaitWorkerThreads();
 	m_trcvtask.rcvbytes = rcvbytes;
 	m_trcvtask.rcvbuf = rcvbuf;
 	WakeupWorkerThreads(e_Receive);
 }
 
+//starts receiving the buffers on the stream thread and returns immediately
+void ABYSetup::AddStreamReceiveTask(std::vector<BYTE*>& rcvbuf, std::vector<uint64_t>& rcvbytes, uint64_t windowbytes) {
+	WaitForStreamEnd();
+	WaitWorkerThreads();
+	assert(rcvbuf.size() == rcvbytes.size() && windowbytes > 0);
+	m_tstreamtask.rcvbuf = rcvbuf;
+	m_tstreamtask.rcvbytes = rcvbytes;
+	m_tstreamtask.windowbytes = windowbytes;
+	m_tstreamtask.totalbytes = 0;
+	for (uint32_t i = 0; i < rcvbytes.size(); i++) {
+		m_tstreamtask.totalbytes += rcvbytes[i];
+	}
+	m_tstreamtask.rcvdbytes = 0;
+	m_pStreamThread->PutJob(e_ReceiveStream);
+}
+
+BOOL ABYSetup::WaitForStreamReceive(uint64_t rcvbytes) {
+	for (;;) {
+		m_lockStream.Lock();
+		uint64_t rcvd = m_tstreamtask.rcvdbytes;
+		m_lockStream.Unlock();
+		if (rcvd >= rcvbytes)
+			return TRUE;
+		m_evtStream.Wait();
+	}
+	return TRUE;
+}
+
+BOOL ABYSetup::WaitForStreamEnd() {
+	return WaitForStreamReceive(m_tstreamtask.totalbytes);
+}
+
+channel* ABYSetup::CreateChannel(uint32_t channelid) {
+	return new channel(channelid, m_tComm->rcv_std, m_tComm->snd_std);
+}
+
 BOOL ABYSetup::ThreadSendData(uint32_t threadid) {
 	m_tSetupChan->send(m_tsndtask.sndbuf, m_tsndtask.sndbytes);
 	return true;
@@ -491,6 +846,24 @@ BOOL ABYSetup::ThreadReceiveData(uint32_t threadid) {
 	return true;
 }
 
+BOOL ABYSetup::ThreadReceiveStream() {
+	uint64_t rcvd = 0;
+	for (uint32_t i = 0; i < m_tstreamtask.rcvbuf.size(); i++) {
+		for (uint64_t pos = 0; pos < m_tstreamtask.rcvbytes[i];) {
+			uint64_t len = std::min(m_tstreamtask.windowbytes, m_tstreamtask.rcvbytes[i] - pos);
+			m_tSetupChan->blocking_receive(m_tstreamtask.rcvbuf[i] + pos, len);
+			pos += len;
+			rcvd += len;
+
+			m_lockStream.Lock();
+			m_tstreamtask.rcvdbytes = rcvd;
+			m_lockStream.Unlock();
+			m_evtStream.Set();
+		}
+	}
+	return true;
+}
+
 //===========================================================================
 // Thread Management
 BOOL ABYSetup::WakeupWorkerThreads(EJobType e) {
@@ -498,9 +871,9 @@ BOOL ABYSetup::WakeupWorkerThreads(EJobType e) {
 
 	m_nWorkingThreads = 2;
 
-	if (e == e_MTPaillier || e == e_MTDGK)
+	if (e == e_MTDGK)
 		m_nWorkingThreads = 2 * m_nNumOTThreads;
-	else if (e == e_Send || e == e_Receive)
+	else if (e == e_MTPaillier || e == e_Send || e == e_Receive)
 		m_nWorkingThreads = 1;
 
 	uint32_t n = m_nWorkingThreads;
@@ -577,6 +950,14 @@ void ABYSetup::CWorkerThread::ThreadMain() {
 		case e_Receive:
 			bSuccess = m_pCallback->ThreadReceiveData(threadid);
 			break;
+		case e_ReceiveStream:
+			//the stream thread is not accounted in m_nWorkingThreads and reports its progress separately
+			m_pCallback->ThreadReceiveStream();
+			continue;
+		case e_RefillPool:
+			//the pool thread is not accounted in m_nWorkingThreads either
+			m_pCallback->ThreadRunPoolRefill();
+			continue;
 		case e_Transmit:
 		case e_Undefined:
 		default:
@@ -587,6 +968,8 @@ void ABYSetup::CWorkerThread::ThreadMain() {
 }
 
 void ABYSetup::Reset() {
+	WaitForPoolRefill();
+	WaitForStreamEnd();
 	/* Clear any remaining OT tasks */
 	for (uint32_t i = 0; i < m_vIKNPOTTasks.size(); i++) {
 		m_vIKNPOTTasks[i].clear();
@@ -32,6 +32,7 @@
 #include <ot/kk-ot-ext-rec.h>
 #include "../DJN/djnparty.h"
 #include "../DGK/dgkparty.h"
+#include "../sharing/mtstore.h"
 #include <ENCRYPTO_utils/constants.h>
 #include <ENCRYPTO_utils/timer.h>
 #include <ENCRYPTO_utils/channel.h>
@@ -113,6 +114,27 @@ struct ReceiveTask {
 	BYTE* rcvbuf; 	  	//buffer for the result
 };
 
+struct StreamReceiveTask {
+	std::vector<BYTE*> rcvbuf{};		//buffers that are filled one after another
+	std::vector<uint64_t> rcvbytes{};	//number of bytes to be received into each buffer
+	uint64_t windowbytes = 0;			//size of the messages a buffer is received in, the last message may be shorter
+	uint64_t totalbytes = 0;			//sum of rcvbytes
+	uint64_t rcvdbytes = 0; 			//number of bytes that were received so far, protected by m_lockStream
+};
+
+/* Pre-computed values of one sharing and bit-length, which are kept in the pool across executions */
+struct PoolVals {
+	e_sharing sharing; //sharing the values are taken by
+	uint32_t bitlen; //bit-length of the MTs or of the OT strings
+	uint32_t abits, bbits, cbits; //bits of A, B and C per value, 0 if the buffer is not used by this party
+	uint64_t nstart; //index of the first value that was not yet taken
+	uint64_t navail; //number of values that were not yet taken
+	uint64_t ntarget; //number of values the pool is refilled to
+	BYTE* A; //MTs: A, Yao input OTs: choice bits of the receiver
+	BYTE* B; //MTs: B, Yao input OTs: X0 of the sender, received strings of the receiver
+	BYTE* C; //MTs: C, Yao input OTs: X1 of the sender
+};
+
 class ABYSetup {
 
 public:
@@ -146,6 +168,51 @@ public:
 
 	BOOL WaitForTransmissionEnd();
 
+	/**
+	 Receive the buffers one after another in messages of windowbytes bytes on a dedicated thread, such that the
+	 received data can be processed before the transmission is complete. Subsequent receive tasks on the setup
+	 channel wait until the stream is complete, and the stream only starts once the worker threads are idle. Hence,
+	 the stream is the only reader of the setup channel while it runs. The OT extension and the MT generation of the
+	 worker threads run over their own channels and are not affected by the stream.
+	 \param rcvbuf		buffers that are received into
+	 \param rcvbytes	number of bytes for each buffer
+	 \param windowbytes	message size in which the sender transmits the buffers
+	 */
+	void AddStreamReceiveTask(std::vector<BYTE*>& rcvbuf, std::vector<uint64_t>& rcvbytes, uint64_t windowbytes);
+	/**
+	 Block until at least rcvbytes bytes of the current stream have been received.
+	 \param rcvbytes	number of bytes, counted over all buffers of the stream
+	 */
+	BOOL WaitForStreamReceive(uint64_t rcvbytes);
+	/** Block until all buffers of the current stream have been received. */
+	BOOL WaitForStreamEnd();
+
+	/**
+	 Open an additional channel on the connection of the setup phase. The channel is owned and deleted by the caller.
+	 \param channelid	id of the channel, has to be the same for both parties
+	 */
+	channel* CreateChannel(uint32_t channelid);
+
+	/**
+	 Keep the Boolean and arithmetic MTs and the Yao input OTs of nexecs executions pre-computed. The pool is refilled
+	 in the background after each reset, with the demand of the previous execution, and PrepareSetupPhase of the
+	 sharings takes from it instead of generating. Both parties have to enable the pool with the same value.
+	 \param nexecs	number of executions the pool holds values for, 0 disables the pool
+	 */
+	void EnableSetupPool(uint32_t nexecs);
+	/**
+	 Take the values of a sharing from the pool. Nothing is taken unless the pool holds enough values for all sections.
+	 The size of the sections becomes the demand the pool is refilled with.
+	 \param sharing	sharing that takes the values
+	 \param sections	bit-lengths and number of the requested values, as well as the buffers A, B and C they are copied to
+	 \return TRUE if the values were copied to the sections
+	 */
+	BOOL TakeFromPool(e_sharing sharing, std::vector<mt_store_section>& sections);
+	/** Start refilling the pool on its own thread. Does nothing if the pool is not enabled. */
+	void StartPoolRefill();
+	/** Block until the pool was refilled, which has to be done before the OT extension is used again. */
+	BOOL WaitForPoolRefill();
+
 private:
 	BOOL Init();
 	void Cleanup();
@@ -161,10 +228,17 @@ private:
 
 	BOOL ThreadSendData(uint32_t exec);
 	BOOL ThreadReceiveData(uint32_t exec);
+	BOOL ThreadReceiveStream();
 
 	BOOL ThreadRunPaillierMTGen(uint32_t exec);
 	BOOL ThreadRunDGKMTGen(uint32_t threadid);
 
+	BOOL ThreadRunPoolRefill();
+	PoolVals* GetPool(e_sharing sharing, uint32_t bitlen);
+	void AddPoolOTTasks(PoolVals* pool, uint64_t nvals, CBitVector* A, CBitVector* B, CBitVector* C, CBitVector* S);
+	void ComputePoolMTs(PoolVals* pool, uint64_t nvals, CBitVector* A, CBitVector* B, CBitVector* C, CBitVector* S);
+	void FreePools();
+
 	// IKNP OTTask values
 	std::vector<std::vector<IKNP_OTTask*> > m_vIKNPOTTasks;
 
@@ -175,11 +249,16 @@ private:
 	DJNParty* m_cPaillierMTGen;
 	DGKParty** m_cDGKMTGen;
 
+	std::vector<PoolVals*> m_vPools;
+	uint32_t m_nPoolExecs;
+	crypto* m_cPoolCrypt; //the pool draws its randomness independently of the thread that builds the next circuit
+
 	uint32_t m_nNumOTThreads;
 	e_role m_eRole;
 
 	SendTask m_tsndtask;
 	ReceiveTask m_trcvtask;
+	StreamReceiveTask m_tstreamtask;
 
 	e_mt_gen_alg m_eMTGenAlg;
 
@@ -200,7 +279,7 @@ private:
 	/* Thread information */
 
 	enum EJobType {
-		e_IKNPOTExt, e_KKOTExt, e_NP, e_Send, e_Receive, e_Transmit, e_Stop, e_MTPaillier, e_MTDGK, e_Undefined
+		e_IKNPOTExt, e_KKOTExt, e_NP, e_Send, e_Receive, e_ReceiveStream, e_RefillPool, e_Transmit, e_Stop, e_MTPaillier, e_MTDGK, e_Undefined
 	};
 
 	BOOL WakeupWorkerThreads(EJobType);
@@ -231,6 +310,16 @@ private:
 	uint32_t m_nWorkingThreads;
 	BOOL m_bWorkerThreadSuccess;
 
+	CWorkerThread* m_pStreamThread; //receives streamed data independently of the other worker threads
+	CEvent m_evtStream;
+	CLock m_lockStream;
+
+	CWorkerThread* m_pPoolThread; //refills the pool between executions
+	CEvent m_evtPool;
+	CLock m_lockPool;
+	BOOL m_bPoolRefill; //protected by m_lockPool
+	BOOL m_bPoolSuccess;
+
 
 };
 
@@ -21,6 +21,11 @@
 #include <algorithm>
 #include <cassert>
 #include <cstring>
+#include <iterator>
+#include <map>
+#include <queue>
+#include <set>
+#include <unordered_map>
 #include <string>
 #include <iostream>
 #include <vector>
@@ -28,12 +33,14 @@
 
 void ABYCircuit::Cleanup() {
 	Reset();
-	free(m_pGates);
+	free(m_pGateBuf);
 }
 
-ABYCircuit::ABYCircuit(uint32_t maxgates) {
+//the gates are aligned to a cache line. calloc is kept, since it leaves the pages of unused gates untouched
+ABYCircuit::ABYCircuit(uint32_t maxgates) :
+		m_pGateBuf(calloc(1, (uint64_t) maxgates * sizeof(GATE) + GATE_ALIGNMENT)), m_cValueArena(), m_vGateUses() {
 	m_nMaxGates = maxgates;
-	m_pGates = (GATE*) calloc(maxgates, sizeof(GATE));
+	m_pGates = (GATE*) PadToMultiple((uintptr_t) m_pGateBuf, (uintptr_t) GATE_ALIGNMENT);
 	m_nNextFreeGate = 0;
 	m_nMaxVectorSize = 1;
 	m_nMaxDepth = 0;
@@ -155,6 +162,35 @@ uint32_t ABYCircuit::PutNonLinearVectorGate(e_gatetype type, uint32_t choiceinpu
 	return m_nNextFreeGate++;
 }
 
+//add a dot-product gate, which multiplies the values of both inputs pairwise and holds the sum of the products as single value
+uint32_t ABYCircuit::PutDotProductGate(uint32_t inleft, uint32_t inright, uint32_t rounds) {
+	GATE* gate = m_pGates + m_nNextFreeGate;
+	InitGate(gate, G_NON_LIN_DOT, inleft, inright);
+
+	assert(m_pGates[inleft].nvals == m_pGates[inright].nvals);
+
+	gate->nvals = 1;
+
+	gate->nrounds = rounds;
+
+	return m_nNextFreeGate++;
+}
+
+//add a matrix multiplication gate, the dimensions of the matrices are kept by the circuit that puts the gate
+uint32_t ABYCircuit::PutMatMulGate(uint32_t inleft, uint32_t inright, uint32_t nvals, uint32_t rounds) {
+	GATE* gate = m_pGates + m_nNextFreeGate;
+	InitGate(gate, G_NON_LIN_MAT, inleft, inright);
+
+	gate->nvals = nvals;
+
+	gate->nrounds = rounds;
+
+	if (gate->nvals > m_nMaxVectorSize)
+		m_nMaxVectorSize = gate->nvals;
+
+	return m_nNextFreeGate++;
+}
+
 uint32_t ABYCircuit::PutCombinerGate(std::vector<uint32_t> input) {
 	GATE* gate = m_pGates + m_nNextFreeGate;
 	InitGate(gate, G_COMBINE, input);
@@ -812,8 +848,702 @@ uint32_t FindBitLenPositionInVec(uint32_t bitlen, non_lin_vec_ctx* list, uint32_
 }
 
 void ABYCircuit::Reset() {
-	memset(m_pGates, 0, sizeof(GATE) * m_nMaxGates);
+	//the gates after the head were never used and are still zero, which keeps a reset cheap for large maxgates
+	memset(m_pGates, 0, sizeof(GATE) * m_nNextFreeGate);
+	m_cValueArena.Reset();
 	m_nNextFreeGate = 0;
 	m_nMaxVectorSize = 1;
 	m_nMaxDepth = 0;
 }
+
+//Returns input i of a gate. The inputs are kept in ingates in a layout that depends on the gate type.
+static uint32_t& GetGateInput(GATE* gate, uint32_t i) {
+	switch (gate->type) {
+	case G_LIN:
+	case G_NON_LIN:
+	case G_NON_LIN_VEC:
+	case G_NON_LIN_CONST:
+	case G_NON_LIN_DOT:
+	case G_NON_LIN_MAT:
+		return i == 0 ? gate->ingates.inputs.twin.left : gate->ingates.inputs.twin.right;
+	case G_INV:
+	case G_OUT:
+	case G_SHARED_OUT:
+	case G_SPLIT:
+	case G_REPEAT:
+	case G_SUBSET:
+		return gate->ingates.inputs.parent;
+	default:
+		return gate->ingates.inputs.parents[i];
+	}
+}
+
+//Hands out offsets in the planned region of one sharing, best-fit from the holes that released values leave behind
+struct plan_region {
+	uint64_t end = 0;
+	uint64_t peak = 0;
+	std::map<uint64_t, uint64_t> holes {}; //offset -> size
+	std::set<std::pair<uint64_t, uint64_t> > bysize {}; //(size, offset)
+};
+
+static uint64_t PlanAlloc(plan_region& r, uint64_t bytes) {
+	std::set<std::pair<uint64_t, uint64_t> >::iterator it = r.bysize.lower_bound(std::make_pair(bytes, (uint64_t) 0));
+	if (it == r.bysize.end()) {
+		uint64_t offset = r.end;
+		r.end += bytes;
+		r.peak = std::max(r.peak, r.end);
+		return offset;
+	}
+	uint64_t size = it->first, offset = it->second;
+	r.bysize.erase(it);
+	r.holes.erase(offset);
+	if (size > bytes) {
+		r.holes[offset + bytes] = size - bytes;
+		r.bysize.insert(std::make_pair(size - bytes, offset + bytes));
+	}
+	return offset;
+}
+
+static void PlanFree(plan_region& r, uint64_t offset, uint64_t bytes) {
+	//merge with the neighbouring holes
+	std::map<uint64_t, uint64_t>::iterator next = r.holes.lower_bound(offset);
+	if (next != r.holes.end() && offset + bytes == next->first) {
+		bytes += next->second;
+		r.bysize.erase(std::make_pair(next->second, next->first));
+		next = r.holes.erase(next);
+	}
+	if (next != r.holes.begin()) {
+		std::map<uint64_t, uint64_t>::iterator prev = std::prev(next);
+		if (prev->first + prev->second == offset) {
+			offset = prev->first;
+			bytes += prev->second;
+			r.bysize.erase(std::make_pair(prev->second, prev->first));
+			r.holes.erase(prev);
+		}
+	}
+	if (offset + bytes == r.end) {
+		r.end = offset;
+	} else {
+		r.holes[offset] = bytes;
+		r.bysize.insert(std::make_pair(bytes, offset));
+	}
+}
+
+void ABYCircuit::PlanGateValues(std::vector<uint64_t>& bytes) {
+	const uint32_t alive = (uint32_t) -1;
+	uint32_t ngates = m_nNextFreeGate;
+	std::vector<uint32_t> birth(ngates), death(ngates);
+	uint32_t maxlevel = 0;
+
+	for (uint32_t i = 0; i < ngates; i++) {
+		GATE* gate = m_pGates + i;
+		//inputs and conversions can already be instantiated in the setup phase
+		birth[i] = (gate->type == G_IN || gate->type == G_CONV || gate->type == G_SHARED_IN) ? 0 : gate->depth;
+		//values that are never released by UsedGate live until the end of the execution
+		death[i] = (gate->nused == 0 || gate->type == G_CONV) ? alive : birth[i];
+	}
+	for (uint32_t i = 0; i < ngates; i++) {
+		GATE* user = m_pGates + i;
+		for (uint32_t j = 0; j < user->ingates.ningates; j++) {
+			uint32_t parent = GetGateInput(user, j);
+			if (death[parent] == alive)
+				continue;
+			//another sharing can read the value in a different phase, e.g., while garbling in the setup phase
+			if (user->context != m_pGates[parent].context) {
+				death[parent] = alive;
+			} else {
+				//a gate with several rounds reads its parents until its last round
+				death[parent] = std::max(death[parent], user->depth + std::max(user->nrounds, (uint32_t) 1));
+			}
+		}
+	}
+
+	//sort the planned gates by the level their value is created and released on
+	std::vector<uint32_t> nborn, nreleased;
+	for (uint32_t i = 0; i < ngates; i++) {
+		bytes[i] = PadToMultiple(bytes[i], (uint64_t) GATE_ARENA_PLAN_GRANULE);
+		if (bytes[i] == 0)
+			continue;
+		maxlevel = std::max(maxlevel, birth[i]);
+		if (death[i] != alive)
+			maxlevel = std::max(maxlevel, death[i]);
+	}
+	nborn.assign(maxlevel + 2, 0);
+	nreleased.assign(maxlevel + 2, 0);
+	for (uint32_t i = 0; i < ngates; i++) {
+		if (bytes[i] == 0)
+			continue;
+		nborn[birth[i] + 1]++;
+		if (death[i] != alive)
+			nreleased[death[i] + 1]++;
+	}
+	for (uint32_t l = 1; l < maxlevel + 2; l++) {
+		nborn[l] += nborn[l - 1];
+		nreleased[l] += nreleased[l - 1];
+	}
+	std::vector<uint32_t> born(nborn[maxlevel + 1]), released(nreleased[maxlevel + 1]);
+	for (uint32_t i = 0; i < ngates; i++) {
+		if (bytes[i] == 0)
+			continue;
+		born[nborn[birth[i]]++] = i;
+		if (death[i] != alive)
+			released[nreleased[death[i]]++] = i;
+	}
+
+	//linear scan over the levels, in which a value is released after the level of its last use
+	std::vector<plan_region> regions(S_LAST);
+	for (uint32_t i = 0; i < S_LAST; i++) {
+		regions[i].end = 0;
+		regions[i].peak = 0;
+	}
+	std::vector<uint64_t> offsets(ngates, GATE_ARENA_UNPLANNED);
+	for (uint32_t l = 0, b = 0, r = 0; l <= maxlevel; l++) {
+		for (; r < released.size() && death[released[r]] < l; r++) {
+			uint32_t g = released[r];
+			PlanFree(regions[m_pGates[g].context], offsets[g], bytes[g]);
+		}
+		for (; b < born.size() && birth[born[b]] == l; b++) {
+			uint32_t g = born[b];
+			offsets[g] = PlanAlloc(regions[m_pGates[g].context], bytes[g]);
+		}
+	}
+
+	//the regions of the sharings are laid out one after the other
+	uint64_t plannedbytes[S_LAST];
+	uint64_t base = 0;
+	for (uint32_t i = 0; i < S_LAST; i++) {
+		plannedbytes[i] = regions[i].peak;
+		regions[i].end = base;
+		base += regions[i].peak;
+	}
+	for (uint32_t i = 0; i < ngates; i++) {
+		if (offsets[i] != GATE_ARENA_UNPLANNED)
+			offsets[i] += regions[m_pGates[i].context].end;
+	}
+	m_cValueArena.SetPlan(offsets, bytes, plannedbytes);
+}
+
+//Identifies the value that a gate computes from its inputs, which is shared by gates that compute the same value
+struct gate_key {
+	uint64_t a;
+	uint64_t b;
+	uint32_t typectx;
+	uint32_t nvals;
+	bool operator==(const gate_key& k) const {
+		return a == k.a && b == k.b && typectx == k.typectx && nvals == k.nvals;
+	}
+};
+
+struct gate_key_hash {
+	size_t operator()(const gate_key& k) const {
+		uint64_t h = k.a * 0x9E3779B97F4A7C15ULL;
+		h = (h ^ (h >> 29) ^ k.b) * 0xBF58476D1CE4E5B9ULL;
+		h = (h ^ (h >> 32) ^ (((uint64_t) k.typectx) << 32 | k.nvals)) * 0x94D049BB133111EBULL;
+		return (size_t) (h ^ (h >> 31));
+	}
+};
+
+//Replaces the input from of a gate by to and returns the number of replaced inputs
+static uint32_t ReplaceGateInput(GATE* gate, uint32_t from, uint32_t to) {
+	uint32_t replaced = 0;
+	for (uint32_t i = 0; i < gate->ingates.ningates; i++) {
+		if (GetGateInput(gate, i) == from) {
+			GetGateInput(gate, i) = to;
+			replaced++;
+		}
+	}
+	return replaced;
+}
+
+//Returns the value of a constant gate if all its values are the same bit and all sharings read it as that bit, -1 otherwise
+static int8_t GetUniformConstant(GATE* gate) {
+	if (gate->gs.constval == 0)
+		return 0;
+	//the Yao sharings read one bit of constval per value
+	if (gate->nvals < GATE_T_BITS) {
+		UGATE_T mask = (((UGATE_T) 1) << gate->nvals) - 1;
+		if ((gate->gs.constval & mask) == mask)
+			return 1;
+	}
+	return -1;
+}
+
+//Collects the uses of all gates from their inputs into m_vGateUses, ordered by the gate that uses them, such that the
+//inputs of gate i are the range from inputstart[i] to inputstart[i + 1]
+void ABYCircuit::IndexGateInputs(std::vector<uint32_t>& inputstart) {
+	uint32_t ngates = m_nNextFreeGate;
+	inputstart.assign(ngates + 1, 0);
+	for (uint32_t i = 0; i < ngates; i++) {
+		inputstart[i + 1] = inputstart[i] + m_pGates[i].ingates.ningates;
+	}
+	m_vGateUses.resize(inputstart[ngates]);
+	for (uint32_t i = 0; i < ngates; i++) {
+		for (uint32_t j = 0; j < m_pGates[i].ingates.ningates; j++) {
+			m_vGateUses[inputstart[i] + j] = std::make_pair(GetGateInput(m_pGates + i, j), i);
+		}
+	}
+}
+
+//Frees the uses after a pass, the inputs of the gates were updated along with them
+void ABYCircuit::ClearGateUses() {
+	std::vector<std::pair<uint32_t, uint32_t> >().swap(m_vGateUses);
+}
+
+inline BOOL ABYCircuit::IsOptimizable(GATE* gate) {
+	return (gate->context == S_BOOL || gate->context == S_YAO || gate->context == S_YAO_REV) && !gate->instantiated;
+}
+
+//Drops the uses of the inputs of a gate, or only its use of the input only
+inline void ABYCircuit::ReleaseGateInputs(uint32_t gateid, std::vector<uint32_t>& inputstart, uint32_t only) {
+	for (uint32_t i = inputstart[gateid]; i < inputstart[gateid + 1]; i++) {
+		uint32_t parent = m_vGateUses[i].first;
+		if (parent == (uint32_t) -1 || (only != (uint32_t) -1 && parent != only))
+			continue;
+		m_pGates[parent].nused--;
+		m_vGateUses[i].first = (uint32_t) -1;
+		if (only != (uint32_t) -1)
+			return;
+	}
+}
+
+BOOL ABYCircuit::FoldToConstant(uint32_t gateid, uint32_t val, std::vector<uint32_t>& inputstart, std::vector<int8_t>& constant,
+		std::vector<BYTE>& status) {
+	GATE* gate = m_pGates + gateid;
+	//a constant one with 64 or more values is not read the same by all sharings
+	if (val && gate->nvals >= GATE_T_BITS)
+		return FALSE;
+	ReleaseGateInputs(gateid, inputstart);
+	status[gateid] |= (gate->type == G_LIN ? GATE_OPT_WAS_LIN : 0) | (gate->type == G_NON_LIN ? GATE_OPT_WAS_NON_LIN : 0) | GATE_OPT_FOLDED;
+	gate->type = G_CONSTANT;
+	gate->gs.constval = val ? (((UGATE_T) 1) << gate->nvals) - 1 : 0;
+	gate->ingates.ningates = 0;
+	gate->nrounds = 0;
+	constant[gateid] = val;
+	return TRUE;
+}
+
+//Lets all users of a gate read the value of an earlier gate with the same value instead, after which the gate is unused
+BOOL ABYCircuit::ReplaceGate(uint32_t gateid, uint32_t by, std::vector<uint32_t>& userstart, std::vector<uint32_t>& users) {
+	//the users are scheduled for the level the value of the gate is ready on
+	if (ComputeDepth(m_pGates[by]) > ComputeDepth(m_pGates[gateid]))
+		return FALSE;
+	for (uint32_t i = userstart[gateid]; i < userstart[gateid + 1]; i++) {
+		uint32_t use = users[i];
+		if (m_vGateUses[use].first != gateid)
+			continue;
+		//a user that reads the gate twice has both inputs replaced at its first use
+		ReplaceGateInput(m_pGates + m_vGateUses[use].second, gateid, by);
+		m_vGateUses[use].first = by;
+		m_pGates[gateid].nused--;
+		m_pGates[by].nused++;
+	}
+	return TRUE;
+}
+
+uint32_t ABYCircuit::OptimizeGates(std::vector<BYTE>& status) {
+	uint32_t ngates = m_nNextFreeGate;
+	uint32_t nremoved = 0;
+	status.assign(ngates, 0);
+
+	//index the uses by the gate that uses them and by the gate that is used
+	std::vector<uint32_t> inputstart, userstart(ngates + 1, 0);
+	IndexGateInputs(inputstart);
+	std::vector<uint32_t> users(m_vGateUses.size());
+	for (uint32_t i = 0; i < m_vGateUses.size(); i++) {
+		userstart[m_vGateUses[i].first + 1]++;
+	}
+	for (uint32_t i = 0; i < ngates; i++) {
+		userstart[i + 1] += userstart[i];
+	}
+	std::vector<uint32_t> fill(userstart.begin(), userstart.end() - 1);
+	for (uint32_t i = 0; i < m_vGateUses.size(); i++) {
+		users[fill[m_vGateUses[i].first]++] = i;
+	}
+
+	//fold constants and replace repeated gates, the inputs of a gate are final when it is reached in the order of the ids
+	std::vector<int8_t> constant(ngates, -1);
+	std::unordered_map<gate_key, uint32_t, gate_key_hash> unique;
+	for (uint32_t i = 0; i < ngates; i++) {
+		GATE* gate = m_pGates + i;
+		if (!IsOptimizable(gate) || gate->nused == 0)
+			continue;
+
+		if (gate->type == G_LIN || gate->type == G_NON_LIN) {
+			uint32_t left = gate->ingates.inputs.twin.left;
+			uint32_t right = gate->ingates.inputs.twin.right;
+			if (constant[left] != -1) {
+				std::swap(left, right);
+			}
+			int8_t cl = constant[left], cr = constant[right];
+			BOOL samenvals = m_pGates[left].nvals == gate->nvals;
+			if (gate->type == G_LIN) {
+				if (cl != -1) {
+					FoldToConstant(i, cl ^ cr, inputstart, constant, status);
+				} else if (left == right) {
+					FoldToConstant(i, 0, inputstart, constant, status);
+				} else if (cr == 0 && samenvals && ReplaceGate(i, left, userstart, users)) {
+					continue;
+				} else if (cr == 1 && samenvals) {
+					//x ^ 1 is evaluated locally as inversion of x
+					ReleaseGateInputs(i, inputstart, right);
+					status[i] |= GATE_OPT_WAS_LIN | GATE_OPT_FOLDED;
+					gate->type = G_INV;
+					gate->ingates.ningates = 1;
+					gate->ingates.inputs.parent = left;
+					gate->nrounds = 0;
+				}
+			} else {
+				if (cl == 0 || cr == 0 || (cl == 1 && cr == 1)) {
+					FoldToConstant(i, cl == 1 && cr == 1, inputstart, constant, status);
+				} else if ((cr == 1 || left == right) && samenvals && ReplaceGate(i, left, userstart, users)) {
+					continue;
+				}
+			}
+		} else if (gate->type == G_INV) {
+			uint32_t parent = gate->ingates.inputs.parent;
+			if (constant[parent] != -1) {
+				FoldToConstant(i, constant[parent] ^ 1, inputstart, constant, status);
+			} else if (m_pGates[parent].type == G_INV && IsOptimizable(m_pGates + parent)
+					&& m_pGates[m_pGates[parent].ingates.inputs.parent].nvals == gate->nvals
+					&& ReplaceGate(i, m_pGates[parent].ingates.inputs.parent, userstart, users)) {
+				continue;
+			}
+		} else if (gate->type == G_CONSTANT) {
+			constant[i] = GetUniformConstant(gate);
+		}
+
+		gate_key key;
+		key.typectx = ((uint32_t) gate->type << 8) | (uint32_t) gate->context;
+		key.nvals = gate->nvals;
+		if (gate->type == G_LIN || gate->type == G_NON_LIN) {
+			key.a = std::min(gate->ingates.inputs.twin.left, gate->ingates.inputs.twin.right);
+			key.b = std::max(gate->ingates.inputs.twin.left, gate->ingates.inputs.twin.right);
+		} else if (gate->type == G_INV) {
+			key.a = gate->ingates.inputs.parent;
+			key.b = 0;
+		} else if (gate->type == G_CONSTANT) {
+			key.a = gate->gs.constval;
+			key.b = 0;
+		} else {
+			continue;
+		}
+		std::pair<std::unordered_map<gate_key, uint32_t, gate_key_hash>::iterator, bool> first = unique.insert(std::make_pair(key, i));
+		if (!first.second) {
+			ReplaceGate(i, first.first->second, userstart, users);
+		}
+	}
+
+	//remove the gates that are not used, the inputs of a removed gate are visited after it
+	for (uint32_t i = ngates; i-- > 0;) {
+		GATE* gate = m_pGates + i;
+		if (!IsOptimizable(gate) || gate->nused > 0 || (status[i] & GATE_OPT_REMOVED))
+			continue;
+		if (gate->type != G_LIN && gate->type != G_NON_LIN && gate->type != G_INV && gate->type != G_CONSTANT
+				&& gate->type != G_SPLIT && gate->type != G_REPEAT && gate->type != G_COMBINE)
+			continue;
+		ReleaseGateInputs(i, inputstart);
+		status[i] |= (gate->type == G_LIN ? GATE_OPT_WAS_LIN : 0) | (gate->type == G_NON_LIN ? GATE_OPT_WAS_NON_LIN : 0) | GATE_OPT_REMOVED;
+		if (gate->type == G_COMBINE) {
+			free(gate->ingates.inputs.parents);
+		}
+		gate->ingates.ningates = 0;
+		//a removed gate belongs to no sharing, such that its value is not planned
+		gate->context = S_LAST;
+		nremoved++;
+	}
+
+	ClearGateUses();
+
+	return nremoved;
+}
+
+inline BOOL ABYCircuit::IsBalanceable(GATE* gate) {
+	return gate->type == G_NON_LIN && gate->context == S_BOOL && !gate->instantiated;
+}
+
+//Rebalances the AND tree below root if that lowers the level of root. The levels of the leaves are final.
+BOOL ABYCircuit::BalanceTree(uint32_t root, std::vector<uint32_t>& inputstart, std::vector<uint32_t>& extra, std::vector<BYTE>& inner) {
+	std::vector<uint32_t> leaves, stack(1, root);
+	std::set<uint32_t> slots;
+	while (stack.size() > 0) {
+		GATE* gate = m_pGates + stack.back();
+		stack.pop_back();
+		uint32_t in[2] = { gate->ingates.inputs.twin.left, gate->ingates.inputs.twin.right };
+		for (uint32_t i = 0; i < 2; i++) {
+			if (inner[in[i]]) {
+				stack.push_back(in[i]);
+				slots.insert(in[i]);
+			} else {
+				leaves.push_back(in[i]);
+			}
+		}
+	}
+	if (leaves.size() < 3)
+		return FALSE;
+
+	//combine the two nodes that are ready first. Each combination takes the gate with the lowest id that keeps the ids in
+	//topological order, or any other gate of the tree, since the AND gates of a level are evaluated together.
+	typedef std::pair<uint32_t, uint32_t> node; //(level the value is ready on, gate id)
+	std::priority_queue<node, std::vector<node>, std::greater<node> > ready;
+	for (uint32_t i = 0; i < leaves.size(); i++) {
+		ready.push(std::make_pair(ComputeDepth(m_pGates[leaves[i]]), leaves[i]));
+	}
+	std::vector<uint32_t> combined; //(gate, left, right) for each combination
+	uint32_t rootdepth = 0;
+	while (ready.size() > 1) {
+		node a = ready.top();
+		ready.pop();
+		node b = ready.top();
+		ready.pop();
+		uint32_t slot;
+		if (ready.size() == 0) {
+			slot = root;
+		} else {
+			std::set<uint32_t>::iterator it = slots.upper_bound(std::max(a.second, b.second));
+			if (it == slots.end())
+				it = slots.begin();
+			slot = *it;
+			slots.erase(it);
+		}
+		uint32_t depth = std::max(a.first, b.first) + extra[slot];
+		if (slot == root) {
+			rootdepth = depth;
+		} else {
+			ready.push(std::make_pair(depth + m_pGates[slot].nrounds, slot));
+		}
+		combined.push_back(slot);
+		combined.push_back(a.second);
+		combined.push_back(b.second);
+	}
+	if (rootdepth >= m_pGates[root].depth)
+		return FALSE;
+
+	//the combinations are made bottom-up, such that the inputs of a gate have their level when it is reached
+	for (uint32_t i = 0; i < combined.size(); i += 3) {
+		GATE* gate = m_pGates + combined[i];
+		gate->ingates.inputs.twin.left = combined[i + 1];
+		gate->ingates.inputs.twin.right = combined[i + 2];
+		m_vGateUses[inputstart[combined[i]]].first = combined[i + 1];
+		m_vGateUses[inputstart[combined[i]] + 1].first = combined[i + 2];
+		gate->depth = std::max(ComputeDepth(m_pGates[combined[i + 1]]), ComputeDepth(m_pGates[combined[i + 2]])) + extra[combined[i]];
+	}
+	return TRUE;
+}
+
+uint32_t ABYCircuit::BalanceGates() {
+	uint32_t ngates = m_nNextFreeGate;
+	uint32_t nbalanced = 0;
+
+	std::vector<uint32_t> inputstart;
+	IndexGateInputs(inputstart);
+
+	//the levels of some gates lie above the level their inputs are ready on, e.g., of Y2B conversions, which is kept
+	std::vector<uint32_t> extra(ngates, 0);
+	std::vector<BYTE> inner(ngates, 0);
+	for (uint32_t i = 0; i < ngates; i++) {
+		GATE* gate = m_pGates + i;
+		if (gate->context != S_BOOL || inputstart[i] == inputstart[i + 1])
+			continue;
+		uint32_t depth = 0;
+		for (uint32_t j = inputstart[i]; j < inputstart[i + 1]; j++) {
+			depth = std::max(depth, ComputeDepth(m_pGates[m_vGateUses[j].first]));
+		}
+		assert(gate->depth >= depth);
+		extra[i] = gate->depth - depth;
+
+		//an AND gate that is only read by another AND gate of the same size is an inner gate of its tree
+		if (IsBalanceable(gate)) {
+			uint32_t in[2] = { gate->ingates.inputs.twin.left, gate->ingates.inputs.twin.right };
+			for (uint32_t j = 0; j < 2; j++) {
+				GATE* parent = m_pGates + in[j];
+				if (IsBalanceable(parent) && parent->nused == 1 && parent->nvals == gate->nvals && parent->nrounds == gate->nrounds)
+					inner[in[j]] = 1;
+			}
+		}
+	}
+
+	//recompute the levels in the order of the ids, a tree is balanced when its root is reached and its leaves are final
+	for (uint32_t i = 0; i < ngates; i++) {
+		GATE* gate = m_pGates + i;
+		if (gate->context == S_BOOL && inputstart[i] < inputstart[i + 1]) {
+			uint32_t depth = 0;
+			for (uint32_t j = inputstart[i]; j < inputstart[i + 1]; j++) {
+				depth = std::max(depth, ComputeDepth(m_pGates[m_vGateUses[j].first]));
+			}
+			gate->depth = depth + extra[i];
+			if (IsBalanceable(gate) && !inner[i] && BalanceTree(i, inputstart, extra, inner))
+				nbalanced++;
+		}
+	}
+	ClearGateUses();
+	m_nMaxDepth = 0;
+	for (uint32_t i = 0; i < ngates; i++) {
+		m_nMaxDepth = std::max(m_nMaxDepth, m_pGates[i].depth);
+	}
+	return nbalanced;
+}
+
+inline BOOL ABYCircuit::IsCoalescable(GATE* gate) {
+	return (gate->type == G_LIN || gate->type == G_NON_LIN || gate->type == G_INV) && gate->context == S_BOOL && gate->nvals == 1
+			&& !gate->instantiated && gate->nused > 0;
+}
+
+//Returns the gate that holds the first value of each input, one after the other. loc is the gate and position that
+//holds the value of each gate after coalescing.
+uint32_t ABYCircuit::GatherInputs(std::vector<uint32_t>& inputs, uint32_t depth, std::vector<std::pair<uint32_t, uint32_t> >& loc) {
+	uint32_t simdid = loc[inputs[0]].first;
+	BOOL aligned = m_pGates[simdid].nvals == inputs.size();
+	for (uint32_t j = 0; j < inputs.size() && aligned; j++) {
+		aligned = loc[inputs[j]].first == simdid && loc[inputs[j]].second == j;
+	}
+	if (aligned)
+		return simdid;
+
+	std::vector<uint32_t> parents(inputs.size()), positions(inputs.size());
+	for (uint32_t j = 0; j < inputs.size(); j++) {
+		parents[j] = loc[inputs[j]].first;
+		positions[j] = loc[inputs[j]].second;
+	}
+	uint32_t gateid = PutPermutationGate(parents, positions.data());
+	//the gather is evaluated on the level of the gates it is read by
+	m_pGates[gateid].depth = depth;
+	return gateid;
+}
+
+uint32_t ABYCircuit::CoalesceGates(std::vector<BYTE>& status, std::vector<uint32_t>& rank) {
+	uint32_t ngates = m_nNextFreeGate;
+	uint32_t ncoalesced = 0;
+	status.assign(ngates, 0);
+
+	std::vector<uint32_t> inputstart;
+	IndexGateInputs(inputstart);
+
+	//the local gates of a level can read each other. A gate is ranked after the gates of its level it reads, which have
+	//lower ids. The ranks are even, such that the gates that are added in front of a rank get the odd rank below it.
+	rank.assign(ngates, 2);
+	std::vector<uint32_t> candidates;
+	for (uint32_t i = 0; i < ngates; i++) {
+		GATE* gate = m_pGates + i;
+		if (gate->context != S_BOOL)
+			continue;
+		for (uint32_t j = inputstart[i]; j < inputstart[i + 1]; j++) {
+			uint32_t parent = m_vGateUses[j].first;
+			if (m_pGates[parent].depth == gate->depth)
+				rank[i] = std::max(rank[i], rank[parent] + 2);
+		}
+		if (IsCoalescable(gate))
+			candidates.push_back(i);
+	}
+
+	//gates can be coalesced if they are evaluated in the same phase of a level, i.e., interactively or with the same rank.
+	//The inputs of a gate are in an earlier phase, hence they are coalesced first.
+	std::sort(candidates.begin(), candidates.end(), [&](uint32_t a, uint32_t b) {
+		GATE* ga = m_pGates + a;
+		GATE* gb = m_pGates + b;
+		uint32_t ra = ga->nrounds > 0 ? (uint32_t) -1 : rank[a];
+		uint32_t rb = gb->nrounds > 0 ? (uint32_t) -1 : rank[b];
+		if (ga->depth != gb->depth)
+			return ga->depth < gb->depth;
+		if (ra != rb)
+			return ra < rb;
+		if (ga->type != gb->type)
+			return ga->type < gb->type;
+		if (ga->nrounds != gb->nrounds)
+			return ga->nrounds < gb->nrounds;
+		return a < b;
+	});
+
+	std::vector<std::pair<uint32_t, uint32_t> > loc(ngates);
+	for (uint32_t i = 0; i < ngates; i++) {
+		loc[i] = std::make_pair(i, 0);
+	}
+	std::vector<uint32_t> splits;
+	for (uint32_t start = 0, end; start < candidates.size(); start = end) {
+		GATE* first = m_pGates + candidates[start];
+		BOOL interactive = first->nrounds > 0;
+		for (end = start + 1; end < candidates.size(); end++) {
+			GATE* gate = m_pGates + candidates[end];
+			if (gate->depth != first->depth || (gate->nrounds > 0) != interactive || (!interactive && rank[candidates[end]] != rank[candidates[start]])
+					|| gate->type != first->type || gate->nrounds != first->nrounds)
+				break;
+		}
+		//a SIMD gate needs up to two gathers
+		if (end - start < GATE_COALESCE_MIN_GATES || m_nNextFreeGate + 3 > m_nMaxGates)
+			continue;
+
+		//ordering the gates by the position of their first input keeps the values of SIMD gates that are read by SIMD
+		//gates in the same order, which can then be read without a gather
+		e_gatetype type = first->type;
+		std::vector<uint32_t> members(candidates.begin() + start, candidates.begin() + end);
+		std::stable_sort(members.begin(), members.end(), [&](uint32_t a, uint32_t b) {
+			if (type == G_INV)
+				return loc[m_pGates[a].ingates.inputs.parent] < loc[m_pGates[b].ingates.inputs.parent];
+			return loc[m_pGates[a].ingates.inputs.twin.left] < loc[m_pGates[b].ingates.inputs.twin.left];
+		});
+
+		uint32_t depth = first->depth, nrounds = first->nrounds, nmembers = members.size();
+		std::vector<uint32_t> left(nmembers), right(nmembers);
+		for (uint32_t j = 0; j < nmembers; j++) {
+			GATE* gate = m_pGates + members[j];
+			if (type == G_INV) {
+				left[j] = gate->ingates.inputs.parent;
+			} else {
+				left[j] = gate->ingates.inputs.twin.left;
+				right[j] = gate->ingates.inputs.twin.right;
+			}
+		}
+		uint32_t simdid;
+		if (type == G_INV) {
+			simdid = PutINVGate(GatherInputs(left, depth, loc));
+		} else {
+			uint32_t inleft = GatherInputs(left, depth, loc);
+			uint32_t inright = GatherInputs(right, depth, loc);
+			simdid = PutPrimitiveGate(type, inleft, inright, nrounds);
+		}
+		GATE* simd = m_pGates + simdid;
+		simd->depth = depth;
+		simd->nvals = nmembers;
+		m_nMaxVectorSize = std::max(m_nMaxVectorSize, simd->nvals);
+		//the gathers of an interactive gate are evaluated after all local gates of the level, the ones of a local gate
+		//in front of the rank of the coalesced gates
+		rank.resize(m_nNextFreeGate, interactive ? (uint32_t) -1 : rank[members[0]] - 1);
+		ncoalesced++;
+
+		//the coalesced gates read their value from the SIMD gate
+		for (uint32_t j = 0; j < nmembers; j++) {
+			uint32_t gateid = members[j];
+			GATE* gate = m_pGates + gateid;
+			ReleaseGateInputs(gateid, inputstart);
+			status[gateid] |= (type == G_LIN ? GATE_OPT_WAS_LIN : 0) | (type == G_NON_LIN ? GATE_OPT_WAS_NON_LIN : 0) | GATE_OPT_SPLIT;
+			gate->type = G_SPLIT;
+			gate->ingates.ningates = 1;
+			gate->ingates.inputs.parent = simdid;
+			gate->gs.sinput.pos = j;
+			gate->depth = ComputeDepth(*simd);
+			gate->nrounds = 0;
+			m_vGateUses[inputstart[gateid]].first = simdid;
+			simd->nused++;
+			loc[gateid] = std::make_pair(simdid, j);
+			//the value of an interactive gate is split before all local gates of the next level
+			if (interactive)
+				rank[gateid] = 0;
+			splits.push_back(gateid);
+		}
+	}
+
+	//remove the splitters that are only read by SIMD gates
+	for (uint32_t i = 0; i < splits.size(); i++) {
+		GATE* gate = m_pGates + splits[i];
+		if (gate->nused > 0)
+			continue;
+		ReleaseGateInputs(splits[i], inputstart);
+		status[splits[i]] |= GATE_OPT_REMOVED;
+		gate->ingates.ningates = 0;
+		gate->context = S_LAST;
+	}
+
+	ClearGateUses();
+
+	status.resize(m_nNextFreeGate, GATE_OPT_ADDED);
+	return ncoalesced;
+}
@@ -21,6 +21,7 @@
 #include <math.h>
 #include <ENCRYPTO_utils/typedefs.h>
 #include "../ABY_utils/ABYconstants.h"
+#include "gatevaluearena.h"
 #include <string>
 #include <vector>
 #include <fstream>
@@ -36,6 +37,20 @@
 
 #define IsSIMDGate(gatetype) (!!((gatetype)&0x80))
 
+//Alignment of the gate array, which is the size of a cache line
+#define GATE_ALIGNMENT 64
+
+//Flags that ABYCircuit::OptimizeGates sets for a gate, with which the circuits update their queues and counters
+#define GATE_OPT_REMOVED 0x01		//the gate is no longer evaluated
+#define GATE_OPT_FOLDED 0x02		//the gate was turned into a constant or an inversion gate in place and is evaluated locally
+#define GATE_OPT_WAS_LIN 0x04		//the gate was a G_LIN gate before it was removed or folded
+#define GATE_OPT_WAS_NON_LIN 0x08	//the gate was a G_NON_LIN gate before it was removed or folded
+#define GATE_OPT_ADDED 0x10		//the gate was added and is put into the queue of its level
+#define GATE_OPT_SPLIT 0x20		//the gate was turned into a splitter gate of a SIMD gate and is evaluated locally on its level
+
+//Minimum number of scalar gates that ABYCircuit::CoalesceGates coalesces into one SIMD gate
+#define GATE_COALESCE_MIN_GATES 8
+
 struct GATE;
 
 struct yao_fields {
@@ -153,18 +168,21 @@ struct input_gates {
 	uint32_t ningates;
 };
 
+//The 8-byte aligned members come first, such that a gate has no padding and fills exactly one cache line on 64-bit systems
 struct GATE {
-	bool instantiated;
+	gs_t gs;				// here the differences for the gates come in
+	input_gates ingates;		// the number of input gates together with the values of the input gates
 	e_sharing context;		// the representation of the value stored in the gate (Public / arithmetic sharing / Boolean sharing / Yao sharing)
 	e_gatetype type;			// gate type
 	uint32_t nrounds;		// specifies the number of interaction rounds that are required when evaluating this gate
 	uint32_t nused;			// number of uses of the gate
 	uint32_t depth;			// number of AND gates to the root
 	uint32_t nvals;			// the number of values that are stored in this gate
-	gs_t gs;				// here the differences for the gates come in
 	uint32_t sharebitlen;	// bitlength of the shares in the context
-	input_gates ingates;		// the number of input gates together with the values of the input gates
+	bool instantiated;
 };
+//the pointers of a gate are smaller on 32-bit targets, hence only 64-bit targets fill the cache line exactly
+static_assert(sizeof(void*) != 8 || sizeof(GATE) == GATE_ALIGNMENT, "a gate has to fill exactly one cache line, reorder the members of GATE");
 
 std::string GetOpName(e_gatetype op);
 
@@ -194,9 +212,15 @@ public:
 	GATE* Gates() {
 		return m_pGates;
 	}
+	//the values of the gates are allocated from this arena and are all taken back by Reset
+	GateValueArena* GetValueArena() {
+		return &m_cValueArena;
+	}
 
 	uint32_t PutPrimitiveGate(e_gatetype type, uint32_t inleft, uint32_t inright, uint32_t rounds);
 	uint32_t PutNonLinearVectorGate(e_gatetype type, uint32_t choiceinput, uint32_t vectorinput, uint32_t rounds);
+	uint32_t PutDotProductGate(uint32_t inleft, uint32_t inright, uint32_t rounds);
+	uint32_t PutMatMulGate(uint32_t inleft, uint32_t inright, uint32_t nvals, uint32_t rounds);
 	uint32_t PutCombinerGate(std::vector<uint32_t> input);
 	uint32_t PutSplitterGate(uint32_t input, uint32_t pos, uint32_t bitlen);
         std::vector<uint32_t> PutSplitterGate(uint32_t input, std::vector<uint32_t> bitlen = std::vector<uint32_t>());		//, vector<uint32_t> gatelengths = NULL);
@@ -240,6 +264,50 @@ public:
 		return m_nMaxVectorSize;
 	}
 
+	/**
+	 Plans the memory of the gate values before the circuit is evaluated. The lifetime of each value is derived from the
+	 level it is created on and the last level one of its users reads it on, and the values are given offsets in one
+	 region per sharing such that values with disjoint lifetimes share memory. Values that are read by gates of another
+	 sharing, whose phases are not aligned to the levels, are kept until the end of the execution.
+	 \param bytes	Size of the value of each gate in its sharing, 0 if it is not planned. Is padded in place.
+	 */
+	void PlanGateValues(std::vector<uint64_t>& bytes);
+
+	/**
+	 Optimizes the gates of the Boolean sharings (S_BOOL, S_YAO and S_YAO_REV) before the circuit is evaluated. Gates with
+	 constant inputs are folded, gates that compute the same value as an earlier gate are replaced by it in their users
+	 (hash-consing) and gates whose value is never used are removed. The ids and levels of the remaining gates are kept,
+	 the queues of the circuits are updated with Circuit::ApplyGateOptimization. Both parties have to optimize, such that
+	 they evaluate the same circuit.
+	 \param status	Is resized to the number of gates and receives the GATE_OPT_* flags of each gate
+	 \return Number of removed gates
+	 */
+	uint32_t OptimizeGates(std::vector<BYTE>& status);
+
+	/**
+	 Minimizes the multiplicative depth of the GMW (S_BOOL) gates. Trees of AND gates, whose inner gates are only used
+	 within the tree, are rebalanced such that the leaves that are ready first are combined first. The gates of a tree are
+	 reused, hence the number of gates is kept, and the levels of all S_BOOL gates are recomputed afterwards. The queues of
+	 the circuits are updated with Circuit::UpdateQueueLevels. Both parties have to balance, such that they evaluate the
+	 same circuit.
+	 \return Number of rebalanced trees
+	 */
+	uint32_t BalanceGates();
+
+	/**
+	 Coalesces the scalar gates of the GMW (S_BOOL) circuit into SIMD gates. XOR, AND and inversion gates with a single
+	 value, which are evaluated in the same phase of a level, are replaced by one gate that holds all their values. Its
+	 inputs are read directly if they already are the values of a SIMD gate in the same order, and are gathered with a
+	 permutation gate otherwise. A coalesced gate is turned into a splitter gate of the SIMD gate if it still has
+	 users that read it as scalar, and is removed otherwise. The queues of the circuit are updated with
+	 Circuit::ApplyGateCoalescing. Both parties have to coalesce, such that they evaluate the same circuit.
+	 \param status	Is resized to the number of gates and receives the GATE_OPT_* flags of each gate
+	 \param rank	Receives the order of the local gates of a level, which are evaluated after all local gates of the level
+	 				with a lower rank
+	 \return Number of SIMD gates that were added
+	 */
+	uint32_t CoalesceGates(std::vector<BYTE>& status, std::vector<uint32_t>& rank);
+
 	//Export the constructed circuit in the Bristol circuit file format
 	void ExportCircuitInBristolFormat(std::vector<uint32_t> ingates_client, std::vector<uint32_t> ingates_server,
 			std::vector<uint32_t> outgates, const char* filename);
@@ -259,11 +327,26 @@ private:
 	void CheckAndPropagateConstant(uint32_t gateid, uint32_t& next_gate_id, std::vector<int>& gate_id_map,
 			std::vector<int>& constant_map, std::ofstream& outfile);
 
+	void IndexGateInputs(std::vector<uint32_t>& inputstart);
+	void ClearGateUses();
+	inline BOOL IsOptimizable(GATE* gate);
+	inline void ReleaseGateInputs(uint32_t gateid, std::vector<uint32_t>& inputstart, uint32_t only = (uint32_t) -1);
+	BOOL FoldToConstant(uint32_t gateid, uint32_t val, std::vector<uint32_t>& inputstart, std::vector<int8_t>& constant,
+			std::vector<BYTE>& status);
+	BOOL ReplaceGate(uint32_t gateid, uint32_t by, std::vector<uint32_t>& userstart, std::vector<uint32_t>& users);
+	inline BOOL IsBalanceable(GATE* gate);
+	BOOL BalanceTree(uint32_t root, std::vector<uint32_t>& inputstart, std::vector<uint32_t>& extra, std::vector<BYTE>& inner);
+	inline BOOL IsCoalescable(GATE* gate);
+	uint32_t GatherInputs(std::vector<uint32_t>& inputs, uint32_t depth, std::vector<std::pair<uint32_t, uint32_t> >& loc);
+
 	GATE* m_pGates;
+	void* m_pGateBuf;			// allocation that m_pGates is aligned in
 	uint32_t m_nNextFreeGate;	// points to the current first unused gate
 	uint32_t m_nMaxVectorSize; 	// The maximum vector size in bits, required for correctly instantiating the 0 and 1 gates
 	uint32_t m_nMaxGates; 		// Maximal number of gates that is allowed
 	uint32_t m_nMaxDepth;	// maximum depth encountered in the circuit
+	GateValueArena m_cValueArena;	// memory of the gate values
+	std::vector<std::pair<uint32_t, uint32_t> > m_vGateUses;	// (used gate, using gate) for every use, only kept while a pass runs
 };
 
 #endif /* __ABYCIRCUIT_H_ */
@@ -67,6 +67,54 @@ uint32_t ArithmeticCircuit::PutMULGate(uint32_t inleft, uint32_t inright) {
 	return gateid;
 }
 
+share* ArithmeticCircuit::PutDotProductGate(share* ina, share* inb) {
+	share* shr = new arithshare(this);
+	shr->set_wire_id(0, PutDotProductGate(ina->get_wire_id(0), inb->get_wire_id(0)));
+	return shr;
+}
+
+uint32_t ArithmeticCircuit::PutDotProductGate(uint32_t inleft, uint32_t inright) {
+	// with a constant input, the products are local and are summed up by
+	// free ADD gates
+	if (m_pGates[inleft].type == G_CONSTANT || m_pGates[inright].type == G_CONSTANT) {
+		std::vector<uint32_t> products = PutSplitterGate(PutMULCONSTGate(inleft, inright));
+		uint32_t gateid = products[0];
+		for (uint32_t i = 1; i < products.size(); i++) {
+			gateid = PutADDGate(gateid, products[i]);
+		}
+		return gateid;
+	}
+
+	uint32_t gateid = m_cCircuit->PutDotProductGate(inleft, inright, m_nRoundsAND);
+	UpdateInteractiveQueue(gateid);
+
+	// one MT for each pair of values
+	m_nMULs += m_pGates[inleft].nvals;
+	return gateid;
+}
+
+share* ArithmeticCircuit::PutMatMulGate(share* ina, share* inb, uint32_t nrows, uint32_t ninner, uint32_t ncols) {
+	share* shr = new arithshare(this);
+	shr->set_wire_id(0, PutMatMulGate(ina->get_wire_id(0), inb->get_wire_id(0), nrows, ninner, ncols));
+	return shr;
+}
+
+uint32_t ArithmeticCircuit::PutMatMulGate(uint32_t inleft, uint32_t inright, uint32_t nrows, uint32_t ninner, uint32_t ncols) {
+	assert(m_pGates[inleft].nvals == nrows * ninner && m_pGates[inright].nvals == ninner * ncols);
+
+	uint32_t gateid = m_cCircuit->PutMatMulGate(inleft, inright, nrows * ncols, m_nRoundsAND);
+	UpdateInteractiveQueue(gateid);
+
+	mat_mul_gate mat;
+	mat.gateid = gateid;
+	mat.nrows = nrows;
+	mat.ninner = ninner;
+	mat.ncols = ncols;
+	m_vMatMulGates.push_back(mat);
+
+	return gateid;
+}
+
 share* ArithmeticCircuit::PutMULCONSTGate(share* ina, share* inb) {
 	share* shr = new arithshare(this);
 	shr->set_wire_id(0, PutMULCONSTGate(ina->get_wire_id(0), inb->get_wire_id(0)));
@@ -359,6 +407,7 @@ void ArithmeticCircuit::Reset() {
 	Circuit::Reset();
 	m_nMULs = 0;
 	m_nCONVGates = 0;
+	m_vMatMulGates.clear();
 	m_nMaxDepth = 0;
 
 	for (uint32_t i = 0; i < m_vLocalQueueOnLvl.size(); i++) {
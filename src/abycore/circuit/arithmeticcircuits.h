@@ -24,12 +24,21 @@
 #include "circuit.h"
 #include "share.h"
 #include <cstring>
+#include <vector>
+
+/** Matrix multiplication gate, which multiplies a nrows x ninner matrix with a ninner x ncols matrix */
+typedef struct mat_mul_ctx {
+	uint32_t gateid;
+	uint32_t nrows;
+	uint32_t ninner;
+	uint32_t ncols;
+} mat_mul_gate;
 
 /** Arithmetic Circuit class.*/
 class ArithmeticCircuit: public Circuit {
 public:
 	ArithmeticCircuit(ABYCircuit* aby, e_sharing context, e_role myrole, uint32_t bitlen) :
-			Circuit(aby, context, myrole, bitlen, C_ARITHMETIC) {
+			Circuit(aby, context, myrole, bitlen, C_ARITHMETIC), m_vMatMulGates() {
 		Init();
 	}
 	;
@@ -44,6 +53,8 @@ public:
 
 	uint32_t PutMULGate(uint32_t left, uint32_t right);
 	uint32_t PutMULCONSTGate(uint32_t left, uint32_t right);
+	uint32_t PutDotProductGate(uint32_t left, uint32_t right);
+	uint32_t PutMatMulGate(uint32_t left, uint32_t right, uint32_t nrows, uint32_t ninner, uint32_t ncols);
 	uint32_t PutADDGate(uint32_t left, uint32_t right);
 	uint32_t PutSUBGate(uint32_t left, uint32_t right);
 
@@ -81,7 +92,7 @@ public:
 	template<class T> uint32_t PutSharedINGate(T val) {
 		uint32_t gateid = PutSharedINGate();
 		GATE* gate = m_pGates + gateid;
-		gate->gs.val = (UGATE_T*) calloc(ceil_divide(1 * m_nShareBitLen, GATE_T_BITS), sizeof(UGATE_T));
+		gate->gs.val = (UGATE_T*) m_cCircuit->GetValueArena()->Alloc(m_eContext, ceil_divide(1 * m_nShareBitLen, GATE_T_BITS) * sizeof(UGATE_T));
 
 		*gate->gs.val = (UGATE_T) val;
 		gate->instantiated = true;
@@ -93,7 +104,7 @@ public:
 	template<class T> uint32_t PutSharedSIMDINGate(uint32_t nvals, T val) {
 		uint32_t gateid = PutSharedSIMDINGate(nvals);
 		GATE* gate = m_pGates + gateid;
-		gate->gs.val = (UGATE_T*) calloc(ceil_divide(nvals * m_nShareBitLen, GATE_T_BITS), sizeof(UGATE_T));
+		gate->gs.val = (UGATE_T*) m_cCircuit->GetValueArena()->Alloc(m_eContext, ceil_divide(nvals * m_nShareBitLen, GATE_T_BITS) * sizeof(UGATE_T));
 
 		*gate->gs.val = (UGATE_T) val;
 		gate->instantiated = true;
@@ -249,6 +260,31 @@ public:
 	/* Multiplication with a constant - offline & free */
 	share* PutMULCONSTGate(share* ina, share* inb);
 
+	/**
+	 * \brief Multiplies the values of two SIMD shares pairwise and sums up the products. Requires one MT per pair, but
+	 * 		only a single gate and a single output value.
+	 * \param ina first input share with n values
+	 * \param inb second input share with n values
+	 * \return share with the inner product as single value
+	 */
+	share* PutDotProductGate(share* ina, share* inb);
+
+	/**
+	 * \brief Multiplies two matrices that are given as SIMD shares in row-major order. Uses a single matrix
+	 * 		multiplication triple, such that only nrows * ninner + ninner * ncols values are opened.
+	 * \param ina share with the nrows x ninner values of the left matrix
+	 * \param inb share with the ninner x ncols values of the right matrix
+	 * \return share with the nrows x ncols values of the product
+	 */
+	share* PutMatMulGate(share* ina, share* inb, uint32_t nrows, uint32_t ninner, uint32_t ncols);
+
+	/**
+	 * \return The matrix multiplication gates of the circuit together with their dimensions
+	 */
+	std::vector<mat_mul_gate>& GetMatMulGates() {
+		return m_vMatMulGates;
+	}
+
 	share* PutGTGate(share*, share*) {
 		std::cerr << "GT not implemented in arithmetic sharing" << std::endl;
 		return new arithshare(this);
@@ -311,6 +347,7 @@ private:
 
 	uint32_t m_nMULs; //number of AND gates in the circuit
 	uint32_t m_nCONVGates; //number of Boolean to arithmetic conversion gates
+	std::vector<mat_mul_gate> m_vMatMulGates;
 
 	//SharedIN
 	template<class T> share* InternalPutSharedINGate(uint32_t nvals, T* val, uint32_t bitlen) {
@@ -324,7 +361,7 @@ private:
 		GATE* gate = m_pGates + gateid;
 		uint32_t sharebytelen = ceil_divide(m_nShareBitLen, 8);
 		uint32_t inbytelen = ceil_divide(bitlen, 8);
-		gate->gs.val = (UGATE_T*) calloc(nvals, PadToMultiple(sharebytelen, sizeof(UGATE_T)));
+		gate->gs.val = (UGATE_T*) m_cCircuit->GetValueArena()->Alloc(m_eContext, nvals * PadToMultiple(sharebytelen, sizeof(UGATE_T)));
 		for (uint32_t i = 0; i < nvals; i++) {
 			memcpy(((uint8_t*) gate->gs.val) + i * sharebytelen, val + i, inbytelen);
 		}
@@ -21,8 +21,13 @@
 #include <cstring>
 #include <fstream>
 #include <map>
+#include <mutex>
 #include <string>
 #include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #ifdef HW_DEBUG
 #include <memory>
 #endif
@@ -297,7 +302,7 @@ template<class T> uint32_t BooleanCircuit::PutSharedINGate(T val) {
 	uint32_t gateid = PutSharedINGate();
 	//assign value
 	GATE* gate = m_pGates + gateid;
-	gate->gs.val = (UGATE_T*) calloc(1 * m_nShareBitLen, sizeof(UGATE_T));
+	gate->gs.val = (UGATE_T*) m_cCircuit->GetValueArena()->Alloc(m_eContext, 1 * m_nShareBitLen * sizeof(UGATE_T));
 
 	*gate->gs.val = (UGATE_T) val;
 	gate->instantiated = true;
@@ -325,7 +330,7 @@ template<class T> uint32_t BooleanCircuit::PutSharedSIMDINGate(uint32_t ninvals,
 	uint32_t gateid = PutSharedSIMDINGate(ninvals);
 	//assign value
 	GATE* gate = m_pGates + gateid;
-	gate->gs.val = (UGATE_T*) calloc(ninvals * m_nShareBitLen, sizeof(UGATE_T));
+	gate->gs.val = (UGATE_T*) m_cCircuit->GetValueArena()->Alloc(m_eContext, ninvals * m_nShareBitLen * sizeof(UGATE_T));
 
 	*gate->gs.val = (UGATE_T) val;
 	gate->instantiated = true;
@@ -353,7 +358,7 @@ template<class T> uint32_t BooleanCircuit::PutSharedINGate(T* val) {
 
 		//assign value
 		GATE* gate = m_pGates + gateid;
-		gate->gs.val = (UGATE_T*) calloc(ceil_divide(1 * m_nShareBitLen, GATE_T_BITS), sizeof(UGATE_T));
+		gate->gs.val = (UGATE_T*) m_cCircuit->GetValueArena()->Alloc(m_eContext, ceil_divide(1 * m_nShareBitLen, GATE_T_BITS) * sizeof(UGATE_T));
 		memcpy(gate->gs.val, val, ceil_divide(1 * m_nShareBitLen, 8));
 
 		gate->instantiated = true;
@@ -379,7 +384,7 @@ template<class T> uint32_t BooleanCircuit::PutSharedSIMDINGate(uint32_t ninvals,
 	uint32_t gateid = PutSharedSIMDINGate(ninvals);
 	//assign value
 	GATE* gate = m_pGates + gateid;
-	gate->gs.val = (UGATE_T*) calloc(ceil_divide(ninvals * m_nShareBitLen, GATE_T_BITS), sizeof(UGATE_T));
+	gate->gs.val = (UGATE_T*) m_cCircuit->GetValueArena()->Alloc(m_eContext, ceil_divide(ninvals * m_nShareBitLen, GATE_T_BITS) * sizeof(UGATE_T));
 	memcpy(gate->gs.val, val, ceil_divide(ninvals * m_nShareBitLen, 8));
 	gate->instantiated = true;
 	return gateid;
@@ -406,7 +411,7 @@ uint32_t BooleanCircuit::PutSharedINGate(uint64_t val) {
 	uint32_t gateid = PutSharedINGate();
 	//assign value
 	GATE* gate = m_pGates + gateid;
-	gate->gs.val = (UGATE_T*) calloc(ceil_divide(1 * m_nShareBitLen, sizeof(UGATE_T) * 8), sizeof(UGATE_T));
+	gate->gs.val = (UGATE_T*) m_cCircuit->GetValueArena()->Alloc(m_eContext, ceil_divide(1 * m_nShareBitLen, sizeof(UGATE_T) * 8) * sizeof(UGATE_T));
 	memcpy(gate->gs.val, &val, ceil_divide(1 * m_nShareBitLen, 8));
 
 	gate->instantiated = true;
@@ -434,7 +439,7 @@ uint32_t BooleanCircuit::PutSharedSIMDINGate(uint32_t nvals, uint64_t val) {
 
 	//assign value
 	GATE* gate = m_pGates + gateid;
-	gate->gs.val = (UGATE_T*) calloc(ceil_divide(nvals * m_nShareBitLen, sizeof(UGATE_T) * 8), sizeof(UGATE_T));
+	gate->gs.val = (UGATE_T*) m_cCircuit->GetValueArena()->Alloc(m_eContext, ceil_divide(nvals * m_nShareBitLen, sizeof(UGATE_T) * 8) * sizeof(UGATE_T));
 	memcpy(gate->gs.val, &val, ceil_divide(nvals * m_nShareBitLen, 8));
 
 	gate->instantiated = true;
@@ -484,12 +489,13 @@ uint32_t BooleanCircuit::PutYaoSharedSIMDINGate(uint32_t nvals, yao_fields keys)
 	//TODO: fixed to 128-bit security atm. CHANGE
 	uint8_t keybytelen = ceil_divide(128, 8);
 	if(m_eMyRole == SERVER) {
-		gate->gs.yinput.outKey = (uint8_t*) malloc(keybytelen * nvals);
+		//the permutation bits are kept behind the keys, as done by YaoServerSharing::InstantiateGate
+		gate->gs.yinput.outKey = (uint8_t*) m_cCircuit->GetValueArena()->Alloc(m_eContext, (keybytelen + 1) * nvals, FALSE);
 		memcpy(gate->gs.yinput.outKey, keys.outKey, keybytelen * nvals);
-		gate->gs.yinput.pi = (uint8_t*) malloc(nvals);
+		gate->gs.yinput.pi = gate->gs.yinput.outKey + keybytelen * nvals;
 		memcpy(gate->gs.yinput.pi, keys.pi, nvals);
 	} else {
-		gate->gs.yval = (uint8_t*) malloc(keybytelen * nvals);
+		gate->gs.yval = (uint8_t*) m_cCircuit->GetValueArena()->Alloc(m_eContext, keybytelen * nvals, FALSE);
 		memcpy(gate->gs.yval, keys.outKey, keybytelen * nvals);
 	}
 
@@ -2431,93 +2437,284 @@ std::vector<uint32_t> BooleanCircuit::PutFPGate(const std::string func, std::vec
 }
 
 
-std::vector<uint32_t> BooleanCircuit::PutGateFromFile(const std::string filename, std::vector<uint32_t> inputs, uint32_t nvals){
+/** Gates of a parsed .aby circuit file */
+enum circuit_file_gate_type {
+	CF_INPUT, CF_CONST_ZERO, CF_CONST_ONE, CF_AND, CF_XOR, CF_MUX, CF_INV
+};
+
+/** Gate of a parsed .aby circuit file. The gate with index i defines wire i, in holds the indices of its input wires. */
+typedef struct circuit_file_gate_ctx {
+	uint32_t type;
+	uint32_t in[3]; /**< For CF_INPUT, in[0] is the index of the input that is passed to PutGateFromFile */
+} circuit_file_gate;
+
+/** Header of a .abyc file, which is followed by the gates and the output wires */
+typedef struct circuit_file_header_ctx {
+	char magic[8];
+	uint32_t version;
+	uint32_t ninputs;
+	uint32_t ngates;
+	uint32_t noutputs;
+} circuit_file_header;
+
+static const char CIRCUIT_FILE_MAGIC[8] = "ABYCIRC";
+#define CIRCUIT_FILE_VERSION 1
+
+/** Parsed .aby circuit file, either read from the text file or mapped from a .abyc file */
+typedef struct circuit_file_ctx {
+	uint32_t ninputs = 0;
+	uint32_t ngates = 0;
+	uint32_t noutputs = 0;
+	const circuit_file_gate* gates = NULL;
+	const uint32_t* outputs = NULL;
+	std::vector<circuit_file_gate> gatebuf{};
+	std::vector<uint32_t> outputbuf{};
+	void* map = NULL; /**< Mapping of the .abyc file, NULL if the text file was parsed */
+	uint64_t mapsize = 0;
+} circuit_file;
+
+//circuit files are parsed once per process and shared by all circuits
+static std::map<std::string, circuit_file*> circuit_file_cache;
+static std::mutex circuit_file_mutex;
+
+static BOOL ParseCircuitFile(const std::string& filename, circuit_file* cf) {
 	std::string line;
-	std::vector<uint32_t> tokens, outputs;
+	std::vector<uint32_t> tokens;
+	//wire ids of the file to indices of the gates that define them
 	std::map<uint32_t, uint32_t> wires;
+	std::map<uint32_t, uint32_t>::iterator it;
+	circuit_file_gate gate;
+	uint32_t nin, out;
 
-	std::ifstream myfile;
+	std::ifstream myfile(filename.c_str());
+	if (!myfile.is_open()) {
+		std::cerr << "Error: Unable to open circuit file " << filename << std::endl;
+		return FALSE;
+	}
+
+	cf->ninputs = 0;
+	while (getline(myfile, line)) {
+		if (line == "")
+			continue;
+
+		switch (line.at(0)) {
+		case 'S': case 'C': nin = 0; break; // Server / Client input wire ids
+		case '0': case '1': nin = 0; break; // Constant Zero / One Gate
+		case 'A': case 'X': nin = 2; break; // AND / XOR Gate
+		case 'M': nin = 3; break; // MUX Gate
+		case 'I': nin = 1; break; // INV Gate
+		case 'O': nin = 0; break; // List of output wires
+		default: continue;
+		}
 
-	//std::cout << "opening " << filename <<  std::endl;
-	myfile.open(filename.c_str());
+		tokenize_verilog(line, tokens);
+		//the outputs of the file are wires as well, which have to be defined before
+		if (line.at(0) == 'O') {
+			nin = tokens.size();
+		} else if (line.at(0) != 'S' && line.at(0) != 'C' && tokens.size() < nin + 1) {
+			std::cerr << "Error: Malformed line '" << line << "' in circuit file " << filename << std::endl;
+			return FALSE;
+		}
 
-	uint32_t file_input_size = 0;
+		memset(&gate, 0, sizeof(gate));
+		for (uint32_t i = 0; i < nin; i++) {
+			it = wires.find(tokens[i]);
+			if (it == wires.end()) {
+				std::cerr << "Error: Wire " << (int32_t) tokens[i] << " is used before it is defined in circuit file " << filename << std::endl;
+				return FALSE;
+			}
+			if (line.at(0) == 'O')
+				cf->outputbuf.push_back(it->second);
+			else
+				gate.in[i] = it->second;
+		}
 
-	if (myfile.is_open()) {
-		while (getline(myfile, line)) {
+		switch (line.at(0)) {
+		case 'S': case 'C':
+			for (uint32_t i = 0; i < tokens.size(); i++) {
+				gate.type = CF_INPUT;
+				gate.in[0] = cf->ninputs++;
+				wires[tokens[i]] = cf->gatebuf.size();
+				cf->gatebuf.push_back(gate);
+			}
+			continue;
+		case 'O':
+			continue;
+		case '0': gate.type = CF_CONST_ZERO; break;
+		case '1': gate.type = CF_CONST_ONE; break;
+		case 'A': gate.type = CF_AND; break;
+		case 'X': gate.type = CF_XOR; break;
+		case 'M': gate.type = CF_MUX; break;
+		case 'I': gate.type = CF_INV; break;
+		}
+		out = tokens[nin];
+		wires[out] = cf->gatebuf.size();
+		cf->gatebuf.push_back(gate);
+	}
+	myfile.close();
+
+	cf->ngates = cf->gatebuf.size();
+	cf->noutputs = cf->outputbuf.size();
+	cf->gates = cf->gatebuf.data();
+	cf->outputs = cf->outputbuf.data();
+	return TRUE;
+}
+
+static BOOL MapCompiledCircuitFile(const std::string& filename, circuit_file* cf) {
+	struct stat st;
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+		return FALSE;
+	if (fstat(fd, &st) != 0 || (uint64_t) st.st_size < sizeof(circuit_file_header)) {
+		close(fd);
+		return FALSE;
+	}
+	cf->mapsize = st.st_size;
+	cf->map = mmap(NULL, cf->mapsize, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (cf->map == MAP_FAILED) {
+		cf->map = NULL;
+		return FALSE;
+	}
+
+	circuit_file_header* header = (circuit_file_header*) cf->map;
+	BOOL valid = memcmp(header->magic, CIRCUIT_FILE_MAGIC, sizeof(header->magic)) == 0 && header->version == CIRCUIT_FILE_VERSION
+			&& cf->mapsize == sizeof(circuit_file_header) + (uint64_t) header->ngates * sizeof(circuit_file_gate)
+			+ (uint64_t) header->noutputs * sizeof(uint32_t);
+	if (valid) {
+		cf->ninputs = header->ninputs;
+		cf->ngates = header->ngates;
+		cf->noutputs = header->noutputs;
+		cf->gates = (const circuit_file_gate*) (header + 1);
+		cf->outputs = (const uint32_t*) (cf->gates + cf->ngates);
+	}
+	//every wire has to be defined before it is used, such that the file can be replayed without checks
+	for (uint32_t i = 0; i < cf->ngates && valid; i++) {
+		const circuit_file_gate& g = cf->gates[i];
+		uint32_t nin = (g.type == CF_MUX) ? 3 : (g.type == CF_AND || g.type == CF_XOR) ? 2 : (g.type == CF_INV) ? 1 : 0;
+		valid = g.type <= CF_INV && (g.type != CF_INPUT || g.in[0] < cf->ninputs);
+		for (uint32_t j = 0; j < nin && valid; j++) {
+			valid = g.in[j] < i;
+		}
+	}
+	for (uint32_t i = 0; i < cf->noutputs && valid; i++) {
+		valid = cf->outputs[i] < cf->ngates;
+	}
 
-			if (line != "") {
+	if (!valid) {
+		std::cerr << "Warning: " << filename << " is not a compiled circuit file of version " << CIRCUIT_FILE_VERSION << ", ignoring it" << std::endl;
+		munmap(cf->map, cf->mapsize);
+		cf->map = NULL;
+		return FALSE;
+	}
+	return TRUE;
+}
 
-				tokenize_verilog(line, tokens);
+/**
+ * \return The parsed circuit file, which is loaded from <filename>c if that file is not older than filename, or NULL if
+ * 		the file could not be read
+ */
+static const circuit_file* GetCircuitFile(const std::string& filename) {
+	std::lock_guard<std::mutex> lock(circuit_file_mutex);
 
-				switch (line.at(0)) {
+	std::map<std::string, circuit_file*>::iterator it = circuit_file_cache.find(filename);
+	if (it != circuit_file_cache.end())
+		return it->second;
 
-				case 'S': // Server input wire ids
-					assert(inputs.size() >= tokens.size() + file_input_size);
+	circuit_file* cf = new circuit_file();
 
-					for (uint32_t i = 0; i < tokens.size(); i++) {
-						wires[tokens[i]] = inputs[i + file_input_size];
-					}
-					file_input_size += tokens.size();
-					break;
+	std::string compiled = filename + "c";
+	struct stat src, bin;
+	BOOL loaded = FALSE;
+	if (stat(compiled.c_str(), &bin) == 0 && (stat(filename.c_str(), &src) != 0 || bin.st_mtime >= src.st_mtime)) {
+		loaded = MapCompiledCircuitFile(compiled, cf);
+	}
+	if (!loaded && !ParseCircuitFile(filename, cf)) {
+		delete cf;
+		return NULL;
+	}
 
-				case 'C': // Client input wire ids
-					assert(inputs.size() >= tokens.size() + file_input_size);
+	circuit_file_cache[filename] = cf;
+	return cf;
+}
 
-					for (uint32_t i = 0; i < tokens.size(); i++) {
-						wires[tokens[i]] = inputs[i + file_input_size];
-					}
-					file_input_size += tokens.size();
-					break;
+std::vector<uint32_t> BooleanCircuit::PutGateFromFile(const std::string filename, std::vector<uint32_t> inputs, uint32_t nvals){
+	std::vector<uint32_t> outputs;
+	const circuit_file* cf = GetCircuitFile(filename);
 
-				case '0': // Constant Zero Gate
-					wires[tokens[0]] = PutConstantGate(0, nvals);
-					break;
+	if (!cf) {
+		return outputs;
+	}
 
-				case '1': // Constant Zero Gate
-					wires[tokens[0]] = PutConstantGate((1 << nvals) - 1, nvals);
-					break;
+	assert(inputs.size() >= cf->ninputs);
 
-				case 'A': // AND Gate
-					wires[tokens[2]] = PutANDGate(wires[tokens[0]], wires[tokens[1]]);
-					break;
+	std::vector<uint32_t> wires(cf->ngates);
+	for (uint32_t i = 0; i < cf->ngates; i++) {
+		const circuit_file_gate& g = cf->gates[i];
+		switch (g.type) {
+		case CF_INPUT:
+			wires[i] = inputs[g.in[0]];
+			break;
+		case CF_CONST_ZERO:
+			wires[i] = PutConstantGate(0, nvals);
+			break;
+		case CF_CONST_ONE:
+			wires[i] = PutConstantGate((1 << nvals) - 1, nvals);
+			break;
+		case CF_AND:
+			wires[i] = PutANDGate(wires[g.in[0]], wires[g.in[1]]);
+			break;
+		case CF_XOR:
+			wires[i] = PutXORGate(wires[g.in[0]], wires[g.in[1]]);
+			break;
+		case CF_MUX:
+			wires[i] = PutVecANDMUXGate(wires[g.in[1]], wires[g.in[0]], wires[g.in[2]]);
+			break;
+		case CF_INV:
+			wires[i] = PutINVGate(wires[g.in[0]]);
+			break;
+		}
+	}
 
-				case 'X': // XOR Gate
-					wires[tokens[2]] = PutXORGate(wires[tokens[0]], wires[tokens[1]]);
-					break;
+	outputs.resize(cf->noutputs);
+	for (uint32_t i = 0; i < cf->noutputs; i++) {
+		outputs[i] = wires[cf->outputs[i]];
+	}
 
-				case 'M': // MUX Gate
-					wires[tokens[3]] = PutVecANDMUXGate(wires[tokens[1]], wires[tokens[0]], wires[tokens[2]]);
-					break;
+	if (cf->ninputs < inputs.size()) {
+		std::cerr << "Warning: Input sizes didn't match! Less inputs read from circuit file than passed to it!" << std::endl;
+	}
 
-				case 'I': // INV Gate
-					wires[tokens[1]] = PutINVGate(tokens[0]);
-					break;
+	return outputs;
+}
 
-				case 'O': // List of output wires
-					for (uint32_t i = 0; i < tokens.size(); i++) {
-						outputs.push_back(wires[tokens[i]]);
-					}
-					std::cout << std::endl;
-					break;
-				}
-			}
-		}
-		myfile.close();
+BOOL BooleanCircuit::CompileCircuitFile(const std::string filename) {
+	const circuit_file* cf = GetCircuitFile(filename);
 
-		if (file_input_size < inputs.size()) {
-			std::cerr << "Warning: Input sizes didn't match! Less inputs read from circuit file than passed to it!" << std::endl;
-		}
+	if (!cf) {
+		return FALSE;
 	}
 
-	else {
-		std::cerr << "Error: Unable to open circuit file " << filename << std::endl;
-	}
+	circuit_file_header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CIRCUIT_FILE_MAGIC, sizeof(header.magic));
+	header.version = CIRCUIT_FILE_VERSION;
+	header.ninputs = cf->ninputs;
+	header.ngates = cf->ngates;
+	header.noutputs = cf->noutputs;
 
-	wires.clear();
-	tokens.clear();
+	std::string compiled = filename + "c";
+	std::ofstream myfile(compiled.c_str(), std::ios::binary | std::ios::trunc);
+	myfile.write((const char*) &header, sizeof(header));
+	myfile.write((const char*) cf->gates, (uint64_t) cf->ngates * sizeof(circuit_file_gate));
+	myfile.write((const char*) cf->outputs, (uint64_t) cf->noutputs * sizeof(uint32_t));
+	myfile.close();
 
-	return outputs;
+	if (!myfile) {
+		std::cerr << "Error: Unable to write compiled circuit file " << compiled << std::endl;
+		return FALSE;
+	}
+	return TRUE;
 }
 
 share* BooleanCircuit::PutLUTGateFromFile(const std::string filename, share* input) {
@@ -2646,44 +2843,9 @@ std::vector<uint32_t> BooleanCircuit::PutLUTGateFromFile(const std::string filen
 
 
 uint32_t BooleanCircuit::GetInputLengthFromFile(const std::string filename){
-	std::string line;
-	std::vector<uint32_t> tokens;
-	std::ifstream myfile;
-
-	//std::cout << "opening " << filename <<  std::endl;
-	myfile.open(filename.c_str());
+	const circuit_file* cf = GetCircuitFile(filename);
 
-	uint32_t file_input_size = 0;
-
-	if (myfile.is_open()) {
-		while (getline(myfile, line)) {
-
-			if (line != "") {
-
-				tokenize_verilog(line, tokens);
-
-				switch (line.at(0)) {
-
-				case 'S': // Server input wire ids
-					file_input_size += tokens.size();
-					break;
-
-				case 'C': // Client input wire ids
-					file_input_size += tokens.size();
-					break;
-				}
-			}
-		}
-		myfile.close();
-	}
-
-	else {
-		std::cerr << "Error: Unable to open circuit file " << filename << std::endl;
-	}
-
-	tokens.clear();
-
-	return file_input_size;
+	return cf ? cf->ninputs : 0;
 }
 
 uint32_t BooleanCircuit::PutIdxGate(uint32_t r, uint32_t maxidx) {
@@ -2778,6 +2940,37 @@ void BooleanCircuit::Reset() {
 	m_vTTlens[0][0][0].ttable_values.clear();
 }
 
+void BooleanCircuit::ApplyGateOptimization(const std::vector<BYTE>& status) {
+	//the AND gates that were removed or folded need no MTs and no garbled tables
+	for (uint32_t q = 0; q < 2; q++) {
+		std::vector<std::vector<uint32_t> >& queues = q == 0 ? m_vLocalQueueOnLvl : m_vInteractiveQueueOnLvl;
+		for (uint32_t lvl = 0; lvl < queues.size(); lvl++) {
+			for (uint32_t i = 0; i < queues[lvl].size(); i++) {
+				uint32_t gateid = queues[lvl][i];
+				if (status[gateid] & GATE_OPT_WAS_NON_LIN) {
+					m_vANDs[0].numgates -= m_pGates[gateid].nvals;
+				} else if (status[gateid] & GATE_OPT_WAS_LIN) {
+					m_nNumXORVals -= m_pGates[gateid].nvals;
+					m_nNumXORGates--;
+				}
+			}
+		}
+	}
+	Circuit::ApplyGateOptimization(status);
+}
+
+void BooleanCircuit::ApplyGateCoalescing(const std::vector<BYTE>& status, const std::vector<uint32_t>& rank) {
+	//the values of the coalesced XOR gates are now computed by the SIMD gates, the number of AND values is unchanged
+	for (uint32_t i = 0; i < status.size(); i++) {
+		if ((status[i] & GATE_OPT_SPLIT) && (status[i] & GATE_OPT_WAS_LIN)) {
+			m_nNumXORGates--;
+		} else if ((status[i] & GATE_OPT_ADDED) && m_pGates[i].type == G_LIN) {
+			m_nNumXORGates++;
+		}
+	}
+	Circuit::ApplyGateCoalescing(status, rank);
+}
+
 void BooleanCircuit::PadWithLeadingZeros(std::vector<uint32_t> &a, std::vector<uint32_t> &b) {
 	uint32_t maxlen = std::max(a.size(), b.size());
 	if(a.size() != b.size()) {
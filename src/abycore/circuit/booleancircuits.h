@@ -45,6 +45,8 @@ public:
 	void Init();
 	void Cleanup();
 	void Reset();
+	void ApplyGateOptimization(const std::vector<BYTE>& status);
+	void ApplyGateCoalescing(const std::vector<BYTE>& status, const std::vector<uint32_t>& rank);
 
 	uint32_t PutANDGate(uint32_t left, uint32_t right);
 	std::vector<uint32_t> PutANDGate(std::vector<uint32_t> inleft, std::vector<uint32_t> inright);
@@ -384,6 +386,14 @@ public:
 	 */
 	uint32_t GetInputLengthFromFile(const std::string filename);
 
+	/**
+	 * \brief Writes the parsed form of a .aby file to a binary <filename>c file (e.g., fp_ieee_add_32.abyc), which
+	 * 		PutGateFromFile and GetInputLengthFromFile load instead of the .aby file as long as it is not older than the .aby file
+	 * \param filename the file name of the circuit
+	 * \return TRUE if the binary file was written
+	 */
+	BOOL CompileCircuitFile(const std::string filename);
+
 	void PutMinIdxGate(share** vals, share** ids, uint32_t nvals, share** minval_shr, share** minid_shr);
 	void PutMinIdxGate(std::vector<std::vector<uint32_t> > vals, std::vector<std::vector<uint32_t> > ids,
 			std::vector<uint32_t>& minval, std::vector<uint32_t>& minid);
@@ -18,6 +18,7 @@
 */
 #include "circuit.h"
 #include "share.h"
+#include <algorithm>
 #include <cstring>
 
 
@@ -93,6 +94,117 @@ void Circuit::Reset() {
 	//m_vNonLinOnLayer.min_depth = 0;
 }
 
+void Circuit::ApplyGateOptimization(const std::vector<BYTE>& status) {
+	for (uint32_t lvl = 0; lvl < m_vLocalQueueOnLvl.size(); lvl++) {
+		std::vector<uint32_t>& queue = m_vLocalQueueOnLvl[lvl];
+		uint32_t kept = 0;
+		for (uint32_t i = 0; i < queue.size(); i++) {
+			if (status[queue[i]] & GATE_OPT_REMOVED) {
+				m_nGates--;
+			} else {
+				queue[kept++] = queue[i];
+			}
+		}
+		queue.resize(kept);
+	}
+
+	for (uint32_t lvl = 0; lvl < m_vInteractiveQueueOnLvl.size(); lvl++) {
+		std::vector<uint32_t>& queue = m_vInteractiveQueueOnLvl[lvl];
+		uint32_t kept = 0;
+		BOOL moved = FALSE;
+		for (uint32_t i = 0; i < queue.size(); i++) {
+			uint32_t gateid = queue[i];
+			if (status[gateid] & GATE_OPT_REMOVED) {
+				m_nGates--;
+			} else if (status[gateid] & GATE_OPT_FOLDED) {
+				//a folded gate no longer needs interaction and is evaluated with the local gates of its level
+				if (lvl >= m_vLocalQueueOnLvl.size())
+					m_vLocalQueueOnLvl.resize(lvl + 1);
+				m_vLocalQueueOnLvl[lvl].push_back(gateid);
+				moved = TRUE;
+			} else {
+				queue[kept++] = gateid;
+			}
+		}
+		queue.resize(kept);
+		//the ids are in topological order, hence the local gates of a level are evaluated in the order of their ids
+		if (moved)
+			std::sort(m_vLocalQueueOnLvl[lvl].begin(), m_vLocalQueueOnLvl[lvl].end());
+	}
+}
+
+//Sorts the gates of all levels of queues by their ids and puts them on the level they are now evaluated on
+static void MoveToLevels(std::vector<std::vector<uint32_t> >& queues, GATE* gates, uint32_t& maxdepth) {
+	std::vector<uint32_t> gateids;
+	for (uint32_t lvl = 0; lvl < queues.size(); lvl++) {
+		gateids.insert(gateids.end(), queues[lvl].begin(), queues[lvl].end());
+		queues[lvl].clear();
+	}
+	std::sort(gateids.begin(), gateids.end());
+	for (uint32_t i = 0; i < gateids.size(); i++) {
+		uint32_t depth = gates[gateids[i]].depth;
+		if (depth + 1 > queues.size()) {
+			queues.resize(depth + 1);
+		}
+		maxdepth = std::max(maxdepth, depth + 1);
+		queues[depth].push_back(gateids[i]);
+	}
+	//drop the levels that became empty at the end
+	while (queues.size() > 0 && queues.back().size() == 0) {
+		queues.pop_back();
+	}
+}
+
+void Circuit::UpdateQueueLevels() {
+	m_nMaxDepth = 0;
+	MoveToLevels(m_vLocalQueueOnLvl, m_pGates, m_nMaxDepth);
+	MoveToLevels(m_vInteractiveQueueOnLvl, m_pGates, m_nMaxDepth);
+}
+
+void Circuit::ApplyGateCoalescing(const std::vector<BYTE>& status, const std::vector<uint32_t>& rank) {
+	//the gates that were turned into splitter gates are put back below, on their new level
+	for (uint32_t q = 0; q < 2; q++) {
+		std::vector<std::vector<uint32_t> >& queues = q == 0 ? m_vLocalQueueOnLvl : m_vInteractiveQueueOnLvl;
+		for (uint32_t lvl = 0; lvl < queues.size(); lvl++) {
+			uint32_t kept = 0;
+			for (uint32_t i = 0; i < queues[lvl].size(); i++) {
+				uint32_t gateid = queues[lvl][i];
+				if (status[gateid] & GATE_OPT_REMOVED) {
+					m_nGates--;
+				} else if (!(status[gateid] & GATE_OPT_SPLIT)) {
+					queues[lvl][kept++] = gateid;
+				}
+			}
+			queues[lvl].resize(kept);
+		}
+	}
+
+	std::vector<BYTE> changed(m_vLocalQueueOnLvl.size(), 0);
+	for (uint32_t i = 0; i < status.size(); i++) {
+		if (!(status[i] & (GATE_OPT_ADDED | GATE_OPT_SPLIT)) || (status[i] & GATE_OPT_REMOVED))
+			continue;
+		if (status[i] & GATE_OPT_ADDED)
+			m_nGates++;
+		uint32_t depth = m_pGates[i].depth;
+		std::vector<std::vector<uint32_t> >& queues = m_pGates[i].nrounds > 0 ? m_vInteractiveQueueOnLvl : m_vLocalQueueOnLvl;
+		if (depth + 1 > queues.size())
+			queues.resize(depth + 1);
+		queues[depth].push_back(i);
+		if (depth + 1 > changed.size())
+			changed.resize(depth + 1, 0);
+		changed[depth] = 1;
+	}
+
+	//the local gates of a level are no longer in topological order of their ids
+	for (uint32_t lvl = 0; lvl < m_vLocalQueueOnLvl.size() && lvl < changed.size(); lvl++) {
+		if (!changed[lvl])
+			continue;
+		std::sort(m_vLocalQueueOnLvl[lvl].begin(), m_vLocalQueueOnLvl[lvl].end(), [&](uint32_t a, uint32_t b) {
+			return rank[a] != rank[b] ? rank[a] < rank[b] : a < b;
+		});
+	}
+}
+
 gate_specific Circuit::GetGateSpecificOutput(uint32_t gateid) {
 	assert(m_pGates[gateid].instantiated);
 	return m_pGates[gateid].gs;
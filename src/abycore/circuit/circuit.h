@@ -93,6 +93,26 @@ public:
 	/** It will reset all the member objects to zero/clear them.*/
 	void Reset();
 
+	/**
+		Removes the gates that ABYCircuit::OptimizeGates removed from the queues and moves the gates it folded into local
+		gates from the interactive to the local queue of their level.
+		\param status	GATE_OPT_* flags of each gate
+	*/
+	virtual void ApplyGateOptimization(const std::vector<BYTE>& status);
+
+	/**
+		Moves the gates of the queues to the queues of their current level, after ABYCircuit::BalanceGates changed the
+		levels, and updates the maximum depth.
+	*/
+	void UpdateQueueLevels();
+
+	/**
+		Updates the queues after ABYCircuit::CoalesceGates: drops the removed gates, puts the added gates and the gates that
+		were turned into splitter gates into the queue of their level and orders the local gates of the changed levels by
+		their rank.
+	*/
+	virtual void ApplyGateCoalescing(const std::vector<BYTE>& status, const std::vector<uint32_t>& rank);
+
 	/* organizational routines */
 
 	/**
@@ -114,7 +134,7 @@ public:
 		\param lvl Required level of local queue.
 		\return Local queue on the required level
 	*/
-        std::deque<uint32_t> GetLocalQueueOnLvl(uint32_t lvl) {
+	const std::vector<uint32_t>& GetLocalQueueOnLvl(uint32_t lvl) {
 
 		if (lvl < m_vLocalQueueOnLvl.size())
 			return m_vLocalQueueOnLvl[lvl];
@@ -127,7 +147,7 @@ public:
 		\param lvl Required level of interactive queue.
 		\return Interactive queue on the required level
 	*/
-        std::deque<uint32_t> GetInteractiveQueueOnLvl(uint32_t lvl) {
+	const std::vector<uint32_t>& GetInteractiveQueueOnLvl(uint32_t lvl) {
 		if (lvl < m_vInteractiveQueueOnLvl.size()) {
 			return m_vInteractiveQueueOnLvl[lvl];
                 } else { 
@@ -500,8 +520,9 @@ protected:
 	e_circuit m_eCirctype;
 	uint32_t m_nMaxDepth;
 
-	std::vector<std::deque<uint32_t> > m_vLocalQueueOnLvl; //for locally evaluatable gates, first dimension is the level of the gates, second dimension presents the queue on which the gateids are put
-	std::vector<std::deque<uint32_t> > m_vInteractiveQueueOnLvl; //for gates that need interaction, first dimension is the level of the gates, second dimension presents the queue on which the gateids are put
+	//the gate ids of a level are stored contiguously, such that the sharings scan a level without copying it
+	std::vector<std::vector<uint32_t> > m_vLocalQueueOnLvl; //for locally evaluatable gates, first dimension is the level of the gates, second dimension presents the queue on which the gateids are put
+	std::vector<std::vector<uint32_t> > m_vInteractiveQueueOnLvl; //for gates that need interaction, first dimension is the level of the gates, second dimension presents the queue on which the gateids are put
 	std::vector<std::deque<uint32_t> > m_vInputGates;				//input gates for the parties
 	std::vector<std::deque<uint32_t> > m_vOutputGates;				//input gates for the parties
 	std::vector<uint32_t> m_vInputBits;				//number of input bits for the parties
@@ -522,7 +543,7 @@ protected:
 	std::vector<uint32_t> m_nRoundsIN;
 	std::vector<uint32_t> m_nRoundsOUT;
 
-	const std::deque<uint32_t> EMPTYQUEUE;
+	const std::vector<uint32_t> EMPTYQUEUE;
 
 	//non_lin_on_layers m_vNonLinOnLayer;
 };
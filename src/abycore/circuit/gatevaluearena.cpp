@@ -0,0 +1,176 @@
+/**
+ \file 		gatevaluearena.cpp
+ \author	agent@local
+ \copyright	ABY - A Framework for Efficient Mixed-protocol Secure Two-party Computation
+			Copyright (C) 2015 Engineering Cryptographic Protocols Group, TU Darmstadt
+			This program is free software: you can redistribute it and/or modify
+			it under the terms of the GNU Affero General Public License as published
+			by the Free Software Foundation, either version 3 of the License, or
+			(at your option) any later version.
+			This program is distributed in the hope that it will be useful,
+			but WITHOUT ANY WARRANTY; without even the implied warranty of
+			MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+			GNU Affero General Public License for more details.
+			You should have received a copy of the GNU Affero General Public License
+			along with this program. If not, see <http://www.gnu.org/licenses/>.
+ \brief		Slab allocator for the values of gates.
+ */
+#include "gatevaluearena.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#define ClassBytes(sizeclass) ((uint64_t) 1 << ((sizeclass) + GATE_ARENA_MIN_CLASS_BITS))
+
+GateValueArena::GateValueArena() :
+		m_pBump(NULL), m_pBumpEnd(NULL), m_nNextSlab(0), m_vSlabs(), m_sLarge(), m_nLargeBytes(0), m_pRegion(NULL),
+		m_nRegionSize(0), m_vPlan() {
+	memset(m_pFreeList, 0, sizeof(m_pFreeList));
+	memset(m_nBytesInUse, 0, sizeof(m_nBytesInUse));
+	memset(m_nHighWaterMark, 0, sizeof(m_nHighWaterMark));
+	memset(m_nPlannedBytes, 0, sizeof(m_nPlannedBytes));
+}
+
+GateValueArena::~GateValueArena() {
+	Reset();
+	for (uint32_t i = 0; i < m_vSlabs.size(); i++) {
+		free(m_vSlabs[i]);
+	}
+	free(m_pRegion);
+}
+
+BYTE* GateValueArena::NewBlock(uint32_t sizeclass) {
+	uint64_t blockbytes = sizeof(block_header) + ClassBytes(sizeclass);
+	if ((uint64_t) (m_pBumpEnd - m_pBump) < blockbytes) {
+		//the rest of the current slab is too small and stays unused until the next Reset
+		if (m_nNextSlab == m_vSlabs.size()) {
+			BYTE* slab = (BYTE*) malloc(GATE_ARENA_SLAB_SIZE);
+			if (slab == NULL) {
+				std::cerr << "Memory allocation not successful for the gate value arena" << std::endl;
+				exit(0);
+			}
+			m_vSlabs.push_back(slab);
+		}
+		m_pBump = m_vSlabs[m_nNextSlab++];
+		m_pBumpEnd = m_pBump + GATE_ARENA_SLAB_SIZE;
+	}
+	BYTE* block = m_pBump;
+	m_pBump += blockbytes;
+	return block;
+}
+
+void* GateValueArena::Alloc(e_sharing context, uint64_t bytes, BOOL zero) {
+	uint32_t sizeclass = 0;
+	while (sizeclass < GATE_ARENA_NUM_CLASSES && ClassBytes(sizeclass) < bytes) {
+		sizeclass++;
+	}
+
+	block_header* header;
+	uint64_t blockbytes;
+	if (sizeclass == GATE_ARENA_NUM_CLASSES) {
+		header = (block_header*) malloc(sizeof(block_header) + bytes);
+		if (header == NULL) {
+			std::cerr << "Memory allocation not successful for a gate value of " << bytes << " bytes" << std::endl;
+			exit(0);
+		}
+		m_sLarge.insert(header);
+		m_nLargeBytes += bytes;
+		blockbytes = bytes;
+	} else if (m_pFreeList[sizeclass]) {
+		header = ((block_header*) m_pFreeList[sizeclass]) - 1;
+		m_pFreeList[sizeclass] = m_pFreeList[sizeclass]->next;
+		blockbytes = ClassBytes(sizeclass);
+	} else {
+		header = (block_header*) NewBlock(sizeclass);
+		blockbytes = ClassBytes(sizeclass);
+	}
+	header->sizeclass = sizeclass;
+	header->context = (uint32_t) context;
+	header->bytes = blockbytes;
+
+	m_nBytesInUse[context] += blockbytes;
+	if (m_nBytesInUse[context] > m_nHighWaterMark[context]) {
+		m_nHighWaterMark[context] = m_nBytesInUse[context];
+	}
+
+	void* ptr = header + 1;
+	if (zero) {
+		memset(ptr, 0, bytes);
+	}
+	return ptr;
+}
+
+void GateValueArena::Free(void* ptr) {
+	if (ptr == NULL || ((BYTE*) ptr >= m_pRegion && (BYTE*) ptr < m_pRegion + m_nRegionSize))
+		return;
+	block_header* header = ((block_header*) ptr) - 1;
+	m_nBytesInUse[header->context] -= header->bytes;
+	if (header->sizeclass == GATE_ARENA_NUM_CLASSES) {
+		m_sLarge.erase(header);
+		m_nLargeBytes -= header->bytes;
+		free(header);
+	} else {
+		free_block* block = (free_block*) ptr;
+		block->next = m_pFreeList[header->sizeclass];
+		m_pFreeList[header->sizeclass] = block;
+	}
+}
+
+void GateValueArena::Reset() {
+	for (std::unordered_set<block_header*>::iterator it = m_sLarge.begin(); it != m_sLarge.end(); it++) {
+		free(*it);
+	}
+	m_sLarge.clear();
+	m_nLargeBytes = 0;
+
+	//the blocks on the free lists lie in the slabs, which are carved again from the start
+	memset(m_pFreeList, 0, sizeof(m_pFreeList));
+	m_pBump = NULL;
+	m_pBumpEnd = NULL;
+	m_nNextSlab = 0;
+
+	memset(m_nBytesInUse, 0, sizeof(m_nBytesInUse));
+	memset(m_nHighWaterMark, 0, sizeof(m_nHighWaterMark));
+
+	m_vPlan.clear();
+	memset(m_nPlannedBytes, 0, sizeof(m_nPlannedBytes));
+}
+
+void GateValueArena::SetPlan(const std::vector<uint64_t>& offsets, const std::vector<uint64_t>& bytes, const uint64_t* plannedbytes) {
+	uint64_t regionsize = 0;
+	for (uint32_t i = 0; i < S_LAST; i++) {
+		m_nPlannedBytes[i] = plannedbytes[i];
+		regionsize += plannedbytes[i];
+	}
+	//the region only grows, such that repeated executions of similar circuits do not allocate
+	if (regionsize > m_nRegionSize) {
+		free(m_pRegion);
+		m_pRegion = (BYTE*) malloc(regionsize);
+		if (m_pRegion == NULL) {
+			std::cerr << "Memory allocation not successful for the " << regionsize << " bytes of planned gate values" << std::endl;
+			exit(0);
+		}
+		m_nRegionSize = regionsize;
+	}
+	m_vPlan.resize(offsets.size());
+	for (uint32_t i = 0; i < offsets.size(); i++) {
+		uint64_t offset = offsets[i] / GATE_ARENA_PLAN_GRANULE, size = bytes[i] / GATE_ARENA_PLAN_GRANULE;
+		//values beyond what the entries can address, which only occur for regions of 64 GiB, fall back to the slabs
+		if (offsets[i] == GATE_ARENA_UNPLANNED || offset + size > (uint32_t) -1) {
+			offset = 0;
+			size = 0;
+		}
+		m_vPlan[i].offset = (uint32_t) offset;
+		m_vPlan[i].size = (uint32_t) size;
+	}
+}
+
+void* GateValueArena::AllocPlanned(uint32_t gateid, uint64_t bytes, BOOL zero) {
+	if (gateid >= m_vPlan.size() || m_vPlan[gateid].size == 0 || bytes > (uint64_t) m_vPlan[gateid].size * GATE_ARENA_PLAN_GRANULE)
+		return NULL;
+	void* ptr = m_pRegion + (uint64_t) m_vPlan[gateid].offset * GATE_ARENA_PLAN_GRANULE;
+	if (zero) {
+		memset(ptr, 0, bytes);
+	}
+	return ptr;
+}
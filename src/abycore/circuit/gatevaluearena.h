@@ -0,0 +1,183 @@
+/**
+ \file 		gatevaluearena.h
+ \author	agent@local
+ \copyright	ABY - A Framework for Efficient Mixed-protocol Secure Two-party Computation
+			Copyright (C) 2015 Engineering Cryptographic Protocols Group, TU Darmstadt
+			This program is free software: you can redistribute it and/or modify
+			it under the terms of the GNU Affero General Public License as published
+			by the Free Software Foundation, either version 3 of the License, or
+			(at your option) any later version.
+			This program is distributed in the hope that it will be useful,
+			but WITHOUT ANY WARRANTY; without even the implied warranty of
+			MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+			GNU Affero General Public License for more details.
+			You should have received a copy of the GNU Affero General Public License
+			along with this program. If not, see <http://www.gnu.org/licenses/>.
+ \brief		Slab allocator for the values of gates.
+ */
+
+#ifndef __GATEVALUEARENA_H__
+#define __GATEVALUEARENA_H__
+
+#include "../ABY_utils/ABYconstants.h"
+#include <ENCRYPTO_utils/typedefs.h>
+#include <cstdint>
+#include <unordered_set>
+#include <vector>
+
+/**
+ \def 	GATE_ARENA_MIN_CLASS_BITS
+ \brief	Log2 of the block size of the smallest size class
+ */
+#define GATE_ARENA_MIN_CLASS_BITS 4
+
+/**
+ \def 	GATE_ARENA_NUM_CLASSES
+ \brief	Number of size classes, which are powers of two from 16 bytes to 64 KiB. Larger values are allocated separately.
+ */
+#define GATE_ARENA_NUM_CLASSES 13
+
+/**
+ \def 	GATE_ARENA_SLAB_SIZE
+ \brief	Size of the slabs that the blocks of all size classes are carved from
+ */
+#define GATE_ARENA_SLAB_SIZE (1 << 20)
+
+/**
+ \def 	GATE_ARENA_UNPLANNED
+ \brief	Offset of a gate whose value is not part of the plan
+ */
+#define GATE_ARENA_UNPLANNED ((uint64_t) -1)
+
+/**
+ \def 	GATE_ARENA_PLAN_GRANULE
+ \brief	Alignment of the planned values, the plan stores their offsets and sizes in multiples of it
+ */
+#define GATE_ARENA_PLAN_GRANULE 16
+
+/**
+ Arena for the values of gates (gs.val, gs.aval, gs.yval and gs.yinput). Blocks are rounded up to a power of two and
+ carved from slabs of GATE_ARENA_SLAB_SIZE bytes. A freed block is put on the free list of its size class, such that the
+ values of the next level reuse the memory of the values whose last use was in the previous level.
+
+ Gates whose lifetime is known before the evaluation can additionally be given a fixed offset in one planned region
+ (see ABYCircuit::PlanGateValues). Their values are taken from the region without any allocation and freeing them is a
+ no-op. Values that are not planned, or that turn out larger than planned, fall back to the slabs.
+
+ Reset() takes back all blocks at once but keeps the slabs and the planned region for the next circuit. The arena is
+ not synchronized, callers that allocate from several threads have to serialize the calls. AllocPlanned only reads the
+ plan and can be called concurrently.
+ */
+class GateValueArena {
+public:
+	GateValueArena();
+	~GateValueArena();
+	GateValueArena(const GateValueArena&) = delete;
+	GateValueArena& operator=(const GateValueArena&) = delete;
+
+	/**
+	 Allocates a block that is accounted to a sharing. The block is aligned to 16 bytes.
+	 \param context	Sharing the value belongs to
+	 \param bytes	Size of the value
+	 \param zero	Whether the block is zeroed, as with calloc
+	 \return Pointer to the block
+	 */
+	void* Alloc(e_sharing context, uint64_t bytes, BOOL zero = TRUE);
+
+	/**
+	 Returns a block to its size class. NULL and values in the planned region are ignored.
+	 \param ptr		Pointer that was returned by Alloc or AllocPlanned
+	 */
+	void Free(void* ptr);
+
+	/**
+	 Takes back all blocks, drops the plan, keeps the slabs and the planned region for later allocations and restarts
+	 the high-water marks.
+	 */
+	void Reset();
+
+	/**
+	 Sets the plan for the current circuit and sizes the planned region to fit it. The plan keeps 8 bytes per gate.
+	 \param offsets		Offset of the value of each gate in the region, GATE_ARENA_UNPLANNED if it is not planned. Is a
+	 					multiple of GATE_ARENA_PLAN_GRANULE.
+	 \param bytes			Planned size of the value of each gate, a multiple of GATE_ARENA_PLAN_GRANULE
+	 \param plannedbytes	Bytes of the region that belong to each sharing, S_LAST entries
+	 */
+	void SetPlan(const std::vector<uint64_t>& offsets, const std::vector<uint64_t>& bytes, const uint64_t* plannedbytes);
+
+	/**
+	 Returns the planned memory of the value of a gate.
+	 \param gateid	Id of the gate
+	 \param bytes	Size of the value
+	 \param zero	Whether the value is zeroed, as with calloc
+	 \return Pointer into the planned region, NULL if the gate is not planned or its value is larger than planned
+	 */
+	void* AllocPlanned(uint32_t gateid, uint64_t bytes, BOOL zero = TRUE);
+
+	/**
+	 \return Bytes of the blocks that are currently allocated for a sharing
+	 */
+	uint64_t GetBytesInUse(e_sharing context) {
+		return m_nBytesInUse[context];
+	}
+
+	/**
+	 \return Maximum number of bytes that were allocated for a sharing at the same time since the last Reset, which
+	 includes the planned bytes of the sharing
+	 */
+	uint64_t GetHighWaterMark(e_sharing context) {
+		return m_nHighWaterMark[context] + m_nPlannedBytes[context];
+	}
+
+	/**
+	 \return Bytes of the planned region that belong to a sharing, which is the peak of its planned values
+	 */
+	uint64_t GetPlannedBytes(e_sharing context) {
+		return m_nPlannedBytes[context];
+	}
+
+	/**
+	 \return Bytes of all slabs, of the large blocks that are allocated separately and of the planned region
+	 */
+	uint64_t GetReservedBytes() {
+		return (uint64_t) m_vSlabs.size() * GATE_ARENA_SLAB_SIZE + m_nLargeBytes + m_nRegionSize;
+	}
+
+private:
+	//precedes every block and keeps the payload aligned to 16 bytes
+	struct block_header {
+		uint32_t sizeclass;
+		uint32_t context;
+		uint64_t bytes;
+	};
+
+	//free blocks are linked through their payload
+	struct free_block {
+		free_block* next;
+	};
+
+	//offset and size of a planned value in multiples of GATE_ARENA_PLAN_GRANULE, the size is 0 if it is not planned
+	struct plan_entry {
+		uint32_t offset;
+		uint32_t size;
+	};
+
+	BYTE* NewBlock(uint32_t sizeclass);
+
+	free_block* m_pFreeList[GATE_ARENA_NUM_CLASSES];
+	BYTE* m_pBump; /**< Next unused byte of the current slab */
+	BYTE* m_pBumpEnd; /**< End of the current slab */
+	uint32_t m_nNextSlab; /**< Index of the next slab in m_vSlabs that is handed out after a Reset */
+	std::vector<BYTE*> m_vSlabs;
+	std::unordered_set<block_header*> m_sLarge; /**< Blocks that are larger than the largest size class */
+	uint64_t m_nLargeBytes;
+	uint64_t m_nBytesInUse[S_LAST];
+	uint64_t m_nHighWaterMark[S_LAST];
+
+	BYTE* m_pRegion; /**< Planned region, which is kept across Reset */
+	uint64_t m_nRegionSize;
+	std::vector<plan_entry> m_vPlan;
+	uint64_t m_nPlannedBytes[S_LAST];
+};
+
+#endif /* __GATEVALUEARENA_H__ */
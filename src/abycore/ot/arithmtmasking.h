@@ -0,0 +1,191 @@
+/**
+ \file 		arithmtmasking.h
+ \author 	michael.zohner@ec-spride.de
+ \copyright	ABY - A Framework for Efficient Mixed-protocol Secure Two-party Computation
+			Copyright (C) 2015 Engineering Cryptographic Protocols Group, TU Darmstadt
+			This program is free software: you can redistribute it and/or modify
+			it under the terms of the GNU Affero General Public License as published
+			by the Free Software Foundation, either version 3 of the License, or
+			(at your option) any later version.
+			This program is distributed in the hope that it will be useful,
+			but WITHOUT ANY WARRANTY; without even the implied warranty of
+			MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+			GNU Affero General Public License for more details.
+			You should have received a copy of the GNU Affero General Public License
+			along with this program. If not, see <http://www.gnu.org/licenses/>.
+ \brief		arithmtmasking implementation.
+ */
+#ifndef __ARITHMTMASKING_H_
+#define __ARITHMTMASKING_H_
+
+#include <vector>
+#include <ot/maskingfunction.h>
+
+//#define DEBUGARITHMTMASKING
+
+/**
+ Masking function that turns the OTs of the arithmetic multiplication triple generation into additive shares. Each MT of
+ bit-length MTBitLen takes MTBitLen OTs, which carry K values each.
+
+ Mask and UnMask process the OTs without branching on the choice bits, such that the compiler can evaluate them in SIMD
+ lanes: for K = 1 the OTs of one MT are the lanes, otherwise the K values of one OT are. The functions hold no state
+ besides the inputs, so the OT extension can call them concurrently for the slices of its threads.
+ */
+template<typename T>
+class ArithMTMasking: public MaskingFunction {
+public:
+	//numelements =K, the number of values the sender multiplies with each value of the receiver;
+	//in holds K values of the sender for each value of the receiver
+	ArithMTMasking(uint32_t numelements, CBitVector* in) :
+			m_vInput(in), m_nElements(numelements), m_nOTByteLen(sizeof(T) * numelements), m_nMTBitLen(sizeof(T) * 8),
+			aesexpand(sizeof(T) * numelements > AES_BYTES) {
+	}
+	;
+
+	~ArithMTMasking() {
+	}
+	;
+
+	ArithMTMasking(const ArithMTMasking&) = delete;
+	ArithMTMasking& operator=(const ArithMTMasking&) = delete;
+
+	//In total K' OTs will be performed
+	void Mask(uint32_t progress, uint32_t len, CBitVector** values, CBitVector* snd_buf, snd_ot_flavor) {
+
+		//progress and processedOTs should always be divisible by MTBitLen
+		if (progress % m_nMTBitLen != 0 || len % m_nMTBitLen != 0) {
+			std::cerr << "progress or processed OTs not divisible by MTBitLen, cannot guarantee correct result. Progress = " << progress << ", processed OTs " << len
+					<< ", MTBitLen = " << m_nMTBitLen << std::endl;
+		}
+
+		//each MT takes MTBitLen OTs, which carry K values each
+		uint32_t startpos = progress / m_nMTBitLen;
+		uint32_t nmts = len / m_nMTBitLen;
+
+		T* input = ((T*) m_vInput->GetArr()) + (uint64_t) startpos * m_nElements;
+		T* rndval = (T*) snd_buf[0].GetArr();
+		T* maskedval = (T*) snd_buf[1].GetArr();
+
+		T* retvals = ((T*) values[0]->GetArr()) + (uint64_t) startpos * m_nElements;
+
+		if (m_nElements == 1) {
+			for (uint32_t mtid = 0; mtid < nmts; mtid++, rndval += MTBITLEN, maskedval += MTBITLEN) {
+				T diff = input[mtid];
+				T sum = 0;
+				for (uint32_t mtbit = 0; mtbit < MTBITLEN; mtbit++) {
+					//Add the random mask to the sum of masks and mask the correlation (diff << mtbit) - mask with the second OT result
+					sum += rndval[mtbit];
+					maskedval[mtbit] ^= (T) ((T) (diff << mtbit) - rndval[mtbit]);
+				}
+				retvals[mtid] = sum;
+#ifdef DEBUGARITHMTMASKING
+				std::cout << "S: mtid = " << startpos + mtid << ", val = " << (UINT64_T) diff << ", mask = " << (UINT64_T) sum << std::endl;
+#endif
+			}
+		} else {
+			for (uint32_t mtid = 0; mtid < nmts; mtid++, input += m_nElements, retvals += m_nElements) {
+				for (uint32_t j = 0; j < m_nElements; j++)
+					retvals[j] = 0;
+				for (uint32_t mtbit = 0; mtbit < m_nMTBitLen; mtbit++, rndval += m_nElements, maskedval += m_nElements) {
+					for (uint32_t j = 0; j < m_nElements; j++) {
+						retvals[j] += rndval[j];
+						maskedval[j] ^= (T) ((T) (input[j] << mtbit) - rndval[j]);
+					}
+				}
+			}
+		}
+	}
+	;
+
+	//rcv_buf holds the masked values that were sent by the sender, output holds the masks that were generated by the receiver
+	void UnMask(uint32_t progress, uint32_t len, CBitVector* choices, CBitVector* output, CBitVector* rcv_buf, CBitVector* tmpmask, snd_ot_flavor) {
+		//progress and len should always be divisible by MTBitLen
+		if (progress % m_nMTBitLen != 0 || len % m_nMTBitLen != 0) {
+			std::cerr << "progress or processed OTs not divisible by MTBitLen, cannot guarantee correct result. Progress = " << progress << ", processed OTs " << len
+					<< ", MTBitLen = " << m_nMTBitLen << std::endl;
+		}
+
+		uint32_t startpos = progress / m_nMTBitLen;
+		uint32_t nmts = len / m_nMTBitLen;
+
+		//the MTBitLen choice bits of an MT form the value of the receiver
+		T* choicevals = ((T*) choices->GetArr()) + startpos;
+		T* masks = (T*) tmpmask->GetArr();
+		T* rcvedvals = (T*) rcv_buf->GetArr();
+		T* outvals = ((T*) output->GetArr()) + (uint64_t) startpos * m_nElements;
+
+		//For a choice bit c, sel is all ones if c = 1 and zero otherwise. The mask m is unmasked with the received value and
+		//added if c = 1 and subtracted if c = 0, where -m = (m ^ ~sel) + 1.
+		T c, sel, m;
+
+		if (m_nElements == 1) {
+			for (uint32_t mtid = 0; mtid < nmts; mtid++, masks += MTBITLEN, rcvedvals += MTBITLEN) {
+				T a = choicevals[mtid];
+				T sum = 0;
+				for (uint32_t mtbit = 0; mtbit < MTBITLEN; mtbit++) {
+					c = (a >> mtbit) & 1;
+					sel = (T) 0 - c;
+					m = masks[mtbit] ^ (rcvedvals[mtbit] & sel);
+					sum += (T) (m ^ (T) ~sel) + (T) (c ^ 1);
+				}
+				outvals[mtid] = sum;
+#ifdef DEBUGARITHMTMASKING
+				std::cout << "R: mtid = " << startpos + mtid << ", val = " << (UINT64_T) a << ", mask = " << (UINT64_T) sum << std::endl;
+#endif
+			}
+		} else {
+			for (uint32_t mtid = 0; mtid < nmts; mtid++, outvals += m_nElements) {
+				T a = choicevals[mtid];
+				for (uint32_t j = 0; j < m_nElements; j++)
+					outvals[j] = 0;
+				for (uint32_t mtbit = 0; mtbit < m_nMTBitLen; mtbit++, masks += m_nElements, rcvedvals += m_nElements) {
+					c = (a >> mtbit) & 1;
+					sel = (T) 0 - c;
+					for (uint32_t j = 0; j < m_nElements; j++) {
+						m = masks[j] ^ (rcvedvals[j] & sel);
+						outvals[j] += (T) (m ^ (T) ~sel) + (T) (c ^ 1);
+					}
+				}
+			}
+		}
+	}
+	;
+
+	void expandMask(CBitVector* out, BYTE* sbp, uint32_t offset, uint32_t processedOTs, uint32_t, crypto* crypt) {
+		if (!aesexpand) {
+			BYTE* outptr = out->GetArr() + (uint64_t) offset * m_nOTByteLen;
+			for (uint32_t i = 0; i < processedOTs; i++, sbp += AES_KEY_BYTES, outptr += m_nOTByteLen) {
+				memcpy(outptr, sbp, m_nOTByteLen);
+			}
+		} else {
+			//the buffers are local, since the OT threads expand their masks concurrently
+			uint32_t nblocks = ceil_divide(m_nOTByteLen, AES_BYTES);
+			std::vector<BYTE> ctrbuf(AES_BYTES, 0);
+			std::vector<BYTE> rndbuf(nblocks * AES_BYTES);
+			uint32_t* counter = reinterpret_cast<uint32_t*>(ctrbuf.data());
+			AES_KEY_CTX tkey;
+			for (uint32_t i = 0; i < processedOTs; i++, sbp += AES_KEY_BYTES) {
+				//Generate sufficient random bits
+				crypt->init_aes_key(&tkey, sbp);
+				for (counter[0] = 0; counter[0] < nblocks; counter[0]++) {
+					crypt->encrypt(&tkey, rndbuf.data() + counter[0] * AES_BYTES, ctrbuf.data(), AES_BYTES);
+				}
+				crypt->clean_aes_key(&tkey);
+				//Copy random bits into output vector
+				out->SetBytes(rndbuf.data(), (uint64_t) (offset + i) * m_nOTByteLen, m_nOTByteLen);
+			}
+		}
+	}
+
+private:
+	//constant trip count of the loops over the OTs of an MT, such that they can be vectorized
+	static const uint32_t MTBITLEN = sizeof(T) * 8;
+
+	CBitVector* m_vInput;
+	uint32_t m_nElements;
+	uint32_t m_nOTByteLen;
+	uint32_t m_nMTBitLen;
+	BOOL aesexpand;
+};
+
+#endif /* __ARITHMTMASKING_H_ */
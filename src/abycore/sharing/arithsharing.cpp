@@ -18,8 +18,37 @@
 
 #include <algorithm>
 #include "arithsharing.h"
+#include "mtstore.h"
 #include "../aby/abysetup.h"
 
+/**
+ \def 	MAT_MUL_BLOCK
+ \brief	Number of rows and columns of the blocks of the right matrix in MatMulAdd, such that a block fits into the L1 cache
+ */
+#define MAT_MUL_BLOCK 64
+
+//c += a * b for a row-major nrows x ninner matrix a and ninner x ncols matrix b. The right matrix is processed in blocks,
+//the innermost loop runs over contiguous values such that it is vectorized by the compiler.
+template<typename T>
+static void MatMulAdd(const T* a, const T* b, T* c, uint32_t nrows, uint32_t ninner, uint32_t ncols) {
+	for (uint32_t jj = 0; jj < ncols; jj += MAT_MUL_BLOCK) {
+		uint32_t jend = std::min(jj + MAT_MUL_BLOCK, ncols);
+		for (uint32_t kk = 0; kk < ninner; kk += MAT_MUL_BLOCK) {
+			uint32_t kend = std::min(kk + MAT_MUL_BLOCK, ninner);
+			for (uint32_t i = 0; i < nrows; i++) {
+				T* crow = c + (uint64_t) i * ncols;
+				for (uint32_t k = kk; k < kend; k++) {
+					T aval = a[(uint64_t) i * ninner + k];
+					const T* brow = b + (uint64_t) k * ncols;
+					for (uint32_t j = jj; j < jend; j++) {
+						crow[j] += aval * brow[j];
+					}
+				}
+			}
+		}
+	}
+}
+
 template<typename T>
 void ArithSharing<T>::Init() {
 	m_nMTs = 0;
@@ -68,6 +97,7 @@ void ArithSharing<T>::InitNewLayer() {
 	m_nOutputShareSndCtr = 0;
 
 	m_vMULGates.clear();
+	m_vMatMulGates.clear();
 	m_vInputShareGates.clear();
 	m_vOutputShareGates.clear();
 
@@ -79,7 +109,20 @@ void ArithSharing<T>::PrepareSetupPhase(ABYSetup* setup) {
 
 	InitMTs();
 
-	if (m_nMTs > 0) {
+	//In READ mode the MTs are taken from the store, such that no OTs are needed. Revert to default mode if the store does not hold enough MTs.
+	if (m_nMTs > 0 && GetPreCompPhaseValue() == ePreCompRead && !ReadMTsFromStore()) {
+		SetPreCompPhaseValue(ePreCompDefault);
+	}
+
+	//In the default mode, OT based MTs are taken from the pool of the setup phase if it holds enough of them
+	m_bMTsFromPool = FALSE;
+	if (m_nMTs > 0 && m_eMTGenAlg == MT_OT && GetPreCompPhaseValue() == ePreCompDefault) {
+		std::vector<mt_store_section> sections(1);
+		GetMTStoreSection(&sections[0]);
+		m_bMTsFromPool = setup->TakeFromPool(m_eContext, sections);
+	}
+
+	if (m_nMTs > 0 && GetPreCompPhaseValue() != ePreCompRead && !m_bMTsFromPool) {
 		if (m_eMTGenAlg == MT_PAILLIER || m_eMTGenAlg == MT_DGK) {
 			PKMTGenVals* pgentask = (PKMTGenVals*) malloc(sizeof(PKMTGenVals));
 			pgentask->A = &(m_vA[0]);
@@ -113,6 +156,8 @@ void ArithSharing<T>::PrepareSetupPhase(ABYSetup* setup) {
 		}
 	}
 
+	InitMatMTs(setup);
+
 	m_nNumCONVs = m_cArithCircuit->GetNumCONVGates();
 	if (m_nNumCONVs > 0) {
 		XORMasking* fXORMaskFct = new XORMasking(m_nTypeBitLen); //TODO to implement the vector multiplication change first argument
@@ -160,10 +205,14 @@ void ArithSharing<T>::FinishSetupPhase(ABYSetup* setup) {
 		<< ", C: " << (UINT64_T) m_vC[0].template Get<T>(i * m_nTypeBitLen, m_nTypeBitLen) << ", S: " << (UINT64_T) m_vS[0].template Get<T>(i * m_nTypeBitLen, m_nTypeBitLen) << std::endl;
 	}
 #endif
-	if (m_eMTGenAlg == MT_OT) {
+	if (m_eMTGenAlg == MT_OT && GetPreCompPhaseValue() != ePreCompRead && !m_bMTsFromPool) {
 		//Compute Multiplication Triples
 		ComputeMTsFromOTs();
 	}
+	ComputeMatMTsFromOTs();
+	if (m_nMTs > 0 && GetPreCompPhaseValue() == ePreCompStore) {
+		StoreMTsToStore();
+	}
 
 	FinishMTGeneration();
 #ifdef VERIFY_ARITH_MT
@@ -202,25 +251,161 @@ void ArithSharing<T>::InitMTs() {
 }
 
 template<typename T>
-void ArithSharing<T>::ComputeMTsFromOTs() {
-	uint32_t bytesMTs = ceil_divide(m_nMTs * m_nTypeBitLen, 8);
+void ArithSharing<T>::GetMTStoreSection(mt_store_section* section) {
+	section->bitlen = m_nTypeBitLen;
+	section->nmts = m_nMTs;
+	section->abytes = m_nMTs * sizeof(T);
+	section->bcbytes = m_nMTs * sizeof(T);
+	section->A = m_vA[0].GetArr();
+	section->B = m_vB[0].GetArr();
+	section->C = m_vC[0].GetArr();
+}
+
+template<typename T>
+void ArithSharing<T>::StoreMTsToStore() {
+	std::vector<mt_store_section> sections(1);
+	GetMTStoreSection(&sections[0]);
 
-	CBitVector temp(m_nMTs);
+	MTStore store(m_eRole);
+	store.Append(m_eContext, sections);
+}
+
+template<typename T>
+BOOL ArithSharing<T>::ReadMTsFromStore() {
+	std::vector<mt_store_section> sections(1);
+	GetMTStoreSection(&sections[0]);
+
+	MTStore store(m_eRole);
+	return store.Read(m_eContext, sections);
+}
+
+template<typename T>
+void ArithSharing<T>::ComputeMTsFromOTs() {
+	T* a = (T*) m_vA[0].GetArr();
+	T* b = (T*) m_vB[0].GetArr();
+	T* c = (T*) m_vC[0].GetArr();
+	T* s = (T*) m_vS[0].GetArr();
 
-	T tmp;
 	for (uint32_t i = 0; i < m_nMTs; i++) {
-		tmp = m_vA[0].template Get<T>(i * m_nTypeBitLen, m_nTypeBitLen)
-				* m_vB[0].template Get<T>(i * m_nTypeBitLen, m_nTypeBitLen);
-		tmp += m_vC[0].template Get<T>(i * m_nTypeBitLen, m_nTypeBitLen);
-		tmp += m_vS[0].template Get<T>(i * m_nTypeBitLen, m_nTypeBitLen);
-		m_vC[0].template Set<T>(tmp, i * m_nTypeBitLen, m_nTypeBitLen);
+		c[i] = a[i] * b[i] + c[i] + s[i];
+	}
 #ifdef DEBUGARITH
-		std::cout << "Computed MT " << i << ": ";
-		std::cout << "A: " << (UINT64_T) m_vA[0].template Get<T>(i * m_nTypeBitLen, m_nTypeBitLen) << ", B: " << (UINT64_T) m_vB[0].template Get<T>(i * m_nTypeBitLen, m_nTypeBitLen)
-		<< ", C: " << (UINT64_T) m_vC[0].template Get<T>(i * m_nTypeBitLen, m_nTypeBitLen) << std::endl;
+	for (uint32_t i = 0; i < m_nMTs; i++) {
+		std::cout << "Computed MT " << i << ": A: " << (UINT64_T) a[i] << ", B: " << (UINT64_T) b[i] << ", C: " << (UINT64_T) c[i] << std::endl;
+	}
+#endif
+}
+
+template<typename T>
+void ArithSharing<T>::InitMatMTs(ABYSetup* setup) {
+	std::vector<mat_mul_gate>& matgates = m_cArithCircuit->GetMatMulGates();
+	uint64_t nopen = 0;
+
+	//The triples are computed like vector multiplication triples: each value of A of the receiver is multiplied with
+	//the ncols values of the row of B of the sender that it meets in A * B. The products are summed up in ComputeMatMTsFromOTs.
+	for (uint32_t g = 0; g < matgates.size(); g++) {
+		mat_mt* mt = new mat_mt();
+		mt->dims = matgates[g];
+		uint32_t ninner = mt->dims.ninner;
+		uint32_t ncols = mt->dims.ncols;
+		uint64_t asize = (uint64_t) mt->dims.nrows * ninner;
+		uint64_t bsize = (uint64_t) ninner * ncols;
+
+		mt->A.Create(asize, m_nTypeBitLen, m_cCrypto);
+		mt->B.Create(bsize, m_nTypeBitLen, m_cCrypto);
+		mt->C.Create((uint64_t) mt->dims.nrows * ncols, m_nTypeBitLen);
+		mt->Bexp.Create(asize * ncols, m_nTypeBitLen);
+		mt->Csnd.Create(asize * ncols, m_nTypeBitLen);
+		mt->S.Create(asize * ncols, m_nTypeBitLen);
+		mt->openidx = 0;
+
+		T* b = (T*) mt->B.GetArr();
+		T* bexp = (T*) mt->Bexp.GetArr();
+		for (uint64_t i = 0; i < asize; i++) {
+			memcpy(bexp + i * ncols, b + (i % ninner) * ncols, ncols * sizeof(T));
+		}
+
+		for (uint32_t i = 0; i < 2; i++) {
+			ArithMTMasking<T> *fMaskFct = new ArithMTMasking<T>(ncols, &(mt->Bexp));
+			IKNP_OTTask* task = (IKNP_OTTask*) malloc(sizeof(IKNP_OTTask));
+			task->bitlen = m_nTypeBitLen * ncols;
+			task->snd_flavor = Snd_C_OT;
+			task->rec_flavor = Rec_OT;
+			task->numOTs = asize * m_nTypeBitLen;
+			task->mskfct = fMaskFct;
+			task->delete_mskfct = TRUE;
+			if ((m_eRole ^ i) == SERVER) {
+				task->pval.sndval.X0 = &(mt->Csnd);
+				task->pval.sndval.X1 = &(mt->Csnd);
+			} else {
+				task->pval.rcvval.C = &(mt->A);
+				task->pval.rcvval.R = &(mt->S);
+			}
+#ifndef BATCH
+			std::cout << "Adding a OT task which is supposed to perform " << task->numOTs << " OTs on " << task->bitlen << " bits for ArithMatMul" << std::endl;
 #endif
+			setup->AddOTTask(task, i);
+		}
+
+		m_mMatMTs[mt->dims.gateid] = mt;
+		nopen += asize + bsize;
+	}
+
+	if (nopen > 0) {
+		m_vMatOpenSnd.Create(nopen, m_nTypeBitLen);
+		m_vMatOpenRcv.Create(nopen, m_nTypeBitLen);
+	}
+}
+
+template<typename T>
+void ArithSharing<T>::ComputeMatMTsFromOTs() {
+	for (typename std::map<uint32_t, mat_mt*>::iterator it = m_mMatMTs.begin(); it != m_mMatMTs.end(); it++) {
+		mat_mt* mt = it->second;
+		uint32_t nrows = mt->dims.nrows;
+		uint32_t ninner = mt->dims.ninner;
+		uint32_t ncols = mt->dims.ncols;
+
+		T* c = (T*) mt->C.GetArr();
+		T* csnd = (T*) mt->Csnd.GetArr();
+		T* s = (T*) mt->S.GetArr();
+
+		//C = A * B + the shares of both cross products of the own and the other party's A and B
+		memset(c, 0, (uint64_t) nrows * ncols * sizeof(T));
+		MatMulAdd((T*) mt->A.GetArr(), (T*) mt->B.GetArr(), c, nrows, ninner, ncols);
+		for (uint64_t i = 0, pos = 0; i < nrows; i++) {
+			T* crow = c + i * ncols;
+			for (uint32_t j = 0; j < ninner; j++) {
+				for (uint32_t k = 0; k < ncols; k++, pos++) {
+					crow[k] += csnd[pos] + s[pos];
+				}
+			}
+		}
+
+		mt->Bexp.delCBitVector();
+		mt->Csnd.delCBitVector();
+		mt->S.delCBitVector();
+	}
+}
 
+template<typename T>
+void ArithSharing<T>::DeleteMatMTs() {
+	for (typename std::map<uint32_t, mat_mt*>::iterator it = m_mMatMTs.begin(); it != m_mMatMTs.end(); it++) {
+		mat_mt* mt = it->second;
+		mt->A.delCBitVector();
+		mt->B.delCBitVector();
+		mt->C.delCBitVector();
+		mt->Bexp.delCBitVector();
+		mt->Csnd.delCBitVector();
+		mt->S.delCBitVector();
+		delete mt;
 	}
+	m_mMatMTs.clear();
+	m_vMatMulGates.clear();
+
+	m_vMatOpenSnd.delCBitVector();
+	m_vMatOpenRcv.delCBitVector();
+	m_nMatOpenStartIdx = 0;
+	m_nMatOpenIdx = 0;
 }
 
 template<typename T>
@@ -268,7 +453,7 @@ void ArithSharing<T>::PrepareOnlinePhase() {
 
 template<typename T>
 void ArithSharing<T>::EvaluateLocalOperations(uint32_t depth) {
-	std::deque<uint32_t> localops = m_cArithCircuit->GetLocalQueueOnLvl(depth);
+	const std::vector<uint32_t>& localops = m_cArithCircuit->GetLocalQueueOnLvl(depth);
 
 	for (uint32_t i = 0; i < localops.size(); i++) {
 		GATE* gate = m_pGates + localops[i];
@@ -318,16 +503,21 @@ void ArithSharing<T>::EvaluateLocalOperations(uint32_t depth) {
 template<typename T>
 void ArithSharing<T>::EvaluateInteractiveOperations(uint32_t depth) {
 
-	std::deque<uint32_t> interactiveops = m_cArithCircuit->GetInteractiveQueueOnLvl(depth);
+	const std::vector<uint32_t>& interactiveops = m_cArithCircuit->GetInteractiveQueueOnLvl(depth);
 
 	for (uint32_t i = 0; i < interactiveops.size(); i++) {
 		GATE* gate = m_pGates + interactiveops[i];
 
-		if (gate->type == G_NON_LIN) {
+		if (gate->type == G_NON_LIN || gate->type == G_NON_LIN_DOT) {
 #ifdef DEBUGARITH
 			std::cout << " which is an MUL gate" << std::endl;
 #endif
 			SelectiveOpen(gate);
+		} else if (gate->type == G_NON_LIN_MAT) {
+#ifdef DEBUGARITH
+			std::cout << " which is a matrix MUL gate" << std::endl;
+#endif
+			SelectiveOpenMatrix(interactiveops[i]);
 		} else if (gate->type == G_IN) {
 			if (gate->gs.ishare.src == m_eRole) {
 #ifdef DEBUGARITH
@@ -516,24 +706,56 @@ template<typename T>
 void ArithSharing<T>::SelectiveOpen(GATE* gate) {
 	uint32_t idleft = gate->ingates.inputs.twin.left;
 	uint32_t idright = gate->ingates.inputs.twin.right;
+	uint32_t nmuls = GetNumMULs(gate);
 
-	T d, e, x, y, a, b;
-	for (uint32_t i = 0; i < gate->nvals; i++, m_vMTIdx[0]++) {
-		a = m_vD_snd[0].template Get<T>(m_vMTIdx[0]);
-		x = ((T*) m_pGates[idleft].gs.aval)[i];
-		d = MOD_SUB(x, a, m_nTypeBitMask); //a > x ? m_nTypeBitMask - (a - 1) + x : x - a;
-		m_vD_snd[0].template Set<T>(d, m_vMTIdx[0]);
-		b = m_vE_snd[0].template Get<T>(m_vMTIdx[0]);
-		y = ((T*) m_pGates[idright].gs.aval)[i];
-		e = MOD_SUB(y, b, m_nTypeBitMask); //b > y ? m_nTypeBitMask - (b - 1) + y : y - b;
-		m_vE_snd[0].template Set<T>(e, m_vMTIdx[0]);
+	//D_snd and E_snd are pre-set to A and B and are overwritten with d = x - a and e = y - b
+	T* d = ((T*) m_vD_snd[0].GetArr()) + m_vMTIdx[0];
+	T* e = ((T*) m_vE_snd[0].GetArr()) + m_vMTIdx[0];
+	T* x = (T*) m_pGates[idleft].gs.aval;
+	T* y = (T*) m_pGates[idright].gs.aval;
+
+	for (uint32_t i = 0; i < nmuls; i++) {
+		d[i] = x[i] - d[i];
+		e[i] = y[i] - e[i];
 	}
+	m_vMTIdx[0] += nmuls;
 	m_vMULGates.push_back(gate);
 
 	UsedGate(idleft);
 	UsedGate(idright);
 }
 
+template<typename T>
+void ArithSharing<T>::SelectiveOpenMatrix(uint32_t gateid) {
+	GATE* gate = m_pGates + gateid;
+	uint32_t idleft = gate->ingates.inputs.twin.left;
+	uint32_t idright = gate->ingates.inputs.twin.right;
+	mat_mt* mt = m_mMatMTs[gateid];
+
+	uint64_t asize = (uint64_t) mt->dims.nrows * mt->dims.ninner;
+	uint64_t bsize = (uint64_t) mt->dims.ninner * mt->dims.ncols;
+
+	T* d = ((T*) m_vMatOpenSnd.GetArr()) + m_nMatOpenIdx;
+	T* e = d + asize;
+	T* a = (T*) mt->A.GetArr();
+	T* b = (T*) mt->B.GetArr();
+	T* x = (T*) m_pGates[idleft].gs.aval;
+	T* y = (T*) m_pGates[idright].gs.aval;
+
+	for (uint64_t i = 0; i < asize; i++) {
+		d[i] = x[i] - a[i];
+	}
+	for (uint64_t i = 0; i < bsize; i++) {
+		e[i] = y[i] - b[i];
+	}
+	mt->openidx = m_nMatOpenIdx;
+	m_nMatOpenIdx += asize + bsize;
+	m_vMatMulGates.push_back(gateid);
+
+	UsedGate(idleft);
+	UsedGate(idright);
+}
+
 template<typename T>
 void ArithSharing<T>::FinishCircuitLayer(uint32_t depth) {
 #ifdef DEBUGARITH
@@ -555,6 +777,7 @@ void ArithSharing<T>::FinishCircuitLayer(uint32_t depth) {
 
 	EvaluateMTs();
 	EvaluateMULGate();
+	EvaluateMatMulGates();
 	AssignInputShares();
 	AssignOutputShares();
 	AssignConversionShares();
@@ -566,51 +789,105 @@ template<typename T>
 void ArithSharing<T>::EvaluateMTs() {
 
 	uint32_t startid = m_vMTStartIdx[0];
-	uint32_t endid = m_vMTIdx[0];
-
-	T a, b, c, dsnd, esnd, drcv, ercv, e, d, tempres;
-	for (uint32_t i = startid; i < endid; i++) {
-		a = m_vA[0].template Get<T>(i);
-		b = m_vB[0].template Get<T>(i);
-		c = m_vC[0].template Get<T>(i);
-
-		dsnd = m_vD_snd[0].template Get<T>(i);
-		esnd = m_vE_snd[0].template Get<T>(i);
-
-		drcv = m_vD_rcv[0].template Get<T>(i);
-		ercv = m_vE_rcv[0].template Get<T>(i);
-
-		d = (dsnd + drcv) & m_nTypeBitMask;
-		e = (esnd + ercv) & m_nTypeBitMask;
-
-		tempres = ((a * e) + (b * d) + c) & m_nTypeBitMask;
-
-		if (m_eRole == SERVER) {
-			tempres = (tempres + (d * e)) & m_nTypeBitMask;
+	uint32_t nmts = m_vMTIdx[0] - startid;
+
+	//The triples are stored as arrays of T, such that the reduction modulo 2^l is done by the type itself and the
+	//loops below can be vectorized by the compiler
+	T* a = ((T*) m_vA[0].GetArr()) + startid;
+	T* b = ((T*) m_vB[0].GetArr()) + startid;
+	T* c = ((T*) m_vC[0].GetArr()) + startid;
+	T* dsnd = ((T*) m_vD_snd[0].GetArr()) + startid;
+	T* esnd = ((T*) m_vE_snd[0].GetArr()) + startid;
+	T* drcv = ((T*) m_vD_rcv[0].GetArr()) + startid;
+	T* ercv = ((T*) m_vE_rcv[0].GetArr()) + startid;
+	T* res = ((T*) m_vResA[0].GetArr()) + startid;
+
+	T d, e;
+	if (m_eRole == SERVER) {
+		for (uint32_t i = 0; i < nmts; i++) {
+			d = dsnd[i] + drcv[i];
+			e = esnd[i] + ercv[i];
+			res[i] = (a[i] * e) + (b[i] * d) + c[i] + (d * e);
 		}
+	} else {
+		for (uint32_t i = 0; i < nmts; i++) {
+			d = dsnd[i] + drcv[i];
+			e = esnd[i] + ercv[i];
+			res[i] = (a[i] * e) + (b[i] * d) + c[i];
+		}
+	}
 #ifdef DEBUGARITH
-		std::cout << "mt result = " << (UINT64_T) tempres << " = ((" << (UINT64_T) a << " * " << (UINT64_T) e << " ) + ( " << (UINT64_T) b
-		<< " * " << (UINT64_T) d << ") + " << (UINT64_T) c << ")" << std::endl;
-#endif
-		m_vResA[0].template Set<T>(tempres, i);
+	for (uint32_t i = 0; i < nmts; i++) {
+		std::cout << "mt result = " << (UINT64_T) res[i] << " = ((" << (UINT64_T) a[i] << " * " << (UINT64_T) (T) (esnd[i] + ercv[i]) << " ) + ( "
+		<< (UINT64_T) b[i] << " * " << (UINT64_T) (T) (dsnd[i] + drcv[i]) << ") + " << (UINT64_T) c[i] << ")" << std::endl;
 	}
+#endif
 }
 
 template<typename T>
 void ArithSharing<T>::EvaluateMULGate() {
 	GATE* gate;
+	T* res = (T*) m_vResA[0].GetArr();
 	for (uint32_t i = 0, idx = m_vMTStartIdx[0]; i < m_vMULGates.size() && idx < m_vMTIdx[0]; i++) {
 		gate = m_vMULGates[i];
 		InstantiateGate(gate);
 
-		for (uint32_t j = 0; j < gate->nvals; j++, idx++) {
-			((T*) gate->gs.aval)[j] = m_vResA[0].template Get<T>(idx);
+		if (gate->type == G_NON_LIN_DOT) {
+			T sum = 0;
+			for (uint32_t j = 0, nmuls = GetNumMULs(gate); j < nmuls; j++, idx++) {
+				sum += res[idx];
+			}
+			((T*) gate->gs.aval)[0] = sum;
+		} else {
+			memcpy(gate->gs.aval, res + idx, gate->nvals * sizeof(T));
+			idx += gate->nvals;
 		}
 	}
 
 	m_vMTStartIdx[0] = m_vMTIdx[0];
 }
 
+template<typename T>
+void ArithSharing<T>::EvaluateMatMulGates() {
+	for (uint32_t g = 0; g < m_vMatMulGates.size(); g++) {
+		GATE* gate = m_pGates + m_vMatMulGates[g];
+		mat_mt* mt = m_mMatMTs[m_vMatMulGates[g]];
+		uint32_t nrows = mt->dims.nrows;
+		uint32_t ninner = mt->dims.ninner;
+		uint32_t ncols = mt->dims.ncols;
+		uint64_t asize = (uint64_t) nrows * ninner;
+		uint64_t bsize = (uint64_t) ninner * ncols;
+
+		//D = X - A and E = Y - B are reconstructed in the receive buffer
+		T* dsnd = ((T*) m_vMatOpenSnd.GetArr()) + mt->openidx;
+		T* d = ((T*) m_vMatOpenRcv.GetArr()) + mt->openidx;
+		T* e = d + asize;
+		for (uint64_t i = 0; i < asize + bsize; i++) {
+			d[i] += dsnd[i];
+		}
+
+		InstantiateGate(gate);
+		T* z = (T*) gate->gs.aval;
+		T* b = (T*) mt->B.GetArr();
+
+		//Z = C + D * B + A * E, where the server adds D * E by computing D * (B + E)
+		memcpy(z, mt->C.GetArr(), (uint64_t) nrows * ncols * sizeof(T));
+		if (m_eRole == SERVER) {
+			std::vector<T> be(bsize);
+			for (uint64_t i = 0; i < bsize; i++) {
+				be[i] = b[i] + e[i];
+			}
+			MatMulAdd(d, be.data(), z, nrows, ninner, ncols);
+		} else {
+			MatMulAdd(d, b, z, nrows, ninner, ncols);
+		}
+		MatMulAdd((T*) mt->A.GetArr(), e, z, nrows, ninner, ncols);
+	}
+	m_vMatMulGates.clear();
+
+	m_nMatOpenStartIdx = m_nMatOpenIdx;
+}
+
 template<typename T>
 void ArithSharing<T>::AssignInputShares() {
 	GATE* gate;
@@ -833,6 +1110,12 @@ void ArithSharing<T>::GetDataToSend(std::vector<BYTE*>& sendbuf, std::vector<uin
 		sndbytes.push_back(mtbytelen);
 	}
 
+	//Selective openings of matrix multiplications
+	if (m_nMatOpenIdx > m_nMatOpenStartIdx) {
+		sendbuf.push_back(m_vMatOpenSnd.GetArr() + m_nMatOpenStartIdx * sizeof(T));
+		sndbytes.push_back((m_nMatOpenIdx - m_nMatOpenStartIdx) * sizeof(T));
+	}
+
 #ifdef DEBUGARITH
 	if(m_nInputShareSndCtr > 0) {
 		std::cout << "Sending " << m_nInputShareSndCtr << " Input shares : ";
@@ -899,6 +1182,12 @@ void ArithSharing<T>::GetBuffersToReceive(std::vector<BYTE*>& rcvbuf, std::vecto
 		rcvbytes.push_back(mtbytelen);
 	}
 
+	//Selective openings of matrix multiplications
+	if (m_nMatOpenIdx > m_nMatOpenStartIdx) {
+		rcvbuf.push_back(m_vMatOpenRcv.GetArr() + m_nMatOpenStartIdx * sizeof(T));
+		rcvbytes.push_back((m_nMatOpenIdx - m_nMatOpenStartIdx) * sizeof(T));
+	}
+
 #ifdef DEBUGARITH
 	if(mtbytelen > 0) {
 		std::cout << "Receiving 2* " << (m_vMTIdx[0] - m_vMTStartIdx[0]) << " MTs" << std::endl;
@@ -910,10 +1199,15 @@ void ArithSharing<T>::GetBuffersToReceive(std::vector<BYTE*>& rcvbuf, std::vecto
 #endif
 }
 
+template<typename T>
+uint64_t ArithSharing<T>::GetGateValueBytes(GATE* gate) {
+	return sizeof(T) * gate->nvals;
+}
+
 template<typename T>
 void ArithSharing<T>::InstantiateGate(GATE* gate) {
 	gate->instantiated = true;
-	gate->gs.aval = (UGATE_T*) calloc(sizeof(T), gate->nvals);
+	gate->gs.aval = (UGATE_T*) AllocGateValue(gate, sizeof(T) * gate->nvals);
 }
 
 template<typename T>
@@ -1137,6 +1431,8 @@ void ArithSharing<T>::Reset() {
 		m_vResB[i].delCBitVector();
 	}
 
+	DeleteMatMTs();
+
 	m_vInputShareSndBuf.delCBitVector();
 	m_vOutputShareSndBuf.delCBitVector();
 
@@ -21,6 +21,7 @@
 
 #include "sharing.h"
 #include <algorithm>
+#include <map>
 #include "../circuit/arithmeticcircuits.h"
 
 //#define DEBUGARITH
@@ -33,7 +34,8 @@ class ArithSharing: public Sharing {
 public:
 	/** Constructor of the class.*/
 	ArithSharing(e_sharing context, e_role role, uint32_t sharebitlen, ABYCircuit* circuit, crypto* crypt, e_mt_gen_alg mt_alg) :
-			Sharing(context, role, sharebitlen, circuit, crypt) {
+			Sharing(context, role, sharebitlen, circuit, crypt), m_bMTsFromPool(FALSE), m_mMatMTs(), m_vMatMulGates(), m_vMatOpenSnd(), m_vMatOpenRcv(),
+			m_nMatOpenStartIdx(0), m_nMatOpenIdx(0) {
 		m_eMTGenAlg = mt_alg;
 		Init();
 	}
@@ -62,6 +64,7 @@ public:
 	}
 
 	void InstantiateGate(GATE* gate);
+	uint64_t GetGateValueBytes(GATE* gate);
 
 	void GetDataToSend(std::vector<BYTE*>& sendbuf, std::vector<uint64_t>& bytesize);
 	void GetBuffersToReceive(std::vector<BYTE*>& rcvbuf, std::vector<uint64_t>& rcvbytes);
@@ -114,6 +117,7 @@ private:
 	e_mt_gen_alg m_eMTGenAlg;
 
 	uint32_t m_nMTs;
+	BOOL m_bMTsFromPool; //the MTs of this execution were taken from the pool of the setup phase
 	uint32_t m_nNumCONVs;
 
 	uint64_t m_nTypeBitMask;
@@ -158,6 +162,25 @@ private:
 	uint32_t m_nConvShareIdx; //the global
 	uint32_t m_nConvShareSndCtr; //counts for each round
 	uint32_t m_nConvShareRcvCtr;
+
+	/** Matrix multiplication triple (A, B, C = A * B) of a matrix multiplication gate */
+	typedef struct mat_mt_ctx {
+		mat_mul_gate dims{};
+		CBitVector A{}; //nrows x ninner values, the choices of the OTs as receiver
+		CBitVector B{}; //ninner x ncols values
+		CBitVector C{}; //nrows x ncols values
+		CBitVector Bexp{}; //the row j of B for each value (i, j) of A, the input of the OTs as sender
+		CBitVector Csnd{}; //output of the OTs as sender, ncols values for each value of A
+		CBitVector S{}; //output of the OTs as receiver, ncols values for each value of A
+		uint64_t openidx = 0; //position of X - A and Y - B in the matrix opening buffers
+	} mat_mt;
+
+	std::map<uint32_t, mat_mt*> m_mMatMTs; //matrix multiplication triples by gate id
+	std::vector<uint32_t> m_vMatMulGates;
+	CBitVector m_vMatOpenSnd; //X - A and Y - B of all matrix multiplication gates
+	CBitVector m_vMatOpenRcv;
+	uint64_t m_nMatOpenStartIdx;
+	uint64_t m_nMatOpenIdx;
 	/**
 	 Share Values
 	 \param 	gate 	Object of class Gate
@@ -183,6 +206,18 @@ private:
 	 \param gate 	Gate Object
 	 */
 	void SelectiveOpen(GATE* gate);
+	/**
+	 \param gate 	MUL or dot-product gate
+	 \return Number of MTs that the gate uses, which for a dot-product gate is the number of values of its inputs
+	 */
+	uint32_t GetNumMULs(GATE* gate) {
+		return gate->type == G_NON_LIN_DOT ? m_pGates[gate->ingates.inputs.twin.left].nvals : gate->nvals;
+	}
+	/**
+	 Method for the selective open of a matrix multiplication gate, which opens X - A and Y - B of its triple.
+	 \param gateid 	Identifier of the matrix multiplication gate
+	 */
+	void SelectiveOpenMatrix(uint32_t gateid);
 	/**
 	 Method for Evaluating MTs.
 	 */
@@ -211,6 +246,10 @@ private:
 	 Method for evaluating Multiplication Gate
 	 */
 	void EvaluateMULGate();
+	/**
+	 Method for evaluating the matrix multiplication gates of the current layer from the opened X - A and Y - B
+	 */
+	void EvaluateMatMulGates();
 
 	/**
 	 Method for assigning conversion shares.
@@ -235,7 +274,34 @@ private:
 	 Method for initialising MTs.
 	 */
 	void InitMTs();
+	/**
+	 Method for creating the matrix multiplication triples and adding the OTs that compute them
+	 \param setup	Setup object the OT tasks are added to
+	 */
+	void InitMatMTs(ABYSetup* setup);
+	/**
+	 Method for computing C of the matrix multiplication triples from the OT outputs
+	 */
+	void ComputeMatMTsFromOTs();
+	/**
+	 Method for deleting the matrix multiplication triples
+	 */
+	void DeleteMatMTs();
 
+	/**
+	 Method for describing the MTs as a section of the MT store
+	 \param section	Is set to the bit-length, size and buffers of the MTs
+	 */
+	void GetMTStoreSection(mt_store_section* section);
+	/**
+	 Method for appending the MTs to the MT store
+	 */
+	void StoreMTsToStore();
+	/**
+	 Method for taking the MTs from the MT store
+	 \return TRUE if the store held enough MTs for this circuit
+	 */
+	BOOL ReadMTsFromStore();
 	/**
 	 Method for computing MTs from OTs
 	 */
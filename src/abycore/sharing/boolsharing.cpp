@@ -16,10 +16,52 @@
  \brief		Bool sharing class implementation.
  */
 #include "boolsharing.h"
+#include "mtstore.h"
 #include "../aby/abysetup.h"
+#include <ENCRYPTO_utils/thread.h>
+
+class BoolSharing::CLocalThread: public CThread {
+public:
+	CLocalThread(uint32_t id, BoolSharing* callback) :
+			threadid(id), m_pCallback(callback), m_evt(), m_eJob(e_Local_Undefined) {
+	};
+	~CLocalThread() {
+	}
+	CLocalThread(const CLocalThread&) = delete;
+	CLocalThread& operator=(const CLocalThread&) = delete;
+
+	void PutJob(ELocalJobType e) {
+		m_eJob = e;
+		m_evt.Set();
+	}
+
+	void ThreadMain();
+	uint32_t threadid;
+	BoolSharing* m_pCallback;
+	CEvent m_evt;
+	ELocalJobType m_eJob;
+};
+
+void BoolSharing::CLocalThread::ThreadMain() {
+	for (;;) {
+		m_evt.Wait();
+
+		switch (m_eJob) {
+		case e_Local_Stop:
+			return;
+		case e_Local_Evaluate:
+			m_pCallback->EvaluateLocalRunChunks();
+			break;
+		case e_Local_Undefined:
+		default:
+			std::cerr << "Error: Unhandled Local Evaluation Thread Job!" << std::endl;
+		}
 
+		m_pCallback->LocalThreadDone();
+	}
+}
 
-void BoolSharing::Init() {
+void BoolSharing::Init(uint32_t nthreads) {
 
 	m_nTotalNumMTs = 0;
 	m_nXORGates = 0;
@@ -41,6 +83,33 @@ void BoolSharing::Init() {
 	m_nSIMDTime = 0;
 	m_nXORTime = 0;
 #endif
+
+	//The calling thread evaluates a part of each run as well, hence nthreads-1 additional threads are started
+	m_evtLocalRun = new CEvent();
+	m_lockLocalRun = new CLock();
+	m_lockLocalUsedGate = new CLock();
+#ifndef BENCHBOOLTIME //the timings of the gates are only measured for a single thread
+	if (nthreads > 1) {
+		m_vLocalThreads.resize(nthreads - 1);
+		for (uint32_t i = 0; i < nthreads - 1; i++) {
+			m_vLocalThreads[i] = new CLocalThread(i, this);
+			m_vLocalThreads[i]->Start();
+		}
+	}
+#endif
+}
+
+BoolSharing::~BoolSharing() {
+	Reset();
+	delete m_cBoolCircuit;
+	for (size_t i = 0; i < m_vLocalThreads.size(); i++) {
+		m_vLocalThreads[i]->PutJob(e_Local_Stop);
+		m_vLocalThreads[i]->Wait();
+		delete m_vLocalThreads[i];
+	}
+	delete m_evtLocalRun;
+	delete m_lockLocalRun;
+	delete m_lockLocalUsedGate;
 }
 
 //Pre-set values for new layer
@@ -81,17 +150,6 @@ void BoolSharing::PrepareSetupPhase(ABYSetup* setup) {
 	m_nNumANDSizes = m_cBoolCircuit->GetANDs(m_vANDs);
 
 
-	/**Checking the role of the executor. Based on the role a specific file is selected.*/
-	//TODO use strings
-	char filename[21];
-	if(m_eRole == SERVER) {
-		strcpy(filename, "pre_comp_server.dump");
-	}
-	else {
-		strcpy(filename, "pre_comp_client.dump");
-	}
-
-
 	m_nTotalNumMTs = 0;
 	m_nNumMTs.resize(m_nNumANDSizes);
 	for (uint32_t i = 0; i < m_nNumANDSizes; i++) {
@@ -107,14 +165,24 @@ void BoolSharing::PrepareSetupPhase(ABYSetup* setup) {
 	InitializeMTs();
 
 	/**
-		Checking if the precomputation mode is READ. If so, checking if the circuit size configured is
-		within the provided specification of the precomputation values stored in the file.
-		If it not within the spec, reverting to default mode.
+		Checking if the precomputation mode is READ. If so, the MTs are taken from the store, such that no OTs
+		are needed. If the store does not hold enough MTs for this circuit, reverting to default mode.
 	*/
-	if((GetPreCompPhaseValue()==ePreCompRead)&&(!isCircuitSizeLessThanOrEqualWithValueFromFile(filename, m_nNumANDSizes))) {
+	if((GetPreCompPhaseValue()==ePreCompRead)&&(m_nTotalNumMTs > 0)&&(!ReadMTsFromStore())) {
 			SetPreCompPhaseValue(ePreCompDefault);
 	}
 
+	/**
+		In the default mode, the MTs are taken from the pool of the setup phase if it holds enough of them.
+		The MTs that are generated with KK OTs need their temporary values, hence they are always computed.
+	*/
+	m_bMTsFromPool = FALSE;
+#ifndef USE_KK_OT_FOR_MT
+	if((GetPreCompPhaseValue()==ePreCompDefault)&&(m_nTotalNumMTs > 0)) {
+		m_bMTsFromPool = TakeMTsFromPool(setup);
+	}
+#endif
+
 
 
 	/*
@@ -142,7 +210,7 @@ void BoolSharing::PrepareSetupPhaseMTs(ABYSetup* setup) {
 		   If the precomputation is READ or in Reading phase when in RAM mode, the MTs doesn't need to be
 		   computed again and therefore following check is done.
 	 */
-	if((GetPreCompPhaseValue() != ePreCompRead)&&(GetPreCompPhaseValue() != ePreCompRAMRead)) {
+	if((GetPreCompPhaseValue() != ePreCompRead)&&(GetPreCompPhaseValue() != ePreCompRAMRead)&&(!m_bMTsFromPool)) {
 
 #ifdef USE_KK_OT_FOR_MT
 		for (uint32_t j = 0; j < 2; j++) {
@@ -565,69 +633,168 @@ void BoolSharing::ComputeMTs() {
 }
 
 void BoolSharing::EvaluateLocalOperations(uint32_t depth) {
-	std::deque<uint32_t> localops = m_cBoolCircuit->GetLocalQueueOnLvl(depth);
+	const std::vector<uint32_t>& localops = m_cBoolCircuit->GetLocalQueueOnLvl(depth);
 	GATE* gate;
+
+	for (uint32_t i = 0; i < localops.size(); i++) {
+		gate = m_pGates + localops[i];
+
+		//Gates that only read their parents are collected into a run, which is evaluated by all threads. Local gates
+		//on the same level can depend on each other, hence a gate that reads a gate of the run ends it.
+		if (m_vLocalThreads.size() > 0 && IsParallelLocalGate(gate)) {
+			if (m_vLocalRun.size() > 0 && DependsOnLocalRun(gate)) {
+				EvaluateLocalRun();
+			}
+			m_vLocalRun.push_back(localops[i]);
+		} else {
+			EvaluateLocalRun();
+			EvaluateLocalGate(localops[i]);
+		}
+	}
+	EvaluateLocalRun();
+}
+
+void BoolSharing::EvaluateLocalGate(uint32_t gateid) {
+	GATE* gate = m_pGates + gateid;
 #ifdef BENCHBOOLTIME
 	timespec tstart, tend;
 #endif
-	for (uint32_t i = 0; i < localops.size(); i++) {
-		gate = m_pGates + localops[i];
 
 #ifdef DEBUGBOOL
-		std::cout << "Evaluating local gate with id = " << localops[i] << " and type " << get_gate_type_name(gate->type) << std::endl;
+	std::cout << "Evaluating local gate with id = " << gateid << " and type " << get_gate_type_name(gate->type) << std::endl;
 #endif
 
-		switch (gate->type) {
-		case G_LIN:
+	switch (gate->type) {
+	case G_LIN:
 #ifdef BENCHBOOLTIME
-			clock_gettime(CLOCK_MONOTONIC, &tstart);
+		clock_gettime(CLOCK_MONOTONIC, &tstart);
 #endif
-			EvaluateXORGate(localops[i]);
+		EvaluateXORGate(gateid);
 #ifdef BENCHBOOLTIME
-			clock_gettime(CLOCK_MONOTONIC, &tend);
-			m_nXORTime += getMillies(tstart, tend);
+		clock_gettime(CLOCK_MONOTONIC, &tend);
+		m_nXORTime += getMillies(tstart, tend);
 #endif
-			break;
-		case G_CONSTANT:
-			EvaluateConstantGate(localops[i]);
-			break;
-		case G_INV:
-			EvaluateINVGate(localops[i]);
-			break;
-		case G_CONV:
-			EvaluateCONVGate(localops[i]);
-			break;
-		case G_SHARED_OUT:
-			InstantiateGate(gate);
-			memcpy(gate->gs.val, ((GATE*) m_pGates + gate->ingates.inputs.parent)->gs.val, bits_in_bytes(gate->nvals));
-			UsedGate(gate->ingates.inputs.parent);
-			break;
-		case G_SHARED_IN:
-			break;
-		case G_CALLBACK:
-			EvaluateCallbackGate(localops[i]);
-			break;
-		case G_PRINT_VAL:
-			EvaluatePrintValGate(localops[i], C_BOOLEAN);
-			break;
-		case G_ASSERT:
-			EvaluateAssertGate(localops[i], C_BOOLEAN);
-			break;
-		default:
-			if (IsSIMDGate(gate->type)) {
-				EvaluateSIMDGate(localops[i]);
-			} else {
-				std::cerr << "Boolsharing: Non-interactive Operation not recognized: " << (uint32_t) gate->type
-						<< "(" << get_gate_type_name(gate->type) << "), stopping execution" << std::endl;
-				exit(0);
-			}
-			break;
+		break;
+	case G_CONSTANT:
+		EvaluateConstantGate(gateid);
+		break;
+	case G_INV:
+		EvaluateINVGate(gateid);
+		break;
+	case G_CONV:
+		EvaluateCONVGate(gateid);
+		break;
+	case G_SHARED_OUT:
+		InstantiateGate(gate);
+		memcpy(gate->gs.val, ((GATE*) m_pGates + gate->ingates.inputs.parent)->gs.val, bits_in_bytes(gate->nvals));
+		UsedGate(gate->ingates.inputs.parent);
+		break;
+	case G_SHARED_IN:
+		break;
+	case G_CALLBACK:
+		EvaluateCallbackGate(gateid);
+		break;
+	case G_PRINT_VAL:
+		EvaluatePrintValGate(gateid, C_BOOLEAN);
+		break;
+	case G_ASSERT:
+		EvaluateAssertGate(gateid, C_BOOLEAN);
+		break;
+	default:
+		if (IsSIMDGate(gate->type)) {
+			EvaluateSIMDGate(gateid);
+		} else {
+			std::cerr << "Boolsharing: Non-interactive Operation not recognized: " << (uint32_t) gate->type
+					<< "(" << get_gate_type_name(gate->type) << "), stopping execution" << std::endl;
+			exit(0);
+		}
+		break;
+	}
+}
+
+BOOL BoolSharing::IsParallelLocalGate(GATE* gate) {
+	return gate->type == G_LIN || gate->type == G_INV || gate->type == G_CONSTANT || IsSIMDGate(gate->type);
+}
+
+BOOL BoolSharing::DependsOnLocalRun(GATE* gate) {
+	//the gates of the run are instantiated once they are evaluated
+	switch (gate->type) {
+	case G_CONSTANT:
+		return false;
+	case G_LIN:
+		return !m_pGates[gate->ingates.inputs.twin.left].instantiated || !m_pGates[gate->ingates.inputs.twin.right].instantiated;
+	case G_INV:
+	case G_SPLIT:
+	case G_REPEAT:
+	case G_SUBSET:
+		return !m_pGates[gate->ingates.inputs.parent].instantiated;
+	default:
+		//G_COMBINE, G_PERM, G_COMBINEPOS and G_STRUCT_COMBINE read an array of parents
+		for (uint32_t i = 0; i < gate->ingates.ningates; i++) {
+			if (!m_pGates[gate->ingates.inputs.parents[i]].instantiated)
+				return true;
+		}
+		return false;
+	}
+}
+
+void BoolSharing::EvaluateLocalRun() {
+	if (m_vLocalRun.size() < MIN_PARALLEL_LOCAL_GATES) {
+		//small runs are not worth the synchronization with the threads
+		for (uint32_t i = 0; i < m_vLocalRun.size(); i++) {
+			EvaluateLocalGate(m_vLocalRun[i]);
+		}
+	} else {
+		//gates of the run can share parents, hence releasing them has to be serialized
+		m_lockUsedGate = m_lockLocalUsedGate;
+		m_nLocalRunCtr = 0;
+		m_nWorkingLocalThreads = m_vLocalThreads.size();
+		for (uint32_t i = 0; i < m_vLocalThreads.size(); i++) {
+			m_vLocalThreads[i]->PutJob(e_Local_Evaluate);
 		}
+		EvaluateLocalRunChunks();
+		for (;;) {
+			m_lockLocalRun->Lock();
+			uint32_t n = m_nWorkingLocalThreads;
+			m_lockLocalRun->Unlock();
+			if (!n)
+				break;
+			m_evtLocalRun->Wait();
+		}
+		m_lockUsedGate = NULL;
 	}
+	m_vLocalRun.clear();
+}
+
+void BoolSharing::EvaluateLocalRunChunks() {
+	uint32_t start, end;
+	for (;;) {
+		//threads that finish early take the next chunk, which balances gates with different numbers of values
+		m_lockLocalRun->Lock();
+		start = m_nLocalRunCtr;
+		end = std::min(start + LOCAL_GATE_CHUNK_SIZE, (uint32_t) m_vLocalRun.size());
+		m_nLocalRunCtr = end;
+		m_lockLocalRun->Unlock();
+
+		if (start >= end)
+			return;
+		for (uint32_t i = start; i < end; i++) {
+			EvaluateLocalGate(m_vLocalRun[i]);
+		}
+	}
+}
+
+void BoolSharing::LocalThreadDone() {
+	m_lockLocalRun->Lock();
+	uint32_t n = --m_nWorkingLocalThreads;
+	m_lockLocalRun->Unlock();
+
+	if (!n)
+		m_evtLocalRun->Set();
 }
 
 void BoolSharing::EvaluateInteractiveOperations(uint32_t depth) {
-	std::deque<uint32_t> interactiveops = m_cBoolCircuit->GetInteractiveQueueOnLvl(depth);
+	const std::vector<uint32_t>& interactiveops = m_cBoolCircuit->GetInteractiveQueueOnLvl(depth);
 
 	for (uint32_t i = 0; i < interactiveops.size(); i++) {
 		GATE* gate = m_pGates + interactiveops[i];
@@ -944,7 +1111,9 @@ void BoolSharing::EvaluateMTs() {
 			uint64_t startposstringbytes = startposbytes * m_vANDs[i].bitlen;
 			uint64_t lenbytes = ceil_divide(len, 8);
 			uint64_t stringbytelen = ceil_divide(m_vANDs[i].bitlen * len, 8);
+#ifdef DEBUGBOOL
 			uint64_t mtbytelen = ceil_divide(m_vANDs[i].bitlen, 8);
+#endif
 
 
 		/*	std::cout << "lenbytes = " << lenbytes << ", stringlen = " << stringbytelen << ", mtbytelen = " << mtbytelen <<
@@ -988,31 +1157,10 @@ void BoolSharing::EvaluateMTs() {
 				m_vResA[i].ANDBytes(m_vE_snd[i].GetArr() + startposbytes, startposbytes, lenbytes);
 				m_vResB[i].ANDBytes(m_vD_snd[i].GetArr() + startposbytes, startposbytes, lenbytes);
 			} else {
-				if((m_vANDs[i].bitlen & 0x07) == 0) {
-					for (uint32_t j = 0; j < len; j++) {
-						if (m_vA[i].GetBitNoMask(j + startpos)) { //a * e
-							m_vResA[i].SetBytes(m_vE_snd[i].GetArr() + startposstringbytes + j * mtbytelen,
-									startposstringbytes + j * mtbytelen, mtbytelen);
-						}
-						if (m_vD_snd[i].GetBitNoMask(j + startpos)) { //d * b
-							m_vResB[i].SetBytes(m_vB[i].GetArr() + startposstringbytes + j * mtbytelen,
-									startposstringbytes + j * mtbytelen, mtbytelen);
-						}
-					}
-				} else {
-					uint8_t* tmp = (uint8_t*) malloc(ceil_divide(m_vANDs[i].bitlen, 8));
-					for (uint32_t j = 0; j < len; j++) {
-						if (m_vA[i].GetBitNoMask(j + startpos)) { //a * e
-							m_vE_snd[i].GetBits(tmp, startposstringbits + j*m_vANDs[i].bitlen, m_vANDs[i].bitlen);
-							m_vResA[i].SetBits(tmp, startposstringbits + j*m_vANDs[i].bitlen, m_vANDs[i].bitlen);
-						}
-						if (m_vD_snd[i].GetBitNoMask(j + startpos)) { //d * b
-							m_vB[i].GetBits(tmp, startposstringbits + j*m_vANDs[i].bitlen, m_vANDs[i].bitlen);
-							m_vResB[i].SetBits(tmp, startposstringbits + j*m_vANDs[i].bitlen, m_vANDs[i].bitlen);
-						}
-					}
-					free(tmp);
-				}
+				ExpandVecANDChoices(m_vA[i], startpos, len, m_vANDs[i].bitlen, m_vVecANDMaskA);
+				ExpandVecANDChoices(m_vD_snd[i], startpos, len, m_vANDs[i].bitlen, m_vVecANDMaskD);
+				SelectVecANDStrings(m_vE_snd[i], m_vVecANDMaskA, m_vResA[i], startposstringbits, m_vANDs[i].bitlen * len); //a * e
+				SelectVecANDStrings(m_vB[i], m_vVecANDMaskD, m_vResB[i], startposstringbits, m_vANDs[i].bitlen * len); //d * b
 			}
 
 			m_vResA[i].XORBytes(m_vResB[i].GetArr() + startposstringbytes, startposstringbytes, stringbytelen);
@@ -1023,27 +1171,8 @@ void BoolSharing::EvaluateMTs() {
 					m_vResB[i].Copy(m_vE_snd[i].GetArr() + startposbytes, startposbytes, lenbytes);
 					m_vResB[i].ANDBytes(m_vD_snd[i].GetArr() + startposbytes, startposbytes, lenbytes);
 				} else {
-					if((m_vANDs[i].bitlen & 0x07) == 0) {
-						for (uint32_t j = 0; j < len; j++) {
-							if (m_vD_snd[i].GetBitNoMask(j + startpos)) { //d * e
-								m_vResB[i].SetBytes(m_vE_snd[i].GetArr() + startposstringbytes + j * mtbytelen,
-										startposstringbytes + j * mtbytelen, mtbytelen);
-							}
-						}
-					} else {
-						uint8_t* tmp = (uint8_t*) malloc(ceil_divide(m_vANDs[i].bitlen, 8));
-						for (uint32_t j = 0; j < len; j++) {
-							if (m_vD_snd[i].GetBitNoMask(j + startpos)) { //d * e
-								//uint64_t tmp = m_vE_snd[i].Get<uint64_t>(startposstringbits + j*m_vANDs[i].bitlen, m_vANDs[i].bitlen);
-								m_vE_snd[i].GetBits(tmp, startposstringbits + j*m_vANDs[i].bitlen, m_vANDs[i].bitlen);
-								//m_vResB[i].Set<uint64_t>(tmp, startposstringbits + j*m_vANDs[i].bitlen, m_vANDs[i].bitlen);
-								m_vResB[i].SetBits(tmp, startposstringbits + j*m_vANDs[i].bitlen, m_vANDs[i].bitlen);
-								//m_vResB[i].SetBitsPosOffset(m_vE_snd[i].GetArr(), startposstringbits + j * m_vANDs[i].bitlen,
-								//		startposstringbits + j * m_vANDs[i].bitlen, m_vANDs[i].bitlen);
-							}
-						}
-						free(tmp);
-					}
+					//the choice bits of D were already expanded for d * b
+					SelectVecANDStrings(m_vE_snd[i], m_vVecANDMaskD, m_vResB[i], startposstringbits, m_vANDs[i].bitlen * len); //d * e
 				}
 				m_vResA[i].XORBytes(m_vResB[i].GetArr() + startposstringbytes, startposstringbytes, stringbytelen);
 			}
@@ -1051,6 +1180,46 @@ void BoolSharing::EvaluateMTs() {
 	}
 }
 
+void BoolSharing::ExpandVecANDChoices(CBitVector& choices, uint64_t startpos, uint64_t len, uint32_t bitlen, std::vector<UGATE_T>& mask) {
+	uint64_t offset = (startpos * bitlen) & 0x07;
+	mask.assign(ceil_divide(offset + len * bitlen, GATE_T_BITS), 0);
+	UGATE_T* maskptr = mask.data();
+
+	for (uint64_t j = 0, pos = offset; j < len; j++) {
+		//all ones if the choice bit is set, all zeros otherwise, which avoids branching on the choice bits
+		UGATE_T fill = ((UGATE_T) 0) - (UGATE_T) choices.GetBitNoMask(startpos + j);
+		for (uint64_t bitstofill = bitlen, wordbits; bitstofill > 0; bitstofill -= wordbits, pos += wordbits) {
+			wordbits = std::min(bitstofill, (uint64_t) (GATE_T_BITS - (pos % GATE_T_BITS)));
+			UGATE_T wordmask = (wordbits == GATE_T_BITS) ? ~((UGATE_T) 0) : ((((UGATE_T) 1) << wordbits) - 1) << (pos % GATE_T_BITS);
+			maskptr[pos / GATE_T_BITS] |= fill & wordmask;
+		}
+	}
+}
+
+void BoolSharing::SelectVecANDStrings(CBitVector& vals, std::vector<UGATE_T>& mask, CBitVector& res, uint64_t startbit, uint64_t nbits) {
+	uint64_t offset = startbit & 0x07;
+	uint64_t nbytes = ceil_divide(offset + nbits, 8);
+	BYTE* resptr = res.GetArr() + (startbit >> 3);
+	BYTE* valptr = vals.GetArr() + (startbit >> 3);
+	BYTE* maskptr = (BYTE*) mask.data();
+
+	//the first and the last byte can contain bits that do not belong to the strings and are kept
+	BYTE firstmask = (BYTE) (0xFF << offset);
+	BYTE lastmask = ((offset + nbits) & 0x07) ? (BYTE) (0xFF >> (8 - ((offset + nbits) & 0x07))) : 0xFF;
+	if (nbytes == 1) {
+		firstmask &= lastmask;
+	}
+
+	resptr[0] = (resptr[0] & ~firstmask) | (valptr[0] & maskptr[0] & firstmask);
+	//plain loop over the inner bytes, which the compiler vectorizes
+	for (uint64_t k = 1; k + 1 < nbytes; k++) {
+		resptr[k] = valptr[k] & maskptr[k];
+	}
+	if (nbytes > 1) {
+		resptr[nbytes - 1] = (resptr[nbytes - 1] & ~lastmask) | (valptr[nbytes - 1] & maskptr[nbytes - 1] & lastmask);
+	}
+}
+
 void BoolSharing::EvaluateANDGate() {
 	GATE* gate;
 	for (uint32_t k = 0; k < m_nNumANDSizes; k++) {
@@ -1268,8 +1437,12 @@ void BoolSharing::GetBuffersToReceive(std::vector<BYTE*>& rcvbuf, std::vector<ui
 	}
 }
 
+uint64_t BoolSharing::GetGateValueBytes(GATE* gate) {
+	return ceil_divide(gate->nvals, GATE_T_BITS) * sizeof(UGATE_T);
+}
+
 inline void BoolSharing::InstantiateGate(GATE* gate) {
-	gate->gs.val = (UGATE_T*) calloc((ceil_divide(gate->nvals, GATE_T_BITS)), sizeof(UGATE_T));
+	gate->gs.val = (UGATE_T*) AllocGateValue(gate, ceil_divide(gate->nvals, GATE_T_BITS) * sizeof(UGATE_T));
 	gate->instantiated = true;
 }
 
@@ -1600,23 +1773,6 @@ void BoolSharing::Reset() {
 	if(!m_vOP_LUT_SelOpeningBitCtr.empty()) {
 		m_vOP_LUT_SelOpeningBitCtr.clear();
 	}
-
-	/**Checking the role and and deciding upon the file to be deleted if the precomputation values are
-	  completely used up in a Precomputation READ mode.*/
-	if(m_eRole == SERVER) {
-		if((FileExists((char*)"pre_comp_server.dump"))&&(m_nFilePos >=
-                        FileSize((char*)"pre_comp_server.dump"))&&(GetPreCompPhaseValue() == ePreCompRead)) {
-			remove((char*)"pre_comp_server.dump");
-			m_nFilePos = -1;
-		}
-	}
-	else  {
-		if((FileExists((char*)"pre_comp_client.dump"))&&(m_nFilePos >=
-                        FileSize((char*)"pre_comp_client.dump"))&&(GetPreCompPhaseValue() == ePreCompRead)) {
-			remove((char*)"pre_comp_client.dump");
-			m_nFilePos = -1;
-		}
-	}
 }
 
 /**Pre-computations*/
@@ -1625,192 +1781,78 @@ void BoolSharing::PreComputationPhase() {
 	/**Obtaining the precomputation mode value*/
 	ePreCompPhase phase_value = GetPreCompPhaseValue();
 
-	/**Decision of the precomputation file based on the role of executor.*/
-	char filename[50];
-	if(m_eRole == SERVER) {
-		strcpy(filename, "pre_comp_server.dump");
-	}
-	else {
-		strcpy(filename, "pre_comp_client.dump");
-	}
-
-	/**Check if the precomputation mode is in RAM Reading phase*/
-	if(phase_value == ePreCompRAMRead) {
+	/**
+		Check if the precomputation mode is in RAM Reading phase or in READ mode. In READ mode, the MTs were
+		already taken from the store in PrepareSetupPhase, the same holds for MTs that were taken from the pool.
+	*/
+	if((phase_value == ePreCompRAMRead)||((phase_value == ePreCompRead)&&(m_nTotalNumMTs > 0))||m_bMTsFromPool) {
 		return;
 	}
-	/**Check if the execution is non-Read mode or if the file to be used in READ mode doesn't exist*/
-	else if((phase_value != ePreCompRead)||(!FileExists(filename))) {
-		/**Compute the MTs normally*/
-		ComputeMTs();
-		/**Check if the mode of precomputation is store. If so store it to respective file.*/
-		if(phase_value == ePreCompStore) {
-			StoreMTsToFile(filename);
-		}
-		/**
-			Check if precompution mode is in RAM writing phase. If so, change it to RAM reading phase
-			since, the write phase mainly comprises of computation of MTs in their respective vectors.
-		*/
-		else if(phase_value == ePreCompRAMWrite) {
-			SetPreCompPhaseValue(ePreCompRAMRead);
-		}
+	/**Compute the MTs normally*/
+	ComputeMTs();
+	/**Check if the mode of precomputation is store. If so store it to the MT store.*/
+	if(phase_value == ePreCompStore) {
+		StoreMTsToStore();
 	}
-	/**This condition is activated once READ mode is persistent and execution of the mode is possible.*/
-	else {
-		ReadMTsFromFile(filename);
-	}
-}
-
-void BoolSharing::StoreMTsToFile(char *filename) {
-
-
-	FILE *fp;
-
 	/**
-		Condition to check if the file already exists. If so then, the mode of write would
-		be file append.
+		Check if precompution mode is in RAM writing phase. If so, change it to RAM reading phase
+		since, the write phase mainly comprises of computation of MTs in their respective vectors.
 	*/
-	if(FileExists(filename)) {
-		fp = fopen(filename, "a+b");
-	}
-	else {
-		fp = fopen(filename, "wb");
+	else if(phase_value == ePreCompRAMWrite) {
+		SetPreCompPhaseValue(ePreCompRAMRead);
 	}
+}
 
-	/**Initially writing the NUMANDSizes corresponding to the number of AND gate Vectors.*/
-	fwrite(&m_nNumANDSizes, sizeof(uint32_t), 1, fp);
-
-	/**Writing the MTs and bytelen of the MTs o the file.*/
+void BoolSharing::GetMTStoreSections(std::vector<mt_store_section>& sections) {
+	sections.resize(m_nNumANDSizes);
 	for (uint32_t i = 0; i < m_nNumANDSizes; i++) {
-		uint32_t andbytelen = ceil_divide(m_nNumMTs[i], 8);
-		uint32_t stringbytelen = ceil_divide(m_nNumMTs[i] * m_vANDs[i].bitlen, 8);
-		fwrite(&andbytelen, sizeof(uint32_t), 1, fp);
-		fwrite(m_vA[i].GetArr(), andbytelen, 1, fp);
-		fwrite(m_vB[i].GetArr(), andbytelen, 1, fp);
-		fwrite(m_vC[i].GetArr(), andbytelen, 1, fp);
-
+		sections[i].bitlen = m_vANDs[i].bitlen;
+		sections[i].nmts = m_nNumMTs[i];
+		sections[i].abytes = ceil_divide(m_nNumMTs[i], 8);
+		sections[i].bcbytes = ceil_divide(m_nNumMTs[i] * m_vANDs[i].bitlen, 8);
+		sections[i].A = m_vA[i].GetArr();
+		sections[i].B = m_vB[i].GetArr();
+		sections[i].C = m_vC[i].GetArr();
 	}
-	/**Closing the file pointer.*/
-	fclose(fp);
 }
 
-void BoolSharing::ReadMTsFromFile(char *filename) {
-
-	FILE *fp;
-	/**Calculate the file size*/
-	uint64_t file_size = FileSize(filename);
-
-	/**Variable for the storing the NUMANDSizes value from the file.*/
-	uint32_t num_and_sizes;
-
-	/**Opening the file in read mode.*/
-	fp = fopen(filename, "rb");
-	/**BYTE pointer used as a buffer to read from the file.*/
-	BYTE *ptr;
-	/**Seek the file pointer to the location of the last read position.*/
-	if(fseek(fp, m_nFilePos, SEEK_SET))
-            std::cout << "Error occured in fseek" << std::endl;
-	/**Reading the num and sizes from the file.*/
-	if(!fread(&num_and_sizes, sizeof(uint32_t), 1, fp))
-            std::cout << "Error occured in fread" << std::endl;;
-	for (uint32_t i = 0; i < m_nNumANDSizes; i++) {
+void BoolSharing::StoreMTsToStore() {
+	std::vector<mt_store_section> sections;
+	GetMTStoreSections(sections);
 
-		/**Calculating the required ANDGatelength in bytes for the provided circuit configuration.*/
-		uint32_t andbytelen = ceil_divide(m_nNumMTs[i], 8);
-		uint32_t org_andbytelen;
-		uint32_t stringbytelen = ceil_divide(m_nNumMTs[i] * m_vANDs[i].bitlen, 8);
-
-		/**Reading the ANDGate length in bytes from file.*/
-		if(!fread(&org_andbytelen, sizeof(uint32_t), 1, fp))
-                    std::cout << "Error occured in fread" << std::endl;
-
-		/**Allocating the memory for the BYTE pointer with the read ANDGate lenght size from the file.*/
-		ptr = (BYTE*)malloc(org_andbytelen*sizeof(BYTE));
-
-		/**
-			If unequal means the bytes should be read from the file with original byte size else if
-			the configured size.
-		*/
-		if(org_andbytelen != andbytelen) {
-
-			if(!fread(ptr, org_andbytelen, 1, fp))
-                            std::cout << "Error occured in fread" << std::endl;
-			m_vA[i].Copy(ptr, 0, andbytelen);
-			if(!fread(ptr, org_andbytelen, 1, fp))
-                            std::cout << "Error occured in fread" << std::endl;
-			m_vB[i].Copy(ptr, 0, andbytelen);
-			if(!fread(ptr, org_andbytelen, 1, fp))
-                                std::cout << "Error occured in fread" << std::endl;
-			m_vC[i].Copy(ptr, 0, andbytelen);
-		}
-		else {
-			if(!fread(ptr, andbytelen, 1, fp))
-                            std::cout << "Error occured in fread" << std::endl;
-			m_vA[i].Copy(ptr, 0, andbytelen);
-			if(!fread(ptr, andbytelen, 1, fp))
-                                std::cout << "Error occured in fread" << std::endl;
-			m_vB[i].Copy(ptr, 0, andbytelen);
-			if(!fread(ptr, andbytelen, 1, fp))
-                            std::cout << "Error occured in fread" << std::endl;
-			m_vC[i].Copy(ptr, 0, andbytelen);
-		}
-		m_vD_snd[i].Copy(m_vA[i].GetArr(), 0, andbytelen);
-		m_vE_snd[i].Copy(m_vB[i].GetArr(), 0, stringbytelen);
-
-	}
-
-	/**Storing the current file pointer position for next iteration use of the circuit setup.*/
-	m_nFilePos = ftell(fp);
-	/**Closing the file.*/
-	fclose(fp);
+	MTStore store(m_eRole);
+	store.Append(m_eContext, sections);
 }
 
-BOOL BoolSharing::isCircuitSizeLessThanOrEqualWithValueFromFile(char *filename, uint32_t in_circ_size) {
+BOOL BoolSharing::ReadMTsFromStore() {
+	std::vector<mt_store_section> sections;
+	GetMTStoreSections(sections);
 
-	/**Check if the file already exists and if the existing is empty. If so, return false.*/
-	if(!FileExists(filename)||FileEmpty(filename)) {
-		/**Returning false and reverting the precomputation mode to default.*/
+	MTStore store(m_eRole);
+	if(!store.Read(m_eContext, sections)) {
 		return FALSE;
 	}
 
-	/**Opening the precomputation file in read mode.*/
-	FILE *fp = fopen(filename, "rb");
+	/**Pre-store the values in A and B in D_snd and E_snd*/
+	for (uint32_t i = 0; i < m_nNumANDSizes; i++) {
+		m_vD_snd[i].Copy(m_vA[i].GetArr(), 0, sections[i].abytes);
+		m_vE_snd[i].Copy(m_vB[i].GetArr(), 0, sections[i].bcbytes);
+	}
+	return TRUE;
+}
 
-	uint32_t circ_size_in_file, andbytelen_in_file;
+BOOL BoolSharing::TakeMTsFromPool(ABYSetup* setup) {
+	std::vector<mt_store_section> sections;
+	GetMTStoreSections(sections);
 
-	/**Reading the circuit size mainly the NUMAndGate vector size*/
-	if(!fread(&circ_size_in_file, sizeof(uint32_t), 1, fp))
-            std::cout << "Error occured in fread" << std::endl;
-	/**Checking if they are unequal.*/
-	if(circ_size_in_file != in_circ_size) {
-		/**Returning false and reverting the precomputation mode to default.*/
+	if(!setup->TakeFromPool(m_eContext, sections)) {
 		return FALSE;
 	}
-	/**
-	 Checking the byte length of the MTs in the file with the required size.
-	 If it is value in the file is less than the required then, the precomputation
-	 mode is reverted to defaut.
-	*/
-	for (uint32_t i = 0; i < circ_size_in_file; i++) {
-		/**Calculating the AND gate length in bytes for the provided circuit configuration.*/
-		uint32_t andbytelen = ceil_divide(m_nNumMTs[i], 8);
-		/**Reading the AND gate length in bytes from the file.*/
-		if(!fread(&andbytelen_in_file, sizeof(uint32_t), 1, fp))
-                    std::cout << "Error occured in fread" << std::endl;
-		uint32_t traverseMT_size_in_file = andbytelen_in_file*3;
 
-		/**Shifting through the MTs based on the ANDGate size in byte length.*/
-		fseek(fp, (ftell(fp) + traverseMT_size_in_file), SEEK_SET);
-
-		/**Checking if the condition of size of byte length in file is lower than byte length required.*/
-		if(andbytelen > andbytelen_in_file) {
-
-			/**Close the file*/
-			fclose(fp);
-			/**Returning false and reverting the precomputation mode to default.*/
-			return FALSE;
-		}
+	/**Pre-store the values in A and B in D_snd and E_snd*/
+	for (uint32_t i = 0; i < m_nNumANDSizes; i++) {
+		m_vD_snd[i].Copy(m_vA[i].GetArr(), 0, sections[i].abytes);
+		m_vE_snd[i].Copy(m_vB[i].GetArr(), 0, sections[i].bcbytes);
 	}
-	/**Close the file*/
-	fclose(fp);
 	return TRUE;
 }
@@ -28,9 +28,23 @@
 #include <ENCRYPTO_utils/cbitvector.h>
 
 class XORMasking;
+class CEvent;
+class CLock;
 
 //#define DEBUGBOOL
 //#define BENCHBOOLTIME
+
+/**
+ \def 	MIN_PARALLEL_LOCAL_GATES
+ \brief	Minimum number of independent local gates of a level for which the evaluation is distributed to the threads
+ */
+#define MIN_PARALLEL_LOCAL_GATES 1024
+
+/**
+ \def 	LOCAL_GATE_CHUNK_SIZE
+ \brief	Number of local gates a thread takes from the shared run at once
+ */
+#define LOCAL_GATE_CHUNK_SIZE 64
 /**
  BOOL SHARING - <DETAILED EXPLANATION PLEASE>
  */
@@ -50,19 +64,19 @@ typedef struct op_lut_precomp {
 class BoolSharing: public Sharing {
 
 public:
-	/** Constructor of the class.*/
-	BoolSharing(e_sharing context, e_role role, uint32_t sharebitlen, ABYCircuit* circuit, crypto* crypt) :\
+	/**
+	 Constructor of the class.
+	 \param nthreads	Number of threads that evaluate the independent local gates of a level
+	 */
+	BoolSharing(e_sharing context, e_role role, uint32_t sharebitlen, ABYCircuit* circuit, crypto* crypt, uint32_t nthreads = 1) :\
 
-			Sharing(context, role, sharebitlen, circuit, crypt) {
-		Init();
+			Sharing(context, role, sharebitlen, circuit, crypt), m_bMTsFromPool(FALSE), m_vVecANDMaskA(), m_vVecANDMaskD(), m_vLocalThreads(),
+			m_vLocalRun(), m_nLocalRunCtr(0), m_lockLocalRun(NULL), m_lockLocalUsedGate(NULL), m_evtLocalRun(NULL), m_nWorkingLocalThreads(0) {
+		Init(nthreads);
 	}
 	;
 	/** Destructor of the class.*/
-	~BoolSharing() {
-		Reset();
-		delete m_cBoolCircuit;
-	}
-	;
+	~BoolSharing();
 
 	//SUPER CLASS MEMBER FUNCTION
 	void PrepareSetupPhase(ABYSetup* setup);
@@ -78,6 +92,7 @@ public:
 	void PreComputationPhase();
 
 	inline void InstantiateGate(GATE* gate);
+	uint64_t GetGateValueBytes(GATE* gate);
 
 	void GetDataToSend(std::vector<BYTE*>& sendbuf, std::vector<uint64_t>& bytesize);
 	void GetBuffersToReceive(std::vector<BYTE*>& rcvbuf, std::vector<uint64_t>& rcvbytes);
@@ -117,6 +132,7 @@ public:
 private:
 
 	uint32_t m_nTotalNumMTs;
+	BOOL m_bMTsFromPool; //the MTs of this execution were taken from the pool of the setup phase
 	uint32_t m_nOPLUT_Tables;
 	std::vector<uint32_t> m_nNumMTs;
 	uint32_t m_nXORGates;
@@ -148,6 +164,8 @@ private:
 	std::vector<CBitVector> m_vResA;
 	std::vector<CBitVector> m_vResB;
 	non_lin_vec_ctx* m_vANDs;
+	std::vector<UGATE_T> m_vVecANDMaskA; //choice bits of A, each expanded to the bit-length of the vector AND MTs
+	std::vector<UGATE_T> m_vVecANDMaskD; //choice bits of D, each expanded to the bit-length of the vector AND MTs
 
 	//multiplication triple values A, B and C for use in KK OT ext. Are later written to m_vA, m_vB and mvC. m_vKKS is used for temporary results
 	std::vector<CBitVector> m_vKKA;
@@ -173,6 +191,20 @@ private:
 
 	BooleanCircuit* m_cBoolCircuit;
 
+	enum ELocalJobType {
+		e_Local_Evaluate, e_Local_Stop, e_Local_Undefined
+	};
+
+	class CLocalThread;
+
+	std::vector<CLocalThread*> m_vLocalThreads; /**< Worker threads that evaluate the local gates of a run, empty if single-threaded */
+	std::vector<uint32_t> m_vLocalRun; /**< Independent local gates of the current level that are evaluated by the threads */
+	uint32_t m_nLocalRunCtr; /**< Position of the first gate in m_vLocalRun that was not taken by a thread */
+	CLock* m_lockLocalRun; /**< Protects m_nLocalRunCtr and m_nWorkingLocalThreads */
+	CLock* m_lockLocalUsedGate; /**< Serializes UsedGate while a run is evaluated by the threads */
+	CEvent* m_evtLocalRun; /**< Signals that all threads are done with the current run */
+	uint32_t m_nWorkingLocalThreads; /**< Number of threads that still work on the current run */
+
 #ifdef BENCHBOOLTIME
 	double m_nCombTime;
 	double m_nSubsetTime;
@@ -232,6 +264,26 @@ private:
 	 Method for Evaluating MTs.
 	 */
 	void EvaluateMTs();
+	/**
+	 Expands each of the choice bits into a string of bitlen ones or zeros, such that the vector AND MTs can be
+	 evaluated word-wise instead of bit-wise.
+	 \param choices	Bits that select the strings
+	 \param startpos	Position of the first choice bit
+	 \param len		Number of choice bits
+	 \param bitlen	Bit-length of the strings
+	 \param mask		Expanded choice bits, aligned to the bit offset of the first string in its byte
+	 */
+	void ExpandVecANDChoices(CBitVector& choices, uint64_t startpos, uint64_t len, uint32_t bitlen, std::vector<UGATE_T>& mask);
+	/**
+	 Sets the bits startbit to startbit+nbits of res to the corresponding bits of vals AND mask. All other bits of res
+	 remain unchanged.
+	 \param vals		Strings that are selected
+	 \param mask		Expanded choice bits, computed by ExpandVecANDChoices()
+	 \param res		Vector the selected strings are written to
+	 \param startbit	Bit position of the first string
+	 \param nbits		Number of bits of all strings
+	 */
+	void SelectVecANDStrings(CBitVector& vals, std::vector<UGATE_T>& mask, CBitVector& res, uint64_t startbit, uint64_t nbits);
 	/**
 	 Method for evaluating AND gate
 	 */
@@ -260,6 +312,32 @@ private:
 	 \param gateid		Gate identifier
 	 */
 	inline void EvaluateConstantGate(uint32_t gateid);
+	/**
+	 Method for evaluating a single local gate.
+	 \param gateid		Gate identifier
+	 */
+	void EvaluateLocalGate(uint32_t gateid);
+	/**
+	 Check whether a local gate only reads the values of its parents and can hence be evaluated by the threads.
+	 \param gate		Gate object
+	 */
+	BOOL IsParallelLocalGate(GATE* gate);
+	/**
+	 Check whether a gate reads a gate of the current run, which has not been evaluated yet.
+	 \param gate		Gate object
+	 */
+	BOOL DependsOnLocalRun(GATE* gate);
+	/**
+	 Evaluate the gates of the current run, on all threads if it holds at least MIN_PARALLEL_LOCAL_GATES gates.
+	 */
+	void EvaluateLocalRun();
+	/**
+	 Take chunks of LOCAL_GATE_CHUNK_SIZE gates from the current run and evaluate them until the run is empty.
+	 Is called by all threads that work on the run.
+	 */
+	void EvaluateLocalRunChunks();
+	/** Called by a thread once it finished its part of the run. */
+	void LocalThreadDone();
 	/**
 	 Method for assigning values to OP-LUT gates after the interaction of this round has finished.
 	 */
@@ -274,24 +352,34 @@ private:
 	void ComputeMTs();
 
 	/**
-	 Method for store MTs to File
+	 Method for collecting the MTs of all bit-lengths as sections of the MT store
 	*/
-	void StoreMTsToFile(char *filename);
+	void GetMTStoreSections(std::vector<mt_store_section>& sections);
 
 	/**
-	 Method for read MTs from file
+	 Method for appending the MTs to the MT store
 	*/
-	void ReadMTsFromFile(char *filename);
+	void StoreMTsToStore();
+
+	/**
+	 Method for taking the MTs from the MT store
+	 \return TRUE if the store held enough MTs for this circuit
+	*/
+	BOOL ReadMTsFromStore();
+
 	/**
-	Method to check if it is the right nvals or the circuit size.
+	 Method for taking the MTs from the pool of the setup phase
+	 \param setup	ABYSetup object that holds the pool
+	 \return TRUE if the pool held enough MTs for this circuit
 	*/
-	BOOL isCircuitSizeLessThanOrEqualWithValueFromFile(char *filename, uint32_t in_circ_size);
+	BOOL TakeMTsFromPool(ABYSetup* setup);
 
 
 	/**
 	 Method for initializing.
+	 \param nthreads	Number of threads that evaluate the independent local gates of a level
 	 */
-	void Init();
+	void Init(uint32_t nthreads);
 	/**
 	 Method for initiating a new layer.
 	 */
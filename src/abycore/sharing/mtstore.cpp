@@ -0,0 +1,281 @@
+/**
+ \file 		mtstore.cpp
+ \author	agent@local
+ \copyright	ABY - A Framework for Efficient Mixed-protocol Secure Two-party Computation
+			Copyright (C) 2015 Engineering Cryptographic Protocols Group, TU Darmstadt
+			This program is free software: you can redistribute it and/or modify
+			it under the terms of the GNU Affero General Public License as published
+			by the Free Software Foundation, either version 3 of the License, or
+			(at your option) any later version.
+			This program is distributed in the hope that it will be useful,
+			but WITHOUT ANY WARRANTY; without even the implied warranty of
+			MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+			GNU Affero General Public License for more details.
+			You should have received a copy of the GNU Affero General Public License
+			along with this program. If not, see <http://www.gnu.org/licenses/>.
+ \brief		Store for pre-computed multiplication triples.
+ */
+#include "mtstore.h"
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char MT_STORE_MAGIC[8] = "ABYMTS";
+
+//all parts of a batch start at a multiple of 8 bytes
+#define PadToWord(bytes) (((bytes) + 7) & ~((uint64_t) 7))
+
+static BOOL WriteAt(int fd, const void* buf, uint64_t len, uint64_t offset) {
+	const BYTE* ptr = (const BYTE*) buf;
+	while (len > 0) {
+		ssize_t written = pwrite(fd, ptr, len, offset);
+		if (written <= 0)
+			return FALSE;
+		ptr += written;
+		len -= written;
+		offset += written;
+	}
+	return TRUE;
+}
+
+MTStore::MTStore(e_role role) :
+		m_cFileName((role == SERVER) ? MT_STORE_FILE_SERVER : MT_STORE_FILE_CLIENT), m_eRole(role), m_nFD(-1), m_pMap(NULL),
+		m_nMapSize(0) {
+}
+
+MTStore::~MTStore() {
+	Unmap();
+}
+
+void MTStore::InitHeader(mt_store_header* header) {
+	memset(header, 0, sizeof(mt_store_header));
+	memcpy(header->magic, MT_STORE_MAGIC, sizeof(header->magic));
+	header->version = MT_STORE_VERSION;
+	header->role = (uint32_t) m_eRole;
+	for (uint32_t i = 0; i < MT_STORE_MAX_SHARINGS; i++) {
+		header->cursor[i] = sizeof(mt_store_header);
+	}
+}
+
+BOOL MTStore::IsValidHeader(mt_store_header* header) {
+	return memcmp(header->magic, MT_STORE_MAGIC, sizeof(header->magic)) == 0 && header->version == MT_STORE_VERSION
+			&& header->role == (uint32_t) m_eRole;
+}
+
+BOOL MTStore::Map() {
+	struct stat st;
+	m_nFD = open(m_cFileName, O_RDWR);
+	if (m_nFD < 0)
+		return FALSE;
+	if (fstat(m_nFD, &st) != 0 || (uint64_t) st.st_size < sizeof(mt_store_header)) {
+		Unmap();
+		return FALSE;
+	}
+	m_nMapSize = st.st_size;
+	m_pMap = (BYTE*) mmap(NULL, m_nMapSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_nFD, 0);
+	if (m_pMap == MAP_FAILED) {
+		m_pMap = NULL;
+		Unmap();
+		return FALSE;
+	}
+	if (!IsValidHeader((mt_store_header*) m_pMap)) {
+		Unmap();
+		return FALSE;
+	}
+	return TRUE;
+}
+
+void MTStore::Unmap() {
+	if (m_pMap) {
+		munmap(m_pMap, m_nMapSize);
+		m_pMap = NULL;
+	}
+	m_nMapSize = 0;
+	if (m_nFD >= 0) {
+		close(m_nFD);
+		m_nFD = -1;
+	}
+}
+
+uint64_t MTStore::GetEndOfBatches() {
+	uint64_t offset = sizeof(mt_store_header);
+	while (offset + sizeof(mt_store_batch) <= m_nMapSize) {
+		mt_store_batch* batch = (mt_store_batch*) (m_pMap + offset);
+		//a batch that was not completely written is ignored
+		if (batch->bytes < sizeof(mt_store_batch) || offset + batch->bytes > m_nMapSize)
+			break;
+		offset += batch->bytes;
+	}
+	return offset;
+}
+
+BOOL MTStore::Append(e_sharing sharing, std::vector<mt_store_section>& sections) {
+	uint64_t offset;
+	if (Map()) {
+		offset = GetEndOfBatches();
+		Unmap();
+	} else {
+		if (access(m_cFileName, F_OK) == 0) {
+			std::cerr << "Warning: " << m_cFileName << " is not a multiplication triple store of version " << MT_STORE_VERSION
+					<< " for this role, overwriting it" << std::endl;
+		}
+		mt_store_header header;
+		InitHeader(&header);
+		m_nFD = open(m_cFileName, O_RDWR | O_CREAT | O_TRUNC, 0600);
+		if (m_nFD < 0 || !WriteAt(m_nFD, &header, sizeof(header), 0)) {
+			std::cerr << "Error: Unable to create multiplication triple store " << m_cFileName << std::endl;
+			Unmap();
+			return FALSE;
+		}
+		Unmap();
+		offset = sizeof(header);
+	}
+
+	mt_store_batch batch;
+	batch.sharing = (uint32_t) sharing;
+	batch.nsections = sections.size();
+	batch.bytes = sizeof(mt_store_batch);
+	for (uint32_t i = 0; i < sections.size(); i++) {
+		batch.bytes += sizeof(mt_store_section_header) + PadToWord(sections[i].abytes) + 2 * PadToWord(sections[i].bcbytes);
+	}
+
+	m_nFD = open(m_cFileName, O_RDWR);
+	//drop the remains of a batch that was not completely written
+	BOOL success = m_nFD >= 0 && ftruncate(m_nFD, offset) == 0;
+	success = success && WriteAt(m_nFD, &batch, sizeof(batch), offset);
+	offset += sizeof(batch);
+
+	for (uint32_t i = 0; i < sections.size() && success; i++) {
+		mt_store_section_header sh;
+		memset(&sh, 0, sizeof(sh));
+		sh.bitlen = sections[i].bitlen;
+		sh.nmts = sections[i].nmts;
+		sh.abytes = sections[i].abytes;
+		sh.bcbytes = sections[i].bcbytes;
+		success = WriteAt(m_nFD, &sh, sizeof(sh), offset);
+		offset += sizeof(sh);
+		//the padding is left to ftruncate, which fills the file with zeros
+		success = success && WriteAt(m_nFD, sections[i].A, sh.abytes, offset);
+		offset += PadToWord(sh.abytes);
+		success = success && WriteAt(m_nFD, sections[i].B, sh.bcbytes, offset);
+		offset += PadToWord(sh.bcbytes);
+		success = success && WriteAt(m_nFD, sections[i].C, sh.bcbytes, offset);
+		offset += PadToWord(sh.bcbytes);
+	}
+	success = success && ftruncate(m_nFD, offset) == 0 && fsync(m_nFD) == 0;
+
+	if (!success) {
+		std::cerr << "Error: Unable to write multiplication triples to " << m_cFileName << std::endl;
+	}
+	Unmap();
+	return success;
+}
+
+BOOL MTStore::Read(e_sharing sharing, std::vector<mt_store_section>& sections) {
+	if (sharing >= MT_STORE_MAX_SHARINGS || !Map())
+		return FALSE;
+
+	mt_store_header* header = (mt_store_header*) m_pMap;
+	uint64_t offset = sizeof(mt_store_header);
+	uint64_t end = GetEndOfBatches();
+	mt_store_batch* batch = NULL;
+
+	//walk the batches from the start, which GetEndOfBatches checked to lie in the file, instead of trusting that the
+	//cursor points to one of them, and take the first batch of the sharing that was not consumed
+	while (offset < end) {
+		batch = (mt_store_batch*) (m_pMap + offset);
+		if (batch->sharing == (uint32_t) sharing && offset >= header->cursor[sharing])
+			break;
+		offset += batch->bytes;
+		batch = NULL;
+	}
+	if (!batch) {
+		Unmap();
+		return FALSE;
+	}
+
+	//locate the sections of the batch, each of which has to lie within the batch
+	uint64_t batchend = offset + batch->bytes;
+	if (batch->nsections > (batch->bytes - sizeof(mt_store_batch)) / sizeof(mt_store_section_header)) {
+		std::cerr << "Error: " << m_cFileName << " is corrupt, a batch holds more sections than fit into it" << std::endl;
+		Unmap();
+		return FALSE;
+	}
+	std::vector<mt_store_section_header*> sh(batch->nsections);
+	std::vector<uint64_t> shoffset(batch->nsections);
+	for (uint64_t i = 0, pos = offset + sizeof(mt_store_batch); i < batch->nsections; i++) {
+		if (batchend - pos < sizeof(mt_store_section_header)) {
+			std::cerr << "Error: " << m_cFileName << " is corrupt, a section header exceeds its batch" << std::endl;
+			Unmap();
+			return FALSE;
+		}
+		sh[i] = (mt_store_section_header*) (m_pMap + pos);
+		shoffset[i] = pos + sizeof(mt_store_section_header);
+		uint64_t left = batchend - shoffset[i];
+		//the sizes are checked one by one, such that their sum cannot overflow
+		if (sh[i]->abytes > left || sh[i]->bcbytes > left || PadToWord(sh[i]->abytes) + 2 * PadToWord(sh[i]->bcbytes) > left) {
+			std::cerr << "Error: " << m_cFileName << " is corrupt, a section exceeds its batch" << std::endl;
+			Unmap();
+			return FALSE;
+		}
+		pos = shoffset[i] + PadToWord(sh[i]->abytes) + 2 * PadToWord(sh[i]->bcbytes);
+	}
+
+	std::vector<uint32_t> match(sections.size());
+	for (uint32_t i = 0; i < sections.size(); i++) {
+		for (match[i] = 0; match[i] < batch->nsections; match[i]++) {
+			if (sh[match[i]]->bitlen == sections[i].bitlen)
+				break;
+		}
+		if (match[i] == batch->nsections || sh[match[i]]->nmts < sections[i].nmts || sh[match[i]]->abytes < sections[i].abytes
+				|| sh[match[i]]->bcbytes < sections[i].bcbytes) {
+			Unmap();
+			return FALSE;
+		}
+	}
+
+	//the batch is consumed before its triples are used, such that they are never used twice
+	header->cursor[sharing] = offset + batch->bytes;
+	if (msync(m_pMap, sizeof(mt_store_header), MS_SYNC) != 0) {
+		std::cerr << "Error: Unable to update the cursor of " << m_cFileName << std::endl;
+		Unmap();
+		return FALSE;
+	}
+
+	for (uint32_t i = 0; i < sections.size(); i++) {
+		mt_store_section_header* s = sh[match[i]];
+		BYTE* data = m_pMap + shoffset[match[i]];
+		memcpy(sections[i].A, data, sections[i].abytes);
+		memcpy(sections[i].B, data + PadToWord(s->abytes), sections[i].bcbytes);
+		memcpy(sections[i].C, data + PadToWord(s->abytes) + PadToWord(s->bcbytes), sections[i].bcbytes);
+	}
+
+	Unmap();
+	return TRUE;
+}
+
+BOOL MTStore::IsConsumed() {
+	if (!Map())
+		return TRUE;
+
+	mt_store_header* header = (mt_store_header*) m_pMap;
+	uint64_t end = GetEndOfBatches();
+	BOOL consumed = TRUE;
+	for (uint64_t offset = sizeof(mt_store_header); offset < end && consumed;) {
+		mt_store_batch* batch = (mt_store_batch*) (m_pMap + offset);
+		if (batch->sharing >= MT_STORE_MAX_SHARINGS || offset >= header->cursor[batch->sharing])
+			consumed = FALSE;
+		offset += batch->bytes;
+	}
+	Unmap();
+	return consumed;
+}
+
+void MTStore::Remove() {
+	Unmap();
+	remove(m_cFileName);
+}
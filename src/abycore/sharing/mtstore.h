@@ -0,0 +1,145 @@
+/**
+ \file 		mtstore.h
+ \author	agent@local
+ \copyright	ABY - A Framework for Efficient Mixed-protocol Secure Two-party Computation
+			Copyright (C) 2015 Engineering Cryptographic Protocols Group, TU Darmstadt
+			This program is free software: you can redistribute it and/or modify
+			it under the terms of the GNU Affero General Public License as published
+			by the Free Software Foundation, either version 3 of the License, or
+			(at your option) any later version.
+			This program is distributed in the hope that it will be useful,
+			but WITHOUT ANY WARRANTY; without even the implied warranty of
+			MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+			GNU Affero General Public License for more details.
+			You should have received a copy of the GNU Affero General Public License
+			along with this program. If not, see <http://www.gnu.org/licenses/>.
+ \brief		Store for pre-computed multiplication triples.
+ */
+
+#ifndef __MTSTORE_H__
+#define __MTSTORE_H__
+
+#include "../ABY_utils/ABYconstants.h"
+#include <ENCRYPTO_utils/typedefs.h>
+#include <cstdint>
+#include <vector>
+
+/**
+ \def 	MT_STORE_VERSION
+ \brief	Version of the file format. Files with a different version are not read.
+ */
+#define MT_STORE_VERSION 1
+
+/**
+ \def 	MT_STORE_FILE_SERVER
+ \brief	File that stores the multiplication triples of the server
+ */
+#define MT_STORE_FILE_SERVER "pre_comp_server.mts"
+
+/**
+ \def 	MT_STORE_FILE_CLIENT
+ \brief	File that stores the multiplication triples of the client
+ */
+#define MT_STORE_FILE_CLIENT "pre_comp_client.mts"
+
+/**
+ \def 	MT_STORE_MAX_SHARINGS
+ \brief	Number of sharings the header keeps a consumption cursor for
+ */
+#define MT_STORE_MAX_SHARINGS 8
+
+/** Multiplication triples of one bit-length that are written to or read from the store */
+typedef struct mt_store_section_ctx {
+	uint32_t bitlen; /**< Bit-length of the values in B and C */
+	uint64_t nmts; /**< Number of triples */
+	uint64_t abytes; /**< Bytes of A */
+	uint64_t bcbytes; /**< Bytes of B and of C */
+	BYTE* A;
+	BYTE* B;
+	BYTE* C;
+} mt_store_section;
+
+/**
+ File based store for multiplication triples that were pre-computed in an earlier execution (ePreCompStore) and are
+ consumed by later executions (ePreCompRead).
+
+ The file starts with a versioned header that holds a consumption cursor for each sharing. The triples are appended
+ as batches, each of which belongs to one sharing and holds a section of A, B and C values for every bit-length the
+ circuit needs. Batches are read from a memory mapping of the file. The cursor is advanced and synced to disk as soon as
+ a batch is taken, such that a batch is never handed out twice, even if the process terminates afterwards.
+ */
+class MTStore {
+public:
+	/**
+	 Constructor of the class.
+	 \param role	Role of the party, which selects the file
+	 */
+	MTStore(e_role role);
+	~MTStore();
+	MTStore(const MTStore&) = delete;
+	MTStore& operator=(const MTStore&) = delete;
+
+	/**
+	 Appends a batch of multiplication triples to the store. The file is created if it does not exist.
+	 \param sharing		Sharing the triples belong to
+	 \param sections	Triples of each bit-length
+	 \return TRUE if the batch was written
+	 */
+	BOOL Append(e_sharing sharing, std::vector<mt_store_section>& sections);
+
+	/**
+	 Takes the next batch of a sharing from the store and copies the requested triples out of it. The batch is
+	 consumed even if it contains more triples than requested.
+	 \param sharing		Sharing the triples belong to
+	 \param sections	Bit-lengths and number of the requested triples, as well as the buffers A, B and C they are copied to
+	 \return TRUE if the next batch contained enough triples for all sections. Nothing is consumed otherwise.
+	 */
+	BOOL Read(e_sharing sharing, std::vector<mt_store_section>& sections);
+
+	/**
+	 \return TRUE if the store contains no batches that were not yet consumed
+	 */
+	BOOL IsConsumed();
+
+	/**
+	 Deletes the file of the store.
+	 */
+	void Remove();
+
+private:
+	struct mt_store_header {
+		char magic[8];
+		uint32_t version;
+		uint32_t role;
+		uint64_t cursor[MT_STORE_MAX_SHARINGS]; /**< Offset of the first batch that was not consumed for each sharing */
+	};
+
+	struct mt_store_batch {
+		uint32_t sharing;
+		uint32_t nsections;
+		uint64_t bytes; /**< Size of the batch including this header */
+	};
+
+	struct mt_store_section_header {
+		uint32_t bitlen;
+		uint32_t reserved;
+		uint64_t nmts;
+		uint64_t abytes;
+		uint64_t bcbytes;
+	};
+
+	BOOL Map();
+	void Unmap();
+	void InitHeader(mt_store_header* header);
+	BOOL IsValidHeader(mt_store_header* header);
+	/** \return The offset after the last completely written batch */
+	uint64_t GetEndOfBatches();
+
+	const char* m_cFileName;
+	e_role m_eRole;
+	int m_nFD;
+	BYTE* m_pMap;
+	uint64_t m_nMapSize;
+};
+
+#endif /* __MTSTORE_H__ */
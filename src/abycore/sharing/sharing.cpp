@@ -16,16 +16,19 @@
  \brief		Sharing class implementation.
  */
 #include "sharing.h"
+#include "mtstore.h"
 #include "../circuit/circuit.h"
 #include "../circuit/abycircuit.h"
 #include <ENCRYPTO_utils/crypto/crypto.h>
 #include <ENCRYPTO_utils/fileops.h>
+#include <ENCRYPTO_utils/thread.h>
 #include <cassert>
 #include <cstring>
 #include <iostream>
 #include <iomanip>
 
-Sharing::Sharing(e_sharing context, e_role role, uint32_t sharebitlen, ABYCircuit* circuit, crypto* crypt) {
+Sharing::Sharing(e_sharing context, e_role role, uint32_t sharebitlen, ABYCircuit* circuit, crypto* crypt) :
+		m_lockUsedGate(NULL) {
 	m_eContext = context;
 	m_nShareBitLen = sharebitlen;
 	m_pCircuit = circuit;
@@ -34,7 +37,6 @@ Sharing::Sharing(e_sharing context, e_role role, uint32_t sharebitlen, ABYCircui
 	m_cCrypto = crypt;
 	m_nSecParamBytes = ceil_divide(m_cCrypto->get_seclvl().symbits, 8);
 	m_ePhaseValue = ePreCompDefault;
-	m_nFilePos = -1;
 	m_nTypeBitLen = sharebitlen;
 }
 
@@ -64,24 +66,11 @@ ePreCompPhase Sharing::GetPreCompPhaseValue() {
 	return m_ePhaseValue;
 }
 void Sharing::PreCompFileDelete() {
-	char filename[21];
-	uint64_t truncation_size;
-	if(m_eRole == SERVER) {
-		strcpy(filename, "pre_comp_server.dump");
-	}
-	else {
-		strcpy(filename, "pre_comp_client.dump");
-	}
-
-	if((FileExists(filename))&&(GetPreCompPhaseValue() == ePreCompRead)) {
-
-		if(m_nFilePos >= FileSize(filename)) {
-			remove(filename);
-		}
-		else {
-			truncation_size = FileSize(filename) - m_nFilePos;
-			if(truncate(filename, truncation_size))
-                        std::cout << "Error occured in truncate" << std::endl;
+	if(GetPreCompPhaseValue() == ePreCompRead) {
+		/**The store is only deleted once the triples of all sharings are used up.*/
+		MTStore store(m_eRole);
+		if(store.IsConsumed()) {
+			store.Remove();
 		}
 	}
 }
@@ -217,32 +206,51 @@ void Sharing::FreeGate(GATE *gate) {
 		role = (role == SERVER ? CLIENT : SERVER);
 		context = S_YAO;
 	}
+	GateValueArena* arena = m_pCircuit->GetValueArena();
 	switch(context) {
 	case S_BOOL:
 	case S_ARITH:
 	case S_SPLUT:
-		free(gate->gs.val);
+		arena->Free(gate->gs.val);
 		break;
 	case S_YAO:
 		if(role == SERVER) {
 			// input gates are freed before
 			if(gate->type == G_IN || gate->type == G_CONV) { break; }
-			free(gate->gs.yinput.outKey);
-			free(gate->gs.yinput.pi);
+			// pi lies in the same block as outKey
+			arena->Free(gate->gs.yinput.outKey);
 		} else {
-			free(gate->gs.yval);
+			arena->Free(gate->gs.yval);
 		}
 		break;
 	}
 	gate->instantiated = false;
 }
 
+void* Sharing::AllocGateValue(GATE* gate, uint64_t bytes, BOOL zero) {
+	GateValueArena* arena = m_pCircuit->GetValueArena();
+	void* ptr = arena->AllocPlanned(gate - m_pGates, bytes, zero);
+	if(ptr) {
+		return ptr;
+	}
+	if(m_lockUsedGate) { m_lockUsedGate->Lock(); }
+	ptr = arena->Alloc(m_eContext, bytes, FALSE);
+	if(m_lockUsedGate) { m_lockUsedGate->Unlock(); }
+	if(zero) {
+		memset(ptr, 0, bytes);
+	}
+	return ptr;
+}
+
 // Mark gate as used. If it is no longer needed, free it.
 void Sharing::UsedGate(uint32_t gateid) {
 	GATE *gate = &m_pGates[gateid];
-	if(!gate->instantiated) { return; }
-	gate->nused--;
-	if(!gate->nused && gate->type != G_CONV) {
-		FreeGate(gate);
+	if(m_lockUsedGate) { m_lockUsedGate->Lock(); }
+	if(gate->instantiated) {
+		gate->nused--;
+		if(!gate->nused && gate->type != G_CONV) {
+			FreeGate(gate);
+		}
 	}
+	if(m_lockUsedGate) { m_lockUsedGate->Unlock(); }
 }
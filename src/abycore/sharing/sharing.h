@@ -31,8 +31,11 @@ class ABYCircuit;
 class ABYSetup;
 class Circuit;
 class crypto;
+class CLock;
 struct GATE;
 struct UGATE;
+struct mt_store_section_ctx;
+typedef struct mt_store_section_ctx mt_store_section;
 
 
 /**
@@ -121,13 +124,22 @@ public:
 	 */
 	virtual void InstantiateGate(GATE* gate) = 0;
 	/**
-	 Method for finding the used gate with the gateid.
+	 Method for the size of the value that InstantiateGate allocates for a gate, which is used to plan the memory of
+	 the values before the evaluation (see ABYCircuit::PlanGateValues).
+	 \param gate		Gate of this sharing
+	 \return Bytes of the value, 0 if the values of the sharing are not created in the order of the levels
+	 */
+	virtual uint64_t GetGateValueBytes(GATE* /*gate*/) {
+		return 0;
+	}
+	/**
+	 Method for finding the used gate with the gateid. Is serialized by m_lockUsedGate if it is set.
 	 \param gateid		Id of the used gate.
 	 */
 	void UsedGate(uint32_t gateid);
 
 	/**
-	 Method for freeing gate memory depending on its type
+	 Method for freeing gate memory depending on its type. The memory is returned to the value arena of the circuit.
 	 \param gate		Pointer to the gat to free
 	 */
 	void FreeGate(GATE* gate);
@@ -170,8 +182,9 @@ public:
 			In setup phase the implementation uses the baseOTs to compute OTs and use the OTs
 			to communicate and compute the MTs. Online phase primarily deals with the rest of
 			the circuit execution where the circuit evaluation is performed.
-			Currently Precomputation scheme is only implemented for BoolSharing circuits or
-	 	 	GMW based circuits. The implementation involves the use of 4 different modes of
+			Currently Precomputation scheme is implemented for BoolSharing circuits or
+	 	 	GMW based circuits. The store and read modes are also supported by ArithSharing,
+	 	 	whose MTs are kept in the same store. The implementation involves the use of 4 different modes of
 	 	 	operation: PrecomputationStore, PrecomputationRead, PrecomputeInRAM and finally
 	 	 	the default. In precomputationStore:  the MTs are computed for the specified
 	 	 	circuit design and stored in a specific file(depending on the role) and the online
@@ -197,7 +210,7 @@ public:
 	*/
 	ePreCompPhase GetPreCompPhaseValue();
 	/**
-	Method to delete the File which stores the precomputation values.
+	Method to delete the MT store once all precomputation values in it were used.
 	*/
 	void PreCompFileDelete();
 
@@ -233,6 +246,16 @@ protected:
 	 \returns	The value of the gate in a standardized format
 	 */
 	UGATE_T* ReadOutputValue(uint32_t gateid, e_circuit circ_type, uint32_t* bitlen);
+	/**
+	 Method for allocating the value of a gate from the value arena of the circuit. The planned memory of the gate is
+	 used if it has one, otherwise the value is taken from the slabs, which recycle the values that were freed by
+	 UsedGate and is serialized by m_lockUsedGate if it is set.
+	 \param gate		Gate the value belongs to
+	 \param bytes		Size of the value
+	 \param zero		Whether the value is zeroed, as with calloc
+	 \return Pointer to the value, which is freed by FreeGate
+	 */
+	void* AllocGateValue(GATE* gate, uint64_t bytes, BOOL zero = TRUE);
 
 
 	uint32_t m_nShareBitLen; /**< Bit length of shared item. */
@@ -243,7 +266,7 @@ protected:
 	crypto* m_cCrypto; /**< Class that contains cryptographic routines */
 	e_sharing m_eContext; /** Which sharing is executed */
 	uint32_t m_nTypeBitLen; /** Bit-length of the arithmetic shares in arithsharing */
-	uint64_t m_nFilePos;/**< Variable which stores the position of the file pointer. */
+	CLock* m_lockUsedGate; /**< Set while gates are evaluated by several threads, which can share parents. NULL otherwise. */
 	ePreCompPhase m_ePhaseValue;/**< Variable storing the current Precomputation Mode */
 
 };
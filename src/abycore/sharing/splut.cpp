@@ -420,7 +420,7 @@ void SetupLUT::PrepareOnlinePhase() {
 
 
 void SetupLUT::EvaluateLocalOperations(uint32_t depth) {
-	std::deque<uint32_t> localops = m_cBoolCircuit->GetLocalQueueOnLvl(depth);
+	const std::vector<uint32_t>& localops = m_cBoolCircuit->GetLocalQueueOnLvl(depth);
 	GATE* gate;
 #ifdef BENCHBOOLTIME
 	timeval tstart, tend;
@@ -483,7 +483,7 @@ void SetupLUT::EvaluateLocalOperations(uint32_t depth) {
 
 
 void SetupLUT::EvaluateInteractiveOperations(uint32_t depth) {
-	std::deque<uint32_t> interactiveops = m_cBoolCircuit->GetInteractiveQueueOnLvl(depth);
+	const std::vector<uint32_t>& interactiveops = m_cBoolCircuit->GetInteractiveQueueOnLvl(depth);
 
 	for (uint32_t i = 0; i < interactiveops.size(); i++) {
 		GATE* gate = m_pGates + interactiveops[i];
@@ -1436,8 +1436,12 @@ void SetupLUT::GetBuffersToReceive(std::vector<BYTE*>& rcvbuf, std::vector<uint6
 	}
 }
 
+uint64_t SetupLUT::GetGateValueBytes(GATE* gate) {
+	return ceil_divide(gate->nvals, GATE_T_BITS) * sizeof(UGATE_T);
+}
+
 inline void SetupLUT::InstantiateGate(GATE* gate) {
-	gate->gs.val = (UGATE_T*) calloc((ceil_divide(gate->nvals, GATE_T_BITS)), sizeof(UGATE_T));
+	gate->gs.val = (UGATE_T*) AllocGateValue(gate, ceil_divide(gate->nvals, GATE_T_BITS) * sizeof(UGATE_T));
 	gate->instantiated = true;
 }
 
@@ -81,6 +81,7 @@ public:
 	}
 
 	inline void InstantiateGate(GATE* gate);
+	uint64_t GetGateValueBytes(GATE* gate);
 
 	void GetDataToSend(std::vector<BYTE*>& sendbuf, std::vector<uint64_t>& bytesize);
 	void GetBuffersToReceive(std::vector<BYTE*>& rcvbuf, std::vector<uint64_t>& rcvbytes);
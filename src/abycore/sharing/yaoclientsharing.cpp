@@ -36,18 +36,10 @@ void YaoClientSharing::InitClient() {
 
 	fMaskFct = new XORMasking(m_cCrypto->get_seclvl().symbits);
 
-	m_vTmpEncBuf = (uint8_t**) malloc(sizeof(uint8_t*) * KEYS_PER_GATE_IN_TABLE);
-	for(uint32_t i = 0; i < KEYS_PER_GATE_IN_TABLE; i++)
-		m_vTmpEncBuf[i] = (uint8_t*) malloc(sizeof(uint8_t) * AES_BYTES);
-
 }
 
 YaoClientSharing::~YaoClientSharing() {
 		Reset();
-		for(size_t i = 0; i < KEYS_PER_GATE_IN_TABLE; i++) {
-			free(m_vTmpEncBuf[i]);
-		}
-		free(m_vTmpEncBuf);
 		delete fMaskFct;
 }
 
@@ -62,12 +54,8 @@ void YaoClientSharing::InitNewLayer() {
 
 /* Send a new task for pre-computing the OTs in the setup phase */
 void YaoClientSharing::PrepareSetupPhase(ABYSetup* setup) {
-	BYTE* buf;
-	uint64_t gt_size;
 	m_nANDGates = m_cBoolCircuit->GetNumANDGates();
 
-	gt_size = ((uint64_t) m_nANDGates) * KEYS_PER_GATE_IN_TABLE * m_nSecParamBytes;
-
 	if (m_cBoolCircuit->GetMaxDepth() == 0)
 		return;
 
@@ -77,8 +65,7 @@ void YaoClientSharing::PrepareSetupPhase(ABYSetup* setup) {
 	m_nClientInputBits = m_cBoolCircuit->GetNumInputBitsForParty(CLIENT);
 	m_nConversionInputBits = m_cBoolCircuit->GetNumB2YGates() + m_cBoolCircuit->GetNumA2YGates() + m_cBoolCircuit->GetNumYSwitchGates();
 
-	buf = (BYTE*) malloc(gt_size);
-	m_vGarbledCircuit.AttachBuf(buf, gt_size);
+	CreateGarbledTableRing();
 
 	m_vOutputShareRcvBuf.Create((uint32_t) m_cBoolCircuit->GetNumOutputBitsForParty(CLIENT));
 	m_vOutputShareSndBuf.Create((uint32_t) m_cBoolCircuit->GetNumOutputBitsForParty(SERVER));
@@ -92,6 +79,18 @@ void YaoClientSharing::PrepareSetupPhase(ABYSetup* setup) {
 	std::cout << "OT Choice bits: " << std::endl;
 	m_vChoiceBits.Print(0, m_nClientInputBits + m_nConversionInputBits);
 #endif
+	//The random OTs are taken from the pool of the setup phase if it holds enough of them
+	std::vector<mt_store_section> sections(1);
+	sections[0].bitlen = m_cCrypto->get_seclvl().symbits;
+	sections[0].nmts = m_nClientInputBits + m_nConversionInputBits;
+	sections[0].abytes = ceil_divide(sections[0].nmts, 8);
+	sections[0].bcbytes = ceil_divide(sections[0].nmts * sections[0].bitlen, 8);
+	sections[0].A = m_vChoiceBits.GetArr();
+	sections[0].B = m_vROTMasks.GetArr();
+	sections[0].C = NULL;
+	if (setup->TakeFromPool(m_eContext, sections))
+		return;
+
 	/* Use the standard XORMasking function */
 
 	/* Define the new OT tasks that will be done when the setup phase is performed*/
@@ -112,6 +111,13 @@ void YaoClientSharing::PrepareSetupPhase(ABYSetup* setup) {
 void YaoClientSharing::PerformSetupPhase(ABYSetup* setup) {
 	if (m_cBoolCircuit->GetMaxDepth() == 0)
 		return;
+
+	//In pipelined execution the server garbles and sends each level during the online phase
+	if (IsPipelinedGC()) {
+		OpenPipelineChannel(setup);
+		return;
+	}
+
 	ReceiveGarbledCircuitAndOutputShares(setup);
 }
 
@@ -120,15 +126,26 @@ void YaoClientSharing::PrepareOnlinePhase() {
 }
 
 void YaoClientSharing::ReceiveGarbledCircuitAndOutputShares(ABYSetup* setup) {
-	if (m_nANDGates > 0)
-		setup->AddReceiveTask(m_vGarbledCircuit.GetArr(), ((uint64_t) m_nANDGates) * m_nSecParamBytes * KEYS_PER_GATE_IN_TABLE);
-	if (m_cBoolCircuit->GetNumOutputBitsForParty(CLIENT) > 0)
-		setup->AddReceiveTask(m_vOutputShareRcvBuf.GetArr(), ceil_divide(m_cBoolCircuit->GetNumOutputBitsForParty(CLIENT), 8));
+	std::vector<BYTE*> rcvbuf;
+	std::vector<uint64_t> rcvbytes;
 
+	if (m_nANDGates > 0) {
+		rcvbuf.push_back(m_vGarbledCircuit.GetArr());
+		rcvbytes.push_back(((uint64_t) m_nANDGates) * m_nSecParamBytes * KEYS_PER_GATE_IN_TABLE);
+	}
+	if (m_cBoolCircuit->GetNumOutputBitsForParty(CLIENT) > 0) {
+		rcvbuf.push_back(m_vOutputShareRcvBuf.GetArr());
+		rcvbytes.push_back(ceil_divide(m_cBoolCircuit->GetNumOutputBitsForParty(CLIENT), 8));
+	}
+
+	//The server streams the garbled circuit in windows while garbling it. The windows are received in the background and
+	//the garbled tables can be evaluated as soon as their window arrived, see EvaluateBatch.
+	m_pSetup = setup;
+	m_pSetup->AddStreamReceiveTask(rcvbuf, rcvbytes, (uint64_t) GARBLED_TABLE_WINDOW * m_nSecParamBytes * KEYS_PER_GATE_IN_TABLE);
 }
 
 void YaoClientSharing::FinishSetupPhase(ABYSetup* setup) {
-	//wait for transmission end of GC
+	//the garbled circuit is still being streamed and is only waited for when it is evaluated
 	setup->WaitForTransmissionEnd();
 	/*std::cout << "Garbled Table Cl: " << std::endl;
 	m_vGarbledCircuit.PrintHex(0, ((uint64_t) m_nANDGates) * m_nSecParamBytes * KEYS_PER_GATE_IN_TABLE);
@@ -136,6 +153,8 @@ void YaoClientSharing::FinishSetupPhase(ABYSetup* setup) {
 	std::cout << "Outshares C: " << std::endl;
 	m_vOutputShareRcvBuf.PrintHex(ceil_divide(m_cBoolCircuit->GetNumOutputBitsForParty(CLIENT), 8));*/
 #ifdef DEBUGYAOCLIENT
+	if(!IsPipelinedGC())
+		setup->WaitForStreamEnd();
 	std::cout << "Received Garbled Circuit: ";
 	m_vGarbledCircuit.PrintHex();
 	std::cout << "Received my output shares: ";
@@ -151,12 +170,27 @@ void YaoClientSharing::FinishSetupPhase(ABYSetup* setup) {
 }
 void YaoClientSharing::EvaluateLocalOperations(uint32_t depth) {
 
-	std::deque<uint32_t> localops = m_cBoolCircuit->GetLocalQueueOnLvl(depth);
+	const std::vector<uint32_t>& localops = m_cBoolCircuit->GetLocalQueueOnLvl(depth);
+
+	//In pipelined execution the server sends the tables of this level in windows and flushes the last window at its end
+	if (IsPipelinedGC()) {
+		m_nPipelineLevelEndCtr = m_nGarbledTableCtr;
+		for (uint32_t i = 0; i < localops.size(); i++) {
+			if (m_pGates[localops[i]].type == G_NON_LIN) {
+				m_nPipelineLevelEndCtr += m_pGates[localops[i]].nvals;
+			}
+		}
+	}
 
 	//std::cout << "In total I have " <<  localops.size() << " local operations to evaluate on this level " << std::endl;
 	for (uint32_t i = 0; i < localops.size(); i++) {
 		GATE* gate = m_pGates + localops[i];
 		//std::cout << "Evaluating gate " << localops[i] << " with context = " << gate->context << std::endl;
+		//AND gates are evaluated in batches, hence their keys have to be computed before they can be read
+		if (m_vPendingANDGates.size() > 0 && DependsOnPendingANDGates(gate)) {
+			EvaluatePendingANDGates();
+		}
+
 		if (gate->type == G_LIN) {
 			EvaluateXORGate(gate);
 		} else if (gate->type == G_NON_LIN) {
@@ -194,10 +228,16 @@ void YaoClientSharing::EvaluateLocalOperations(uint32_t depth) {
 			exit(0);
 		}
 	}
+	//Evaluate the remaining AND gates of this level
+	EvaluatePendingANDGates();
 }
 
 void YaoClientSharing::EvaluateInteractiveOperations(uint32_t depth) {
-	std::deque<uint32_t> interactiveops = m_cBoolCircuit->GetInteractiveQueueOnLvl(depth);
+	const std::vector<uint32_t>& interactiveops = m_cBoolCircuit->GetInteractiveQueueOnLvl(depth);
+
+	if (IsPipelinedGC()) {
+		ReceivePipelinedOutputShares(interactiveops);
+	}
 
 	//std::cout << "In total I have " <<  localops.size() << " local operations to evaluate on this level " << std::endl;
 	for (uint32_t i = 0; i < interactiveops.size(); i++) {
@@ -271,32 +311,123 @@ void YaoClientSharing::EvaluateXORGate(GATE* gate) {
 	UsedGate(idright);
 }
 
+//Evaluate an AND gate: only schedule it, the garbled tables are evaluated in EvaluatePendingANDGates
 void YaoClientSharing::EvaluateANDGate(GATE* gate) {
-	uint32_t idleft = gate->ingates.inputs.twin.left; //gate->gs.ginput.left;
-	uint32_t idright = gate->ingates.inputs.twin.right; //gate->gs.ginput.right;
-	GATE* gleft = m_pGates + idleft;
-	GATE* gright = m_pGates + idright;
+	m_vPendingANDGates.push_back(gate);
+}
 
-	//evaluate garbled table
-	InstantiateGate(gate);
-	for (uint32_t g = 0; g < gate->nvals; g++) {
-		EvaluateGarbledTable(gate, g, gleft, gright);
+void YaoClientSharing::EvaluatePendingANDGates() {
+	uint32_t nslots = 0;
+	uint64_t tablectr;
+	BYTE* tweaks;
+	GATE *gate, *gleft, *gright;
+
+	for (uint32_t i = 0; i < m_vPendingANDGates.size(); i++) {
+		gate = m_vPendingANDGates[i];
+		gleft = m_pGates + gate->ingates.inputs.twin.left;
+		gright = m_pGates + gate->ingates.inputs.twin.right;
+
+		InstantiateGate(gate);
+
+		for (uint32_t g = 0; g < gate->nvals; g++) {
+			m_vGarbleSlots[nslots].gate = gate;
+			m_vGarbleSlots[nslots].pos = g;
+			//the tables of the batch are read in order, starting at m_nGarbledTableCtr
+			tablectr = m_nGarbledTableCtr + nslots;
+			tweaks = m_bGarbleTweakBuf + nslots * KEYS_PER_GATE_IN_TABLE * AES_BYTES;
+			PrepareWireTweak(tweaks, gleft->gs.yval + g * m_nSecParamBytes, KEYS_PER_GATE_IN_TABLE*tablectr);
+			PrepareWireTweak(tweaks + AES_BYTES, gright->gs.yval + g * m_nSecParamBytes, KEYS_PER_GATE_IN_TABLE*tablectr+1);
+			nslots++;
+			if (nslots == m_nGarbleBatchSize) {
+				EvaluateBatch(nslots);
+				nslots = 0;
+			}
+		}
+	}
+	if (nslots > 0) {
+		EvaluateBatch(nslots);
+	}
+
+	for (uint32_t i = 0; i < m_vPendingANDGates.size(); i++) {
+		UsedGate(m_vPendingANDGates[i]->ingates.inputs.twin.left);
+		UsedGate(m_vPendingANDGates[i]->ingates.inputs.twin.right);
+	}
+	m_vPendingANDGates.clear();
+}
+
+void YaoClientSharing::EvaluateBatch(uint32_t nslots) {
+	GATE* gate;
+
+	//wait until the window that contains the last garbled table of this batch arrived
+	if (IsPipelinedGC()) {
+		ReceivePipelinedTables(m_nGarbledTableCtr + nslots);
+	} else {
+		m_pSetup->WaitForStreamReceive((m_nGarbledTableCtr + nslots) * m_nSecParamBytes * KEYS_PER_GATE_IN_TABLE);
+	}
+
+	EncryptWireBatch(m_bGarbleMaskBuf, m_bGarbleTweakBuf, nslots * KEYS_PER_GATE_IN_TABLE);
+
+	for (uint32_t i = 0; i < nslots; i++) {
+		gate = m_vGarbleSlots[i].gate;
+		EvaluateGarbledTable(gate, m_vGarbleSlots[i].pos, m_pGates + gate->ingates.inputs.twin.left,
+				m_pGates + gate->ingates.inputs.twin.right, m_bGarbleMaskBuf + i * KEYS_PER_GATE_IN_TABLE * AES_BYTES);
 		m_nGarbledTableCtr++;
+	}
+
+	if (IsPipelinedGC()) {
+		AcknowledgePipelinedTables();
+	}
+}
 
-		//Pipelined receive - TODO: outsource in own thread
-		/*if(andctr >= GARBLED_TABLE_WINDOW) {
-		 gtsize = std::min(remandgates, GARBLED_TABLE_WINDOW);
-		 sock.Receive(m_vGarbledTables.GetArr(), gtsize * KEYS_PER_GATE_IN_TABLE * BYTES_SSP);
-		 remandgates -= gtsize;
-		 andctr=0;
-		 }*/
+void YaoClientSharing::ReceivePipelinedTables(uint64_t tablectr) {
+	uint64_t ntables;
 
+	//Receive the same windows the server sent, their tables are stored in the ring until they were evaluated
+	while (m_nGarbledTableRcvCtr < tablectr) {
+		ntables = std::min((uint64_t) GARBLED_TABLE_WINDOW, m_nPipelineLevelEndCtr - m_nGarbledTableRcvCtr);
+		assert(m_nGarbledTableRcvCtr + ntables <= m_nGarbledTableCtr + m_nGarbledTableRingSize);
+		for (uint64_t i = 0, n; i < ntables; i += n) {
+			n = GetContiguousGarbledTables(m_nGarbledTableRcvCtr + i, ntables - i);
+			m_tPipelineChan->blocking_receive(GetGarbledTable(m_nGarbledTableRcvCtr + i), n * m_nSecParamBytes * KEYS_PER_GATE_IN_TABLE);
+		}
+		m_nGarbledTableRcvCtr += ntables;
+		m_vPipelineWindowEnds.push_back(m_nGarbledTableRcvCtr);
 	}
-	UsedGate(idleft);
-	UsedGate(idright);
 }
 
-BOOL YaoClientSharing::EvaluateGarbledTable(GATE* gate, uint32_t pos, GATE* gleft, GATE* gright)
+void YaoClientSharing::AcknowledgePipelinedTables() {
+	uint64_t ack;
+
+	//Acknowledge every window once all of its tables were evaluated, such that the server can reuse its space in the ring
+	while (m_vPipelineWindowEnds.size() > 0 && m_vPipelineWindowEnds.front() <= m_nGarbledTableCtr) {
+		ack = m_vPipelineWindowEnds.front();
+		m_tPipelineChan->send((BYTE*) &ack, sizeof(uint64_t));
+		m_vPipelineWindowEnds.pop_front();
+	}
+}
+
+void YaoClientSharing::ReceivePipelinedOutputShares(const std::vector<uint32_t>& queue) {
+	uint32_t noutbits = 0;
+	GATE* gate;
+
+	for (uint32_t i = 0; i < queue.size(); i++) {
+		gate = m_pGates + queue[i];
+		if (gate->type == G_OUT && (gate->gs.oshare.dst == CLIENT || gate->gs.oshare.dst == ALL)) {
+			noutbits += gate->nvals;
+		}
+	}
+	if (noutbits == 0)
+		return;
+
+	//The server sends the shares of the clients output gates on this level, they are read starting at m_nClientOUTBitCtr
+	CBitVector rcvbuf(noutbits);
+	m_tPipelineChan->blocking_receive(rcvbuf.GetArr(), ceil_divide(noutbits, 8));
+	for (uint32_t i = 0; i < noutbits; i++) {
+		m_vOutputShareRcvBuf.SetBit(m_nClientOUTBitCtr + i, rcvbuf.GetBit(i));
+	}
+}
+
+BOOL YaoClientSharing::EvaluateGarbledTable(GATE* gate, uint32_t pos, GATE* gleft, GATE* gright, BYTE* masks)
 {
 
 	uint8_t *lkey, *rkey, *okey, *gtptr;
@@ -305,17 +436,15 @@ BOOL YaoClientSharing::EvaluateGarbledTable(GATE* gate, uint32_t pos, GATE* glef
 	okey = gate->gs.yval + pos * m_nSecParamBytes;
 	lkey = gleft->gs.yval + pos * m_nSecParamBytes;
 	rkey = gright->gs.yval + pos * m_nSecParamBytes;
-	gtptr = m_vGarbledCircuit.GetArr() + m_nSecParamBytes * KEYS_PER_GATE_IN_TABLE * m_nGarbledTableCtr;
+	gtptr = GetGarbledTable(m_nGarbledTableCtr);
 
 	lpbit = lkey[m_nSecParamBytes-1] & 0x01;
 	rpbit = rkey[m_nSecParamBytes-1] & 0x01;
 
 	assert(lpbit < 2 && rpbit < 2);
 
-	EncryptWire(m_vTmpEncBuf[0], lkey, KEYS_PER_GATE_IN_TABLE*m_nGarbledTableCtr);
-	EncryptWire(m_vTmpEncBuf[1], rkey, KEYS_PER_GATE_IN_TABLE*m_nGarbledTableCtr+1);
-
-	m_pKeyOps->XOR(okey, m_vTmpEncBuf[0], m_vTmpEncBuf[1]);//gc_xor(okey, encbuf[0], encbuf[1]);
+	//masks holds the encryptions of the left and right wire, as computed by EncryptWireBatch
+	m_pKeyOps->XOR(okey, masks, masks + AES_BYTES);//gc_xor(okey, encbuf[0], encbuf[1]);
 
 	if(lpbit) {
 		m_pKeyOps->XOR(okey, okey, gtptr);//gc_xor(okey, okey, gtptr);
@@ -334,9 +463,9 @@ BOOL YaoClientSharing::EvaluateGarbledTable(GATE* gate, uint32_t pos, GATE* glef
 		PrintKey(okey);
 		std::cout << " (" << (uint32_t) (okey[m_nSecParamBytes-1] & 0x01) << ")" << std::endl;
 		std::cout << "A: ";
-		PrintKey(m_vTmpEncBuf[0]);
+		PrintKey(masks);
 		std::cout << "; B: ";
-		PrintKey(m_vTmpEncBuf[1]);
+		PrintKey(masks + AES_BYTES);
 		std::cout << std::endl;
 		std::cout << "Table A: ";
 		PrintKey(gtptr);
@@ -355,6 +484,11 @@ void YaoClientSharing::EvaluateClientOutputGate(uint32_t gateid) {
 	uint32_t in;
 	InstantiateGate(gate);
 
+	//the output shares are streamed after the garbled circuit, in pipelined execution they were received on this level
+	if (!IsPipelinedGC()) {
+		m_pSetup->WaitForStreamEnd();
+	}
+
 #ifdef DEBUGYAOCLIENT
 	std::cout << "ClientOutput: ";
 #endif
@@ -538,6 +672,11 @@ void YaoClientSharing::FinishCircuitLayer(uint32_t level) {
 		m_vClientSendCorrectionGates.clear();
 	}
 
+	//All windows were acknowledged during the evaluation of the last level
+	if (m_tPipelineChan && level + 1 >= m_cBoolCircuit->GetMaxDepth()) {
+		ClosePipelineChannel();
+	}
+
 	InitNewLayer();
 }
 ;
@@ -598,9 +737,13 @@ void YaoClientSharing::AssignClientInputKeys() {
 	m_nClientRcvKeyCtr = 0;
 }
 
+uint64_t YaoClientSharing::GetGateValueBytes(GATE* gate) {
+	return m_nSecParamIters * gate->nvals * sizeof(UGATE_T);
+}
+
 void YaoClientSharing::InstantiateGate(GATE* gate) {
 	gate->instantiated = true;
-	gate->gs.yval = (BYTE*) calloc(m_nSecParamIters * gate->nvals, sizeof(UGATE_T));
+	gate->gs.yval = (BYTE*) AllocGateValue(gate, m_nSecParamIters * gate->nvals * sizeof(UGATE_T));
 }
 
 void YaoClientSharing::EvaluateSIMDGate(uint32_t gateid) {
@@ -731,12 +874,16 @@ void YaoClientSharing::Reset() {
 
 	m_nGarbledCircuitRcvCtr = 0;
 
+	//the stream into the buffers below has already ended in ABYSetup::Reset
+	m_pSetup = NULL;
+
 	m_vOutputShareRcvBuf.delCBitVector();
 	m_vOutputShareSndBuf.delCBitVector();
 
 	m_vClientSendCorrectionGates.clear();
 	m_vServerInputGates.clear();
 	m_vANDGates.clear();
+	m_vPendingANDGates.clear();
 	m_vOutputShareGates.clear();
 
 	m_vROTSndBuf.delCBitVector();
@@ -762,5 +909,10 @@ void YaoClientSharing::Reset() {
 	m_vGarbledCircuit.delCBitVector();
 	m_nGarbledTableCtr = 0;
 
+	ClosePipelineChannel();
+	m_nGarbledTableRcvCtr = 0L;
+	m_nPipelineLevelEndCtr = 0L;
+	m_vPipelineWindowEnds.clear();
+
 	m_cBoolCircuit->Reset();
 }
@@ -32,7 +32,8 @@ class YaoClientSharing: public YaoSharing {
 public:
 	/** Constructor of the class.*/
 	YaoClientSharing(e_sharing context, e_role role, uint32_t sharebitlen, ABYCircuit* circuit, crypto* crypt) :
-			YaoSharing(context, role, sharebitlen, circuit, crypt) {
+			YaoSharing(context, role, sharebitlen, circuit, crypt), m_pSetup(NULL), m_nGarbledTableRcvCtr(0), m_nPipelineLevelEndCtr(0),
+			m_vPipelineWindowEnds() {
 		InitClient();
 	}
 	;
@@ -53,6 +54,7 @@ public:
 	void PrepareOnlinePhase();
 
 	void InstantiateGate(GATE* gate);
+	uint64_t GetGateValueBytes(GATE* gate);
 
 	void GetDataToSend(std::vector<BYTE*>& sendbuf, std::vector<uint64_t>& bytesize);
 	void GetBuffersToReceive(std::vector<BYTE*>& rcvbuf, std::vector<uint64_t>& rcvbytes);
@@ -85,6 +87,11 @@ private:
 	std::vector<CBitVector> m_vClientKeyRcvBuf; /**< Client Key Receiver Buffer*/
 
 	uint32_t m_nGarbledCircuitRcvCtr;/**< Garbled Circuit Receiver Counter*/
+	ABYSetup* m_pSetup; /**< Setup that streams the garbled circuit and output shares, set in the setup phase*/
+
+	uint64_t m_nGarbledTableRcvCtr; /**< Number of garbled tables received in pipelined execution */
+	uint64_t m_nPipelineLevelEndCtr; /**< Number of garbled tables up to the end of the current level in pipelined execution */
+	std::deque<uint64_t> m_vPipelineWindowEnds; /**< Ends of the received windows that were not acknowledged yet */
 
 	CBitVector m_vOutputShareRcvBuf;/**< Output Share Receiver Buffer.*/
 	CBitVector m_vOutputShareSndBuf;/**< Output Share Sender Buffer*/
@@ -97,7 +104,6 @@ private:
 	CBitVector m_vROTSndBuf;/**< __________________*/
 	uint32_t m_vROTCtr;/**< __________________*/
 
-	uint8_t**			m_vTmpEncBuf;
 
 	/**
 	 Receive Server Keys from the given gateid.
@@ -127,18 +133,41 @@ private:
 	void EvaluateXORGate(GATE* gate);
 	/**
 	 Method for evaluating AND gate for the inputted
-	 gate object.
+	 gate object. The gate is added to the current batch and evaluated
+	 once the batch is processed by EvaluatePendingANDGates.
 	 \param gate		Gate Object
 	 */
 	void EvaluateANDGate(GATE* gate);
+	/**
+	 Evaluate all pending AND gates in batches of GARBLING_BATCH_SIZE tables and release their parents.
+	 */
+	void EvaluatePendingANDGates();
+	/**
+	 Hash the wire keys of the first nslots entries of the current batch and evaluate their garbled tables.
+	 \param nslots	Number of filled slots in the batch.
+	 */
+	void EvaluateBatch(uint32_t nslots);
+	/**
+	 Receive the windows of the pipelined execution until the garbled table tablectr-1 arrived.
+	 \param tablectr	Number of garbled tables that are needed.
+	 */
+	void ReceivePipelinedTables(uint64_t tablectr);
+	/** Acknowledge the received windows of the pipelined execution whose garbled tables were all evaluated. */
+	void AcknowledgePipelinedTables();
+	/**
+	 Receive the output shares of the client output gates on a level in pipelined execution.
+	 \param queue	Interactive queue of the level.
+	 */
+	void ReceivePipelinedOutputShares(const std::vector<uint32_t>& queue);
 	/**
 	 Method for evaluating garbled table.
 	 \param gate	gate Object.
 	 \param pos 		Position of the object in the queue.
 	 \param gleft	left gate in the queue.
 	 \param gright	right gate in the queue.
+	 \param masks	hashed keys of the left and right input wire, as AES_BYTES blocks
 	 */
-	BOOL EvaluateGarbledTable(GATE* gate, uint32_t pos, GATE* gleft, GATE* gright);
+	BOOL EvaluateGarbledTable(GATE* gate, uint32_t pos, GATE* gleft, GATE* gright, BYTE* masks);
 	/**
 	 Method for server output Gate for the inputted Gate.
 	 \param gate		Gate Object
@@ -168,7 +197,8 @@ private:
 	void EvaluateClientOutputGate(uint32_t gateid);
 
 	/**
-	 Method for receive Garbled Circuit And Output shares
+	 Method for receive Garbled Circuit And Output shares. Both are streamed in the background and waited for
+	 when they are needed during the evaluation.
 	 \param setup 	ABYSetup Object.
 	 */
 	void ReceiveGarbledCircuitAndOutputShares(ABYSetup* setup);
@@ -18,18 +18,75 @@
 
 #include "yaoserversharing.h"
 #include "../aby/abysetup.h"
+#include <ENCRYPTO_utils/thread.h>
+
+class YaoServerSharing::CGarblingThread: public CThread {
+public:
+	CGarblingThread(uint32_t id, YaoServerSharing* callback) :
+			threadid(id), m_pCallback(callback), m_evt(), m_eJob(e_Garble_Undefined), m_nStartSlot(0), m_nEndSlot(0),
+			m_kGarble((AES_KEY_CTX*) malloc(sizeof(AES_KEY_CTX))), m_bLKeyBuf((BYTE*) malloc(sizeof(BYTE) * callback->m_nSecParamBytes)) {
+		//every thread needs its own AES context and scratch buffer
+		m_pCallback->m_cCrypto->init_aes_key(m_kGarble, (uint8_t*) m_vFixedKeyAESSeed);
+	};
+	~CGarblingThread() {
+		m_pCallback->m_cCrypto->clean_aes_key(m_kGarble);
+		free(m_kGarble);
+		free(m_bLKeyBuf);
+	}
+	CGarblingThread(const CGarblingThread&) = delete;
+	CGarblingThread& operator=(const CGarblingThread&) = delete;
+
+	void PutJob(EGarbleJobType e, uint32_t start, uint32_t end) {
+		m_nStartSlot = start;
+		m_nEndSlot = end;
+		m_eJob = e;
+		m_evt.Set();
+	}
+
+	void ThreadMain();
+	uint32_t threadid;
+	YaoServerSharing* m_pCallback;
+	CEvent m_evt;
+	EGarbleJobType m_eJob;
+	uint32_t m_nStartSlot;
+	uint32_t m_nEndSlot;
+	AES_KEY_CTX* m_kGarble;
+	BYTE* m_bLKeyBuf;
+};
+
+void YaoServerSharing::CGarblingThread::ThreadMain() {
+	for (;;) {
+		m_evt.Wait();
+
+		switch (m_eJob) {
+		case e_Garble_Stop:
+			return;
+		case e_Garble_Batch:
+			m_pCallback->GarbleSlots(m_nStartSlot, m_nEndSlot, m_kGarble, m_bLKeyBuf);
+			break;
+		case e_Garble_Undefined:
+		default:
+			std::cerr << "Error: Unhandled Garbling Thread Job!" << std::endl;
+		}
+
+		m_pCallback->GarblingThreadDone();
+	}
+}
 
 void YaoServerSharing::InitServer() {
 
 	//Allocate memory that is needed when generating the garbled tables
 	for(uint32_t i = 0; i < 2; i++) {
-		m_bLMaskBuf[i] = (BYTE*) malloc(sizeof(BYTE) * m_nSecParamBytes);
-		m_bRMaskBuf[i] = (BYTE*) malloc(sizeof(BYTE) * m_nSecParamBytes);
 		m_bOKeyBuf[i] = (BYTE*) malloc(sizeof(BYTE) * m_nSecParamBytes);
 	}
 	m_bLKeyBuf = (BYTE*) malloc(sizeof(BYTE) * m_nSecParamBytes);
 	m_bTmpBuf = (BYTE*) malloc(sizeof(BYTE) * AES_BYTES);
 
+	//A batch holds GARBLING_BATCH_SIZE tables for each garbling thread, the threads are started by the first batch
+	if (m_nGarblingThreads > 1) {
+		ResizeGarbleBatch(GARBLING_BATCH_SIZE * m_nGarblingThreads);
+	}
+
 	m_vOutputDestionations = nullptr;
 
 	m_nGarbledTableCtr = 0L;
@@ -51,12 +108,17 @@ void YaoServerSharing::InitServer() {
 YaoServerSharing::~YaoServerSharing() {
 		Reset();
 		for(size_t i = 0; i < 2; i++) {
-			free(m_bLMaskBuf[i]);
-			free(m_bRMaskBuf[i]);
 			free(m_bOKeyBuf[i]);
 		}
 		free(m_bLKeyBuf);
 		free(m_bTmpBuf);
+		for (size_t i = 0; i < m_vGarblingThreads.size(); i++) {
+			m_vGarblingThreads[i]->PutJob(e_Garble_Stop, 0, 0);
+			m_vGarblingThreads[i]->Wait();
+			delete m_vGarblingThreads[i];
+		}
+		delete m_evtGarbling;
+		delete m_lockGarbling;
 		delete fMaskFct;
 }
 
@@ -68,13 +130,9 @@ void YaoServerSharing::InitNewLayer() {
 
 /* Send a new task for pre-computing the OTs in the setup phase */
 void YaoServerSharing::PrepareSetupPhase(ABYSetup* setup) {
-	BYTE* buf;
-	uint64_t gt_size;
 	uint32_t symbits = m_cCrypto->get_seclvl().symbits;
 	m_nANDGates = m_cBoolCircuit->GetNumANDGates();
 
-	gt_size = ((uint64_t) m_nANDGates) * KEYS_PER_GATE_IN_TABLE * m_nSecParamBytes;
-
 	/* If no gates were built, return */
 	if (m_cBoolCircuit->GetMaxDepth() == 0)
 		return;
@@ -86,8 +144,7 @@ void YaoServerSharing::PrepareSetupPhase(ABYSetup* setup) {
 
 	//m_vPreSetInputGates = (input_gate_val_t*) calloc(m_nServerInputBits, sizeof(input_gate_val_t));
 
-	buf = (BYTE*) malloc(gt_size);
-	m_vGarbledCircuit.AttachBuf(buf, gt_size);
+	CreateGarbledTableRing();
 
 	m_vR.Create(symbits, m_cCrypto);
 	m_vR.SetBit(symbits - 1, 1);
@@ -129,6 +186,18 @@ void YaoServerSharing::PrepareSetupPhase(ABYSetup* setup) {
 	m_nOutputDestionationsCtr = 0;
 	//std::deque<uint32_t> out = m_cBoolCircuit->GetOutputGatesForParty(CLIENT);
 
+	//The random OTs are taken from the pool of the setup phase if it holds enough of them
+	std::vector<mt_store_section> sections(1);
+	sections[0].bitlen = symbits;
+	sections[0].nmts = m_nClientInputBits + m_nConversionInputBits;
+	sections[0].abytes = 0;
+	sections[0].bcbytes = ceil_divide(sections[0].nmts * symbits, 8);
+	sections[0].A = NULL;
+	sections[0].B = m_vROTMasks[0].GetArr();
+	sections[0].C = m_vROTMasks[1].GetArr();
+	if (setup->TakeFromPool(m_eContext, sections))
+		return;
+
 	IKNP_OTTask* task = (IKNP_OTTask*) malloc(sizeof(IKNP_OTTask));
 	task->bitlen = symbits;
 	task->snd_flavor = Snd_R_OT;
@@ -148,6 +217,12 @@ void YaoServerSharing::PerformSetupPhase(ABYSetup* setup) {
 	if (m_cBoolCircuit->GetMaxDepth() == 0)
 		return;
 
+	//In pipelined execution the circuit is garbled level by level in the online phase
+	if (IsPipelinedGC()) {
+		OpenPipelineChannel(setup);
+		return;
+	}
+
 	CreateAndSendGarbledCircuit(setup);
 }
 
@@ -195,8 +270,16 @@ void YaoServerSharing::FinishSetupPhase(ABYSetup* setup) {
 }
 void YaoServerSharing::EvaluateLocalOperations(uint32_t depth) {
 	//only evalute the PRINT_VAL operation for debugging, all other work was pre-computed
-	std::deque<uint32_t> localqueue = m_cBoolCircuit->GetLocalQueueOnLvl(depth);
+	const std::vector<uint32_t>& localqueue = m_cBoolCircuit->GetLocalQueueOnLvl(depth);
 	GATE* gate;
+
+	//In pipelined execution garble this level now and send it, such that the client can evaluate it
+	if (IsPipelinedGC()) {
+		PrecomputeGC(localqueue, NULL);
+		GarblePendingANDGates(NULL);
+		SendPipelinedTables(TRUE);
+	}
+
 	for (uint32_t i = 0; i < localqueue.size(); i++) {
 		gate = m_pGates + localqueue[i];
 		if(gate->type == G_PRINT_VAL) {
@@ -210,15 +293,17 @@ void YaoServerSharing::EvaluateLocalOperations(uint32_t depth) {
 }
 
 void YaoServerSharing::EvaluateInteractiveOperations(uint32_t depth) {
-	std::deque<uint32_t> interactivequeue = m_cBoolCircuit->GetInteractiveQueueOnLvl(depth);
+	const std::vector<uint32_t>& interactivequeue = m_cBoolCircuit->GetInteractiveQueueOnLvl(depth);
 	GATE *gate, *parent;
 	e_role dst;
+	uint64_t permbitctr;
 
 	for (uint32_t i = 0; i < interactivequeue.size(); i++) {
 		gate = m_pGates + interactivequeue[i];
 #ifdef DEBUGYAOSERVER
 		std::cout << "Evaluating gate with id = " << interactivequeue[i] << ", and type = "<< get_gate_type_name(gate->type) << ", and depth = " << gate->depth << std::endl;
 #endif
+		permbitctr = m_nPermBitCtr;
 		switch (gate->type) {
 		case G_IN:
 			if (gate->gs.ishare.src == SERVER) {
@@ -228,12 +313,12 @@ void YaoServerSharing::EvaluateInteractiveOperations(uint32_t depth) {
 			}
 			break;
 		case G_OUT:
-			if (m_vOutputDestionations[m_nOutputDestionationsCtr] == SERVER ||
-					m_vOutputDestionations[m_nOutputDestionationsCtr] == ALL) {
+			//in pipelined execution the gate is garbled below and hence still holds its destination
+			dst = IsPipelinedGC() ? gate->gs.oshare.dst : m_vOutputDestionations[m_nOutputDestionationsCtr++];
+			if (dst == SERVER || dst == ALL) {
 				m_vServerOutputGates.push_back(gate);
 				m_nOutputShareRcvCtr += gate->nvals;
 			}
-			m_nOutputDestionationsCtr++;
 			//else do nothing since the client has already been given the output
 			break;
 		case G_CONV:
@@ -252,9 +337,52 @@ void YaoServerSharing::EvaluateInteractiveOperations(uint32_t depth) {
 			exit(0);
 		}
 
+		if (IsPipelinedGC()) {
+			GarbleInteractiveGate(interactivequeue[i], permbitctr);
+		}
+	}
+
+	//Send the output shares of the clients output gates on this level
+	if (IsPipelinedGC() && m_nOutputShareSndSize > 0) {
+		m_tPipelineChan->send(m_vOutputShareSndBuf.GetArr(), ceil_divide(m_nOutputShareSndSize, 8));
+		m_nOutputShareSndSize = 0;
 	}
 }
 
+void YaoServerSharing::GarbleInteractiveGate(uint32_t gateid, uint64_t permbitctr) {
+	GATE* gate = m_pGates + gateid;
+	e_role dst;
+
+	//The online evaluation of the gate already advanced the counters, hence garbling has to start from their previous
+	//values. In contrast to the online phase, the client input keys are counted over all levels.
+	uint64_t onlinepermbitctr = m_nPermBitCtr;
+	uint32_t onlineclientinbitctr = m_nClientInBitCtr;
+	size_t onlineclientinputgates = m_vClientInputGate.size();
+	m_nPermBitCtr = permbitctr;
+	m_nClientInBitCtr = m_nGarbledClientInBitCtr;
+
+	if (gate->type == G_IN) {
+		EvaluateInputGate(gateid);
+	} else if (gate->type == G_OUT) {
+		dst = gate->gs.oshare.dst;
+		EvaluateOutputGate(gate);
+		if (dst == CLIENT || dst == ALL) {
+			for (uint32_t j = 0; j < gate->nvals; j++, m_nOutputShareSndSize++) {
+				m_vOutputShareSndBuf.SetBit(m_nOutputShareSndSize, !!((gate->gs.val[j / GATE_T_BITS]) & ((UGATE_T) 1 << (j % GATE_T_BITS))));
+			}
+		}
+	} else if (gate->type == G_CONV && m_pGates[gate->ingates.inputs.parents[0]].context == S_ARITH) {
+		EvaluateConversionGate(gateid);
+	}
+	//Conversions from Boolean and Yao sharing were garbled by their online evaluation and callbacks were already called
+
+	m_nGarbledClientInBitCtr = m_nClientInBitCtr;
+	m_nPermBitCtr = onlinepermbitctr;
+	m_nClientInBitCtr = onlineclientinbitctr;
+	//the client input gates were already queued by the online evaluation
+	m_vClientInputGate.resize(onlineclientinputgates);
+}
+
 void YaoServerSharing::SendConversionValues(uint32_t gateid) {
 	GATE* gate = m_pGates + gateid;
 	GATE* parent = m_pGates + gate->ingates.inputs.parents[0];
@@ -327,10 +455,12 @@ void YaoServerSharing::CreateAndSendGarbledCircuit(ABYSetup* setup) {
 		return;
 
 	for (uint32_t i = 0; i < maxdepth; i++) {
-		std::deque<uint32_t> localqueue = m_cBoolCircuit->GetLocalQueueOnLvl(i);
+		const std::vector<uint32_t>& localqueue = m_cBoolCircuit->GetLocalQueueOnLvl(i);
 		PrecomputeGC(localqueue, setup);
-		std::deque<uint32_t> interactivequeue = m_cBoolCircuit->GetInteractiveQueueOnLvl(i);
+		const std::vector<uint32_t>& interactivequeue = m_cBoolCircuit->GetInteractiveQueueOnLvl(i);
 		PrecomputeGC(interactivequeue, setup);
+		//Garble the remaining AND gates of this level
+		GarblePendingANDGates(setup);
 	}
 	//Store the shares of the clients output gates
 	CollectClientOutputShares();
@@ -341,8 +471,11 @@ void YaoServerSharing::CreateAndSendGarbledCircuit(ABYSetup* setup) {
 				(m_nGarbledTableCtr - m_nGarbledTableSndCtr) * m_nSecParamBytes * KEYS_PER_GATE_IN_TABLE);
 		m_nGarbledTableSndCtr = m_nGarbledTableCtr;
 	}
-	if (m_cBoolCircuit->GetNumOutputBitsForParty(CLIENT) > 0) {
-		setup->AddSendTask(m_vOutputShareSndBuf.GetArr(), ceil_divide(m_cBoolCircuit->GetNumOutputBitsForParty(CLIENT), 8));
+	//The output shares are streamed after the garbled circuit and hence are sent in windows as well
+	uint64_t outbytes = ceil_divide(m_cBoolCircuit->GetNumOutputBitsForParty(CLIENT), 8);
+	uint64_t windowbytes = (uint64_t) GARBLED_TABLE_WINDOW * m_nSecParamBytes * KEYS_PER_GATE_IN_TABLE;
+	for (uint64_t pos = 0; pos < outbytes; pos += windowbytes) {
+		setup->AddSendTask(m_vOutputShareSndBuf.GetArr() + pos, std::min(windowbytes, outbytes - pos));
 	}
 #ifdef DEBUGYAOSERVER
 	std::cout << "Sending Garbled Circuit: ";
@@ -353,7 +486,7 @@ void YaoServerSharing::CreateAndSendGarbledCircuit(ABYSetup* setup) {
 
 }
 
-void YaoServerSharing::PrecomputeGC(std::deque<uint32_t>& queue, ABYSetup* setup) {
+void YaoServerSharing::PrecomputeGC(const std::vector<uint32_t>& queue, ABYSetup* setup) {
 	for (uint32_t i = 0; i < queue.size(); i++) {
 		GATE* gate = m_pGates + queue[i];
 #ifdef DEBUGYAOSERVER
@@ -362,10 +495,15 @@ void YaoServerSharing::PrecomputeGC(std::deque<uint32_t>& queue, ABYSetup* setup
 #endif
 		assert(gate->nvals > 0 && gate->sharebitlen == 1);
 
+		//AND gates are garbled in batches, hence their keys have to be computed before they can be read
+		if (m_vPendingANDGates.size() > 0 && DependsOnPendingANDGates(gate)) {
+			GarblePendingANDGates(setup);
+		}
+
 		if (gate->type == G_LIN) {
 			EvaluateXORGate(gate);
 		} else if (gate->type == G_NON_LIN) {
-			EvaluateANDGate(gate, setup);
+			EvaluateANDGate(gate);
 		} else if (gate->type == G_IN) {
 			EvaluateInputGate(queue[i]);
 		} else if (gate->type == G_OUT) {
@@ -439,7 +577,8 @@ void YaoServerSharing::EvaluateInputGate(uint32_t gateid) {
 	GATE* gate = m_pGates + gateid;
 	if (gate->gs.ishare.src == SERVER) {
 
-		if(gate->instantiated) {
+		//in pipelined execution the input was already sent and is not restored
+		if(gate->instantiated && !IsPipelinedGC()) {
 			input_gate_val_t ingatevals;
 			ingatevals.gateid = gateid;
 			ingatevals.inval = gate->gs.ishare.inval;
@@ -502,10 +641,12 @@ void YaoServerSharing::EvaluateConversionGate(uint32_t gateid) {
 		std::cout << "Evaluating arithmetic conversion gate with gateid = " << gateid << " and pos = " << pos;
 #endif
 		//Convert server's share
-		a2y_gate_pos_t a2ygate;
-		a2ygate.gateid = gateid;
-		a2ygate.pos = pos;
-		m_vPreSetA2YPositions.push_back(a2ygate);
+		if (!IsPipelinedGC()) {
+			a2y_gate_pos_t a2ygate;
+			a2ygate.gateid = gateid;
+			a2ygate.pos = pos;
+			m_vPreSetA2YPositions.push_back(a2ygate);
+		}
 		if((pos & 0x01) == 0) {
 #ifdef DEBUGYAOSERVER
 			std::cout << " converting server share" << std::endl;
@@ -574,36 +715,166 @@ void YaoServerSharing::EvaluateXORGate(GATE* gate) {
 	UsedGate(idright);
 }
 
-//Evaluate an AND gate
-void YaoServerSharing::EvaluateANDGate(GATE* gate, ABYSetup* setup) {
-	uint32_t idleft = gate->ingates.inputs.twin.left;//gate->gs.ginput.left;
-	uint32_t idright = gate->ingates.inputs.twin.right;//gate->gs.ginput.right;
+//Evaluate an AND gate: only schedule it, the garbled tables are computed in GarblePendingANDGates.
+//The gate is instantiated when it is garbled, which is how DependsOnPendingANDGates recognizes pending gates.
+void YaoServerSharing::EvaluateANDGate(GATE* gate) {
+	m_vPendingANDGates.push_back(gate);
+}
 
-	GATE* gleft = m_pGates + idleft;
-	GATE* gright = m_pGates + idright;
+void YaoServerSharing::GarblePendingANDGates(ABYSetup* setup) {
+	uint32_t nslots = 0;
+	GATE *gate, *gleft, *gright;
 
-	InstantiateGate(gate);
+	for (uint32_t i = 0; i < m_vPendingANDGates.size(); i++) {
+		gate = m_vPendingANDGates[i];
+		gleft = m_pGates + gate->ingates.inputs.twin.left;
+		gright = m_pGates + gate->ingates.inputs.twin.right;
+
+		InstantiateGate(gate);
+
+		for (uint32_t g = 0; g < gate->nvals; g++) {
+			m_vGarbleSlots[nslots].gate = gate;
+			m_vGarbleSlots[nslots].pos = g;
+			//the tables of the batch are written in order, starting at m_nGarbledTableCtr
+			PrepareGarbledTable(g, gleft, gright, m_nGarbledTableCtr + nslots,
+					m_bGarbleTweakBuf + nslots * WIRE_ENCRYPTIONS_PER_GATE * AES_BYTES);
+			nslots++;
+			if (nslots == m_nGarbleBatchSize) {
+				GarbleBatch(nslots, setup);
+				nslots = 0;
+			}
+		}
+	}
+	if (nslots > 0) {
+		GarbleBatch(nslots, setup);
+	}
 
-	for(uint32_t g = 0; g < gate->nvals; g++) {
-		CreateGarbledTable(gate, g, gleft, gright);
-		m_nGarbledTableCtr++;
-		assert(gate->gs.yinput.pi[g] < 2);
+	//The keys of the parents are no longer needed for garbling
+	for (uint32_t i = 0; i < m_vPendingANDGates.size(); i++) {
+		UsedGate(m_vPendingANDGates[i]->ingates.inputs.twin.left);
+		UsedGate(m_vPendingANDGates[i]->ingates.inputs.twin.right);
+	}
+	m_vPendingANDGates.clear();
+}
 
+void YaoServerSharing::StartGarblingThreads() {
+	m_evtGarbling = new CEvent();
+	m_lockGarbling = new CLock();
+	m_vGarblingThreads.resize(m_nGarblingThreads);
+	for (uint32_t i = 0; i < m_nGarblingThreads; i++) {
+		m_vGarblingThreads[i] = new CGarblingThread(i, this);
+		m_vGarblingThreads[i]->Start();
 	}
+}
 
-	if((m_nGarbledTableCtr - m_nGarbledTableSndCtr) >= GARBLED_TABLE_WINDOW) {
-		//setup->AddSendTask(m_vGarbledCircuit.GetArr(), m_nGarbledTableCtr * m_nSecParamBytes * KEYS_PER_GATE_IN_TABLE);
+void YaoServerSharing::GarbleBatch(uint32_t nslots, ABYSetup* setup) {
+	uint32_t nthreads = m_nGarblingThreads;
+
+	//batches below the share of one thread are not worth the synchronization with the threads
+	if (nthreads > 1 && nslots > m_nGarbleBatchSize / nthreads) {
+		//only the sharing that garbles starts its threads, the server sharing of the other direction often never does
+		if (m_vGarblingThreads.empty())
+			StartGarblingThreads();
+		uint32_t slotsperthread = ceil_divide(nslots, nthreads);
+		uint32_t nworking = ceil_divide(nslots, slotsperthread);
+
+		m_nWorkingGarblingThreads = nworking;
+		for (uint32_t i = 0; i < nworking; i++) {
+			m_vGarblingThreads[i]->PutJob(e_Garble_Batch, i * slotsperthread, std::min(nslots, (i + 1) * slotsperthread));
+		}
+		for (;;) {
+			m_lockGarbling->Lock();
+			uint32_t n = m_nWorkingGarblingThreads;
+			m_lockGarbling->Unlock();
+			if (!n)
+				break;
+			m_evtGarbling->Wait();
+		}
+	} else {
+		GarbleSlots(0, nslots, m_kGarble, m_bLKeyBuf);
+	}
+	m_nGarbledTableCtr += nslots;
+
+	if (IsPipelinedGC()) {
+		SendPipelinedTables(FALSE);
+		return;
+	}
+
+	//Stream the garbled tables in windows of exactly GARBLED_TABLE_WINDOW tables, such that the client can evaluate each window once it arrived
+	while((m_nGarbledTableCtr - m_nGarbledTableSndCtr) >= GARBLED_TABLE_WINDOW) {
 		setup->AddSendTask(m_vGarbledCircuit.GetArr() + m_nGarbledTableSndCtr * m_nSecParamBytes * KEYS_PER_GATE_IN_TABLE,
-				(m_nGarbledTableCtr - m_nGarbledTableSndCtr) * m_nSecParamBytes * KEYS_PER_GATE_IN_TABLE);
-		m_nGarbledTableSndCtr = m_nGarbledTableCtr;
+				GARBLED_TABLE_WINDOW * m_nSecParamBytes * KEYS_PER_GATE_IN_TABLE);
+		m_nGarbledTableSndCtr += GARBLED_TABLE_WINDOW;
 	}
+}
 
-	UsedGate(idleft);
-	UsedGate(idright);
+void YaoServerSharing::SendPipelinedTables(BOOL flush) {
+	uint64_t ntables = std::min((uint64_t) GARBLED_TABLE_WINDOW, m_nGarbledTableCtr - m_nGarbledTableSndCtr);
+
+	while (ntables == GARBLED_TABLE_WINDOW || (flush && ntables > 0)) {
+		//At most one ring of garbled tables is in transit, the client acknowledges each window once it evaluated it
+		while (m_nGarbledTableSndCtr + ntables > m_nGarbledTableAckCtr + m_nGarbledTableRingSize) {
+			ReceivePipelineAck();
+		}
+		for (uint64_t i = 0, n; i < ntables; i += n) {
+			n = GetContiguousGarbledTables(m_nGarbledTableSndCtr + i, ntables - i);
+			m_tPipelineChan->send(GetGarbledTable(m_nGarbledTableSndCtr + i), n * m_nSecParamBytes * KEYS_PER_GATE_IN_TABLE);
+		}
+		m_nGarbledTableSndCtr += ntables;
+		m_nPipelineWindowCtr++;
+
+		ntables = std::min((uint64_t) GARBLED_TABLE_WINDOW, m_nGarbledTableCtr - m_nGarbledTableSndCtr);
+	}
+}
+
+void YaoServerSharing::ReceivePipelineAck() {
+	uint64_t ack;
+	m_tPipelineChan->blocking_receive((BYTE*) &ack, sizeof(uint64_t));
+	m_nGarbledTableAckCtr = ack;
+	m_nPipelineAckCtr++;
+}
+
+void YaoServerSharing::GarbleSlots(uint32_t start, uint32_t end, AES_KEY_CTX* aeskey, BYTE* lkeybuf) {
+	GATE* gate;
+	uint32_t pos;
+
+	EncryptWireBatch(m_bGarbleMaskBuf + start * WIRE_ENCRYPTIONS_PER_GATE * AES_BYTES,
+			m_bGarbleTweakBuf + start * WIRE_ENCRYPTIONS_PER_GATE * AES_BYTES, (end - start) * WIRE_ENCRYPTIONS_PER_GATE, aeskey);
+
+	for (uint32_t i = start; i < end; i++) {
+		gate = m_vGarbleSlots[i].gate;
+		pos = m_vGarbleSlots[i].pos;
+		CreateGarbledTable(gate, pos, m_pGates + gate->ingates.inputs.twin.left, m_pGates + gate->ingates.inputs.twin.right,
+				m_bGarbleMaskBuf + i * WIRE_ENCRYPTIONS_PER_GATE * AES_BYTES, m_nGarbledTableCtr + i, lkeybuf);
+		assert(gate->gs.yinput.pi[pos] < 2);
+	}
+}
+
+void YaoServerSharing::GarblingThreadDone() {
+	m_lockGarbling->Lock();
+	uint32_t n = --m_nWorkingGarblingThreads;
+	m_lockGarbling->Unlock();
+
+	if (!n)
+		m_evtGarbling->Set();
 }
 
+void YaoServerSharing::PrepareGarbledTable(uint32_t pos, GATE* gleft, GATE* gright, uint64_t tablectr, BYTE* tweaks) {
+	uint8_t* lkey = gleft->gs.yinput.outKey + pos * m_nSecParamBytes;
+	uint8_t* rkey = gright->gs.yinput.outKey + pos * m_nSecParamBytes;
+
+	//Encryptions of wire A
+	PrepareWireTweak(tweaks, lkey, KEYS_PER_GATE_IN_TABLE*tablectr);
+	m_pKeyOps->XOR(m_bTmpBuf, lkey, m_vR.GetArr());
+	PrepareWireTweak(tweaks + AES_BYTES, m_bTmpBuf, KEYS_PER_GATE_IN_TABLE*tablectr);
+
+	//Encryptions of wire B
+	PrepareWireTweak(tweaks + 2 * AES_BYTES, rkey, KEYS_PER_GATE_IN_TABLE*tablectr+1);
+	m_pKeyOps->XOR(m_bTmpBuf, rkey, m_vR.GetArr());
+	PrepareWireTweak(tweaks + 3 * AES_BYTES, m_bTmpBuf, KEYS_PER_GATE_IN_TABLE*tablectr+1);
+}
 
-void YaoServerSharing::CreateGarbledTable(GATE* ggate, uint32_t pos, GATE* gleft, GATE* gright){
+void YaoServerSharing::CreateGarbledTable(GATE* ggate, uint32_t pos, GATE* gleft, GATE* gright, BYTE* masks, uint64_t tablectr, BYTE* lkeybuf){
 
 	uint32_t outkey;
 
@@ -611,10 +882,11 @@ void YaoServerSharing::CreateGarbledTable(GATE* ggate, uint32_t pos, GATE* gleft
 	uint8_t lpbit = gleft->gs.yinput.pi[pos];
 	uint8_t rpbit = gright->gs.yinput.pi[pos];
 	uint8_t lsbit, rsbit;
+	uint8_t *lmask[2], *rmask[2];
 
 	assert(lpbit < 2 && rpbit < 2);
 
-	table = m_vGarbledCircuit.GetArr() + m_nGarbledTableCtr * KEYS_PER_GATE_IN_TABLE * m_nSecParamBytes;
+	table = GetGarbledTable(tablectr);
 	outwire_key = ggate->gs.yinput.outKey + pos * m_nSecParamBytes;
 
 	lkey = gleft->gs.yinput.outKey + pos * m_nSecParamBytes;
@@ -624,32 +896,28 @@ void YaoServerSharing::CreateGarbledTable(GATE* ggate, uint32_t pos, GATE* gleft
 	rsbit = (rkey[m_nSecParamBytes-1] & 0x01);
 
 	if(lpbit) {
-		m_pKeyOps->XOR(m_bLKeyBuf, lkey, m_vR.GetArr());
+		m_pKeyOps->XOR(lkeybuf, lkey, m_vR.GetArr());
 	} else {
-		memcpy(m_bLKeyBuf, lkey, m_nSecParamBytes);
+		memcpy(lkeybuf, lkey, m_nSecParamBytes);
 	}
 
-	//Encryptions of wire A
-	EncryptWire(m_bLMaskBuf[lpbit], lkey, KEYS_PER_GATE_IN_TABLE*m_nGarbledTableCtr);
-	m_pKeyOps->XOR(m_bTmpBuf, lkey, m_vR.GetArr());
-	EncryptWire(m_bLMaskBuf[!lpbit], m_bTmpBuf, KEYS_PER_GATE_IN_TABLE*m_nGarbledTableCtr);
-
-	//Encryptions of wire B
-	EncryptWire(m_bRMaskBuf[rpbit], rkey, KEYS_PER_GATE_IN_TABLE*m_nGarbledTableCtr+1);
-	m_pKeyOps->XOR(m_bTmpBuf, rkey, m_vR.GetArr());
-	EncryptWire(m_bRMaskBuf[!rpbit], m_bTmpBuf, KEYS_PER_GATE_IN_TABLE*m_nGarbledTableCtr+1);
+	//Encryptions of wire A and B, as computed by PrepareGarbledTable and EncryptWireBatch
+	lmask[lpbit] = masks;
+	lmask[!lpbit] = masks + AES_BYTES;
+	rmask[rpbit] = masks + 2 * AES_BYTES;
+	rmask[!rpbit] = masks + 3 * AES_BYTES;
 
 	//Compute two table entries, T_G is the first cipher-text, T_E the second cipher-text
 	//Compute T_G = Enc(W_a^0) XOR Enc(W_a^1) XOR p_b*R
 
-	m_pKeyOps->XOR(table, m_bLMaskBuf[0], m_bLMaskBuf[1]);
+	m_pKeyOps->XOR(table, lmask[0], lmask[1]);
 	if(rpbit)
 		m_pKeyOps->XOR(table, table, m_vR.GetArr());
 
 	if(lpbit)
-		m_pKeyOps->XOR(outwire_key, m_bLMaskBuf[1], m_bRMaskBuf[0]);
+		m_pKeyOps->XOR(outwire_key, lmask[1], rmask[0]);
 	else
-		m_pKeyOps->XOR(outwire_key, m_bLMaskBuf[0], m_bRMaskBuf[0]);
+		m_pKeyOps->XOR(outwire_key, lmask[0], rmask[0]);
 
 	if((lsbit) & (rsbit))
 		m_pKeyOps->XOR(outwire_key, outwire_key, m_vR.GetArr());
@@ -658,14 +926,14 @@ void YaoServerSharing::CreateGarbledTable(GATE* ggate, uint32_t pos, GATE* gleft
 	//Compute W^0 = W_G^0 XOR W_E^0 = Enc(W_a^0) XOR Enc(W_b^0) XOR p_a*T_G XOR p_b * (T_E XOR W_a^0)
 
 	//Compute T_E = Enc(W_b^0) XOR Enc(W_b^1) XOR W_a^0
-	m_pKeyOps->XOR(table + m_nSecParamBytes, m_bRMaskBuf[0], m_bRMaskBuf[1]);
-	m_pKeyOps->XOR(table + m_nSecParamBytes, table + m_nSecParamBytes, m_bLKeyBuf);
+	m_pKeyOps->XOR(table + m_nSecParamBytes, rmask[0], rmask[1]);
+	m_pKeyOps->XOR(table + m_nSecParamBytes, table + m_nSecParamBytes, lkeybuf);
 
 	//Compute the resulting key for the output wire
 	if(rpbit) {
 		//std::cout << "Server Xoring right_table" << std::endl;
 		m_pKeyOps->XOR(outwire_key, outwire_key, table + m_nSecParamBytes);
-		m_pKeyOps->XOR(outwire_key, outwire_key, m_bLKeyBuf);
+		m_pKeyOps->XOR(outwire_key, outwire_key, lkeybuf);
 	}
 
 	//Set permutation bit
@@ -685,13 +953,13 @@ void YaoServerSharing::CreateGarbledTable(GATE* ggate, uint32_t pos, GATE* gleft
 		PrintKey(outwire_key);
 		std::cout << " (" << (uint32_t) ggate->gs.yinput.pi[pos] << ")" << std::endl;
 		std::cout << "A_0: ";
-		PrintKey(m_bLMaskBuf[0]);
+		PrintKey(lmask[0]);
 		std::cout << "; A_1: ";
-		PrintKey(m_bLMaskBuf[1]);
+		PrintKey(lmask[1]);
 		std::cout << std::endl << "B_0: ";
-		PrintKey(m_bRMaskBuf[0]);
+		PrintKey(rmask[0]);
 		std::cout << "; B_1: ";
-		PrintKey(m_bRMaskBuf[1]);
+		PrintKey(rmask[1]);
 
 		std::cout << std::endl << "Table A: ";
 		PrintKey(table);
@@ -723,7 +991,7 @@ void YaoServerSharing::EvaluateOutputGate(GATE* gate) {
 	//std::cout << "After" << std::endl;
 	//InstantiateGate(gate);
 
-	gate->gs.val = (UGATE_T*) calloc(ceil_divide(gate->nvals, GATE_T_BITS), sizeof(UGATE_T));
+	gate->gs.val = (UGATE_T*) AllocGateValue(gate, ceil_divide(gate->nvals, GATE_T_BITS) * sizeof(UGATE_T));
 	gate->instantiated = true;
 	for (uint32_t i = 0; i < gate->nvals; i++) {
 		gate->gs.val[i / GATE_T_BITS] |= (((UGATE_T) m_pGates[parentid].gs.yinput.pi[i]) << (i % GATE_T_BITS));
@@ -868,6 +1136,14 @@ void YaoServerSharing::FinishCircuitLayer(uint32_t level) {
 		AssignOutputShares();
 	}
 
+	//The client acknowledges every window, collect the remaining acknowledgements after the last level
+	if (m_tPipelineChan && level + 1 >= m_cBoolCircuit->GetMaxDepth()) {
+		while (m_nPipelineAckCtr < m_nPipelineWindowCtr) {
+			ReceivePipelineAck();
+		}
+		ClosePipelineChannel();
+	}
+
 	//Recheck if this is working
 	InitNewLayer();
 }
@@ -926,12 +1202,10 @@ void YaoServerSharing::CreateRandomWireKeys(CBitVector& vec, uint32_t numkeys) {
 }
 
 void YaoServerSharing::InstantiateGate(GATE* gate) {
-	gate->gs.yinput.outKey = (BYTE*) malloc(sizeof(UGATE_T) * m_nSecParamIters * gate->nvals);
-	gate->gs.yinput.pi = (BYTE*) malloc(sizeof(BYTE) * gate->nvals);
-	if (gate->gs.yinput.outKey == NULL) {
-		std::cerr << "Memory allocation not successful at Yao gate instantiation" << std::endl;
-		exit(0);
-	}
+	//the permutation bits are kept behind the keys, such that both take a single block
+	uint64_t keybytes = sizeof(UGATE_T) * m_nSecParamIters * gate->nvals;
+	gate->gs.yinput.outKey = (BYTE*) AllocGateValue(gate, keybytes + gate->nvals, FALSE);
+	gate->gs.yinput.pi = gate->gs.yinput.outKey + keybytes;
 	gate->instantiated = true;
 }
 
@@ -1074,6 +1348,7 @@ void YaoServerSharing::Reset() {
 
 	m_vClientInputGate.clear();
 	m_vANDGates.clear();
+	m_vPendingANDGates.clear();
 	m_vOutputShareGates.clear();
 	m_vServerOutputGates.clear();
 
@@ -1102,6 +1377,12 @@ void YaoServerSharing::Reset() {
 	m_nGarbledTableCtr = 0;
 	m_nGarbledTableSndCtr = 0L;
 
+	ClosePipelineChannel();
+	m_nGarbledTableAckCtr = 0L;
+	m_nPipelineWindowCtr = 0L;
+	m_nPipelineAckCtr = 0L;
+	m_nGarbledClientInBitCtr = 0;
+
 
 	m_cBoolCircuit->Reset();
 }
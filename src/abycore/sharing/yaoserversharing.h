@@ -25,6 +25,8 @@
 #include <vector>
 #include "yaosharing.h"
 
+class CEvent;
+class CLock;
 
 //#define DEBUGYAOSERVER
 /**
@@ -35,9 +37,12 @@ class YaoServerSharing: public YaoSharing {
 public:
 	/**
 	 Constructor of the class.
+	 \param nthreads	Number of threads that garble the independent AND gates of a batch
 	 */
-	YaoServerSharing(e_sharing context, e_role role, uint32_t sharebitlen, ABYCircuit* circuit, crypto* crypt) :
-			YaoSharing(context, role, sharebitlen, circuit, crypt) {
+	YaoServerSharing(e_sharing context, e_role role, uint32_t sharebitlen, ABYCircuit* circuit, crypto* crypt, uint32_t nthreads = 1) :
+			YaoSharing(context, role, sharebitlen, circuit, crypt), m_nGarbledTableAckCtr(0), m_nPipelineWindowCtr(0),
+			m_nPipelineAckCtr(0), m_nGarbledClientInBitCtr(0), m_vGarblingThreads(), m_evtGarbling(NULL), m_lockGarbling(NULL),
+			m_nWorkingGarblingThreads(0), m_nGarblingThreads(nthreads) {
 		InitServer();
 	}
 	;
@@ -85,6 +90,11 @@ private:
 
 	uint64_t m_nGarbledTableSndCtr;
 
+	uint64_t m_nGarbledTableAckCtr; /**< Number of garbled tables the client evaluated in pipelined execution */
+	uint64_t m_nPipelineWindowCtr; /**< Number of windows sent in pipelined execution */
+	uint64_t m_nPipelineAckCtr; /**< Number of acknowledged windows in pipelined execution */
+	uint32_t m_nGarbledClientInBitCtr; /**< Number of garbled client input bits over all levels in pipelined execution */
+
 	CBitVector m_vServerKeySndBuf; /**< Server Key Sender Buffer*/
 	std::vector<CBitVector> m_vClientKeySndBuf; /**< Client Key Sender Buffer*/
 	CBitVector m_vClientROTRcvBuf; /**< Client ______________*/
@@ -105,13 +115,23 @@ private:
 	uint32_t m_nServerKeyCtr; /**< _____________*/
 	uint32_t m_nClientInBitCtr; /**< _____________*/
 
-	uint8_t* m_bLMaskBuf[2]; /**< _____________*/
-	uint8_t* m_bRMaskBuf[2]; /**< _____________*/
 	uint8_t* m_bLKeyBuf; /**< _____________*/
 	uint8_t* m_bOKeyBuf[2]; /**< _____________*/
 	uint8_t* m_bTmpBuf;
 	//CBitVector
 
+	enum EGarbleJobType {
+		e_Garble_Batch, e_Garble_Stop, e_Garble_Undefined
+	};
+
+	class CGarblingThread;
+
+	std::vector<CGarblingThread*> m_vGarblingThreads; /**< Worker threads that garble parts of a batch, empty until the first batch that is split */
+	CEvent* m_evtGarbling; /**< Signals that all garbling threads are done */
+	CLock* m_lockGarbling; /**< Protects m_nWorkingGarblingThreads */
+	uint32_t m_nWorkingGarblingThreads; /**< Number of garbling threads that still work on the current batch */
+	uint32_t m_nGarblingThreads; /**< Number of garbling threads, 1 if the batches are garbled by the calling thread */
+
 	std::vector<uint32_t> m_vClientInputGate; /**< _____________*/
 	std::deque<input_gate_val_t> m_vPreSetInputGates;/**< _____________*/
 	std::deque<a2y_gate_pos_t> m_vPreSetA2YPositions;/**< _____________*/
@@ -121,8 +141,10 @@ private:
 
 	//std::deque<uint32_t> 			m_vClientInputGate;
 
-	/**Initialising the server. */
+	/**Initialising the server.*/
 	void InitServer();
+	/**Start the garbling threads and their synchronization objects.*/
+	void StartGarblingThreads();
 	/**Initialising a new layer.*/
 	void InitNewLayer();
 
@@ -155,10 +177,11 @@ private:
 	void EvaluateXORGate(GATE* gate);
 	/**
 	 Method for evaluating AND gate for the inputted
-	 gate object.
+	 gate object. The gate is added to the garbling batch and garbled once
+	 the batch is flushed by GarblePendingANDGates.
 	 \param gate		Gate Object
 	 */
-	void EvaluateANDGate(GATE* gate, ABYSetup* setup);
+	void EvaluateANDGate(GATE* gate);
 	/**
 	 Method for evaluating SIMD gate for the inputted
 	 gateid.
@@ -183,14 +206,63 @@ private:
 	 \param pos 		Position of the object in the queue.
 	 \param gleft	left gate in the queue.
 	 \param gright	right gate in the queue.
+	 \param masks	hashed keys of the input wires in the order left^0, left^1, right^0, right^1, as AES_BYTES blocks
+	 \param tablectr	Index of the garbled table in m_vGarbledCircuit.
+	 \param lkeybuf	Scratch buffer of m_nSecParamBytes bytes that is exclusive to the calling thread.
+	 */
+	void CreateGarbledTable(GATE* ggate, uint32_t pos, GATE* gleft, GATE* gright, BYTE* masks, uint64_t tablectr, BYTE* lkeybuf);
+	/**
+	 Write the AES inputs of the four wire key encryptions of an AND gate position to the batch buffer.
+	 \param pos 		Position in the SIMD gate.
+	 \param gleft	left gate.
+	 \param gright	right gate.
+	 \param tablectr	Index of the garbled table that is created for this position.
+	 \param tweaks	Destination of WIRE_ENCRYPTIONS_PER_GATE * AES_BYTES bytes.
+	 */
+	void PrepareGarbledTable(uint32_t pos, GATE* gleft, GATE* gright, uint64_t tablectr, BYTE* tweaks);
+	/**
+	 Garble all pending AND gates in batches of GARBLING_BATCH_SIZE tables and release their parents.
+	 \param setup	Is needed to perform pipelined sending of the circuit
+	 */
+	void GarblePendingANDGates(ABYSetup* setup);
+	/**
+	 Hash the wire keys of the first nslots entries of the current garbling batch and write their garbled tables.
+	 The slots are split evenly across the garbling threads.
+	 \param nslots	Number of filled slots in the batch.
+	 \param setup	Is needed to perform pipelined sending of the circuit
+	 */
+	void GarbleBatch(uint32_t nslots, ABYSetup* setup);
+	/**
+	 Garble the slots [start, end) of the current batch. The slots are independent and their table positions are
+	 fixed by their index, hence disjoint ranges can be garbled concurrently.
+	 \param start	First slot.
+	 \param end		Slot after the last slot.
+	 \param aeskey	Fixed-key AES context that is exclusive to the calling thread.
+	 \param lkeybuf	Scratch buffer of m_nSecParamBytes bytes that is exclusive to the calling thread.
+	 */
+	void GarbleSlots(uint32_t start, uint32_t end, AES_KEY_CTX* aeskey, BYTE* lkeybuf);
+	/** Called by a garbling thread once it finished its part of the batch. */
+	void GarblingThreadDone();
+	/**
+	 Send the garbled tables of the pipelined execution in windows of GARBLED_TABLE_WINDOW tables. Waits for the
+	 acknowledgements of the client if the ring of garbled tables is in transit.
+	 \param flush	Also send the remaining tables that do not fill a window, done at the end of each level.
+	 */
+	void SendPipelinedTables(BOOL flush);
+	/** Receive the acknowledgement of the client for a window of the pipelined execution. */
+	void ReceivePipelineAck();
+	/**
+	 Garble a gate of the interactive queue in pipelined execution, right after its online evaluation.
+	 \param gateid			Gate Identifier
+	 \param permbitctr	m_nPermBitCtr before the online evaluation of the gate.
 	 */
-	void CreateGarbledTable(GATE* ggate, uint32_t pos, GATE* gleft, GATE* gright);
+	void GarbleInteractiveGate(uint32_t gateid, uint64_t permbitctr);
 	/**
 	 PrecomputeGC______________
 	 \param queue 	Dequeue Object.
 	 \param setup	Is needed to perform pipelined sending of the circuit
 	 */
-	void PrecomputeGC(std::deque<uint32_t>& queue, ABYSetup* setup);
+	void PrecomputeGC(const std::vector<uint32_t>& queue, ABYSetup* setup);
 
 	//void EvaluateClientOutputGate(GATE* gate);
 	void CollectClientOutputShares();
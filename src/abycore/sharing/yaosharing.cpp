@@ -17,6 +17,8 @@
  */
 
 #include "yaosharing.h"
+#include "../aby/abysetup.h"
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 #include <iomanip>
@@ -40,6 +42,55 @@ void YaoSharing::Init() {
 #endif
 
 	m_nSecParamIters = ceil_divide(m_nSecParamBytes, sizeof(UGATE_T));
+
+	//Buffers for hashing the wire keys of GARBLING_BATCH_SIZE tables at once
+	ResizeGarbleBatch(GARBLING_BATCH_SIZE);
+}
+
+void YaoSharing::ResizeGarbleBatch(uint32_t nslots) {
+	m_nGarbleBatchSize = nslots;
+	m_vGarbleSlots = (garble_slot_t*) realloc(m_vGarbleSlots, sizeof(garble_slot_t) * nslots);
+	m_bGarbleTweakBuf = (BYTE*) realloc(m_bGarbleTweakBuf, sizeof(BYTE) * nslots * WIRE_ENCRYPTIONS_PER_GATE * AES_BYTES);
+	m_bGarbleMaskBuf = (BYTE*) realloc(m_bGarbleMaskBuf, sizeof(BYTE) * nslots * WIRE_ENCRYPTIONS_PER_GATE * AES_BYTES);
+	if (m_vGarbleSlots == NULL || m_bGarbleTweakBuf == NULL || m_bGarbleMaskBuf == NULL) {
+		std::cerr << "Memory allocation not successful for the garbling batch" << std::endl;
+		exit(0);
+	}
+}
+
+void YaoSharing::CreateGarbledTableRing() {
+	uint64_t ntables = m_nANDGates;
+	if (IsPipelinedGC()) {
+		uint64_t windowbytes = (uint64_t) GARBLED_TABLE_WINDOW * m_nSecParamBytes * KEYS_PER_GATE_IN_TABLE;
+		uint64_t nwindows = std::max((uint64_t) GC_PIPELINE_MIN_WINDOWS, m_nPipelinedGCBudget / windowbytes);
+		ntables = std::min(ntables, nwindows * GARBLED_TABLE_WINDOW);
+	}
+	m_nGarbledTableRingSize = std::max(ntables, (uint64_t) 1);
+
+	uint64_t gt_size = m_nGarbledTableRingSize * KEYS_PER_GATE_IN_TABLE * m_nSecParamBytes;
+	BYTE* buf = (BYTE*) malloc(gt_size);
+	if (buf == NULL) {
+		std::cerr << "Memory allocation not successful for the garbled circuit" << std::endl;
+		exit(0);
+	}
+	m_vGarbledCircuit.AttachBuf(buf, gt_size);
+}
+
+uint64_t YaoSharing::GetContiguousGarbledTables(uint64_t tablectr, uint64_t ntables) {
+	return std::min(ntables, m_nGarbledTableRingSize - (tablectr % m_nGarbledTableRingSize));
+}
+
+void YaoSharing::OpenPipelineChannel(ABYSetup* setup) {
+	//S_YAO and S_YAO_REV run at the same time with opposite roles, hence each needs its own channel
+	m_tPipelineChan = setup->CreateChannel(m_eContext == S_YAO ? YAO_PIPELINE_CHANNEL : YAO_REV_PIPELINE_CHANNEL);
+}
+
+void YaoSharing::ClosePipelineChannel() {
+	if (m_tPipelineChan) {
+		m_tPipelineChan->synchronize_end();
+		delete m_tPipelineChan;
+		m_tPipelineChan = NULL;
+	}
 }
 
 YaoSharing::~YaoSharing() {
@@ -47,6 +98,9 @@ YaoSharing::~YaoSharing() {
 	delete m_cBoolCircuit;
 	free(m_bZeroBuf);
 	free(m_bTempKeyBuf);
+	free(m_vGarbleSlots);
+	free(m_bGarbleTweakBuf);
+	free(m_bGarbleMaskBuf);
 #ifdef FIXED_KEY_GARBLING
 	free(m_bResKeyBuf);
 	m_cCrypto->clean_aes_key(m_kGarble);
@@ -57,9 +111,7 @@ YaoSharing::~YaoSharing() {
 BOOL YaoSharing::EncryptWire(BYTE* c, BYTE* p, uint32_t id)
 {
 #ifdef FIXED_KEY_GARBLING
-	memset(m_bTempKeyBuf, 0, AES_BYTES);
-	memcpy(m_bTempKeyBuf, (BYTE*) (&id), sizeof(uint32_t));
-	m_pKeyOps->XOR_DOUBLE_B(m_bTempKeyBuf, m_bTempKeyBuf, p);
+	PrepareWireTweak(m_bTempKeyBuf, p, id);
 	//m_pKeyOps->XOR(m_bTempKeyBuf, m_bTempKeyBuf, p);
 	m_cCrypto->encrypt(m_kGarble, m_bResKeyBuf, m_bTempKeyBuf, AES_BYTES);
 
@@ -91,6 +143,57 @@ BOOL YaoSharing::EncryptWire(BYTE* c, BYTE* p, uint32_t id)
 	return true;
 }
 
+void YaoSharing::PrepareWireTweak(BYTE* buf, BYTE* p, uint32_t id) {
+	memset(buf, 0, AES_BYTES);
+	memcpy(buf, (BYTE*) (&id), sizeof(uint32_t));
+	m_pKeyOps->XOR_DOUBLE_B(buf, buf, p);
+}
+
+void YaoSharing::EncryptWireBatch(BYTE* c, BYTE* tweaks, uint32_t nwires) {
+#ifdef FIXED_KEY_GARBLING
+	EncryptWireBatch(c, tweaks, nwires, m_kGarble);
+#else
+	std::cerr << "Batched wire encryption is only supported with FIXED_KEY_GARBLING" << std::endl;
+	exit(0);
+#endif
+}
+
+void YaoSharing::EncryptWireBatch(BYTE* c, BYTE* tweaks, uint32_t nwires, AES_KEY_CTX* aeskey) {
+#ifdef FIXED_KEY_GARBLING
+	//a single ECB call over all blocks lets the AES implementation interleave the independent blocks
+	m_cCrypto->encrypt(aeskey, c, tweaks, nwires * AES_BYTES);
+	for (uint32_t i = 0; i < nwires; i++, c += AES_BYTES, tweaks += AES_BYTES) {
+		m_pKeyOps->XOR(c, c, tweaks);
+	}
+#else
+	std::cerr << "Batched wire encryption is only supported with FIXED_KEY_GARBLING" << std::endl;
+	exit(0);
+#endif
+}
+
+BOOL YaoSharing::DependsOnPendingANDGates(GATE* gate) {
+	switch (gate->type) {
+	case G_IN:
+	case G_CONSTANT:
+	case G_SHARED_IN:
+		//no keys of other gates are read
+		return false;
+	case G_LIN:
+	case G_NON_LIN:
+		return !m_pGates[gate->ingates.inputs.twin.left].instantiated || !m_pGates[gate->ingates.inputs.twin.right].instantiated;
+	case G_INV:
+	case G_OUT:
+	case G_SHARED_OUT:
+	case G_SPLIT:
+	case G_REPEAT:
+	case G_SUBSET:
+		return !m_pGates[gate->ingates.inputs.parent].instantiated;
+	default:
+		//gates with an arbitrary number of parents are rare, simply process all pending gates
+		return true;
+	}
+}
+
 void YaoSharing::PrintKey(BYTE* key) {
 	for (uint32_t i = 0; i < m_nSecParamBytes; i++) {
 		std::cout << std::setw(2) << std::setfill('0') << (std::hex) << (uint32_t) key[i];
@@ -28,6 +28,7 @@
 #define FIXED_KEY_GARBLING
 
 class XORMasking;
+class channel;
 
 typedef struct {
 	uint32_t gateid;
@@ -46,6 +47,31 @@ typedef struct {
  */
 #define KEYS_PER_GATE_IN_TABLE 2
 
+/**
+ \def 	GARBLING_BATCH_SIZE
+ \brief	Number of garbled tables whose wire keys are hashed with a single multi-block fixed-key AES call
+ */
+#define GARBLING_BATCH_SIZE 512
+
+/**
+ \def 	WIRE_ENCRYPTIONS_PER_GATE
+ \brief	Number of wire key hashes needed to garble one AND gate (both keys of the left and the right wire)
+ */
+#define WIRE_ENCRYPTIONS_PER_GATE 4
+
+/**
+ \def 	GC_PIPELINE_MIN_WINDOWS
+ \brief	Minimum number of GARBLED_TABLE_WINDOW windows in the ring buffer of the pipelined garbled circuit. A window and a
+ 		batch of the evaluator can be in use while the garbler waits for the acknowledgement of an older window.
+ */
+#define GC_PIPELINE_MIN_WINDOWS 3
+
+/** Position of a single value of a (SIMD) AND gate inside a garbling batch */
+typedef struct {
+	GATE* gate;
+	uint32_t pos;
+} garble_slot_t;
+
 /**
  Yao Sharing class. <Detailed Description please.>
  */
@@ -55,7 +81,9 @@ public:
 
 	/** Constructor for the class. */
 	YaoSharing(e_sharing context, e_role role, uint32_t sharebitlen, ABYCircuit* circuit, crypto* crypt) :
-			Sharing(context, role, sharebitlen, circuit, crypt) {
+			Sharing(context, role, sharebitlen, circuit, crypt), m_nGarbledTableRingSize(1), m_nPipelinedGCBudget(0),
+			m_tPipelineChan(NULL), m_vPendingANDGates(), m_nGarbleBatchSize(0), m_vGarbleSlots(NULL), m_bGarbleTweakBuf(NULL),
+			m_bGarbleMaskBuf(NULL) {
 		Init();
 	}
 	;
@@ -102,6 +130,30 @@ public:
 	void PrintPerformanceStatistics();
 	//SUPER CLASS METHODS END HERE...
 
+	/**
+	 Enable the pipelined execution of the garbled circuit. Instead of garbling the whole circuit in the setup phase, the
+	 server garbles each level during the online phase and the client evaluates it from the received windows. Both
+	 parties keep the garbled tables in a ring buffer and at most one ring of tables is in transit, hence the memory
+	 for the garbled circuit is bounded by the budget instead of the number of AND gates. Both parties have to set the
+	 same budget.
+	 \param budget 	Size of the ring buffer in bytes, is rounded to whole windows of GARBLED_TABLE_WINDOW garbled
+	 				tables but is at least GC_PIPELINE_MIN_WINDOWS windows. 0 disables the pipelined execution.
+	 */
+	void SetPipelinedGCBudget(uint64_t budget) {
+		m_nPipelinedGCBudget = budget;
+	}
+	;
+
+	/**
+	 Set the number of garbled tables that are garbled or evaluated together in one batch. The server splits the batch
+	 among its garbling threads. Has to be called before the circuit is executed.
+	 \param nslots	Number of garbled tables in one batch, at least 1.
+	 */
+	void SetGarbleBatchSize(uint32_t nslots) {
+		ResizeGarbleBatch(nslots);
+	}
+	;
+
 	/**
 	 Evaluating SIMD Gate.
 	 \param 	gateid 	Identifier of the gate to be evaluated.
@@ -136,6 +188,10 @@ protected:
 
 	CBitVector m_vGarbledCircuit; /**< Garbled Circuit Vector.*/
 	uint64_t m_nGarbledTableCtr; /**< Garbled Table Counter. */
+	uint64_t m_nGarbledTableRingSize; /**< Number of garbled tables in m_vGarbledCircuit, table i is stored at i mod m_nGarbledTableRingSize */
+
+	uint64_t m_nPipelinedGCBudget; /**< Memory budget for the garbled tables in pipelined execution, 0 if not pipelined */
+	channel* m_tPipelineChan; /**< Channel for the garbled tables of the pipelined execution */
 
 	BYTE* m_bZeroBuf; /**< Zero Buffer. */
 	BYTE* m_bTempKeyBuf; /**< Temporary Key Buffer. */
@@ -144,6 +200,12 @@ protected:
 
 	uint32_t m_nSecParamIters; /**< Secure_____________*/
 
+	std::vector<GATE*> m_vPendingANDGates; /**< AND gates that were scheduled but whose garbled tables are not yet processed */
+	uint32_t m_nGarbleBatchSize; /**< Maximum number of garbled tables in one batch */
+	garble_slot_t* m_vGarbleSlots; /**< Gate and position of each garbled table in the current batch */
+	BYTE* m_bGarbleTweakBuf; /**< AES inputs for the wire keys of the current batch */
+	BYTE* m_bGarbleMaskBuf; /**< Hashed wire keys of the current batch */
+
 	uint64_t m_nANDWindowCtr; /**< Counts #AND gates for pipelined exec */
 	uint64_t m_nRemANDGates; /**< Remaining AND gates to be processed for pipelined exec */
 
@@ -163,6 +225,77 @@ protected:
 	 */
 	BOOL EncryptWire(BYTE* c, BYTE* p, uint32_t id);
 
+	/**
+	 Write the fixed-key AES input for encrypting wire key p under the tweak id to buf, such that many wires
+	 can be hashed with a single call to EncryptWireBatch.
+	 \param  buf 	destination of AES_BYTES bytes
+	 \param  p 		wire key
+	 \param  id 		tweak of the wire
+	 */
+	void PrepareWireTweak(BYTE* buf, BYTE* p, uint32_t id);
+
+	/**
+	 Encrypt nwires wires that were prepared with PrepareWireTweak using one multi-block AES call, which keeps
+	 several blocks in flight in the AES pipeline. Produces the same output as EncryptWire for every wire.
+	 \param  c 		output buffer of nwires * AES_BYTES bytes
+	 \param  tweaks 	inputs prepared by PrepareWireTweak, nwires * AES_BYTES bytes
+	 \param  nwires 	number of wires
+	 */
+	void EncryptWireBatch(BYTE* c, BYTE* tweaks, uint32_t nwires);
+	/**
+	 Same as EncryptWireBatch(c, tweaks, nwires) but uses the fixed-key AES context aeskey, such that several
+	 threads can hash wires concurrently.
+	 \param  c 		output buffer of nwires * AES_BYTES bytes
+	 \param  tweaks 	inputs prepared by PrepareWireTweak, nwires * AES_BYTES bytes
+	 \param  nwires 	number of wires
+	 \param  aeskey 	fixed-key AES context that is initialized with m_vFixedKeyAESSeed
+	 */
+	void EncryptWireBatch(BYTE* c, BYTE* tweaks, uint32_t nwires, AES_KEY_CTX* aeskey);
+
+	/**
+	 Resize the batch buffers to hold nslots garbled tables.
+	 \param  nslots 	new maximum number of garbled tables in one batch
+	 */
+	void ResizeGarbleBatch(uint32_t nslots);
+
+	/**
+	 Check whether the gate reads the output of an AND gate that is still pending in the current batch.
+	 Pending AND gates are only instantiated when their batch is processed.
+	 \param gate		Gate Object
+	 \return true if the pending AND gates need to be processed before the gate can be evaluated
+	 */
+	BOOL DependsOnPendingANDGates(GATE* gate);
+
+	/** Check whether the garbled circuit is garbled and evaluated level by level in the online phase. */
+	BOOL IsPipelinedGC() {
+		return m_nPipelinedGCBudget > 0;
+	}
+	/**
+	 Allocate m_vGarbledCircuit, which holds all garbled tables or, in pipelined execution, a ring of tables that fits
+	 in the budget.
+	 */
+	void CreateGarbledTableRing();
+	/**
+	 Get the position of a garbled table in m_vGarbledCircuit.
+	 \param tablectr	Index of the garbled table in the circuit.
+	 */
+	BYTE* GetGarbledTable(uint64_t tablectr) {
+		return m_vGarbledCircuit.GetArr() + (tablectr % m_nGarbledTableRingSize) * m_nSecParamBytes * KEYS_PER_GATE_IN_TABLE;
+	}
+	/**
+	 Get the number of the ntables garbled tables starting at tablectr that are stored consecutively before the end of the ring.
+	 \param tablectr	Index of the first garbled table in the circuit.
+	 \param ntables	Number of garbled tables.
+	 */
+	uint64_t GetContiguousGarbledTables(uint64_t tablectr, uint64_t ntables);
+	/**
+	 Open the channel for the pipelined execution.
+	 \param setup	ABYSetup Object.
+	 */
+	void OpenPipelineChannel(ABYSetup* setup);
+	/** Close the channel of the pipelined execution if it is open. */
+	void ClosePipelineChannel();
+
 	/** Print the key. */
 	void PrintKey(BYTE* key);
 };
@@ -122,25 +122,14 @@ int32_t test_inner_product_circuit(e_role role, char* address, uint16_t port, se
 }
 
 /*
- Constructs the inner product circuit. num multiplications and num additions.
+ Constructs the inner product circuit. num multiplications, which are summed up by a single dot-product gate.
  */
 share* BuildInnerProductCircuit(share *s_x, share *s_y, uint32_t num, ArithmeticCircuit *ac) {
-	uint32_t i;
-
-	// pairwise multiplication of all input values
-	s_x = ac->PutMULGate(s_x, s_y);
-
-	// split SIMD gate to separate wires (size many)
-	s_x = ac->PutSplitterGate(s_x);
-
-	// add up the individual multiplication results and store result on wire 0
-	// in arithmetic sharing ADD is for free, and does not add circuit depth, thus simple sequential adding
-	for (i = 1; i < num; i++) {
-		s_x->set_wire_id(0, ac->PutADDGate(s_x->get_wire_id(0), s_x->get_wire_id(i)));
+	// the dot-product gate takes the length from the shares, which have to hold num values each
+	if (s_x->get_nvals() != num || s_y->get_nvals() != num) {
+		std::cerr << "Error: the inner product expects shares of " << num << " values" << std::endl;
+		exit(0);
 	}
-
-	// discard all wires, except the addition result
-	s_x->set_bitlength(1);
-
-	return s_x;
+	// pairwise multiplication of all num input values and addition of the products
+	return ac->PutDotProductGate(s_x, s_y);
 }
@@ -51,7 +51,7 @@ int32_t test_inner_product_circuit(e_role role, char* address, uint16_t port, se
  \param		ac	 		Arithmetic Circuit object.
  \brief		This function is used to build and solve the Inner Product modulo 2^16. It computes the inner product by
  	 	 	multiplying each value in x and y, and adding those multiplied results to evaluate the inner
- 	 	 	product. The addition is performed in a tree, thus with logarithmic depth.
+ 	 	 	product. Both is done by a single dot-product gate.
  */
 share* BuildInnerProductCircuit(share *s_x, share *s_y, uint32_t num, ArithmeticCircuit *ac);
 
@@ -17,6 +17,8 @@
  */
 
 #include "abytest.h"
+#include <cstdio>
+#include <fstream>
 
 
 
@@ -45,6 +47,14 @@ int main(int argc, char** argv) {
 	run_tests(role, (char*) address.c_str(), port, seclvl, bitlen, nvals, nthreads, mt_alg, test_op, num_test_runs, verbose, randomseed);
 
 	if (test_op == -1) {
+		//Test the garbling in small batches that are split among several threads
+		cout << "Testing batched garbling with several threads in Yao sharing" << endl;
+		test_yao_garbling_batches(role, (char*) address.c_str(), port, seclvl, bitlen, nvals, mt_alg, verbose);
+
+		//Test the evaluation of wide local levels on several threads
+		cout << "Testing local gates on several threads in Boolean sharing" << endl;
+		test_bool_local_threads(role, (char*) address.c_str(), port, seclvl, bitlen, nvals, num_test_runs, mt_alg, verbose);
+
 		//Test the AES circuit
 		cout << "Testing AES circuit in Boolean sharing" << endl;
 		test_aes_circuit(role, (char*) address.c_str(), port, seclvl, nvals, nthreads, mt_alg, S_BOOL);
@@ -125,6 +135,22 @@ bool run_tests(e_role role, char* address, uint16_t port, seclvl seclvl, uint32_
 	test_standard_ops(test_ops, party, bitlen, num_test_runs, nops, role, verbose);
 	test_vector_ops(test_ops, party, bitlen, nvals, num_test_runs, nops, role, verbose);
 
+	if (test_op == -1) {
+		test_dot_product(party, bitlen, nvals, num_test_runs, role, verbose);
+		test_mat_mul(party, bitlen, num_test_runs, role, verbose);
+		test_circuit_optimization(party, bitlen, num_test_runs, role, verbose);
+		test_depth_optimization(party, bitlen, num_test_runs, role, verbose);
+		test_gate_coalescing(party, bitlen, num_test_runs, role, verbose);
+		test_planned_gate_values(party, bitlen, nvals, num_test_runs, role, verbose);
+		test_pipelined_yao(party, bitlen, nvals, num_test_runs, role, verbose);
+		test_vec_and_mux(party, bitlen, nvals, num_test_runs, role, verbose);
+		test_setup_pool(party, bitlen, nvals, role, verbose);
+		test_arith_bitlen(party, bitlen, nvals, role, verbose);
+		test_skipped_interactions(party, bitlen, num_test_runs, role, verbose);
+		test_mt_store(party, bitlen, nvals, role, verbose);
+		test_compiled_circuit_file(party, nvals, role, verbose);
+	}
+
 	delete party;
 	if (test_ops != m_tAllOps)
 		delete test_ops;
@@ -486,6 +512,955 @@ int32_t test_vector_ops(aby_ops_t* test_ops, ABYParty* party, uint32_t bitlen, u
 
 }
 
+int32_t test_dot_product(ABYParty* party, uint32_t bitlen, uint32_t nvals, uint32_t num_test_runs, e_role role, bool verbose) {
+	uint32_t *avec, *bvec, c, verify;
+	share *shra, *shrb, *shrres, *shrout;
+	vector<Sharing*>& sharings = party->GetSharings();
+
+	avec = (uint32_t*) malloc(nvals * sizeof(uint32_t));
+	bvec = (uint32_t*) malloc(nvals * sizeof(uint32_t));
+
+	for (uint32_t r = 0; r < num_test_runs; r++) {
+		if (!verbose)
+			cout << "Running dot product test no. " << r << endl;
+
+		ArithmeticCircuit* ac = (ArithmeticCircuit*) sharings[S_ARITH]->GetCircuitBuildRoutine();
+
+		verify = 0;
+		for (uint32_t j = 0; j < nvals; j++) {
+			avec[j] = (uint32_t) rand() % ((uint64_t) 1<<bitlen);
+			bvec[j] = (uint32_t) rand() % ((uint64_t) 1<<bitlen);
+			verify += avec[j] * bvec[j];
+		}
+		shra = ac->PutSIMDINGate(nvals, avec, bitlen, SERVER);
+		shrb = ac->PutSIMDINGate(nvals, bvec, bitlen, CLIENT);
+
+		shrres = ac->PutDotProductGate(shra, shrb);
+		shrout = ac->PutOUTGate(shrres, ALL);
+
+		party->ExecCircuit();
+
+		c = shrout->get_clear_value<uint32_t>();
+		if (!verbose)
+			cout << get_role_name(role) << " dot product: c = " << c << ", verify = " << verify << endl;
+		party->Reset();
+		assert(verify == c);
+	}
+
+	free(avec);
+	free(bvec);
+
+	return 1;
+}
+
+int32_t test_mat_mul(ABYParty* party, uint32_t bitlen, uint32_t num_test_runs, e_role role, bool verbose) {
+	//nrows x ninner times ninner x ncols, none of the matrices is square
+	const uint32_t dims[][3] = { { 3, 5, 2 }, { 1, 7, 4 }, { 6, 2, 9 } };
+	const uint32_t ndims = sizeof(dims) / sizeof(dims[0]);
+	uint32_t *avec, *bvec, *cvec, *verifyvec, tmpbitlen, tmpnvals, nrows, ninner, ncols;
+	share *shra, *shrb, *shrres, *shrout;
+	vector<Sharing*>& sharings = party->GetSharings();
+
+	cvec = nullptr;
+
+	for (uint32_t r = 0; r < num_test_runs; r++) {
+		for (uint32_t i = 0; i < ndims; i++) {
+			nrows = dims[i][0];
+			ninner = dims[i][1];
+			ncols = dims[i][2];
+			if (!verbose)
+				cout << "Running matrix multiplication test no. " << r << " on " << nrows << "x" << ninner << " times " <<
+				ninner << "x" << ncols << endl;
+
+			ArithmeticCircuit* ac = (ArithmeticCircuit*) sharings[S_ARITH]->GetCircuitBuildRoutine();
+
+			avec = (uint32_t*) malloc(nrows * ninner * sizeof(uint32_t));
+			bvec = (uint32_t*) malloc(ninner * ncols * sizeof(uint32_t));
+			verifyvec = (uint32_t*) calloc(nrows * ncols, sizeof(uint32_t));
+
+			for (uint32_t j = 0; j < nrows * ninner; j++)
+				avec[j] = (uint32_t) rand() % ((uint64_t) 1<<bitlen);
+			for (uint32_t j = 0; j < ninner * ncols; j++)
+				bvec[j] = (uint32_t) rand() % ((uint64_t) 1<<bitlen);
+			for (uint32_t j = 0; j < nrows; j++)
+				for (uint32_t k = 0; k < ncols; k++)
+					for (uint32_t l = 0; l < ninner; l++)
+						verifyvec[j * ncols + k] += avec[j * ninner + l] * bvec[l * ncols + k];
+
+			shra = ac->PutSIMDINGate(nrows * ninner, avec, bitlen, SERVER);
+			shrb = ac->PutSIMDINGate(ninner * ncols, bvec, bitlen, CLIENT);
+
+			shrres = ac->PutMatMulGate(shra, shrb, nrows, ninner, ncols);
+			shrout = ac->PutOUTGate(shrres, ALL);
+
+			party->ExecCircuit();
+
+			shrout->get_clear_value_vec(&cvec, &tmpbitlen, &tmpnvals);
+			assert(tmpnvals == nrows * ncols);
+			party->Reset();
+			for (uint32_t j = 0; j < nrows * ncols; j++) {
+				if (!verbose)
+					cout << "\t" << get_role_name(role) << " matrix multiplication: values[" << j << "]: c = " << cvec[j] <<
+					", verify = " << verifyvec[j] << endl;
+				assert(verifyvec[j] == cvec[j]);
+			}
+			free(cvec);
+			free(avec);
+			free(bvec);
+			free(verifyvec);
+		}
+	}
+
+	return 1;
+}
+
+int32_t test_circuit_optimization(ABYParty* party, uint32_t bitlen, uint32_t num_test_runs, e_role role, bool verbose) {
+	const e_sharing test_sharings[] = { S_BOOL, S_YAO };
+	const uint32_t nouts = 8;
+	const char* outnames[nouts] = { "a & 0", "a ^ a", "b & b", "~~a", "a ^ 1", "a & 1", "a & b", "b & a" };
+	uint32_t a, b, c, verify[nouts], ngates, mask = (uint32_t) (((uint64_t) 1 << bitlen) - 1);
+	share *shra, *shrb, *shrzero, *shrone, *shrres[nouts], *shrout[nouts];
+	vector<Sharing*>& sharings = party->GetSharings();
+
+	party->EnableCircuitOptimization(TRUE);
+
+	for (uint32_t r = 0; r < num_test_runs; r++) {
+		for (uint32_t i = 0; i < sizeof(test_sharings) / sizeof(e_sharing); i++) {
+			if (!verbose)
+				cout << "Running circuit optimization test no. " << r << " in " << get_sharing_name(test_sharings[i]) << endl;
+
+			BooleanCircuit* circ = (BooleanCircuit*) sharings[test_sharings[i]]->GetCircuitBuildRoutine();
+			a = (uint32_t) rand() % ((uint64_t) 1<<bitlen);
+			b = (uint32_t) rand() % ((uint64_t) 1<<bitlen);
+
+			shra = circ->PutINGate(a, bitlen, SERVER);
+			shrb = circ->PutINGate(b, bitlen, CLIENT);
+			shrzero = circ->PutCONSGate((UGATE_T) 0, bitlen);
+			shrone = circ->PutCONSGate((UGATE_T) mask, bitlen);
+
+			//constants are folded, XOR and AND of a value with itself are folded to 0 and to the value, a double
+			//inversion and the repeated AND are replaced by their input
+			shrres[0] = circ->PutANDGate(shra, shrzero);
+			verify[0] = 0;
+			shrres[1] = circ->PutXORGate(shra, shra);
+			verify[1] = 0;
+			shrres[2] = circ->PutANDGate(shrb, shrb);
+			verify[2] = b;
+			shrres[3] = circ->PutINVGate(circ->PutINVGate(shra));
+			verify[3] = a;
+			shrres[4] = circ->PutXORGate(shra, shrone);
+			verify[4] = ~a & mask;
+			shrres[5] = circ->PutANDGate(shra, shrone);
+			verify[5] = a;
+			shrres[6] = circ->PutANDGate(shra, shrb);
+			verify[6] = a & b;
+			shrres[7] = circ->PutANDGate(shrb, shra);
+			verify[7] = a & b;
+
+			//the value of this AND is never used, it is removed together with its XOR input
+			circ->PutANDGate(shra, circ->PutXORGate(shra, shrb));
+
+			for (uint32_t j = 0; j < nouts; j++)
+				shrout[j] = circ->PutOUTGate(shrres[j], ALL);
+
+			ngates = circ->GetNumGates();
+			party->ExecCircuit();
+			assert(circ->GetNumGates() < ngates);
+
+			for (uint32_t j = 0; j < nouts; j++) {
+				c = shrout[j]->get_clear_value<uint32_t>();
+				if (!verbose)
+					cout << get_role_name(role) << " " << outnames[j] << ": values: a = " << a << ", b = " << b << ", c = " <<
+					c << ", verify = " << verify[j] << endl;
+				assert(verify[j] == c);
+			}
+			party->Reset();
+		}
+	}
+
+	party->EnableCircuitOptimization(FALSE);
+
+	return 1;
+}
+
+int32_t test_depth_optimization(ABYParty* party, uint32_t bitlen, uint32_t num_test_runs, e_role role, bool verbose) {
+	//the chain of AND gates over nins inputs is rebalanced into a tree with ceil(log2(nins)) levels of AND gates
+	const uint32_t nins = 13;
+	uint32_t a, c, verify, depth, logn;
+	share *shrres, *shrout;
+	vector<Sharing*>& sharings = party->GetSharings();
+
+	for (logn = 0; (1U << logn) < nins; logn++)
+		;
+
+	party->EnableDepthOptimization(TRUE);
+
+	for (uint32_t r = 0; r < num_test_runs; r++) {
+		if (!verbose)
+			cout << "Running depth optimization test no. " << r << endl;
+
+		BooleanCircuit* bc = (BooleanCircuit*) sharings[S_BOOL]->GetCircuitBuildRoutine();
+
+		verify = (uint32_t) (((uint64_t) 1 << bitlen) - 1);
+		shrres = NULL;
+		for (uint32_t j = 0; j < nins; j++) {
+			//mostly set bits, such that the result is not always 0
+			a = (uint32_t) (rand() | rand() | rand()) % ((uint64_t) 1<<bitlen);
+			share* shra = bc->PutINGate(a, bitlen, j & 0x01 ? CLIENT : SERVER);
+			shrres = shrres == NULL ? shra : bc->PutANDGate(shrres, shra);
+			verify &= a;
+		}
+		shrout = bc->PutOUTGate(shrres, ALL);
+
+		depth = bc->GetMaxDepth();
+		party->ExecCircuit();
+		if (!verbose)
+			cout << get_role_name(role) << " depth optimization: depth " << depth << " -> " << bc->GetMaxDepth() << endl;
+		assert(bc->GetMaxDepth() == depth - (nins - 1) + logn);
+
+		c = shrout->get_clear_value<uint32_t>();
+		if (!verbose)
+			cout << get_role_name(role) << " depth optimization: c = " << c << ", verify = " << verify << endl;
+		party->Reset();
+		assert(verify == c);
+	}
+
+	party->EnableDepthOptimization(FALSE);
+
+	return 1;
+}
+
+//Returns the number of interactive gates in the queues of a circuit
+static uint32_t count_interactive_gates(Circuit* circ) {
+	uint32_t ngates = 0;
+	for (uint32_t l = 0; l < circ->GetNumInteractiveLayers(); l++)
+		ngates += circ->GetInteractiveQueueOnLvl(l).size();
+	return ngates;
+}
+
+int32_t test_gate_coalescing(ABYParty* party, uint32_t bitlen, uint32_t num_test_runs, e_role role, bool verbose) {
+	//independent adders and a comparator that are built from single wires, whose gates of a level are coalesced
+	const uint32_t nadds = 4;
+	uint32_t a[nadds], b[nadds], c, verify[nadds + 1], ninteractive;
+	share *shra[nadds], *shrb[nadds], *shrout[nadds + 1];
+	vector<Sharing*>& sharings = party->GetSharings();
+
+	party->EnableGateCoalescing(TRUE);
+
+	for (uint32_t r = 0; r < num_test_runs; r++) {
+		if (!verbose)
+			cout << "Running gate coalescing test no. " << r << endl;
+
+		Circuit* bc = sharings[S_BOOL]->GetCircuitBuildRoutine();
+
+		for (uint32_t j = 0; j < nadds; j++) {
+			a[j] = (uint32_t) rand() % ((uint64_t) 1<<bitlen);
+			b[j] = (uint32_t) rand() % ((uint64_t) 1<<bitlen);
+			shra[j] = bc->PutINGate(a[j], bitlen, SERVER);
+			shrb[j] = bc->PutINGate(b[j], bitlen, CLIENT);
+			shrout[j] = bc->PutOUTGate(bc->PutADDGate(shra[j], shrb[j]), ALL);
+			verify[j] = a[j] + b[j];
+		}
+		shrout[nadds] = bc->PutOUTGate(bc->PutGTGate(shra[0], shrb[1]), ALL);
+		verify[nadds] = a[0] > b[1];
+
+		ninteractive = count_interactive_gates(bc);
+		party->ExecCircuit();
+		assert(count_interactive_gates(bc) < ninteractive);
+
+		for (uint32_t j = 0; j <= nadds; j++) {
+			c = shrout[j]->get_clear_value<uint32_t>();
+			if (!verbose)
+				cout << get_role_name(role) << " gate coalescing " << (j < nadds ? "add" : "cmp") << ": c = " << c <<
+				", verify = " << verify[j] << endl;
+			assert(verify[j] == c);
+		}
+		party->Reset();
+	}
+
+	party->EnableGateCoalescing(FALSE);
+
+	return 1;
+}
+
+int32_t test_planned_gate_values(ABYParty* party, uint32_t bitlen, uint32_t nvals, uint32_t num_test_runs, e_role role,
+		bool verbose) {
+	//circuits of varying shape in all sharings are evaluated one after the other in the planned memory of the gate values
+	const uint32_t ncycles = 4;
+	const uint32_t cyclenvals[ncycles] = { nvals, 1, nvals / 2 + 3, nvals };
+	uint32_t *avec, *bvec, *svec, *cvec, tmpbitlen, tmpnvals, n;
+	share *shra, *shrb, *shrsum, *shrres, *shrsumout, *shrout;
+	vector<Sharing*>& sharings = party->GetSharings();
+
+	avec = (uint32_t*) malloc(nvals * sizeof(uint32_t));
+	bvec = (uint32_t*) malloc(nvals * sizeof(uint32_t));
+	svec = nullptr;
+	cvec = nullptr;
+
+	for (uint32_t r = 0; r < num_test_runs; r++) {
+		for (uint32_t i = 0; i < ncycles; i++) {
+			n = cyclenvals[i];
+			if (!verbose)
+				cout << "Running planned gate value test no. " << r << " in cycle " << i << " on " << n << " values" << endl;
+
+			Circuit* bc = sharings[S_BOOL]->GetCircuitBuildRoutine();
+			Circuit* yc = sharings[S_YAO]->GetCircuitBuildRoutine();
+			Circuit* ac = sharings[S_ARITH]->GetCircuitBuildRoutine();
+
+			for (uint32_t j = 0; j < n; j++) {
+				avec[j] = (uint32_t) rand() % ((uint64_t) 1<<bitlen);
+				bvec[j] = (uint32_t) rand() % ((uint64_t) 1<<bitlen);
+			}
+			shra = bc->PutSIMDINGate(n, avec, bitlen, SERVER);
+			shrb = bc->PutSIMDINGate(n, bvec, bitlen, CLIENT);
+
+			shrsum = bc->PutADDGate(shra, shrb);
+			shrres = yc->PutB2YGate(shrsum);
+			shrres = yc->PutMULGate(shrres, shrres);
+			shrres = ac->PutY2AGate(shrres, bc);
+			shrres = ac->PutADDGate(shrres, shrres);
+
+			shrsumout = bc->PutOUTGate(shrsum, ALL);
+			shrout = ac->PutOUTGate(shrres, ALL);
+
+			party->ExecCircuit();
+
+			assert(party->GetGateValueHighWaterMark(S_BOOL) > 0);
+			assert(party->GetGateValueHighWaterMark(S_YAO) > 0);
+			assert(party->GetGateValueHighWaterMark(S_ARITH) > 0);
+
+			shrsumout->get_clear_value_vec(&svec, &tmpbitlen, &tmpnvals);
+			assert(tmpnvals == n);
+			shrout->get_clear_value_vec(&cvec, &tmpbitlen, &tmpnvals);
+			assert(tmpnvals == n);
+			party->Reset();
+			for (uint32_t j = 0; j < n; j++) {
+				uint32_t sum = avec[j] + bvec[j];
+				if (!verbose)
+					cout << "\t" << get_role_name(role) << " planned gate values[" << j << "]: a = " << avec[j] << ", b = " <<
+					bvec[j] << ", sum = " << svec[j] << ", c = " << cvec[j] << ", verify = " << (sum * sum) + (sum * sum) << endl;
+				assert(sum == svec[j]);
+				assert((sum * sum) + (sum * sum) == cvec[j]);
+			}
+			free(svec);
+			free(cvec);
+		}
+	}
+
+	free(avec);
+	free(bvec);
+
+	return 1;
+}
+
+int32_t test_pipelined_yao(ABYParty* party, uint32_t bitlen, uint32_t nvals, uint32_t num_test_runs, e_role role, bool verbose) {
+	//with nvals = 65, the products take more AND gates than the smallest ring holds, such that its windows are reused
+	const e_sharing test_sharings[] = { S_YAO, S_YAO_REV };
+	const uint32_t nmuls = 4;
+	uint32_t *avec, *bvec, *cvec, *verifyvec, tmpbitlen, tmpnvals;
+	share *shra, *shrb, *shrres, *shrout;
+	vector<Sharing*>& sharings = party->GetSharings();
+
+	avec = (uint32_t*) malloc(nvals * sizeof(uint32_t));
+	bvec = (uint32_t*) malloc(nvals * sizeof(uint32_t));
+	verifyvec = (uint32_t*) malloc(nvals * sizeof(uint32_t));
+	cvec = nullptr;
+
+	//a budget of 1 byte selects the smallest ring of GC_PIPELINE_MIN_WINDOWS windows
+	for (uint32_t i = 0; i < sizeof(test_sharings) / sizeof(e_sharing); i++)
+		((YaoSharing*) sharings[test_sharings[i]])->SetPipelinedGCBudget(1);
+
+	for (uint32_t r = 0; r < num_test_runs; r++) {
+		for (uint32_t i = 0; i < sizeof(test_sharings) / sizeof(e_sharing); i++) {
+			if (!verbose)
+				cout << "Running pipelined Yao test no. " << r << " in " << get_sharing_name(test_sharings[i]) << endl;
+
+			Circuit* yc = sharings[test_sharings[i]]->GetCircuitBuildRoutine();
+
+			for (uint32_t j = 0; j < nvals; j++) {
+				avec[j] = (uint32_t) rand() % ((uint64_t) 1<<bitlen);
+				bvec[j] = (uint32_t) rand() % ((uint64_t) 1<<bitlen);
+				verifyvec[j] = avec[j];
+			}
+			shra = yc->PutSIMDINGate(nvals, avec, bitlen, SERVER);
+			shrb = yc->PutSIMDINGate(nvals, bvec, bitlen, CLIENT);
+
+			shrres = shra;
+			for (uint32_t k = 0; k < nmuls; k++) {
+				shrres = yc->PutMULGate(shrres, shrb);
+				for (uint32_t j = 0; j < nvals; j++)
+					verifyvec[j] *= bvec[j];
+			}
+			shrout = yc->PutOUTGate(shrres, ALL);
+
+			party->ExecCircuit();
+
+			shrout->get_clear_value_vec(&cvec, &tmpbitlen, &tmpnvals);
+			assert(tmpnvals == nvals);
+			party->Reset();
+			for (uint32_t j = 0; j < nvals; j++) {
+				if (!verbose)
+					cout << "\t" << get_role_name(role) << " pipelined Yao: values[" << j << "]: a = " << avec[j] << ", b = " <<
+					bvec[j] << ", c = " << cvec[j] << ", verify = " << verifyvec[j] << endl;
+				assert(verifyvec[j] == cvec[j]);
+			}
+			free(cvec);
+		}
+	}
+
+	for (uint32_t i = 0; i < sizeof(test_sharings) / sizeof(e_sharing); i++)
+		((YaoSharing*) sharings[test_sharings[i]])->SetPipelinedGCBudget(0);
+
+	free(avec);
+	free(bvec);
+	free(verifyvec);
+
+	return 1;
+}
+
+static bool read_file(const string& filename, vector<char>& buf) {
+	ifstream in(filename.c_str(), ios::binary);
+	buf.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+	return in.good() || in.eof();
+}
+
+static bool write_file(const string& filename, const vector<char>& buf) {
+	ofstream out(filename.c_str(), ios::binary | ios::trunc);
+	out.write(buf.data(), buf.size());
+	return out.good();
+}
+
+int32_t test_compiled_circuit_file(ABYParty* party, uint32_t nvals, e_role role, bool verbose) {
+	//The circuit is loaded from the text file, from its compiled form without the text file, and from a compiled file of
+	//an older version and a truncated one, which both have to be ignored in favor of the text file. Since the parsed
+	//files are cached by their name, each variant gets its own name. Both parties run in the same directory.
+	//the circuit files are in circ next to the executable, which is run from its own or the parent directory
+	const string srcs[] = { "circ/int_div_8.aby", "bin/circ/int_div_8.aby" };
+	const string base = "abytest_circ_" + get_role_name(role);
+	const uint32_t bitlen = 8;
+	const string names[] = { base + ".aby", base + "_bin.aby", base + "_old.aby", base + "_cut.aby" };
+	const uint32_t nnames = sizeof(names) / sizeof(string);
+	uint32_t *avec, *bvec, *cvec[nnames], tmpbitlen, tmpnvals;
+	vector<char> text, compiled, corrupted;
+	share *shra, *shrb, *shrout[nnames];
+	vector<Sharing*>& sharings = party->GetSharings();
+
+	for (uint32_t i = 0; i < sizeof(srcs) / sizeof(string) && text.size() == 0; i++) {
+		read_file(srcs[i], text);
+	}
+	if (text.size() == 0) {
+		cout << "Skipping compiled circuit file test, " << srcs[0] << " was not found" << endl;
+		return 1;
+	}
+
+	BooleanCircuit* bc = (BooleanCircuit*) sharings[S_BOOL]->GetCircuitBuildRoutine();
+
+	bool success = write_file(names[0], text) && bc->CompileCircuitFile(names[0]) && read_file(names[0] + "c", compiled);
+	remove((names[0] + "c").c_str());
+	success = success && compiled.size() > sizeof(uint64_t) + sizeof(uint32_t) && write_file(names[1] + "c", compiled);
+	assert(success);
+
+	//the compiled files are written after the text files, such that they are not older
+	corrupted = compiled;
+	corrupted[sizeof(uint64_t)] ^= 0x80; //version, which follows the magic string
+	success = success && write_file(names[2], text) && write_file(names[2] + "c", corrupted);
+	corrupted.assign(compiled.begin(), compiled.end() - sizeof(uint32_t));
+	success = success && write_file(names[3], text) && write_file(names[3] + "c", corrupted);
+	assert(success);
+
+	//without its text file, the compiled file is the only source of the circuit
+	assert(bc->GetInputLengthFromFile(names[1]) == bc->GetInputLengthFromFile(names[0]));
+
+	avec = (uint32_t*) malloc(nvals * sizeof(uint32_t));
+	bvec = (uint32_t*) malloc(nvals * sizeof(uint32_t));
+	for (uint32_t j = 0; j < nvals; j++) {
+		avec[j] = (uint32_t) rand() % ((uint64_t) 1<<bitlen);
+		bvec[j] = (uint32_t) rand() % ((uint64_t) 1<<bitlen);
+	}
+	shra = bc->PutSIMDINGate(nvals, avec, bitlen, SERVER);
+	shrb = bc->PutSIMDINGate(nvals, bvec, bitlen, CLIENT);
+	vector<uint32_t> inputs = shra->get_wires();
+	vector<uint32_t> inputsb = shrb->get_wires();
+	inputs.insert(inputs.end(), inputsb.begin(), inputsb.end());
+
+	for (uint32_t i = 0; i < nnames; i++) {
+		shrout[i] = bc->PutOUTGate(new boolshare(bc->PutGateFromFile(names[i], inputs, nvals), bc), ALL);
+	}
+
+	party->ExecCircuit();
+
+	for (uint32_t i = 0; i < nnames; i++) {
+		cvec[i] = nullptr;
+		shrout[i]->get_clear_value_vec(&cvec[i], &tmpbitlen, &tmpnvals);
+		assert(tmpnvals == nvals);
+	}
+	party->Reset();
+
+	for (uint32_t i = 1; i < nnames; i++) {
+		for (uint32_t j = 0; j < nvals; j++) {
+			if (!verbose)
+				cout << "\t" << get_role_name(role) << " circuit file " << names[i] << ": values[" << j << "]: a = " << avec[j] <<
+				", b = " << bvec[j] << ", c = " << cvec[i][j] << ", text file = " << cvec[0][j] << endl;
+			assert(cvec[i][j] == cvec[0][j]);
+		}
+	}
+
+	for (uint32_t i = 0; i < nnames; i++) {
+		free(cvec[i]);
+		remove(names[i].c_str());
+		remove((names[i] + "c").c_str());
+	}
+	free(avec);
+	free(bvec);
+
+	return 1;
+}
+
+int32_t test_mt_store(ABYParty* party, uint32_t bitlen, uint32_t nvals, e_role role, bool verbose) {
+	//The first execution only stores the MTs of the circuit, the second one consumes them and the third one falls back to
+	//computing the MTs, since the store is empty. The sharings revert to the default mode when they fall back.
+	const e_sharing test_sharings[] = { S_BOOL, S_ARITH };
+	const ePreCompPhase phases[] = { ePreCompStore, ePreCompRead, ePreCompRead };
+	const ePreCompPhase expected[] = { ePreCompStore, ePreCompRead, ePreCompDefault };
+	const uint32_t nsharings = sizeof(test_sharings) / sizeof(e_sharing);
+	uint32_t *avec, *bvec, *cvec, tmpbitlen, tmpnvals, verify;
+	share *shra, *shrb, *shrout[nsharings];
+	vector<Sharing*>& sharings = party->GetSharings();
+	MTStore store(role);
+
+	avec = (uint32_t*) malloc(nvals * sizeof(uint32_t));
+	bvec = (uint32_t*) malloc(nvals * sizeof(uint32_t));
+	cvec = nullptr;
+
+	store.Remove();
+
+	for (uint32_t r = 0; r < sizeof(phases) / sizeof(ePreCompPhase); r++) {
+		if (!verbose)
+			cout << "Running MT store test no. " << r << endl;
+
+		for (uint32_t j = 0; j < nvals; j++) {
+			avec[j] = (uint32_t) rand() % ((uint64_t) 1<<bitlen);
+			bvec[j] = (uint32_t) rand() % ((uint64_t) 1<<bitlen);
+		}
+
+		for (uint32_t i = 0; i < nsharings; i++) {
+			sharings[test_sharings[i]]->SetPreCompPhaseValue(phases[r]);
+			Circuit* circ = sharings[test_sharings[i]]->GetCircuitBuildRoutine();
+			shra = circ->PutSIMDINGate(nvals, avec, bitlen, SERVER);
+			shrb = circ->PutSIMDINGate(nvals, bvec, bitlen, CLIENT);
+			shrout[i] = circ->PutOUTGate(test_sharings[i] == S_BOOL ? circ->PutANDGate(shra, shrb) : circ->PutMULGate(shra, shrb), ALL);
+		}
+
+		party->ExecCircuit();
+
+		for (uint32_t i = 0; i < nsharings; i++) {
+			assert(sharings[test_sharings[i]]->GetPreCompPhaseValue() == expected[r]);
+			//the online phase is skipped while the MTs are stored
+			if (phases[r] == ePreCompStore)
+				continue;
+
+			shrout[i]->get_clear_value_vec(&cvec, &tmpbitlen, &tmpnvals);
+			assert(tmpnvals == nvals);
+			for (uint32_t j = 0; j < nvals; j++) {
+				verify = test_sharings[i] == S_BOOL ? avec[j] & bvec[j] : avec[j] * bvec[j];
+				if (!verbose)
+					cout << "\t" << get_role_name(role) << " " << get_sharing_name(test_sharings[i]) << " MT store: values[" << j <<
+					"]: a = " << avec[j] << ", b = " << bvec[j] << ", c = " << cvec[j] << ", verify = " << verify << endl;
+				assert(verify == cvec[j]);
+			}
+			free(cvec);
+		}
+		party->Reset();
+		//both batches are consumed by the first read
+		assert(store.IsConsumed() == (phases[r] != ePreCompStore));
+	}
+
+	for (uint32_t i = 0; i < nsharings; i++)
+		sharings[test_sharings[i]]->SetPreCompPhaseValue(ePreCompDefault);
+	store.Remove();
+
+	free(avec);
+	free(bvec);
+
+	return 1;
+}
+
+int32_t test_skipped_interactions(ABYParty* party, uint32_t bitlen, uint32_t num_test_runs, e_role role, bool verbose) {
+	//The Yao inputs of the server and the Boolean input of the client are sent on layer 0. The Yao AND gate on layer 1
+	//and the Y2B gate on layer 2 are local, hence both layers have nothing to exchange. The Boolean AND gate follows
+	//on layer 3 and the output gate on layer 4.
+	const uint32_t nskipped = 2;
+	uint32_t a, b, c, d, verify;
+	share *shra, *shrb, *shrc, *shrres, *shrout;
+	vector<Sharing*>& sharings = party->GetSharings();
+
+	for (uint32_t r = 0; r < num_test_runs; r++) {
+		if (!verbose)
+			cout << "Running skipped interaction test no. " << r << endl;
+
+		Circuit* yc = sharings[S_YAO]->GetCircuitBuildRoutine();
+		Circuit* bc = sharings[S_BOOL]->GetCircuitBuildRoutine();
+
+		a = (uint32_t) rand() % ((uint64_t) 1<<bitlen);
+		b = (uint32_t) rand() % ((uint64_t) 1<<bitlen);
+		c = (uint32_t) rand() % ((uint64_t) 1<<bitlen);
+
+		shra = yc->PutINGate(a, bitlen, SERVER);
+		shrb = yc->PutINGate(b, bitlen, SERVER);
+		shrc = bc->PutINGate(c, bitlen, CLIENT);
+
+		shrres = bc->PutY2BGate(yc->PutANDGate(shra, shrb));
+		shrres = bc->PutANDGate(shrres, shrc);
+		shrout = bc->PutOUTGate(shrres, ALL);
+
+		party->ExecCircuit();
+
+		d = shrout->get_clear_value<uint32_t>();
+		verify = a & b & c;
+		if (!verbose)
+			cout << get_role_name(role) << " skipped interactions: values: a = " << a << ", b = " << b << ", c = " << c <<
+			", d = " << d << ", verify = " << verify << ", skipped layers = " << party->GetSkippedInteractions() << endl;
+		assert(party->GetSkippedInteractions() == nskipped);
+		party->Reset();
+		assert(verify == d);
+	}
+
+	return 1;
+}
+
+int32_t test_vec_and_mux(ABYParty* party, uint32_t bitlen, uint32_t nvals, uint32_t num_test_runs, e_role role, bool verbose) {
+	//nvals MUXes of each width are evaluated with vector AND MTs of that bit-length. The odd widths let the strings of the
+	//MTs start in the middle of a byte and span several words.
+	const uint32_t widths[] = { 3, 13, bitlen };
+	const uint32_t nwidths = sizeof(widths) / sizeof(uint32_t);
+	uint32_t *avec, *bvec, *svec, c, verify;
+	share *shra, *shrb, *shrsel, **shrout;
+	vector<Sharing*>& sharings = party->GetSharings();
+
+	avec = (uint32_t*) malloc(nwidths * nvals * sizeof(uint32_t));
+	bvec = (uint32_t*) malloc(nwidths * nvals * sizeof(uint32_t));
+	svec = (uint32_t*) malloc(nwidths * nvals * sizeof(uint32_t));
+	shrout = (share**) malloc(nwidths * nvals * sizeof(share*));
+
+	for (uint32_t r = 0; r < num_test_runs; r++) {
+		if (!verbose)
+			cout << "Running vector AND MUX test no. " << r << endl;
+
+		Circuit* bc = sharings[S_BOOL]->GetCircuitBuildRoutine();
+
+		for (uint32_t i = 0, k = 0; i < nwidths; i++) {
+			for (uint32_t j = 0; j < nvals; j++, k++) {
+				avec[k] = (uint32_t) rand() % ((uint64_t) 1<<widths[i]);
+				bvec[k] = (uint32_t) rand() % ((uint64_t) 1<<widths[i]);
+				svec[k] = rand() % 2;
+				shra = bc->PutINGate(avec[k], widths[i], SERVER);
+				shrb = bc->PutINGate(bvec[k], widths[i], CLIENT);
+				shrsel = bc->PutINGate(svec[k], 1, SERVER);
+				//a single value MUX in Boolean sharing is built from one vector AND gate
+				shrout[k] = bc->PutOUTGate(bc->PutMUXGate(shra, shrb, shrsel), ALL);
+			}
+		}
+
+		party->ExecCircuit();
+
+		for (uint32_t i = 0, k = 0; i < nwidths; i++) {
+			for (uint32_t j = 0; j < nvals; j++, k++) {
+				c = shrout[k]->get_clear_value<uint32_t>();
+				verify = svec[k] == 0 ? bvec[k] : avec[k];
+				if (!verbose)
+					cout << "\t" << get_role_name(role) << " vector AND MUX: width = " << widths[i] << ", values[" << j << "]: a = " <<
+					avec[k] << ", b = " << bvec[k] << ", s = " << svec[k] << ", c = " << c << ", verify = " << verify << endl;
+				assert(verify == c);
+			}
+		}
+		party->Reset();
+	}
+
+	free(avec);
+	free(bvec);
+	free(svec);
+	free(shrout);
+
+	return 1;
+}
+
+int32_t test_setup_pool(ABYParty* party, uint32_t bitlen, uint32_t nvals, e_role role, bool verbose) {
+	//The first execution computes its MTs and sizes the pool, which is refilled for one execution after each Reset. The
+	//second and third execution hence take their MTs from the pool, while the last one needs twice the values and falls
+	//back to computing its MTs, since the pool runs dry.
+	const uint32_t scale[] = { 1, 1, 1, 2 };
+	const uint32_t nruns = sizeof(scale) / sizeof(uint32_t);
+	uint32_t *avec, *bvec, *svec, *andvec, *mulvec, tmpbitlen, tmpnvals, c, verify;
+	share *shra, *shrb, *shrsel, *shrandout, *shrmulout, **shrmuxout;
+	vector<Sharing*>& sharings = party->GetSharings();
+
+	avec = (uint32_t*) malloc(2 * nvals * sizeof(uint32_t));
+	bvec = (uint32_t*) malloc(2 * nvals * sizeof(uint32_t));
+	svec = (uint32_t*) malloc(2 * nvals * sizeof(uint32_t));
+	shrmuxout = (share**) malloc(2 * nvals * sizeof(share*));
+	andvec = nullptr;
+	mulvec = nullptr;
+
+	party->EnableSetupPool(1);
+
+	for (uint32_t r = 0; r < nruns; r++) {
+		uint32_t n = scale[r] * nvals;
+		if (!verbose)
+			cout << "Running setup pool test no. " << r << " with " << n << " values" << endl;
+
+		for (uint32_t j = 0; j < n; j++) {
+			avec[j] = (uint32_t) rand() % ((uint64_t) 1<<bitlen);
+			bvec[j] = (uint32_t) rand() % ((uint64_t) 1<<bitlen);
+			svec[j] = rand() % 2;
+		}
+
+		Circuit* bc = sharings[S_BOOL]->GetCircuitBuildRoutine();
+		Circuit* ac = sharings[S_ARITH]->GetCircuitBuildRoutine();
+
+		shra = bc->PutSIMDINGate(n, avec, bitlen, SERVER);
+		shrb = bc->PutSIMDINGate(n, bvec, bitlen, CLIENT);
+		shrandout = bc->PutOUTGate(bc->PutANDGate(shra, shrb), ALL);
+
+		//a single value MUX in Boolean sharing is built from one vector AND gate
+		for (uint32_t j = 0; j < n; j++) {
+			shra = bc->PutINGate(avec[j], bitlen, SERVER);
+			shrb = bc->PutINGate(bvec[j], bitlen, CLIENT);
+			shrsel = bc->PutINGate(svec[j], 1, SERVER);
+			shrmuxout[j] = bc->PutOUTGate(bc->PutMUXGate(shra, shrb, shrsel), ALL);
+		}
+
+		shra = ac->PutSIMDINGate(n, avec, bitlen, SERVER);
+		shrb = ac->PutSIMDINGate(n, bvec, bitlen, CLIENT);
+		shrmulout = ac->PutOUTGate(ac->PutMULGate(shra, shrb), ALL);
+
+		party->ExecCircuit();
+
+		shrandout->get_clear_value_vec(&andvec, &tmpbitlen, &tmpnvals);
+		assert(tmpnvals == n);
+		shrmulout->get_clear_value_vec(&mulvec, &tmpbitlen, &tmpnvals);
+		assert(tmpnvals == n);
+		for (uint32_t j = 0; j < n; j++) {
+			c = shrmuxout[j]->get_clear_value<uint32_t>();
+			verify = svec[j] == 0 ? bvec[j] : avec[j];
+			if (!verbose)
+				cout << "\t" << get_role_name(role) << " setup pool: values[" << j << "]: a = " << avec[j] << ", b = " << bvec[j] <<
+				", s = " << svec[j] << ", a & b = " << andvec[j] << ", a * b = " << mulvec[j] << ", mux = " << c << endl;
+			assert((avec[j] & bvec[j]) == andvec[j]);
+			assert(avec[j] * bvec[j] == mulvec[j]);
+			assert(verify == c);
+		}
+		free(andvec);
+		free(mulvec);
+		party->Reset();
+	}
+
+	party->EnableSetupPool(0);
+
+	free(avec);
+	free(bvec);
+	free(svec);
+	free(shrmuxout);
+
+	return 1;
+}
+
+int32_t test_arith_bitlen(ABYParty* party, uint32_t bitlen, uint32_t nvals, e_role role, bool verbose) {
+	//The arithmetic sharing is replaced with one of the new bit-length between two executions of the same party. Both
+	//results are reduced modulo their own bit-length. The sharing of the party's bit-length is restored afterwards.
+	const uint32_t arithbitlens[] = { 16, 64 };
+	uint64_t *avec, *bvec, *cvec, *dvec, mask, verify;
+	uint32_t tmpbitlen, tmpnvals;
+	share *shra, *shrb, *shrmulout, *shraddout;
+	vector<Sharing*>& sharings = party->GetSharings();
+
+	avec = (uint64_t*) malloc(nvals * sizeof(uint64_t));
+	bvec = (uint64_t*) malloc(nvals * sizeof(uint64_t));
+	cvec = nullptr;
+	dvec = nullptr;
+
+	for (uint32_t i = 0; i < sizeof(arithbitlens) / sizeof(uint32_t); i++) {
+		if (!verbose)
+			cout << "Running arithmetic bit-length test with " << arithbitlens[i] << " bits" << endl;
+
+		bool success = party->SetArithBitLen(arithbitlens[i]);
+		assert(success);
+		mask = arithbitlens[i] == 64 ? (uint64_t) -1 : ((uint64_t) 1 << arithbitlens[i]) - 1;
+
+		for (uint32_t j = 0; j < nvals; j++) {
+			avec[j] = (((uint64_t) rand() << 32) ^ (uint64_t) rand()) & mask;
+			bvec[j] = (((uint64_t) rand() << 32) ^ (uint64_t) rand()) & mask;
+		}
+
+		//the sharing was replaced, hence its circuit is fetched again
+		Circuit* ac = sharings[S_ARITH]->GetCircuitBuildRoutine();
+		assert(ac->GetShareBitLen() == arithbitlens[i]);
+
+		shra = ac->PutSIMDINGate(nvals, avec, arithbitlens[i], SERVER);
+		shrb = ac->PutSIMDINGate(nvals, bvec, arithbitlens[i], CLIENT);
+		shrmulout = ac->PutOUTGate(ac->PutMULGate(shra, shrb), ALL);
+		shraddout = ac->PutOUTGate(ac->PutADDGate(shra, shrb), ALL);
+
+		party->ExecCircuit();
+
+		shrmulout->get_clear_value_vec(&cvec, &tmpbitlen, &tmpnvals);
+		assert(tmpnvals == nvals && tmpbitlen == arithbitlens[i]);
+		shraddout->get_clear_value_vec(&dvec, &tmpbitlen, &tmpnvals);
+		assert(tmpnvals == nvals && tmpbitlen == arithbitlens[i]);
+		for (uint32_t j = 0; j < nvals; j++) {
+			verify = (avec[j] * bvec[j]) & mask;
+			if (!verbose)
+				cout << "\t" << get_role_name(role) << " arithmetic bit-length " << arithbitlens[i] << ": values[" << j << "]: a = " <<
+				avec[j] << ", b = " << bvec[j] << ", a * b = " << cvec[j] << ", a + b = " << dvec[j] << ", verify = " << verify << endl;
+			assert(verify == cvec[j]);
+			assert(((avec[j] + bvec[j]) & mask) == dvec[j]);
+		}
+		free(cvec);
+		free(dvec);
+		party->Reset();
+	}
+
+	bool success = party->SetArithBitLen(bitlen);
+	assert(success);
+
+	free(avec);
+	free(bvec);
+
+	return 1;
+}
+
+int32_t test_yao_garbling_batches(e_role role, char* address, uint16_t port, seclvl seclvl, uint32_t bitlen, uint32_t nvals,
+		e_mt_gen_alg mt_alg, bool verbose) {
+	//a level of bitlen AND gates with nvals values each does not fit into a batch of 37 tables, hence the batches end in
+	//the middle of a level and of a SIMD gate. The server splits every batch among its garbling threads.
+	const e_sharing test_sharings[] = { S_YAO, S_YAO_REV };
+	const uint32_t nthreads = 4, batchsize = 37;
+	uint32_t *avec, *bvec, *cvec, *dvec, tmpbitlen, tmpnvals;
+	share *shra, *shrb, *shrand, *shrmul, *shrandout, *shrmulout;
+
+	ABYParty* party = new ABYParty(role, address, port, seclvl, bitlen, nthreads, mt_alg);
+	vector<Sharing*>& sharings = party->GetSharings();
+
+	for (uint32_t i = 0; i < sizeof(test_sharings) / sizeof(e_sharing); i++)
+		((YaoSharing*) sharings[test_sharings[i]])->SetGarbleBatchSize(batchsize);
+
+	avec = (uint32_t*) malloc(nvals * sizeof(uint32_t));
+	bvec = (uint32_t*) malloc(nvals * sizeof(uint32_t));
+	cvec = nullptr;
+	dvec = nullptr;
+
+	for (uint32_t i = 0; i < sizeof(test_sharings) / sizeof(e_sharing); i++) {
+		Circuit* yc = sharings[test_sharings[i]]->GetCircuitBuildRoutine();
+
+		for (uint32_t j = 0; j < nvals; j++) {
+			avec[j] = (uint32_t) rand() % ((uint64_t) 1<<bitlen);
+			bvec[j] = (uint32_t) rand() % ((uint64_t) 1<<bitlen);
+		}
+		shra = yc->PutSIMDINGate(nvals, avec, bitlen, SERVER);
+		shrb = yc->PutSIMDINGate(nvals, bvec, bitlen, CLIENT);
+
+		shrand = yc->PutANDGate(shra, shrb);
+		shrmul = yc->PutMULGate(shra, shrb);
+
+		shrandout = yc->PutOUTGate(shrand, ALL);
+		shrmulout = yc->PutOUTGate(shrmul, ALL);
+
+		party->ExecCircuit();
+
+		shrandout->get_clear_value_vec(&cvec, &tmpbitlen, &tmpnvals);
+		assert(tmpnvals == nvals);
+		shrmulout->get_clear_value_vec(&dvec, &tmpbitlen, &tmpnvals);
+		assert(tmpnvals == nvals);
+		party->Reset();
+		for (uint32_t j = 0; j < nvals; j++) {
+			if (!verbose)
+				cout << "\t" << get_role_name(role) << " " << get_sharing_name(test_sharings[i]) << " batched garbling: values[" <<
+				j << "]: a = " << avec[j] << ", b = " << bvec[j] << ", a & b = " << cvec[j] << ", a * b = " << dvec[j] << endl;
+			assert((avec[j] & bvec[j]) == cvec[j]);
+			assert(avec[j] * bvec[j] == dvec[j]);
+		}
+		free(cvec);
+		free(dvec);
+	}
+
+	free(avec);
+	free(bvec);
+	delete party;
+
+	return 1;
+}
+
+int32_t test_bool_local_threads(e_role role, char* address, uint16_t port, seclvl seclvl, uint32_t bitlen, uint32_t nvals,
+		uint32_t num_test_runs, e_mt_gen_alg mt_alg, bool verbose) {
+	//each level of XOR or INV gates holds twice the gates a run needs to be split among the threads
+	const uint32_t nthreads = 4;
+	const uint32_t nshares = ceil_divide(2 * MIN_PARALLEL_LOCAL_GATES, bitlen);
+	const uint32_t mask = (uint32_t) (((uint64_t) 1 << bitlen) - 1);
+	uint32_t **avec, **bvec, *cvec, tmpbitlen, tmpnvals, verify;
+	share *shra, *shrb, *shrres, **shrout;
+
+	ABYParty* party = new ABYParty(role, address, port, seclvl, bitlen, nthreads, mt_alg);
+	vector<Sharing*>& sharings = party->GetSharings();
+
+	avec = (uint32_t**) malloc(nshares * sizeof(uint32_t*));
+	bvec = (uint32_t**) malloc(nshares * sizeof(uint32_t*));
+	shrout = (share**) malloc(nshares * sizeof(share*));
+	for (uint32_t k = 0; k < nshares; k++) {
+		avec[k] = (uint32_t*) malloc(nvals * sizeof(uint32_t));
+		bvec[k] = (uint32_t*) malloc(nvals * sizeof(uint32_t));
+	}
+	cvec = nullptr;
+
+	for (uint32_t r = 0; r < num_test_runs; r++) {
+		if (!verbose)
+			cout << "Running local thread test no. " << r << " with " << nshares << " shares" << endl;
+
+		BooleanCircuit* bc = (BooleanCircuit*) sharings[S_BOOL]->GetCircuitBuildRoutine();
+
+		for (uint32_t k = 0; k < nshares; k++) {
+			for (uint32_t j = 0; j < nvals; j++) {
+				avec[k][j] = (uint32_t) rand() % ((uint64_t) 1<<bitlen);
+				bvec[k][j] = (uint32_t) rand() % ((uint64_t) 1<<bitlen);
+			}
+			shra = bc->PutSIMDINGate(nvals, avec[k], bitlen, SERVER);
+			shrb = bc->PutSIMDINGate(nvals, bvec[k], bitlen, CLIENT);
+
+			//~((a ^ b) & b) ^ a: a local level before and after the interactive one
+			shrres = bc->PutXORGate(shra, shrb);
+			shrres = bc->PutANDGate(shrres, shrb);
+			shrres = bc->PutINVGate(shrres);
+			shrres = bc->PutXORGate(shrres, shra);
+			shrout[k] = bc->PutOUTGate(shrres, ALL);
+		}
+
+		party->ExecCircuit();
+
+		for (uint32_t k = 0; k < nshares; k++) {
+			shrout[k]->get_clear_value_vec(&cvec, &tmpbitlen, &tmpnvals);
+			assert(tmpnvals == nvals);
+			for (uint32_t j = 0; j < nvals; j++) {
+				verify = (~((avec[k][j] ^ bvec[k][j]) & bvec[k][j]) ^ avec[k][j]) & mask;
+				if (!verbose)
+					cout << "\t" << get_role_name(role) << " local threads: values[" << k << "][" << j << "]: a = " << avec[k][j] <<
+					", b = " << bvec[k][j] << ", c = " << cvec[j] << ", verify = " << verify << endl;
+				assert(verify == cvec[j]);
+			}
+			free(cvec);
+		}
+		party->Reset();
+	}
+
+	for (uint32_t k = 0; k < nshares; k++) {
+		free(avec[k]);
+		free(bvec[k]);
+	}
+	free(avec);
+	free(bvec);
+	free(shrout);
+	delete party;
+
+	return 1;
+}
+
 int32_t read_test_options(int32_t* argcp, char*** argvp, e_role* role, uint32_t* bitlen, uint32_t* nvals, uint32_t* secparam,
 		string* address, uint16_t* port, int32_t* test_op, uint32_t* num_test_runs, e_mt_gen_alg *mt_alg, bool* verbose, bool* randomseed) {
 
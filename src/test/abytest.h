@@ -26,9 +26,13 @@
 #include <ENCRYPTO_utils/crypto/crypto.h>
 #include "../abycore/aby/abyparty.h"
 #include "../abycore/circuit/circuit.h"
+#include "../abycore/circuit/arithmeticcircuits.h"
 #include <ENCRYPTO_utils/timer.h>
 #include <ENCRYPTO_utils/parse_options.h>
 #include "../abycore/sharing/sharing.h"
+#include "../abycore/sharing/boolsharing.h"
+#include "../abycore/sharing/mtstore.h"
+#include "../abycore/sharing/yaosharing.h"
 #include "../examples/psi_scs/common/sort_compare_shuffle.h"
 #include "../examples/psi_phasing/common/phasing_circuit.h"
 #include "../examples/aes/common/aescircuit.h"
@@ -49,6 +53,39 @@ int32_t test_standard_ops(aby_ops_t* test_ops, ABYParty* party, uint32_t bitlen,
 int32_t test_vector_ops(aby_ops_t* test_ops, ABYParty* party, uint32_t bitlen, uint32_t nvals, uint32_t num_test_runs,
 		uint32_t nops, e_role role, bool verbose);
 
+int32_t test_dot_product(ABYParty* party, uint32_t bitlen, uint32_t nvals, uint32_t num_test_runs, e_role role, bool verbose);
+
+int32_t test_mat_mul(ABYParty* party, uint32_t bitlen, uint32_t num_test_runs, e_role role, bool verbose);
+
+int32_t test_circuit_optimization(ABYParty* party, uint32_t bitlen, uint32_t num_test_runs, e_role role, bool verbose);
+
+int32_t test_depth_optimization(ABYParty* party, uint32_t bitlen, uint32_t num_test_runs, e_role role, bool verbose);
+
+int32_t test_gate_coalescing(ABYParty* party, uint32_t bitlen, uint32_t num_test_runs, e_role role, bool verbose);
+
+int32_t test_planned_gate_values(ABYParty* party, uint32_t bitlen, uint32_t nvals, uint32_t num_test_runs, e_role role,
+		bool verbose);
+
+int32_t test_pipelined_yao(ABYParty* party, uint32_t bitlen, uint32_t nvals, uint32_t num_test_runs, e_role role, bool verbose);
+
+int32_t test_yao_garbling_batches(e_role role, char* address, uint16_t port, seclvl seclvl, uint32_t bitlen, uint32_t nvals,
+		e_mt_gen_alg mt_alg, bool verbose);
+
+int32_t test_compiled_circuit_file(ABYParty* party, uint32_t nvals, e_role role, bool verbose);
+
+int32_t test_mt_store(ABYParty* party, uint32_t bitlen, uint32_t nvals, e_role role, bool verbose);
+
+int32_t test_skipped_interactions(ABYParty* party, uint32_t bitlen, uint32_t num_test_runs, e_role role, bool verbose);
+
+int32_t test_vec_and_mux(ABYParty* party, uint32_t bitlen, uint32_t nvals, uint32_t num_test_runs, e_role role, bool verbose);
+
+int32_t test_setup_pool(ABYParty* party, uint32_t bitlen, uint32_t nvals, e_role role, bool verbose);
+
+int32_t test_arith_bitlen(ABYParty* party, uint32_t bitlen, uint32_t nvals, e_role role, bool verbose);
+
+int32_t test_bool_local_threads(e_role role, char* address, uint16_t port, seclvl seclvl, uint32_t bitlen, uint32_t nvals,
+		uint32_t num_test_runs, e_mt_gen_alg mt_alg, bool verbose);
+
 string get_op_name(e_operation op);
 
 #endif /* MAINS_ABYTEST_H_ */